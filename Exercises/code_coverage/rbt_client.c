@@ -7,8 +7,9 @@
  *  whatever message you tell it to through the command line arguments.
  *  rbt_server will receive the message and reply back with a simple reply.
  * 
- *  Run rbt_server first.  Then run rbt_client with command line arguments
- *  telling it what messages to send.  For example:
+ *  Run rbt_client with command line arguments telling it what messages to
+ *  send.  If rbt_server isn't running yet it waits for it, and if rbt_server
+ *  restarts it sends to the new one (see name_cache.h).  For example:
  * 
  *   rbt_client -s Hello
  * 
@@ -35,24 +36,21 @@
 #include "rbt_server.h"
 
 void options(int argc, char **argv);
+static int send_msg(void);
 
 char *name = RBT_SERVER_NAME; /* the name that we rbt_server registers and
  	 	 	 	 	 	 	 	 that we look up */
-rs_msgs_t msg; /* the message we will send to rbt_server, gotten
+uint16_t msgtype; /* the message we will send to rbt_server, gotten
  	 	 	 	  from the command line */
+char text[RBT_SAY_TEXT_MAX + 1]; /* what to say, for a say message */
 char *msgdesc; /* message description for diagnostics */
 char *progname;
 
-int coid;
-
 /*
  *  main
  */
 int main(int argc, char **argv)
 {
-
-	struct timespec stime;
-
 	progname = argv[0];
 
 	if (argc < 2)
@@ -66,30 +64,11 @@ int main(int argc, char **argv)
 			" -x         Server exit\n", progname);
 	}
 	/*
-	 * go into a loop, looking for rbt_server.  We loop because rbt_server may
-	 * not be running yet.
+	 * parse options, and send messages as appropriate.  rbt_server may not be
+	 * running yet, the sends wait for it to attach its name.
 	 */
-
-	/* fill in our nanosleep time for below */
-	stime.tv_sec = 1; /* retry once a second */
-	stime.tv_nsec = 0;
-	while (1)
-	{
-		if ((coid = name_open(RBT_SERVER_NAME, 0)) != -1)
-		{
-			break; /* found it, name_open() succeeded */
-		}
-		nanosleep(&stime, NULL);
-	}
-
-	// parse options, and send messages as appropriate
 	options(argc, argv);
 
-	if ( name_close(coid) == -1 )
-	{
-		fprintf(stderr, "%s: name_close failed\n", progname);
-	}
-
 	return EXIT_SUCCESS;
 }
 
@@ -108,7 +87,7 @@ void options(int argc, char **argv)
 {
 	int c;
 
-	msg.type = 0;
+	msgtype = 0;
 
 	while ((c = getopt(argc, argv, "xn:r:l:s:")) != -1)
 	{
@@ -121,11 +100,11 @@ void options(int argc, char **argv)
 			switch (*optarg)
 			{
 			case 'l':
-				msg.type = RS_MSGTYPE_RAISE_LEFT_ARM;
+				msgtype = RBT_MSG_RAISE_LEFT_ARM;
 				msgdesc = "raise left arm";
 				break;
 			case 'r':
-				msg.type = RS_MSGTYPE_RAISE_RIGHT_ARM;
+				msgtype = RBT_MSG_RAISE_RIGHT_ARM;
 				msgdesc = "raise right arm";
 				break;
 			}
@@ -134,28 +113,30 @@ void options(int argc, char **argv)
 			switch (*optarg)
 			{
 			case 'l':
-				msg.type = RS_MSGTYPE_LOWER_LEFT_ARM;
+				msgtype = RBT_MSG_LOWER_LEFT_ARM;
 				msgdesc = "lower left arm";
 				break;
 			case 'r':
-				msg.type = RS_MSGTYPE_LOWER_RIGHT_ARM;
+				msgtype = RBT_MSG_LOWER_RIGHT_ARM;
 				msgdesc = "lower right arm";
 				break;
 			}
 			break;
 		case 's':
-			msg.type = RS_MSGTYPE_SAY;
-			strncpy(msg.say.text, optarg, RS_MAX_TEXT_LEN);
-			msg.say.text[RS_MAX_TEXT_LEN] = '\0';
+			msgtype = RBT_MSG_SAY;
+			strncpy(text, optarg, RBT_SAY_TEXT_MAX);
+			text[RBT_SAY_TEXT_MAX] = '\0';
 			msgdesc = "say";
 			break;
 		case 'x':
-			msg.type = RS_MSGTYPE_EXIT;
+			msgtype = RBT_MSG_EXIT;
 			msgdesc = "exit";
 			break;
 		}
+		if (c == 'n' || msgtype == 0)
+			continue;
 		/* send message to rbt_server.  */
-		if (MsgSend(coid, &msg, sizeof(msg), NULL, 0) == -1)
+		if (send_msg() == -1)
 		{
 			fprintf(stderr, "%s:  MsgSend() failed: %s (%d)\n", progname,
 					strerror(errno), errno);
@@ -164,7 +145,7 @@ void options(int argc, char **argv)
 		printf("%s:  sent '%s' message\n", progname, msgdesc);
 	}
 
-	if (msg.type == 0)
+	if (msgtype == 0)
 	{
 		fprintf(stderr, "ERROR:  No valid command was given on command line.\n"
 			"use: %s command [command*]\n"
@@ -176,3 +157,31 @@ void options(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 }
+
+/*
+ *  send_msg
+ *
+ *  Sends rbt_server the message from the command line, through the stubs
+ *  generated into rbt_msgs.c -- each message goes out only as long as it is,
+ *  the say text without the rest of its buffer.
+ */
+static int send_msg(void)
+{
+	switch (msgtype)
+	{
+	case RBT_MSG_SAY:
+		return rbt_say(name, text);
+	case RBT_MSG_RAISE_LEFT_ARM:
+		return rbt_raise_left_arm(name);
+	case RBT_MSG_LOWER_LEFT_ARM:
+		return rbt_lower_left_arm(name);
+	case RBT_MSG_RAISE_RIGHT_ARM:
+		return rbt_raise_right_arm(name);
+	case RBT_MSG_LOWER_RIGHT_ARM:
+		return rbt_lower_right_arm(name);
+	case RBT_MSG_EXIT:
+		return rbt_exit(name);
+	}
+	errno = EINVAL;
+	return -1;
+}
@@ -0,0 +1,149 @@
+////////////////////////////////////////////////////////////////////////////////
+// rbt_msgs.c
+//
+// Generated by msggen from rbt.msg, don't edit, see rbt_msgs.h
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/neutrino.h>
+
+#include "name_cache.h"
+#include "rbt_msgs.h"
+
+// each type's header size, where the length of the data after it is (and
+// its size, 0 for none), the most data it can have and if it is a string
+static const struct
+{
+	uint16_t size;
+	uint16_t len_offset;
+	uint8_t len_size;
+	uint8_t string;
+	uint32_t max;
+} layouts[RBT_NUM_MSGS] =
+{
+	{ sizeof(rbt_say_t), offsetof(rbt_say_t, text_len), 2, 1, RBT_SAY_TEXT_MAX },
+	{ sizeof(rbt_raise_left_arm_t), 0, 0, 0, 0 },
+	{ sizeof(rbt_lower_left_arm_t), 0, 0, 0, 0 },
+	{ sizeof(rbt_raise_right_arm_t), 0, 0, 0, 0 },
+	{ sizeof(rbt_lower_right_arm_t), 0, 0, 0, 0 },
+	{ sizeof(rbt_exit_t), 0, 0, 0, 0 },
+};
+
+static int refuse(int rcvid, int error)
+{
+	if (-1 == MsgError(rcvid, error))
+		perror("MsgError");
+	return -1;
+}
+
+int rbt_dispatch(int rcvid, rbt_rx_t *msg, size_t received,
+		const rbt_handler_t handlers[RBT_NUM_MSGS], rbt_handler_t other, void *ctx)
+{
+	unsigned idx;
+	uint32_t len = 0;
+	uint16_t len16;
+
+	if (received > sizeof(*msg))
+		received = sizeof(*msg);
+	if (received < sizeof(msg->type))
+		return refuse(rcvid, EBADMSG);
+	// below the base wraps round to far past the end
+	idx = (unsigned)(msg->type - RBT_MSG_BASE);
+	if (idx >= RBT_NUM_MSGS || NULL == handlers[idx])
+	{
+		if (NULL != other)
+			return other(rcvid, msg, received, ctx);
+		return refuse(rcvid, ENOSYS);
+	}
+	if (received < layouts[idx].size)
+		return refuse(rcvid, EBADMSG);
+	if (layouts[idx].len_size)
+	{
+		if (sizeof(len16) == layouts[idx].len_size)
+		{
+			memcpy(&len16, msg->max + layouts[idx].len_offset, sizeof(len16));
+			len = len16;
+		}
+		else
+			memcpy(&len, msg->max + layouts[idx].len_offset, sizeof(len));
+		if (len > layouts[idx].max)
+			return refuse(rcvid, EMSGSIZE);
+		if (received < layouts[idx].size + len)
+			return refuse(rcvid, EBADMSG);
+		if (layouts[idx].string)
+			msg->max[layouts[idx].size + len] = '\0';
+	}
+	return handlers[idx](rcvid, msg, received, ctx);
+}
+
+int rbt_say(const char *name, const char *text)
+{
+	rbt_say_t msg;
+	iov_t siov[2];
+	size_t text_len = strlen(text);
+
+	if (text_len > RBT_SAY_TEXT_MAX)
+	{
+		errno = EMSGSIZE;
+		return -1;
+	}
+	msg.type = RBT_MSG_SAY;
+	msg.text_len = text_len;
+	SETIOV(&siov[0], &msg, sizeof(msg));
+	SETIOV(&siov[1], text, text_len);
+	if (-1 == name_cache_sendvs(name, siov, 2, NULL, 0))
+		return -1;
+	return 0;
+}
+
+int rbt_raise_left_arm(const char *name)
+{
+	rbt_raise_left_arm_t msg;
+
+	msg.type = RBT_MSG_RAISE_LEFT_ARM;
+	if (-1 == name_cache_send(name, &msg, sizeof(msg), NULL, 0))
+		return -1;
+	return 0;
+}
+
+int rbt_lower_left_arm(const char *name)
+{
+	rbt_lower_left_arm_t msg;
+
+	msg.type = RBT_MSG_LOWER_LEFT_ARM;
+	if (-1 == name_cache_send(name, &msg, sizeof(msg), NULL, 0))
+		return -1;
+	return 0;
+}
+
+int rbt_raise_right_arm(const char *name)
+{
+	rbt_raise_right_arm_t msg;
+
+	msg.type = RBT_MSG_RAISE_RIGHT_ARM;
+	if (-1 == name_cache_send(name, &msg, sizeof(msg), NULL, 0))
+		return -1;
+	return 0;
+}
+
+int rbt_lower_right_arm(const char *name)
+{
+	rbt_lower_right_arm_t msg;
+
+	msg.type = RBT_MSG_LOWER_RIGHT_ARM;
+	if (-1 == name_cache_send(name, &msg, sizeof(msg), NULL, 0))
+		return -1;
+	return 0;
+}
+
+int rbt_exit(const char *name)
+{
+	rbt_exit_t msg;
+
+	msg.type = RBT_MSG_EXIT;
+	if (-1 == name_cache_send(name, &msg, sizeof(msg), NULL, 0))
+		return -1;
+	return 0;
+}
@@ -0,0 +1,127 @@
+#ifndef _RBT_MSGS_H_
+#define _RBT_MSGS_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// rbt_msgs.h
+//
+// Generated by msggen from rbt.msg, don't edit: change that and run
+// "make msgs".
+//
+// What each message puts on the wire (header, then its data), with the
+// padding left in it:
+//
+//   say                    4 bytes + up to 100 of text
+//   raise_left_arm         2 bytes
+//   lower_left_arm         2 bytes
+//   raise_right_arm        2 bytes
+//   lower_right_arm        2 bytes
+//   exit                   2 bytes
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/neutrino.h>
+#include <sys/iomsg.h>
+
+#define RBT_MSG_BASE (_IO_MAX + 1)
+#define RBT_NUM_MSGS 6
+
+// message types, and their places in a handler table
+#define RBT_MSG_SAY (RBT_MSG_BASE + 0)
+#define RBT_IDX_SAY 0
+#define RBT_MSG_RAISE_LEFT_ARM (RBT_MSG_BASE + 1)
+#define RBT_IDX_RAISE_LEFT_ARM 1
+#define RBT_MSG_LOWER_LEFT_ARM (RBT_MSG_BASE + 2)
+#define RBT_IDX_LOWER_LEFT_ARM 2
+#define RBT_MSG_RAISE_RIGHT_ARM (RBT_MSG_BASE + 3)
+#define RBT_IDX_RAISE_RIGHT_ARM 3
+#define RBT_MSG_LOWER_RIGHT_ARM (RBT_MSG_BASE + 4)
+#define RBT_IDX_LOWER_RIGHT_ARM 4
+#define RBT_MSG_EXIT (RBT_MSG_BASE + 5)
+#define RBT_IDX_EXIT 5
+
+// make the robot say text
+typedef struct
+{
+	uint16_t type;
+	uint16_t text_len; // bytes of text after the header
+} rbt_say_t;
+_Static_assert(sizeof(rbt_say_t) == 4, "rbt_say_t is 4 bytes");
+_Static_assert(offsetof(rbt_say_t, text_len) == 2, "text_len at 2");
+// followed by text_len bytes of text, at most:
+#define RBT_SAY_TEXT_MAX 100
+// where they are in a received message, nul terminated by the dispatcher
+#define RBT_SAY_TEXT(msg) ((char *)((msg) + 1))
+
+typedef struct
+{
+	uint16_t type;
+} rbt_raise_left_arm_t;
+_Static_assert(sizeof(rbt_raise_left_arm_t) == 2, "rbt_raise_left_arm_t is 2 bytes");
+
+typedef struct
+{
+	uint16_t type;
+} rbt_lower_left_arm_t;
+_Static_assert(sizeof(rbt_lower_left_arm_t) == 2, "rbt_lower_left_arm_t is 2 bytes");
+
+typedef struct
+{
+	uint16_t type;
+} rbt_raise_right_arm_t;
+_Static_assert(sizeof(rbt_raise_right_arm_t) == 2, "rbt_raise_right_arm_t is 2 bytes");
+
+typedef struct
+{
+	uint16_t type;
+} rbt_lower_right_arm_t;
+_Static_assert(sizeof(rbt_lower_right_arm_t) == 2, "rbt_lower_right_arm_t is 2 bytes");
+
+// tell rbt_server to exit
+typedef struct
+{
+	uint16_t type;
+} rbt_exit_t;
+_Static_assert(sizeof(rbt_exit_t) == 2, "rbt_exit_t is 2 bytes");
+
+// everything the server receives: a pulse, or any message with all of
+// its data (and a nul after a string), so one MsgReceive() gets it all
+#define RBT_RX_SIZE 105
+
+typedef union
+{
+	uint16_t type;
+	struct _pulse pulse;
+	rbt_say_t say;
+	rbt_raise_left_arm_t raise_left_arm;
+	rbt_lower_left_arm_t lower_left_arm;
+	rbt_raise_right_arm_t raise_right_arm;
+	rbt_lower_right_arm_t lower_right_arm;
+	rbt_exit_t exit;
+	char max[RBT_RX_SIZE];
+} rbt_rx_t;
+
+// handles one message; what it returns, rbt_dispatch() does
+typedef int (*rbt_handler_t)(int rcvid, rbt_rx_t *msg, size_t received, void *ctx);
+
+// server side: check the message received into msg (received bytes of it)
+// against the layout of its type and call handlers[type - RBT_MSG_BASE]
+// with it.  Types outside the protocol, or without a handler, go to other
+// (or, if that is NULL, get MsgError(ENOSYS)).  A message too short for
+// its type gets MsgError(EBADMSG), one with too much data EMSGSIZE, and
+// -1 is returned.
+int rbt_dispatch(int rcvid, rbt_rx_t *msg, size_t received,
+		const rbt_handler_t handlers[RBT_NUM_MSGS], rbt_handler_t other, void *ctx);
+
+// client side: send each message to the server attached as name, waiting
+// for it and sending again if it restarts (name_cache_send()).  The
+// header goes from the stack and any data straight from the caller's
+// buffer.  Return 0, or -1 with errno set (EMSGSIZE for too much data).
+int rbt_say(const char *name, const char *text);
+int rbt_raise_left_arm(const char *name);
+int rbt_lower_left_arm(const char *name);
+int rbt_raise_right_arm(const char *name);
+int rbt_lower_right_arm(const char *name);
+int rbt_exit(const char *name);
+
+#endif //_RBT_MSGS_H_
@@ -41,26 +41,35 @@
 #include "rbt_server.h"
 #include <signal.h>
 
-static void say(int rcvid, char *text);
-static void raise_left_arm(int rcvid);
-static void lower_left_arm(int rcvid);
-static void raise_right_arm(int rcvid);
-static void lower_right_arm(int rcvid);
+static int say(int rcvid, rbt_rx_t *msg, size_t received, void *ctx);
+static int raise_left_arm(int rcvid, rbt_rx_t *msg, size_t received, void *ctx);
+static int lower_left_arm(int rcvid, rbt_rx_t *msg, size_t received, void *ctx);
+static int raise_right_arm(int rcvid, rbt_rx_t *msg, size_t received, void *ctx);
+static int lower_right_arm(int rcvid, rbt_rx_t *msg, size_t received, void *ctx);
+static int server_exit(int rcvid, rbt_rx_t *msg, size_t received, void *ctx);
+static int other_msg(int rcvid, rbt_rx_t *msg, size_t received, void *ctx);
 static void handle_pulse(struct _pulse *pulse);
 
 /*
- * rbs_msgs_t is a union of all the types of messages we expect to receive.
- * In our MsgReceive() below, we will need a message buffer that is big
- * enough for our largest expected message since we could receive any of them
- * at any time.  A union is an easy way of doing that.  We expect to receive
- * pulse messages (of type struct _pulse) and the message from rbt_client
+ * rbt_rx_t (generated, see rbt_server.h) is a union of all the types of
+ * messages we expect to receive.  In our MsgReceive() below, we will need a
+ * message buffer that is big enough for our largest expected message since
+ * we could receive any of them at any time.  A union is an easy way of doing
+ * that.  We expect to receive pulse messages (of type struct _pulse) and the
+ * messages from rbt_client.
+ *
+ * rbt_dispatch() checks each message is as long as its type says and calls
+ * its handler from this table, indexed by type.
  */
-typedef union
+static const rbt_handler_t handlers[RBT_NUM_MSGS] =
 {
-	uint16_t type;
-	struct _pulse pulse;
-	rs_msgs_t rbt_msg;
-} message_buf_t;
+	[RBT_IDX_SAY] = say,
+	[RBT_IDX_RAISE_LEFT_ARM] = raise_left_arm,
+	[RBT_IDX_LOWER_LEFT_ARM] = lower_left_arm,
+	[RBT_IDX_RAISE_RIGHT_ARM] = raise_right_arm,
+	[RBT_IDX_LOWER_RIGHT_ARM] = lower_right_arm,
+	[RBT_IDX_EXIT] = server_exit,
+};
 
 #define LOWERED	0
 #define RAISED		1
@@ -88,7 +97,8 @@ void sigexit(int sig)
 int main(int argc, char **argv, char **envp)
 {
 	int rcvid;
-	message_buf_t msg;
+	rbt_rx_t msg;
+	struct _msg_info info;
 	name_attach_t *attach;
 
 	progname = argv[0];
@@ -109,7 +119,7 @@ int main(int argc, char **argv, char **envp)
 		 * wait for a message.  If there is none already then this will not
 		 * return until there is one.
 		 */
-		rcvid = MsgReceive(attach->chid, &msg, sizeof(msg), NULL);
+		rcvid = MsgReceive(attach->chid, &msg, sizeof(msg), &info);
 		if (rcvid == -1)
 		{ //was there an error receiving msg?
 			if (EINTR == errno )
@@ -119,36 +129,7 @@ int main(int argc, char **argv, char **envp)
 		}
 		else if (rcvid > 0)
 		{ //msg has been received
-			switch (msg.type)
-			{
-			case _IO_CONNECT:
-				MsgReply(rcvid, EOK, NULL, 0);
-				break;
-			case RS_MSGTYPE_SAY:
-				say(rcvid, msg.rbt_msg.say.text);
-				break;
-			case RS_MSGTYPE_RAISE_LEFT_ARM:
-				raise_left_arm(rcvid);
-				break;
-			case RS_MSGTYPE_LOWER_LEFT_ARM:
-				lower_left_arm(rcvid);
-				break;
-			case RS_MSGTYPE_RAISE_RIGHT_ARM:
-				raise_right_arm(rcvid);
-				break;
-			case RS_MSGTYPE_LOWER_RIGHT_ARM:
-				lower_right_arm(rcvid);
-				break;
-			case RS_MSGTYPE_EXIT:
-				printf("server exiting from client request\n");
-				MsgReply(rcvid, EOK, NULL, 0);
-				exit(EXIT_SUCCESS);
-				break;
-			default:
-				// MsgError back to any other msg types
-				MsgError(rcvid, ENOSYS);
-				break;
-			}
+			rbt_dispatch(rcvid, &msg, info.msglen, handlers, other_msg, NULL);
 		}
 		/*
 		 * rcvid will be 0 if we received a pulse message.  Our client is not
@@ -167,15 +148,17 @@ int main(int argc, char **argv, char **envp)
 /*
  * 	say
  *
- * 	This routine pretends we make the robot say the text
+ * 	This routine pretends we make the robot say the text, which follows the
+ * 	message header, nul terminated by rbt_dispatch()
  */
-static void say(int rcvid, char *text)
+static int say(int rcvid, rbt_rx_t *msg, size_t received, void *ctx)
 {
-	printf("%s:  robot said '%s'\n", progname, text);
+	printf("%s:  robot said '%s'\n", progname, RBT_SAY_TEXT(&msg->say));
 	if (MsgReply(rcvid, EOK, NULL, 0) == -1)
 	{
 		fprintf(stderr, "%s:  MsgReply() failed\n", progname);
 	}
+	return 0;
 }
 
 /*
@@ -183,7 +166,7 @@ static void say(int rcvid, char *text)
  *
  * 	This routine pretends we make the robot raise its left arm
  */
-static void raise_left_arm(int rcvid)
+static int raise_left_arm(int rcvid, rbt_rx_t *msg, size_t received, void *ctx)
 {
 	if (left_arm_state == LOWERED)
 	{
@@ -195,6 +178,7 @@ static void raise_left_arm(int rcvid)
 	{
 		fprintf(stderr, "%s:  MsgReply() failed\n", progname);
 	}
+	return 0;
 }
 
 /*
@@ -202,7 +186,7 @@ static void raise_left_arm(int rcvid)
  *
  * 	This routine pretends we make the robot lower its left arm
  */
-static void lower_left_arm(int rcvid)
+static int lower_left_arm(int rcvid, rbt_rx_t *msg, size_t received, void *ctx)
 {
 	if (left_arm_state == RAISED)
 	{
@@ -214,6 +198,7 @@ static void lower_left_arm(int rcvid)
 	{
 		fprintf(stderr, "%s:  MsgReply() failed\n", progname);
 	}
+	return 0;
 }
 
 /*
@@ -221,7 +206,7 @@ static void lower_left_arm(int rcvid)
  *
  * 	This routine pretends we make the robot raise its right arm
  */
-static void raise_right_arm(int rcvid)
+static int raise_right_arm(int rcvid, rbt_rx_t *msg, size_t received, void *ctx)
 {
 	if (right_arm_state == LOWERED)
 	{
@@ -233,6 +218,7 @@ static void raise_right_arm(int rcvid)
 	{
 		fprintf(stderr, "%s:  MsgReply() failed\n", progname);
 	}
+	return 0;
 }
 
 /*
@@ -240,7 +226,7 @@ static void raise_right_arm(int rcvid)
  *
  * 	This routine pretends we make the robot lower its right arm
  */
-static void lower_right_arm(int rcvid)
+static int lower_right_arm(int rcvid, rbt_rx_t *msg, size_t received, void *ctx)
 {
 	if (right_arm_state == RAISED)
 	{
@@ -252,6 +238,38 @@ static void lower_right_arm(int rcvid)
 	{
 		fprintf(stderr, "%s:  MsgReply() failed\n", progname);
 	}
+	return 0;
+}
+
+/*
+ * 	server_exit
+ *
+ * 	rbt_client asked us to exit
+ */
+static int server_exit(int rcvid, rbt_rx_t *msg, size_t received, void *ctx)
+{
+	printf("server exiting from client request\n");
+	MsgReply(rcvid, EOK, NULL, 0);
+	exit(EXIT_SUCCESS);
+	return 0;
+}
+
+/*
+ * 	other_msg
+ *
+ * 	Any message that isn't one of ours: name_open() connecting to us, or
+ * 	something we don't handle
+ */
+static int other_msg(int rcvid, rbt_rx_t *msg, size_t received, void *ctx)
+{
+	if (_IO_CONNECT == msg->type)
+	{
+		MsgReply(rcvid, EOK, NULL, 0);
+		return 0;
+	}
+	// MsgError back to any other msg types
+	MsgError(rcvid, ENOSYS);
+	return -1;
 }
 
 /*
@@ -2,8 +2,13 @@
  * 	rbt_server.h
  */
 
-#include <inttypes.h>
-#include <sys/iomsg.h>
+/*
+ * the messages, their RBT_MSG_* type codes, the union rbt_server receives
+ * into, its dispatcher and the client stubs are generated from rbt.msg into
+ * rbt_msgs.h and rbt_msgs.c by ../ipc/msggen -- change rbt.msg and
+ * "make msgs" rather than editing them
+ */
+#include "rbt_msgs.h"
 
 /*
  * this is the name rbt_server attaches -- redefine to something personalized
@@ -12,31 +17,4 @@
 #define RBT_SERVER_NAME			"rbt_server"
 /* #define RBT_SERVER_NAME			"wally_rbt_server" */
 
-#define RS_MAX_TEXT_LEN			100
-
-#define RS_MSGTYPE_SAY				(_IO_MAX+1) /* _IO_MAX defined in iomsg.h */
-#define RS_MSGTYPE_RAISE_LEFT_ARM	(_IO_MAX+2)
-#define RS_MSGTYPE_LOWER_LEFT_ARM	(_IO_MAX+3)
-#define RS_MSGTYPE_RAISE_RIGHT_ARM	(_IO_MAX+4)
-#define RS_MSGTYPE_LOWER_RIGHT_ARM	(_IO_MAX+5)
-#define RS_MSGTYPE_EXIT 		    (_IO_MAX+6)
-
-/* message structure for the RS_MSGTYPE_SAY message */
-typedef struct
-{
-	uint16_t type; /* RS_MSGTYPE_SAY */
-	char text[RS_MAX_TEXT_LEN + 1];
-} rs_msg_say_t;
-
-/* all other RS_MSGTYPE_* messages are simple commands with no data */
-
-/*
- * union of all the possible messages that rbt_server is expecting
- */
-typedef union
-{
-	uint16_t type;
-	rs_msg_say_t say;
-} rs_msgs_t;
-
 /* replies for all messages is simply EOK in the MsgReply() status argument */
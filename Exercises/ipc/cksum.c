@@ -0,0 +1,744 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum.c
+//
+// Checksum kernels and runtime kernel selection, see cksum.h.
+//
+// All kernels sum into unsigned 32 bit arithmetic, which wraps exactly like the
+// original int accumulator did on our targets without relying on signed
+// overflow.  Whether a byte counts as signed or unsigned follows the platform's
+// char type (signed on x86, unsigned on ARM), as the original code did.
+//
+// The SIMD kernels use the "sum of absolute differences against zero" trick
+// to add 8 (or 16) bytes into one 64 bit lane per instruction.  For signed
+// chars every byte is biased by 0x80 first and 128 per byte is subtracted at
+// the end.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "cksum.h"
+
+#if defined(__x86_64__)
+#define CKSUM_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CKSUM_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+// the CRC instructions are optional before ARMv8.1: always built, used if
+// the cpu has them (arm_crc_supported())
+#if defined(__aarch64__)
+#define CKSUM_HAVE_ARM_CRC 1
+#include <arm_acle.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#endif
+#endif
+
+#if CHAR_MIN < 0
+#define CKSUM_SIGNED_CHAR 1
+#endif
+
+typedef uint32_t (*cksum_fn_t)(const void *data, size_t len);
+
+static uint32_t cksum_scalar(const void *data, size_t len)
+{
+	const char *c = data;
+	uint32_t cksum = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		cksum += (uint32_t)(int)c[i];
+	return cksum;
+}
+
+#ifdef CKSUM_HAVE_X86
+__attribute__((target("sse2")))
+static uint32_t cksum_sse2(const void *data, size_t len)
+{
+	const uint8_t *p = data;
+	const __m128i zero = _mm_setzero_si128();
+#ifdef CKSUM_SIGNED_CHAR
+	const __m128i bias = _mm_set1_epi8((char)0x80);
+#endif
+	__m128i acc0 = _mm_setzero_si128();
+	__m128i acc1 = _mm_setzero_si128();
+	__m128i v0, v1, v2, v3;
+	size_t n = len & ~(size_t)63;
+	size_t i;
+	uint64_t total;
+
+	for (i = 0; i < n; i += 64)
+	{
+		v0 = _mm_loadu_si128((const __m128i *)(p + i));
+		v1 = _mm_loadu_si128((const __m128i *)(p + i + 16));
+		v2 = _mm_loadu_si128((const __m128i *)(p + i + 32));
+		v3 = _mm_loadu_si128((const __m128i *)(p + i + 48));
+#ifdef CKSUM_SIGNED_CHAR
+		v0 = _mm_xor_si128(v0, bias);
+		v1 = _mm_xor_si128(v1, bias);
+		v2 = _mm_xor_si128(v2, bias);
+		v3 = _mm_xor_si128(v3, bias);
+#endif
+		acc0 = _mm_add_epi64(acc0, _mm_sad_epu8(v0, zero));
+		acc1 = _mm_add_epi64(acc1, _mm_sad_epu8(v1, zero));
+		acc0 = _mm_add_epi64(acc0, _mm_sad_epu8(v2, zero));
+		acc1 = _mm_add_epi64(acc1, _mm_sad_epu8(v3, zero));
+	}
+	acc0 = _mm_add_epi64(acc0, acc1);
+	total = (uint64_t)_mm_cvtsi128_si64(acc0)
+			+ (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(acc0, acc0));
+#ifdef CKSUM_SIGNED_CHAR
+	total -= (uint64_t)0x80 * n;
+#endif
+	return (uint32_t)total + cksum_scalar(p + n, len - n);
+}
+
+__attribute__((target("avx2")))
+static uint32_t cksum_avx2(const void *data, size_t len)
+{
+	const uint8_t *p = data;
+	const __m256i zero = _mm256_setzero_si256();
+#ifdef CKSUM_SIGNED_CHAR
+	const __m256i bias = _mm256_set1_epi8((char)0x80);
+#endif
+	__m256i acc0 = _mm256_setzero_si256();
+	__m256i acc1 = _mm256_setzero_si256();
+	__m256i v0, v1, v2, v3;
+	__m128i acc;
+	size_t n = len & ~(size_t)127;
+	size_t i;
+	uint64_t total;
+
+	for (i = 0; i < n; i += 128)
+	{
+		v0 = _mm256_loadu_si256((const __m256i *)(p + i));
+		v1 = _mm256_loadu_si256((const __m256i *)(p + i + 32));
+		v2 = _mm256_loadu_si256((const __m256i *)(p + i + 64));
+		v3 = _mm256_loadu_si256((const __m256i *)(p + i + 96));
+#ifdef CKSUM_SIGNED_CHAR
+		v0 = _mm256_xor_si256(v0, bias);
+		v1 = _mm256_xor_si256(v1, bias);
+		v2 = _mm256_xor_si256(v2, bias);
+		v3 = _mm256_xor_si256(v3, bias);
+#endif
+		acc0 = _mm256_add_epi64(acc0, _mm256_sad_epu8(v0, zero));
+		acc1 = _mm256_add_epi64(acc1, _mm256_sad_epu8(v1, zero));
+		acc0 = _mm256_add_epi64(acc0, _mm256_sad_epu8(v2, zero));
+		acc1 = _mm256_add_epi64(acc1, _mm256_sad_epu8(v3, zero));
+	}
+	for (; i + 32 <= len; i += 32)
+	{
+		v0 = _mm256_loadu_si256((const __m256i *)(p + i));
+#ifdef CKSUM_SIGNED_CHAR
+		v0 = _mm256_xor_si256(v0, bias);
+#endif
+		acc1 = _mm256_add_epi64(acc1, _mm256_sad_epu8(v0, zero));
+	}
+	n = i;
+	acc0 = _mm256_add_epi64(acc0, acc1);
+	acc = _mm_add_epi64(_mm256_castsi256_si128(acc0), _mm256_extracti128_si256(acc0, 1));
+	total = (uint64_t)_mm_cvtsi128_si64(acc)
+			+ (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc));
+#ifdef CKSUM_SIGNED_CHAR
+	total -= (uint64_t)0x80 * n;
+#endif
+	// stay in this function for the tail: calling into the legacy-encoded sse2
+	// kernel with the upper ymm halves dirty costs a state transition
+	return (uint32_t)total + cksum_scalar(p + n, len - n);
+}
+#endif
+
+#ifdef CKSUM_HAVE_NEON
+static uint32_t cksum_neon(const void *data, size_t len)
+{
+	const uint8_t *p = data;
+#ifdef CKSUM_SIGNED_CHAR
+	const uint8x16_t bias = vdupq_n_u8(0x80);
+#endif
+	uint64x2_t acc = vdupq_n_u64(0);
+	uint8x16_t v0, v1, v2, v3;
+	uint16x8_t sum16;
+	size_t n = len & ~(size_t)63;
+	size_t i;
+	uint64_t total;
+
+	for (i = 0; i < n; i += 64)
+	{
+		v0 = vld1q_u8(p + i);
+		v1 = vld1q_u8(p + i + 16);
+		v2 = vld1q_u8(p + i + 32);
+		v3 = vld1q_u8(p + i + 48);
+#ifdef CKSUM_SIGNED_CHAR
+		v0 = veorq_u8(v0, bias);
+		v1 = veorq_u8(v1, bias);
+		v2 = veorq_u8(v2, bias);
+		v3 = veorq_u8(v3, bias);
+#endif
+		// each 16 bit lane collects at most 8 bytes, so it can't overflow
+		sum16 = vpaddlq_u8(v0);
+		sum16 = vpadalq_u8(sum16, v1);
+		sum16 = vpadalq_u8(sum16, v2);
+		sum16 = vpadalq_u8(sum16, v3);
+		acc = vpadalq_u32(acc, vpaddlq_u16(sum16));
+	}
+	total = vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1);
+#ifdef CKSUM_SIGNED_CHAR
+	total -= (uint64_t)0x80 * n;
+#endif
+	return (uint32_t)total + cksum_scalar(p + n, len - n);
+}
+#endif
+
+// XXH64, following the reference algorithm
+
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t xxh_rotl64(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+// unaligned little-endian loads
+static inline uint64_t xxh_read64(const uint8_t *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+static inline uint32_t xxh_read32(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap32(v);
+#endif
+	return v;
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input)
+{
+	acc += input * XXH_PRIME64_2;
+	acc = xxh_rotl64(acc, 31);
+	return acc * XXH_PRIME64_1;
+}
+
+static inline uint64_t xxh_merge_round(uint64_t acc, uint64_t val)
+{
+	acc ^= xxh_round(0, val);
+	return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+uint64_t cksum_xxh64(const void *data, size_t len, uint64_t seed)
+{
+	const uint8_t *p = data;
+	const uint8_t *end = p + len;
+	uint64_t h, v1, v2, v3, v4;
+
+	if (len >= 32)
+	{
+		const uint8_t *limit = end - 32;
+
+		v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+		v2 = seed + XXH_PRIME64_2;
+		v3 = seed;
+		v4 = seed - XXH_PRIME64_1;
+		do
+		{
+			v1 = xxh_round(v1, xxh_read64(p));
+			v2 = xxh_round(v2, xxh_read64(p + 8));
+			v3 = xxh_round(v3, xxh_read64(p + 16));
+			v4 = xxh_round(v4, xxh_read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+
+		h = xxh_rotl64(v1, 1) + xxh_rotl64(v2, 7) + xxh_rotl64(v3, 12) + xxh_rotl64(v4, 18);
+		h = xxh_merge_round(h, v1);
+		h = xxh_merge_round(h, v2);
+		h = xxh_merge_round(h, v3);
+		h = xxh_merge_round(h, v4);
+	}
+	else
+	{
+		h = seed + XXH_PRIME64_5;
+	}
+
+	h += len;
+
+	while (p + 8 <= end)
+	{
+		h ^= xxh_round(0, xxh_read64(p));
+		h = xxh_rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+		p += 8;
+	}
+	if (p + 4 <= end)
+	{
+		h ^= (uint64_t)xxh_read32(p) * XXH_PRIME64_1;
+		h = xxh_rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+		p += 4;
+	}
+	while (p < end)
+	{
+		h ^= (*p) * XXH_PRIME64_5;
+		h = xxh_rotl64(h, 11) * XXH_PRIME64_1;
+		p++;
+	}
+
+	h ^= h >> 33;
+	h *= XXH_PRIME64_2;
+	h ^= h >> 29;
+	h *= XXH_PRIME64_3;
+	h ^= h >> 32;
+	return h;
+}
+
+// CRC-32C (Castagnoli polynomial, bit reflected as in iSCSI, ext4, SCTP).
+//
+// Everything here works on the raw CRC register; cksum_crc32c() does the
+// pre and post inversion.  Without CRC instructions a slicing-by-8 table
+// implementation is used.  With them, one instruction folds in 8 bytes but
+// has a latency of 3 cycles, so the data is split into three streams that are
+// computed side by side and then combined: a CRC is linear, so shifting the
+// first stream's register over the length of the second (multiplying by
+// x^(8*len) modulo the polynomial) and xoring in the second's gives the CRC
+// of both.  The shift for the fixed block lengths is done with lookup tables.
+
+#define CRC32C_POLY 0x82F63B78 // reflected
+
+// blocks of 3 streams, long ones for big buffers, short ones for the rest
+#define CRC32C_LONG 8192
+#define CRC32C_SHORT 256
+
+static uint32_t crc32c_table[8][256];
+static uint32_t crc32c_long_shift[4][256];
+static uint32_t crc32c_short_shift[4][256];
+static int crc32c_hw_supported = 0;
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+// a * b modulo the polynomial, reflected (bit 31 is x^0).  a must not be 0.
+static uint32_t crc32c_multmodp(uint32_t a, uint32_t b)
+{
+	uint32_t m = (uint32_t)1 << 31;
+	uint32_t p = 0;
+
+	for (;;)
+	{
+		if (a & m)
+		{
+			p ^= b;
+			if (0 == (a & (m - 1)))
+				break;
+		}
+		m >>= 1;
+		b = (b & 1) ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+	}
+	return p;
+}
+
+// x^(8 * len) modulo the polynomial
+static uint32_t crc32c_x8nmodp(size_t len)
+{
+	uint32_t xpow = (uint32_t)1 << 30; // x^1
+	uint32_t p = (uint32_t)1 << 31; // x^0
+	size_t n = len * 8;
+
+	while (n)
+	{
+		if (n & 1)
+			p = crc32c_multmodp(xpow, p);
+		xpow = crc32c_multmodp(xpow, xpow);
+		n >>= 1;
+	}
+	return p;
+}
+
+// tables to multiply any register by xpow a byte at a time
+static void crc32c_shift_init(uint32_t shift[4][256], size_t len)
+{
+	uint32_t xpow = crc32c_x8nmodp(len);
+	unsigned i, b;
+
+	for (i = 0; i < 4; i++)
+		for (b = 0; b < 256; b++)
+			shift[i][b] = crc32c_multmodp(xpow, (uint32_t)b << (8 * i));
+}
+
+static inline uint32_t crc32c_shift(uint32_t shift[4][256], uint32_t crc)
+{
+	return shift[0][crc & 0xff] ^ shift[1][(crc >> 8) & 0xff] ^ shift[2][(crc >> 16) & 0xff]
+			^ shift[3][crc >> 24];
+}
+
+#ifdef CKSUM_HAVE_ARM_CRC
+static int arm_crc_supported(void)
+{
+#if defined(__ARM_FEATURE_CRC32)
+	return 1; // the compiler was told the cpu has them (-march=armv8-a+crc)
+#elif defined(__linux__)
+	return 0 != (getauxval(AT_HWCAP) & HWCAP_CRC32);
+#else
+	// nothing to ask on QNX short of the build flag, see the Makefile
+	return 0;
+#endif
+}
+#endif
+
+static void crc32c_init(void)
+{
+	uint32_t crc;
+	unsigned n, k, i;
+
+	for (n = 0; n < 256; n++)
+	{
+		crc = n;
+		for (k = 0; k < 8; k++)
+			crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+		crc32c_table[0][n] = crc;
+	}
+	for (n = 0; n < 256; n++)
+	{
+		crc = crc32c_table[0][n];
+		for (i = 1; i < 8; i++)
+		{
+			crc = (crc >> 8) ^ crc32c_table[0][crc & 0xff];
+			crc32c_table[i][n] = crc;
+		}
+	}
+	crc32c_shift_init(crc32c_long_shift, CRC32C_LONG);
+	crc32c_shift_init(crc32c_short_shift, CRC32C_SHORT);
+
+#if defined(CKSUM_HAVE_X86)
+	__builtin_cpu_init();
+	crc32c_hw_supported = __builtin_cpu_supports("sse4.2");
+#elif defined(CKSUM_HAVE_ARM_CRC)
+	crc32c_hw_supported = arm_crc_supported();
+#endif
+}
+
+static uint32_t crc32c_sw(uint32_t crc, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+	uint64_t v;
+	uint32_t hi;
+
+	for (; len >= 8; len -= 8, p += 8)
+	{
+		v = xxh_read64(p) ^ crc;
+		crc = (uint32_t)v;
+		hi = (uint32_t)(v >> 32);
+		crc = crc32c_table[7][crc & 0xff] ^ crc32c_table[6][(crc >> 8) & 0xff]
+				^ crc32c_table[5][(crc >> 16) & 0xff] ^ crc32c_table[4][crc >> 24]
+				^ crc32c_table[3][hi & 0xff] ^ crc32c_table[2][(hi >> 8) & 0xff]
+				^ crc32c_table[1][(hi >> 16) & 0xff] ^ crc32c_table[0][hi >> 24];
+	}
+	while (len--)
+		crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *p++) & 0xff];
+	return crc;
+}
+
+#if defined(CKSUM_HAVE_X86)
+#define CKSUM_HAVE_HW_CRC 1
+#define CRC32C_TARGET __attribute__((target("sse4.2")))
+
+CRC32C_TARGET static inline uint32_t crc32c_hw_u64(uint32_t crc, const uint8_t *p)
+{
+	return (uint32_t)_mm_crc32_u64(crc, xxh_read64(p));
+}
+
+CRC32C_TARGET static inline uint32_t crc32c_hw_u8(uint32_t crc, uint8_t b)
+{
+	return _mm_crc32_u8(crc, b);
+}
+#elif defined(CKSUM_HAVE_ARM_CRC)
+#define CKSUM_HAVE_HW_CRC 1
+#define CRC32C_TARGET __attribute__((target("+crc")))
+
+CRC32C_TARGET static inline uint32_t crc32c_hw_u64(uint32_t crc, const uint8_t *p)
+{
+	return __crc32cd(crc, xxh_read64(p));
+}
+
+CRC32C_TARGET static inline uint32_t crc32c_hw_u8(uint32_t crc, uint8_t b)
+{
+	return __crc32cb(crc, b);
+}
+#endif
+
+#ifdef CKSUM_HAVE_HW_CRC
+// three streams of block bytes each, as long as there is data for them
+CRC32C_TARGET static inline uint32_t crc32c_hw_blocks(uint32_t crc, const uint8_t **pp,
+		size_t *len, size_t block, uint32_t shift[4][256])
+{
+	const uint8_t *p = *pp;
+	const uint8_t *end;
+	uint32_t crc1, crc2;
+
+	while (*len >= 3 * block)
+	{
+		crc1 = crc2 = 0;
+		for (end = p + block; p < end; p += 8)
+		{
+			crc = crc32c_hw_u64(crc, p);
+			crc1 = crc32c_hw_u64(crc1, p + block);
+			crc2 = crc32c_hw_u64(crc2, p + 2 * block);
+		}
+		crc = crc32c_shift(shift, crc) ^ crc1;
+		crc = crc32c_shift(shift, crc) ^ crc2;
+		p += 2 * block;
+		*len -= 3 * block;
+	}
+	*pp = p;
+	return crc;
+}
+
+CRC32C_TARGET static uint32_t crc32c_hw(uint32_t crc, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+
+	crc = crc32c_hw_blocks(crc, &p, &len, CRC32C_LONG, crc32c_long_shift);
+	crc = crc32c_hw_blocks(crc, &p, &len, CRC32C_SHORT, crc32c_short_shift);
+	for (; len >= 8; len -= 8, p += 8)
+		crc = crc32c_hw_u64(crc, p);
+	while (len--)
+		crc = crc32c_hw_u8(crc, *p++);
+	return crc;
+}
+#endif
+
+static const char *kernel_names[CKSUM_KERNEL_COUNT] =
+{ "auto", "scalar", "sse2", "avx2", "neon" };
+
+// the kernel in use, resolved on first call.  Resolution is idempotent so a
+// race between two threads doing it at once is harmless.
+static cksum_kernel_t current_kernel = CKSUM_KERNEL_AUTO;
+static cksum_fn_t current_fn = NULL;
+
+static cksum_fn_t kernel_fn(cksum_kernel_t kernel)
+{
+	switch (kernel)
+	{
+	case CKSUM_KERNEL_SCALAR:
+		return cksum_scalar;
+#ifdef CKSUM_HAVE_X86
+	case CKSUM_KERNEL_SSE2:
+		return cksum_sse2;
+	case CKSUM_KERNEL_AVX2:
+		return cksum_avx2;
+#endif
+#ifdef CKSUM_HAVE_NEON
+	case CKSUM_KERNEL_NEON:
+		return cksum_neon;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+int cksum_kernel_supported(cksum_kernel_t kernel)
+{
+	switch (kernel)
+	{
+	case CKSUM_KERNEL_AUTO:
+	case CKSUM_KERNEL_SCALAR:
+		return 1;
+#ifdef CKSUM_HAVE_X86
+	case CKSUM_KERNEL_SSE2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse2");
+	case CKSUM_KERNEL_AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+#ifdef CKSUM_HAVE_NEON
+	case CKSUM_KERNEL_NEON:
+		return 1; // part of the base instruction set when the compiler emits it
+#endif
+	default:
+		return 0;
+	}
+}
+
+static cksum_kernel_t best_kernel(void)
+{
+	static const cksum_kernel_t preference[] =
+	{ CKSUM_KERNEL_AVX2, CKSUM_KERNEL_SSE2, CKSUM_KERNEL_NEON };
+	unsigned i;
+
+	for (i = 0; i < sizeof(preference) / sizeof(preference[0]); i++)
+	{
+		if (cksum_kernel_supported(preference[i]))
+			return preference[i];
+	}
+	return CKSUM_KERNEL_SCALAR;
+}
+
+int cksum_kernel_select(cksum_kernel_t kernel)
+{
+	if (kernel == CKSUM_KERNEL_AUTO)
+		kernel = best_kernel();
+	if (!cksum_kernel_supported(kernel))
+	{
+		errno = ENOTSUP;
+		return -1;
+	}
+	current_kernel = kernel;
+	current_fn = kernel_fn(kernel);
+	return 0;
+}
+
+cksum_kernel_t cksum_kernel_current(void)
+{
+	if (NULL == current_fn)
+		(void)cksum_kernel_select(CKSUM_KERNEL_AUTO);
+	return current_kernel;
+}
+
+const char *cksum_kernel_name(cksum_kernel_t kernel)
+{
+	if (kernel >= CKSUM_KERNEL_COUNT)
+		return "unknown";
+	return kernel_names[kernel];
+}
+
+int cksum_kernel_run(cksum_kernel_t kernel, const void *data, size_t len, int *cksum)
+{
+	cksum_fn_t fn;
+
+	if (kernel == CKSUM_KERNEL_AUTO)
+		kernel = best_kernel();
+	if (!cksum_kernel_supported(kernel) || NULL == (fn = kernel_fn(kernel)))
+	{
+		errno = ENOTSUP;
+		return -1;
+	}
+	*cksum = (int)fn(data, len);
+	return 0;
+}
+
+int calculate_checksum_len(const void *data, size_t len)
+{
+	if (NULL == current_fn)
+		(void)cksum_kernel_select(CKSUM_KERNEL_AUTO);
+	return (int)current_fn(data, len);
+}
+
+int cksum_update(int cksum, const void *data, size_t len)
+{
+	return (int)((uint32_t)cksum + (uint32_t)calculate_checksum_len(data, len));
+}
+
+int calculate_checksum(const char *text)
+{
+	return calculate_checksum_len(text, strlen(text));
+}
+
+int cksum_crc32c_hw(void)
+{
+	pthread_once(&crc32c_once, crc32c_init);
+	return crc32c_hw_supported && CKSUM_KERNEL_SCALAR != cksum_kernel_current();
+}
+
+uint32_t cksum_crc32c(uint32_t crc, const void *data, size_t len)
+{
+	// this also builds the tables on first use
+	if (cksum_crc32c_hw())
+	{
+#ifdef CKSUM_HAVE_HW_CRC
+		return ~crc32c_hw(~crc, data, len);
+#endif
+	}
+	return ~crc32c_sw(~crc, data, len);
+}
+
+// shifting A's CRC over len_b bytes of zeros and xoring in B's works for the
+// finished (inverted) values too: the inversions of A's end and B's start
+// cancel out, as they do in zlib's crc32_combine()
+uint32_t cksum_crc32c_combine_gen(size_t len_b)
+{
+	return crc32c_x8nmodp(len_b);
+}
+
+uint32_t cksum_crc32c_combine_op(uint32_t crc_a, uint32_t crc_b, uint32_t op)
+{
+	return crc32c_multmodp(op, crc_a) ^ crc_b;
+}
+
+uint32_t cksum_crc32c_combine(uint32_t crc_a, uint32_t crc_b, size_t len_b)
+{
+	return cksum_crc32c_combine_op(crc_a, crc_b, cksum_crc32c_combine_gen(len_b));
+}
+
+static const char *algo_names[CKSUM_ALGO_COUNT] =
+{ "sum", "crc32c", "xxh64" };
+
+int cksum_algo_run(cksum_algo_t algo, const void *data, size_t len, uint64_t *result)
+{
+	switch (algo)
+	{
+	case CKSUM_ALGO_SUM:
+		*result = (uint32_t)calculate_checksum_len(data, len);
+		return 0;
+	case CKSUM_ALGO_CRC32C:
+		*result = cksum_crc32c(0, data, len);
+		return 0;
+	case CKSUM_ALGO_XXH64:
+		*result = cksum_xxh64(data, len, 0);
+		return 0;
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+}
+
+int cksum_algo_run_cancellable(cksum_algo_t algo, const void *data, size_t len,
+		const int *cancel, uint64_t *result)
+{
+	const char *p = data;
+	size_t chunk;
+	uint32_t crc = 0;
+	int sum = 0;
+
+	if (CKSUM_ALGO_SUM != algo && CKSUM_ALGO_CRC32C != algo)
+		return cksum_algo_run(algo, data, len, result);
+
+	while (len > 0)
+	{
+		if (__atomic_load_n(cancel, __ATOMIC_RELAXED))
+		{
+			errno = ECANCELED;
+			return -1;
+		}
+		chunk = len < CKSUM_CANCEL_CHUNK ? len : CKSUM_CANCEL_CHUNK;
+		if (CKSUM_ALGO_SUM == algo)
+			sum = cksum_update(sum, p, chunk);
+		else
+			crc = cksum_crc32c(crc, p, chunk);
+		p += chunk;
+		len -= chunk;
+	}
+	*result = CKSUM_ALGO_SUM == algo ? (uint32_t)sum : crc;
+	return 0;
+}
+
+const char *cksum_algo_name(cksum_algo_t algo)
+{
+	if (algo >= CKSUM_ALGO_COUNT)
+		return "unknown";
+	return algo_names[algo];
+}
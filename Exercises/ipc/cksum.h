@@ -0,0 +1,101 @@
+#ifndef _CKSUM_H_
+#define _CKSUM_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// cksum.h
+//
+// Shared checksum library for the checksum servers.
+//
+// The checksum is the additive sum of the chars of the data, exactly as the
+// original per-server calculate_checksum() computed it.  Several kernels
+// (scalar, SSE2, AVX2, NEON) give identical results; the fastest one the CPU
+// supports is picked at runtime on first use.
+//
+// Requests can also ask for a stronger algorithm (cksum_algo_t): CRC-32C,
+// using the SSE4.2 or ARMv8 CRC instructions when the cpu has them, or XXH64.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum
+{
+	CKSUM_KERNEL_AUTO = 0, // pick the best kernel the cpu supports
+	CKSUM_KERNEL_SCALAR,
+	CKSUM_KERNEL_SSE2,
+	CKSUM_KERNEL_AVX2,
+	CKSUM_KERNEL_NEON,
+	CKSUM_KERNEL_COUNT
+} cksum_kernel_t;
+
+// values are part of the message protocol, don't renumber
+typedef enum
+{
+	CKSUM_ALGO_SUM = 0, // additive sum of the chars, calculate_checksum_len()
+	CKSUM_ALGO_CRC32C, // CRC-32C (Castagnoli), cksum_crc32c()
+	CKSUM_ALGO_XXH64, // cksum_xxh64() with a seed of 0
+	CKSUM_ALGO_COUNT
+} cksum_algo_t;
+
+// checksum of a nul-terminated string (the nul is not included)
+int calculate_checksum(const char *text);
+
+// checksum of len bytes, for callers that already know the size
+int calculate_checksum_len(const void *data, size_t len);
+
+// fold len more bytes into a running checksum, so data that arrives in
+// chunks gives the same result as one calculate_checksum_len() over all of it.
+// Start with a checksum of 0.
+int cksum_update(int cksum, const void *data, size_t len);
+
+// 64 bit xxHash (XXH64) of len bytes, a fast non-cryptographic hash
+uint64_t cksum_xxh64(const void *data, size_t len, uint64_t seed);
+
+// CRC-32C of len bytes.  Pass 0 to start, or the result for the data so far
+// to continue.  Uses the cpu's CRC instructions unless they are missing or
+// the scalar kernel has been forced with cksum_kernel_select().
+uint32_t cksum_crc32c(uint32_t crc, const void *data, size_t len);
+
+// non-zero if cksum_crc32c() is currently using CRC instructions
+int cksum_crc32c_hw(void);
+
+// the CRC-32C of A followed by B, from the CRC-32C of A, that of B and B's
+// length, so pieces computed separately (on different threads) can be put
+// back together.  Combining many pieces of one length is cheaper with the
+// operator for that length: cksum_crc32c_combine_gen() once, then
+// cksum_crc32c_combine_op() for each piece.
+uint32_t cksum_crc32c_combine(uint32_t crc_a, uint32_t crc_b, size_t len_b);
+uint32_t cksum_crc32c_combine_gen(size_t len_b);
+uint32_t cksum_crc32c_combine_op(uint32_t crc_a, uint32_t crc_b, uint32_t op);
+
+// checksum len bytes with algo.  The sum is returned as its 32 bit unsigned
+// value.  Returns -1 (errno EINVAL) for an unknown algorithm.
+int cksum_algo_run(cksum_algo_t algo, const void *data, size_t len, uint64_t *result);
+
+// cksum_algo_run() a chunk of CKSUM_CANCEL_CHUNK bytes at a time, giving up
+// with -1 (errno ECANCELED) at the first chunk boundary after *cancel has
+// been set non-zero, by another thread.  XXH64 has no incremental form here
+// and is run in one go.
+#define CKSUM_CANCEL_CHUNK (64 * 1024)
+int cksum_algo_run_cancellable(cksum_algo_t algo, const void *data, size_t len,
+		const int *cancel, uint64_t *result);
+
+const char *cksum_algo_name(cksum_algo_t algo);
+
+// run one specific kernel, returns -1 and sets errno to ENOTSUP if the
+// kernel isn't available on this cpu
+int cksum_kernel_run(cksum_kernel_t kernel, const void *data, size_t len, int *cksum);
+
+// force the kernel used by calculate_checksum*(), CKSUM_KERNEL_AUTO restores
+// runtime detection.  Returns -1 (errno ENOTSUP) if the kernel isn't available.
+int cksum_kernel_select(cksum_kernel_t kernel);
+
+// the kernel currently used by calculate_checksum*()
+cksum_kernel_t cksum_kernel_current(void);
+
+// non-zero if the kernel was built in and the cpu supports it
+int cksum_kernel_supported(cksum_kernel_t kernel);
+
+const char *cksum_kernel_name(cksum_kernel_t kernel);
+
+#endif //_CKSUM_H_
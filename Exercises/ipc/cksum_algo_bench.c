@@ -0,0 +1,192 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_algo_bench.c
+//
+// Throughput benchmark for the checksum algorithms a request can select
+// (additive sum, CRC-32C, XXH64).  Plain POSIX so it runs on the Linux build
+// hosts as well as on a QNX target.
+//
+// CRC-32C is measured twice, with the CRC instructions and with the table
+// driven fallback (by forcing the scalar kernel), after checking both
+// against the standard check value and each other, at several misalignments
+// and when fed in pieces.
+//
+// -t seconds  time spent on each algorithm/size pair (default 0.25)
+// -s bytes    benchmark only this input size
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cksum.h"
+
+static const size_t default_sizes[] =
+{ 16, 64, 256, 1024, 4096, 16 * 1024, 256 * 1024, 1024 * 1024, 16 * 1024 * 1024, 64 * 1024 * 1024 };
+
+#define NUM_DEFAULT_SIZES (sizeof(default_sizes) / sizeof(default_sizes[0]))
+
+// what gets benchmarked: an algorithm with the kernel selection to use
+typedef struct
+{
+	const char *name;
+	cksum_algo_t algo;
+	cksum_kernel_t kernel;
+} variant_t;
+
+static const variant_t variants[] =
+{
+	{ "sum", CKSUM_ALGO_SUM, CKSUM_KERNEL_AUTO },
+	{ "crc32c", CKSUM_ALGO_CRC32C, CKSUM_KERNEL_AUTO },
+	{ "crc32c-sw", CKSUM_ALGO_CRC32C, CKSUM_KERNEL_SCALAR },
+	{ "xxh64", CKSUM_ALGO_XXH64, CKSUM_KERNEL_AUTO },
+};
+
+#define NUM_VARIANTS (sizeof(variants) / sizeof(variants[0]))
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// hardware and table CRCs must agree, in one go and continued in pieces
+static int verify_crc(const char *buf, size_t len)
+{
+	size_t offset, split;
+	uint32_t hw, sw, pieces;
+
+	for (offset = 0; offset < 4 && offset < len; offset++)
+	{
+		split = (len - offset) / 3;
+		cksum_kernel_select(CKSUM_KERNEL_AUTO);
+		hw = cksum_crc32c(0, buf + offset, len - offset);
+		pieces = cksum_crc32c(cksum_crc32c(0, buf + offset, split), buf + offset + split,
+				len - offset - split);
+		cksum_kernel_select(CKSUM_KERNEL_SCALAR);
+		sw = cksum_crc32c(0, buf + offset, len - offset);
+		cksum_kernel_select(CKSUM_KERNEL_AUTO);
+		if (hw != sw || pieces != sw)
+		{
+			printf("MISMATCH: crc32c len %zu, offset %zu: hw %08x, pieces %08x, table %08x\n",
+					len - offset, offset, hw, pieces, sw);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static double bench(const variant_t *v, const char *buf, size_t len, double seconds)
+{
+	unsigned long iters = 0, batch = 1;
+	double start, elapsed;
+	uint64_t result;
+	volatile uint64_t sink = 0;
+
+	cksum_kernel_select(v->kernel);
+	start = now();
+	do
+	{
+		unsigned long i;
+
+		for (i = 0; i < batch; i++)
+		{
+			cksum_algo_run(v->algo, buf, len, &result);
+			sink += result;
+		}
+		iters += batch;
+		if (batch < (1UL << 20))
+			batch *= 2;
+		elapsed = now() - start;
+	} while (elapsed < seconds);
+	cksum_kernel_select(CKSUM_KERNEL_AUTO);
+
+	return (double)len * iters / elapsed / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	double seconds = 0.25;
+	size_t one_size = 0;
+	const size_t *sizes = default_sizes;
+	unsigned num_sizes = NUM_DEFAULT_SIZES;
+	size_t max_size, i;
+	unsigned s, v;
+	char *buf;
+	uint64_t result;
+	int failed = 0;
+
+	while ((opt = getopt(argc, argv, "t:s:")) != -1)
+	{
+		switch (opt)
+		{
+		case 't':
+			seconds = atof(optarg);
+			break;
+		case 's':
+			one_size = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (one_size)
+	{
+		sizes = &one_size;
+		num_sizes = 1;
+	}
+
+	max_size = 0;
+	for (s = 0; s < num_sizes; s++)
+		if (sizes[s] > max_size)
+			max_size = sizes[s];
+
+	buf = malloc(max_size);
+	if (NULL == buf)
+	{
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	srand(1);
+	for (i = 0; i < max_size; i++)
+		buf[i] = rand();
+
+	// published check values
+	cksum_algo_run(CKSUM_ALGO_CRC32C, "123456789", 9, &result);
+	if (0xE3069283 != result)
+	{
+		printf("MISMATCH: crc32c check value %08llx\n", (unsigned long long)result);
+		failed = 1;
+	}
+	cksum_algo_run(CKSUM_ALGO_XXH64, "abc", 3, &result);
+	if (0x44BC2CF5AD770999ULL != result)
+	{
+		printf("MISMATCH: xxh64 check value %016llx\n", (unsigned long long)result);
+		failed = 1;
+	}
+
+	printf("sum kernel: %s, crc32c: %s\n", cksum_kernel_name(cksum_kernel_current()),
+			cksum_crc32c_hw() ? "crc instructions" : "tables");
+	printf("%-10s %12s %10s\n", "algorithm", "bytes", "GB/s");
+
+	for (v = 0; v < NUM_VARIANTS; v++)
+	{
+		for (s = 0; s < num_sizes; s++)
+		{
+			if (CKSUM_ALGO_CRC32C == variants[v].algo && -1 == verify_crc(buf, sizes[s]))
+			{
+				failed = 1;
+				continue;
+			}
+			printf("%-10s %12zu %10.2f\n", variants[v].name, sizes[s],
+					bench(&variants[v], buf, sizes[s], seconds));
+		}
+	}
+
+	free(buf);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,268 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_cache.c
+//
+// Sharded LRU checksum result cache, see cksum_cache.h
+//
+// Each shard owns a fixed array of entries, carved out of the memory budget
+// up front.  Entries are chained into hash buckets by index and kept on a
+// doubly linked LRU list; a miss on a full shard reuses the least recently
+// used entry.  The payload is hashed before any lock is taken, so the lock
+// only covers a few pointer updates.  Lookup and insert are separate, for
+// callers that compute the checksum themselves on a miss.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cksum.h"
+#include "cksum_cache.h"
+
+#define NUM_SHARDS 16
+#define NIL (-1)
+
+typedef struct
+{
+	uint64_t hash;
+	size_t len;
+	int cksum;
+	int32_t next; // next entry in the same bucket
+	int32_t lru_prev; // towards the most recently used
+	int32_t lru_next; // towards the least recently used
+} entry_t;
+
+typedef struct
+{
+	pthread_mutex_t lock;
+	entry_t *entries;
+	int32_t *buckets;
+	uint32_t bucket_mask;
+	uint32_t capacity;
+	uint32_t used;
+	int32_t lru_head; // most recently used
+	int32_t lru_tail; // least recently used
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	uint64_t bypassed;
+} shard_t;
+
+static shard_t shards[NUM_SHARDS];
+static int enabled = 0;
+static size_t min_len = CKSUM_CACHE_DEFAULT_MIN_LEN;
+
+int cksum_cache_init(size_t budget, size_t min)
+{
+	size_t per_shard = budget / NUM_SHARDS;
+	uint32_t capacity, nbuckets;
+	shard_t *shard;
+	int i;
+
+	// one bucket per entry (rounded up to a power of two) on top of each entry
+	capacity = per_shard / (sizeof(entry_t) + 2 * sizeof(int32_t));
+	if (0 == capacity)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	for (nbuckets = 1; nbuckets < capacity; nbuckets <<= 1)
+		;
+
+	for (i = 0; i < NUM_SHARDS; i++)
+	{
+		shard = &shards[i];
+		memset(shard, 0, sizeof(*shard));
+		shard->entries = malloc(capacity * sizeof(entry_t));
+		shard->buckets = malloc(nbuckets * sizeof(int32_t));
+		if (NULL == shard->entries || NULL == shard->buckets)
+		{
+			errno = ENOMEM;
+			return -1;
+		}
+		memset(shard->buckets, 0xff, nbuckets * sizeof(int32_t)); // all NIL
+		shard->bucket_mask = nbuckets - 1;
+		shard->capacity = capacity;
+		shard->lru_head = shard->lru_tail = NIL;
+		pthread_mutex_init(&shard->lock, NULL);
+	}
+	min_len = min;
+	enabled = 1;
+	return 0;
+}
+
+int cksum_cache_enabled(void)
+{
+	return enabled;
+}
+
+static void lru_unlink(shard_t *shard, int32_t idx)
+{
+	entry_t *e = &shard->entries[idx];
+
+	if (NIL != e->lru_prev)
+		shard->entries[e->lru_prev].lru_next = e->lru_next;
+	else
+		shard->lru_head = e->lru_next;
+	if (NIL != e->lru_next)
+		shard->entries[e->lru_next].lru_prev = e->lru_prev;
+	else
+		shard->lru_tail = e->lru_prev;
+}
+
+static void lru_push_head(shard_t *shard, int32_t idx)
+{
+	entry_t *e = &shard->entries[idx];
+
+	e->lru_prev = NIL;
+	e->lru_next = shard->lru_head;
+	if (NIL != shard->lru_head)
+		shard->entries[shard->lru_head].lru_prev = idx;
+	shard->lru_head = idx;
+	if (NIL == shard->lru_tail)
+		shard->lru_tail = idx;
+}
+
+// take the entry out of its hash bucket's chain
+static void bucket_unlink(shard_t *shard, int32_t idx)
+{
+	entry_t *e = &shard->entries[idx];
+	int32_t *link = &shard->buckets[e->hash & shard->bucket_mask];
+
+	while (*link != idx)
+		link = &shard->entries[*link].next;
+	*link = e->next;
+}
+
+// low bits pick the bucket, so shard on the high bits
+static shard_t *shard_of(uint64_t hash)
+{
+	return &shards[(hash >> 60) % NUM_SHARDS];
+}
+
+int cksum_cache_lookup(const void *data, size_t len, const int *cancel, cksum_cache_key_t *key,
+		int *cksum)
+{
+	const char *p = data;
+	size_t left, chunk;
+	shard_t *shard;
+	uint64_t hash = 0;
+	int32_t idx;
+	entry_t *e;
+
+	key->len = len;
+	key->cacheable = 0;
+	if (!enabled)
+		return 0;
+	if (len < min_len)
+	{
+		// short payloads are the common case, don't take a lock just to count them
+		__atomic_fetch_add(&shards[len % NUM_SHARDS].bypassed, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+
+	left = len;
+	do
+	{
+		if (NULL != cancel && __atomic_load_n(cancel, __ATOMIC_RELAXED))
+		{
+			errno = ECANCELED;
+			return -1;
+		}
+		chunk = left < CKSUM_CANCEL_CHUNK ? left : CKSUM_CANCEL_CHUNK;
+		hash = cksum_xxh64(p, chunk, hash);
+		p += chunk;
+		left -= chunk;
+	} while (left > 0);
+	key->hash = hash;
+	key->cacheable = 1;
+
+	shard = shard_of(hash);
+	pthread_mutex_lock(&shard->lock);
+	for (idx = shard->buckets[hash & shard->bucket_mask]; NIL != idx;
+			idx = shard->entries[idx].next)
+	{
+		e = &shard->entries[idx];
+		if (e->hash == hash && e->len == len)
+		{
+			shard->hits++;
+			lru_unlink(shard, idx);
+			lru_push_head(shard, idx);
+			*cksum = e->cksum;
+			pthread_mutex_unlock(&shard->lock);
+			return 1;
+		}
+	}
+	shard->misses++;
+	pthread_mutex_unlock(&shard->lock);
+	return 0;
+}
+
+void cksum_cache_insert(const cksum_cache_key_t *key, int cksum)
+{
+	shard_t *shard;
+	int32_t idx, *bucket;
+	entry_t *e;
+
+	if (!key->cacheable)
+		return;
+	shard = shard_of(key->hash);
+	pthread_mutex_lock(&shard->lock);
+	bucket = &shard->buckets[key->hash & shard->bucket_mask];
+	if (shard->used < shard->capacity)
+	{
+		idx = shard->used++;
+	}
+	else
+	{
+		idx = shard->lru_tail;
+		lru_unlink(shard, idx);
+		bucket_unlink(shard, idx);
+		shard->evictions++;
+	}
+	// another thread may have inserted the same payload meanwhile, a
+	// duplicate entry is harmless and ages out of the LRU
+	e = &shard->entries[idx];
+	e->hash = key->hash;
+	e->len = key->len;
+	e->cksum = cksum;
+	e->next = *bucket;
+	*bucket = idx;
+	lru_push_head(shard, idx);
+	pthread_mutex_unlock(&shard->lock);
+}
+
+int cksum_cache_checksum(const void *data, size_t len)
+{
+	cksum_cache_key_t key;
+	int cksum;
+
+	if (1 == cksum_cache_lookup(data, len, NULL, &key, &cksum))
+		return cksum;
+	// compute without holding the lock, then insert
+	cksum = calculate_checksum_len(data, len);
+	cksum_cache_insert(&key, cksum);
+	return cksum;
+}
+
+void cksum_cache_get_stats(cksum_cache_stats_t *stats)
+{
+	shard_t *shard;
+	int i;
+
+	memset(stats, 0, sizeof(*stats));
+	if (!enabled)
+		return;
+	for (i = 0; i < NUM_SHARDS; i++)
+	{
+		shard = &shards[i];
+		pthread_mutex_lock(&shard->lock);
+		stats->hits += shard->hits;
+		stats->misses += shard->misses;
+		stats->evictions += shard->evictions;
+		stats->bypassed += shard->bypassed;
+		stats->entries += shard->used;
+		stats->capacity += shard->capacity;
+		pthread_mutex_unlock(&shard->lock);
+	}
+}
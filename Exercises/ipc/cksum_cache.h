@@ -0,0 +1,76 @@
+#ifndef _CKSUM_CACHE_H_
+#define _CKSUM_CACHE_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// cksum_cache.h
+//
+// Bounded LRU cache of checksum results, keyed by the XXH64 hash of the
+// payload plus its length, for servers that see the same payloads over and
+// over.  A hit returns the stored checksum without running the checksum
+// kernel.  Payloads shorter than the minimum length bypass the cache, for
+// those computing the checksum is cheaper than the lookup.
+//
+// The cache is split into shards, each with its own lock and LRU list, so it
+// is safe (and doesn't serialize) when the server runs multiple threads.
+//
+// Two different payloads of the same length with the same 64 bit hash would
+// share an entry; that is improbable, but the cache is not for adversarial
+// input.
+//
+// Payloads are hashed CKSUM_CANCEL_CHUNK bytes at a time, each chunk's XXH64
+// seeded with the one before, so the hash of a long payload can be given up
+// part way through like the checksum itself (cksum_cache_lookup()).  For a
+// payload of one chunk it is just its XXH64.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CKSUM_CACHE_DEFAULT_MIN_LEN 64
+
+// counters, also the reply to a CKSUM_CACHE_STATS_MSG_TYPE message
+typedef struct
+{
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	uint64_t bypassed; // too short to be worth caching
+	uint32_t entries; // currently cached
+	uint32_t capacity; // most entries the memory budget allows
+} cksum_cache_stats_t;
+
+// set the cache up to use at most budget bytes, caching payloads of at least
+// min_len bytes.  Returns -1 (errno EINVAL) if the budget is too small for
+// even one entry per shard, or -1 (errno ENOMEM).
+int cksum_cache_init(size_t budget, size_t min_len);
+
+// non-zero once cksum_cache_init() has succeeded
+int cksum_cache_enabled(void);
+
+// calculate_checksum_len(), through the cache when it's enabled
+int cksum_cache_checksum(const void *data, size_t len);
+
+// where a payload goes in the cache, from cksum_cache_lookup()
+typedef struct
+{
+	uint64_t hash;
+	size_t len;
+	int cacheable; // enabled, and long enough
+} cksum_cache_key_t;
+
+// the lookup half of cksum_cache_checksum(), for callers that work the
+// checksum out themselves on a miss (in parallel, or cancellably), hashing a
+// chunk at a time and giving up with -1 (errno ECANCELED) at the first chunk
+// boundary after *cancel has been set non-zero by another thread.  Returns
+// 1 with the checksum in *cksum on a hit, else 0 with *key for
+// cksum_cache_insert() once the checksum is known.
+int cksum_cache_lookup(const void *data, size_t len, const int *cancel, cksum_cache_key_t *key,
+		int *cksum);
+
+// remember the checksum of the payload key came from (nothing if it isn't
+// cacheable)
+void cksum_cache_insert(const cksum_cache_key_t *key, int cksum);
+
+void cksum_cache_get_stats(cksum_cache_stats_t *stats);
+
+#endif //_CKSUM_CACHE_H_
@@ -0,0 +1,210 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_cache_bench.c
+//
+// Benchmark for the checksum result cache (cksum_cache.c), plain POSIX so it
+// runs on the Linux build hosts as well as on a QNX target.
+//
+// Each thread issues requests of a fixed payload size.  With probability
+// "repeat ratio" a request resends one of a working set of payloads, otherwise
+// it is a payload never seen before.  The same request stream is timed with
+// the cache on and off, and every cached answer is checked against the
+// uncached checksum in a final pass.
+//
+// -n count   requests per thread (default 200000)
+// -s bytes   payload size (default 4096)
+// -r ratio   fraction of requests that repeat a payload, 0 to 1 (default 0.9)
+// -w count   payloads in the repeated working set (default 1000)
+// -b bytes   cache memory budget (default 1M)
+// -t threads threads sharing the cache (default 1)
+// -k kernel  force a checksum kernel (scalar, sse2, avx2, neon)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cksum.h"
+#include "cksum_cache.h"
+
+unsigned long count = 200000;
+size_t size = 4096;
+double repeat_ratio = 0.9;
+unsigned working_set = 1000;
+char *payloads; // working_set payloads of size bytes
+int use_cache; // 0 uncached, 1 cached, 2 cached and checked
+
+typedef struct
+{
+	pthread_t tid;
+	unsigned seed;
+	unsigned long mismatches;
+} worker_t;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void *worker(void *arg)
+{
+	worker_t *w = arg;
+	unsigned seed = w->seed; // same stream for the cached and uncached runs
+	unsigned long i, fresh = 0;
+	char *scratch;
+	const char *data;
+	int cksum;
+
+	scratch = malloc(size);
+	memcpy(scratch, payloads, size);
+
+	for (i = 0; i < count; i++)
+	{
+		if (rand_r(&seed) < repeat_ratio * ((double)RAND_MAX + 1))
+		{
+			data = payloads + (rand_r(&seed) % working_set) * size;
+		}
+		else
+		{
+			// a payload nobody has sent before: stamp a unique id into it
+			fresh++;
+			memcpy(scratch, &w->seed, sizeof(w->seed));
+			memcpy(scratch + sizeof(w->seed), &fresh, sizeof(fresh));
+			data = scratch;
+		}
+
+		if (use_cache)
+		{
+			cksum = cksum_cache_checksum(data, size);
+			if (2 == use_cache && cksum != calculate_checksum_len(data, size))
+				w->mismatches++;
+		}
+		else
+		{
+			(void)calculate_checksum_len(data, size);
+		}
+	}
+
+	free(scratch);
+	return NULL;
+}
+
+// run the request stream on every thread, returns ns per request
+double run(worker_t *workers, int nthreads)
+{
+	double start;
+	int i;
+
+	start = now();
+	for (i = 0; i < nthreads; i++)
+		pthread_create(&workers[i].tid, NULL, worker, &workers[i]);
+	for (i = 0; i < nthreads; i++)
+		pthread_join(workers[i].tid, NULL);
+	return (now() - start) * 1e9 / count;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	size_t budget = 1024 * 1024;
+	int nthreads = 1;
+	worker_t *workers;
+	double uncached, cached;
+	cksum_cache_stats_t stats;
+	unsigned long mismatches = 0;
+	size_t i;
+	int t;
+	cksum_kernel_t k;
+
+	while ((opt = getopt(argc, argv, "n:s:r:w:b:t:k:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			repeat_ratio = atof(optarg);
+			break;
+		case 'w':
+			working_set = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			budget = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		case 'k':
+			for (k = CKSUM_KERNEL_SCALAR; k < CKSUM_KERNEL_COUNT; k++)
+				if (0 == strcmp(optarg, cksum_kernel_name(k)))
+					break;
+			if (-1 == cksum_kernel_select(k))
+			{
+				fprintf(stderr, "kernel %s not available\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (size < sizeof(unsigned) + sizeof(unsigned long) || 0 == working_set || nthreads < 1)
+	{
+		fprintf(stderr, "payload size too small, or no working set or threads\n");
+		exit(EXIT_FAILURE);
+	}
+
+	payloads = malloc(working_set * size);
+	workers = calloc(nthreads, sizeof(*workers));
+	if (NULL == payloads || NULL == workers)
+	{
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	srand(3);
+	for (i = 0; i < working_set * size; i++)
+		payloads[i] = rand();
+	for (t = 0; t < nthreads; t++)
+		workers[t].seed = t + 1;
+
+	if (-1 == cksum_cache_init(budget, 0))
+	{
+		perror("cksum_cache_init");
+		exit(EXIT_FAILURE);
+	}
+
+	use_cache = 0;
+	uncached = run(workers, nthreads);
+
+	use_cache = 1;
+	cached = run(workers, nthreads);
+	cksum_cache_get_stats(&stats);
+
+	use_cache = 2;
+	(void)run(workers, nthreads);
+	for (t = 0; t < nthreads; t++)
+		mismatches += workers[t].mismatches;
+
+	printf("payload %zu bytes, repeat ratio %.2f, working set %u, budget %zu bytes, %d threads\n",
+			size, repeat_ratio, working_set, budget, nthreads);
+	printf("kernel %s, cache capacity %u entries\n",
+			cksum_kernel_name(cksum_kernel_current()), stats.capacity);
+	printf("hits %llu, misses %llu, evictions %llu, hit rate %.1f%%\n",
+			(unsigned long long)stats.hits, (unsigned long long)stats.misses,
+			(unsigned long long)stats.evictions,
+			100.0 * stats.hits / (stats.hits + stats.misses));
+	printf("uncached %.1f ns/request, cached %.1f ns/request, speedup %.2f\n", uncached,
+			cached, uncached / cached);
+	printf("mismatches: %lu\n", mismatches);
+
+	return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
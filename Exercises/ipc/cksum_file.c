@@ -0,0 +1,427 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_file.c
+//
+// Checksumming files in place, see cksum_file.h.
+//
+// The SIGBUS handler finds the checksumming thread's jump buffer through a
+// thread specific key.  The fault it handles is the thread's own, taken in
+// a checksum kernel touching the mapping, never inside a library call, so
+// looking the key up there is safe even though pthread_getspecific() isn't
+// on the list of async signal safe functions.
+//
+// cksum_file_open() resolves the path itself, one directory fd at a time,
+// so a directory or link swapped in part way can't take it anywhere the
+// client couldn't go: each step is opened relative to the last, without
+// following links, and checked with fstat() on what was opened.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cksum_file.h"
+
+static pthread_once_t sigbus_once = PTHREAD_ONCE_INIT;
+static pthread_key_t sigbus_key; // the sigjmp_buf of a thread checksumming a mapping
+static struct sigaction old_sigbus;
+static int sigbus_ready;
+
+static void on_sigbus(int signo, siginfo_t *info, void *context)
+{
+	sigjmp_buf *jmp = pthread_getspecific(sigbus_key);
+
+	if (NULL != jmp)
+		siglongjmp(*jmp, 1);
+	// not ours: hand it to whoever was there before
+	if (old_sigbus.sa_flags & SA_SIGINFO)
+	{
+		old_sigbus.sa_sigaction(signo, info, context);
+	}
+	else if (SIG_DFL != old_sigbus.sa_handler && SIG_IGN != old_sigbus.sa_handler)
+	{
+		old_sigbus.sa_handler(signo);
+	}
+	else
+	{
+		// the faulting access is retried on return, and this time it gets
+		// the default action
+		sigaction(SIGBUS, &old_sigbus, NULL);
+	}
+}
+
+static void sigbus_init(void)
+{
+	struct sigaction sa;
+
+	if (0 != pthread_key_create(&sigbus_key, NULL))
+		return;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_sigaction = on_sigbus;
+	sa.sa_flags = SA_SIGINFO;
+	sigemptyset(&sa.sa_mask);
+	if (0 == sigaction(SIGBUS, &sa, &old_sigbus))
+		sigbus_ready = 1;
+}
+
+// fold len more bytes into the running value of algo.  XXH64 has no
+// incremental form here and must be given everything at once.
+static uint64_t fold(cksum_algo_t algo, uint64_t value, const void *data, size_t len)
+{
+	switch (algo)
+	{
+	case CKSUM_ALGO_SUM:
+		return (uint32_t)cksum_update((int)value, data, len);
+	case CKSUM_ALGO_CRC32C:
+		return cksum_crc32c((uint32_t)value, data, len);
+	default:
+		return cksum_xxh64(data, len, 0);
+	}
+}
+
+// cred may read (S_IROTH) or search (S_IXOTH) what st describes.  Only the
+// first class that matches counts, an owner without the permission doesn't
+// get it through the group.
+static int allows(const struct stat *st, const cksum_file_cred_t *cred, mode_t other_bit)
+{
+	unsigned i;
+
+	if (0 == cred->uid)
+		return 1;
+	if (st->st_uid == cred->uid)
+		return 0 != (st->st_mode & (other_bit << 6));
+	if (st->st_gid == cred->gid)
+		return 0 != (st->st_mode & (other_bit << 3));
+	for (i = 0; i < cred->ngroups; i++)
+		if (st->st_gid == cred->groups[i])
+			return 0 != (st->st_mode & (other_bit << 3));
+	return 0 != (st->st_mode & other_bit);
+}
+
+// symbolic links followed on the way to a file before giving up with ELOOP
+#define MAX_LINKS 40
+
+// how every step of the walk is opened: no following a link swapped in
+// since it was looked at, no waiting on a fifo swapped in for a directory
+#define WALK_FLAGS (O_RDONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC | O_NOFOLLOW)
+
+int cksum_file_open(const char *path, const cksum_file_cred_t *cred)
+{
+	char walk[PATH_MAX], link[PATH_MAX], name[NAME_MAX + 1];
+	const char *p, *end;
+	struct stat st;
+	unsigned links = 0;
+	ssize_t n;
+	size_t len;
+	int dir, fd;
+
+	if ('/' != path[0])
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	if (strlen(path) >= sizeof(walk))
+	{
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy(walk, path);
+	dir = open("/", WALK_FLAGS);
+	if (-1 == dir)
+		return -1;
+
+	// a component at a time from the directory open in dir, following
+	// symbolic links here rather than in open(), so what is checked is
+	// what gets used
+	for (p = walk;;)
+	{
+		p += strspn(p, "/");
+		if ('\0' == *p)
+		{
+			// the path names a directory
+			errno = EINVAL;
+			goto fail;
+		}
+		len = strcspn(p, "/");
+		if (len > NAME_MAX)
+		{
+			errno = ENAMETOOLONG;
+			goto fail;
+		}
+		memcpy(name, p, len);
+		name[len] = '\0';
+		end = p + len;
+
+		// checking before looking means a client that can't search a
+		// directory can't find out what is in it from the errors
+		if (-1 == fstat(dir, &st))
+			goto fail;
+		if (!allows(&st, cred, S_IXOTH))
+		{
+			errno = EACCES;
+			goto fail;
+		}
+		if (-1 == fstatat(dir, name, &st, AT_SYMLINK_NOFOLLOW))
+			goto fail;
+
+		if (S_ISLNK(st.st_mode))
+		{
+			// carry on from where it points, with the rest of the path
+			if (++links > MAX_LINKS)
+			{
+				errno = ELOOP;
+				goto fail;
+			}
+			n = readlinkat(dir, name, link, sizeof(link));
+			if (-1 == n)
+				goto fail;
+			if ((size_t)n + strlen(end) >= sizeof(link))
+			{
+				errno = ENAMETOOLONG;
+				goto fail;
+			}
+			memcpy(link + n, end, strlen(end) + 1);
+			strcpy(walk, link);
+			p = walk;
+			if ('/' == walk[0])
+			{
+				close(dir);
+				dir = open("/", WALK_FLAGS);
+				if (-1 == dir)
+					return -1;
+			}
+			continue;
+		}
+
+		if ('\0' == *end)
+			break;
+		fd = openat(dir, name, WALK_FLAGS);
+		if (-1 == fd)
+			goto fail;
+		close(dir);
+		dir = fd;
+		if (-1 == fstat(dir, &st))
+			goto fail;
+		if (!S_ISDIR(st.st_mode))
+		{
+			errno = ENOTDIR;
+			goto fail;
+		}
+		p = end;
+	}
+
+	// opening a fifo would wait for a writer, a device could do anything
+	if (!S_ISREG(st.st_mode))
+	{
+		errno = EINVAL;
+		goto fail;
+	}
+	fd = openat(dir, name, WALK_FLAGS);
+	close(dir);
+	if (-1 == fd)
+		return -1;
+	// and check what was opened, not what was there a moment ago
+	if (-1 == fstat(fd, &st))
+	{
+		close(fd);
+		return -1;
+	}
+	if (!S_ISREG(st.st_mode) || !allows(&st, cred, S_IROTH))
+	{
+		close(fd);
+		errno = S_ISREG(st.st_mode) ? EACCES : EINVAL;
+		return -1;
+	}
+	return fd;
+
+fail:
+	close(dir);
+	return -1;
+}
+
+int cksum_file_mmap(int fd, cksum_algo_t algo, size_t window, const int *cancel,
+		uint64_t *result, uint64_t *size)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	void *volatile map = MAP_FAILED;
+	volatile size_t mapped = 0;
+	sigjmp_buf jmp;
+	struct stat st;
+	uint64_t value, offset;
+	size_t n;
+	int error;
+
+	if (algo >= CKSUM_ALGO_COUNT)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	if (-1 == fstat(fd, &st))
+		return -1;
+	// its size says nothing about how much a pipe or device has to read
+	if (!S_ISREG(st.st_mode))
+	{
+		errno = ENODEV;
+		return -1;
+	}
+	if (0 == window)
+		window = CKSUM_FILE_DEFAULT_WINDOW;
+	window = (window + page - 1) / page * page;
+	if (CKSUM_ALGO_XXH64 == algo)
+	{
+		if ((uint64_t)st.st_size > SIZE_MAX)
+		{
+			errno = EFBIG;
+			return -1;
+		}
+		window = st.st_size;
+	}
+
+	// without the handler a truncated file would take the process down
+	pthread_once(&sigbus_once, sigbus_init);
+	if (!sigbus_ready)
+	{
+		errno = EAGAIN;
+		return -1;
+	}
+	if (sigsetjmp(jmp, 1))
+	{
+		// the file shrank under the mapping
+		pthread_setspecific(sigbus_key, NULL);
+		munmap(map, mapped);
+		errno = EIO;
+		return -1;
+	}
+	if (0 != (error = pthread_setspecific(sigbus_key, &jmp)))
+	{
+		errno = error;
+		return -1;
+	}
+
+	value = CKSUM_ALGO_XXH64 == algo ? cksum_xxh64("", 0, 0) : 0;
+#ifdef POSIX_FADV_WILLNEED
+	posix_fadvise(fd, 0, window, POSIX_FADV_WILLNEED);
+#endif
+	for (offset = 0; offset < (uint64_t)st.st_size; offset += n)
+	{
+		if (NULL != cancel && __atomic_load_n(cancel, __ATOMIC_RELAXED))
+		{
+			pthread_setspecific(sigbus_key, NULL);
+			errno = ECANCELED;
+			return -1;
+		}
+		n = st.st_size - offset < window ? st.st_size - offset : window;
+		map = mmap(NULL, n, PROT_READ, MAP_SHARED, fd, offset);
+		if (MAP_FAILED == map)
+		{
+			error = errno;
+			pthread_setspecific(sigbus_key, NULL);
+			errno = error;
+			return -1;
+		}
+		mapped = n;
+#ifdef POSIX_MADV_SEQUENTIAL
+		posix_madvise(map, n, POSIX_MADV_SEQUENTIAL);
+#endif
+#ifdef POSIX_FADV_WILLNEED
+		// the next window comes in while this one is checksummed
+		if (offset + n < (uint64_t)st.st_size)
+			posix_fadvise(fd, offset + n, window, POSIX_FADV_WILLNEED);
+#endif
+		value = fold(algo, value, map, n);
+		munmap(map, n);
+		map = MAP_FAILED;
+		mapped = 0;
+	}
+	pthread_setspecific(sigbus_key, NULL);
+
+	*result = value;
+	*size = st.st_size;
+	return 0;
+}
+
+int cksum_file_read(int fd, cksum_algo_t algo, size_t bufsize, const int *cancel,
+		uint64_t *result, uint64_t *size)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	uint64_t value = 0, total = 0;
+	void *buf;
+	ssize_t got;
+	int error;
+
+	if (algo >= CKSUM_ALGO_COUNT)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	if (CKSUM_ALGO_XXH64 == algo)
+	{
+		errno = ENOTSUP;
+		return -1;
+	}
+	if (0 == bufsize)
+		bufsize = CKSUM_FILE_DEFAULT_READ;
+	bufsize = (bufsize + page - 1) / page * page;
+	if (0 != (error = posix_memalign(&buf, page, bufsize)))
+	{
+		errno = error;
+		return -1;
+	}
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	for (;;)
+	{
+		if (NULL != cancel && __atomic_load_n(cancel, __ATOMIC_RELAXED))
+		{
+			free(buf);
+			errno = ECANCELED;
+			return -1;
+		}
+		got = read(fd, buf, bufsize);
+		if (-1 == got)
+		{
+			if (EINTR == errno)
+				continue;
+			error = errno;
+			free(buf);
+			errno = error;
+			return -1;
+		}
+		if (0 == got)
+			break;
+		value = fold(algo, value, buf, got);
+		total += got;
+	}
+	free(buf);
+
+	*result = value;
+	*size = total;
+	return 0;
+}
+
+int cksum_file_fd(int fd, cksum_algo_t algo, const int *cancel, uint64_t *result,
+		uint64_t *size)
+{
+	if (algo >= CKSUM_ALGO_COUNT)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	if (0 == cksum_file_mmap(fd, algo, 0, cancel, result, size))
+		return 0;
+	if (ECANCELED == errno || EIO == errno)
+		return -1;
+	// it can't be mapped, read it instead
+	if (-1 == lseek(fd, 0, SEEK_SET) && ESPIPE != errno)
+		return -1;
+	return cksum_file_read(fd, algo, 0, cancel, result, size);
+}
@@ -0,0 +1,72 @@
+#ifndef _CKSUM_FILE_H_
+#define _CKSUM_FILE_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// cksum_file.h
+//
+// Checksum of a file the server opens itself, named by the client, instead
+// of the client reading it and sending the bytes (read into the client, then
+// copied again into the server by MsgSend()).
+//
+// cksum_file_open() opens the file for a client, refusing it unless the
+// client's credentials would let it read the file and search every
+// directory on the way there, the way the kernel would decide it.
+//
+// cksum_file_fd() maps the file a window at a time with sequential access
+// advice, asking for the next window to be read ahead while the current one
+// is checksummed in place.  Files that can't be mapped are read instead, in
+// large page aligned reads.  Either way the fastest kernel there is does the
+// checksum (cksum.h).
+//
+// A file truncated while it is mapped would kill the process with SIGBUS on
+// the next page past its new end.  cksum_file_mmap() installs a SIGBUS
+// handler that gets the checksumming thread out with EIO instead, and passes
+// any other SIGBUS on to what the process had installed before.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "cksum.h"
+
+// bytes mapped at a time, and read at a time when mapping fails
+#define CKSUM_FILE_DEFAULT_WINDOW (8 * 1024 * 1024)
+#define CKSUM_FILE_DEFAULT_READ (1024 * 1024)
+
+// who the file is being opened for
+typedef struct
+{
+	uid_t uid; // effective ids, as the kernel checks against
+	gid_t gid;
+	const gid_t *groups; // supplementary groups
+	unsigned ngroups;
+} cksum_file_cred_t;
+
+// open the regular file at path, an absolute path, read only for cred.
+// Returns the fd, or -1 with errno set: EINVAL (relative path, or not a
+// regular file), EACCES, or what resolving the path or opening it failed
+// with.  The path is walked a directory at a time, each directory checked
+// as it is opened and symbolic links followed along the way, so nothing
+// renamed or linked in meanwhile can lead past a check; a permission
+// changed on a directory already passed isn't seen.
+int cksum_file_open(const char *path, const cksum_file_cred_t *cred);
+
+// checksum all of fd with algo, as cksum_algo_run() over its contents, by
+// cksum_file_mmap() or, if the file can't be mapped, cksum_file_read().  The
+// bytes checksummed go in *size.  If cancel isn't NULL it stops with -1
+// (errno ECANCELED) at the next window once *cancel is non-zero.  Returns 0,
+// or -1 with errno set.
+int cksum_file_fd(int fd, cksum_algo_t algo, const int *cancel, uint64_t *result,
+		uint64_t *size);
+
+// the two ways of doing it, for comparison.  window and bufsize 0 pick the
+// defaults.  XXH64 can't be done in pieces: cksum_file_mmap() maps all of
+// the file at once for it, cksum_file_read() fails with ENOTSUP.
+// cksum_file_mmap() fails with EIO if the file shrinks under it.
+int cksum_file_mmap(int fd, cksum_algo_t algo, size_t window, const int *cancel,
+		uint64_t *result, uint64_t *size);
+int cksum_file_read(int fd, cksum_algo_t algo, size_t bufsize, const int *cancel,
+		uint64_t *result, uint64_t *size);
+
+#endif //_CKSUM_FILE_H_
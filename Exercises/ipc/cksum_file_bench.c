@@ -0,0 +1,224 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_file_bench.c
+//
+// GB/s of checksumming a file three ways, with the file cached and cold:
+//
+//   copy   read() it in and copy it again, as a client reading a file and
+//          sending it to the server costs (MsgSend() being the copy)
+//   read   cksum_file_read(), large aligned reads straight into one buffer
+//   mmap   cksum_file_mmap(), in place through mapped windows
+//
+// Cold runs drop the file from the cache first (POSIX_FADV_DONTNEED, which
+// works on clean pages without privileges); the resident column says how
+// much of it was still cached when a run started.  The test file is created
+// in the given directory and removed afterwards: put it on a real disk, a
+// tmpfs file is never cold.  Plain POSIX so it runs on the Linux build hosts
+// as well as on a QNX target.
+//
+// -s bytes      file size (default 256M)
+// -d directory  where to put the test file (default .)
+// -a algorithm  sum or crc32c (default sum)
+// -r runs       runs of each, the best is printed (default 3)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "cksum.h"
+#include "cksum_file.h"
+
+typedef enum
+{
+	MODE_COPY, MODE_READ, MODE_MMAP, NUM_MODES
+} bench_mode_t;
+
+static const char *mode_names[NUM_MODES] =
+{ "copy", "read", "mmap" };
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// how much of the file's first size bytes is in the cache, in percent
+static double resident(int fd, size_t size)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	size_t pages = (size + page - 1) / page;
+	size_t i, in = 0;
+	unsigned char *vec;
+	void *map;
+
+	map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (MAP_FAILED == map)
+		return -1;
+	vec = malloc(pages);
+	if (NULL != vec && 0 == mincore(map, size, (void *)vec))
+	{
+		for (i = 0; i < pages; i++)
+			in += vec[i] & 1;
+	}
+	free(vec);
+	munmap(map, size);
+	return 100.0 * in / pages;
+}
+
+// the old way: the client's read, then the copy into the server
+static int copy_checksum(int fd, cksum_algo_t algo, uint64_t *result)
+{
+	static char buf[CKSUM_FILE_DEFAULT_READ], msg[CKSUM_FILE_DEFAULT_READ];
+	uint64_t value = 0;
+	ssize_t got;
+
+	while ((got = read(fd, buf, sizeof(buf))) > 0)
+	{
+		memcpy(msg, buf, got);
+		if (CKSUM_ALGO_SUM == algo)
+			value = (uint32_t)cksum_update((int)value, msg, got);
+		else
+			value = cksum_crc32c((uint32_t)value, msg, got);
+	}
+	*result = value;
+	return got;
+}
+
+static int run(bench_mode_t mode, int fd, cksum_algo_t algo, uint64_t *result)
+{
+	uint64_t size;
+
+	if (-1 == lseek(fd, 0, SEEK_SET))
+		return -1;
+	switch (mode)
+	{
+	case MODE_COPY:
+		return copy_checksum(fd, algo, result);
+	case MODE_READ:
+		return cksum_file_read(fd, algo, 0, NULL, result, &size);
+	default:
+		return cksum_file_mmap(fd, algo, 0, NULL, result, &size);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	size_t size = 256 * 1024 * 1024;
+	const char *dir = ".";
+	cksum_algo_t algo = CKSUM_ALGO_SUM;
+	unsigned runs = 3;
+	char path[1024];
+	uint64_t expected, result;
+	double start, elapsed, best, cached;
+	char *data;
+	size_t i;
+	unsigned r, cold;
+	bench_mode_t mode;
+	int failed = 0;
+	int fd;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "s:d:a:r:")) != -1)
+	{
+		switch (opt)
+		{
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			dir = optarg;
+			break;
+		case 'a':
+			if (0 == strcmp(optarg, cksum_algo_name(CKSUM_ALGO_CRC32C)))
+				algo = CKSUM_ALGO_CRC32C;
+			else if (0 != strcmp(optarg, cksum_algo_name(CKSUM_ALGO_SUM)))
+			{
+				fprintf(stderr, "%s: -a sum or crc32c\n", argv[0]);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'r':
+			runs = atoi(optarg);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (0 == size || 0 == runs)
+	{
+		fprintf(stderr, "%s: nothing to do\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	data = malloc(size);
+	if (NULL == data)
+	{
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	srand(1);
+	for (i = 0; i < size; i++)
+		data[i] = rand();
+	cksum_algo_run(algo, data, size, &expected);
+
+	snprintf(path, sizeof(path), "%s/cksum_file_bench.XXXXXX", dir);
+	fd = mkstemp(path);
+	if (-1 == fd)
+	{
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+	if (write(fd, data, size) != (ssize_t)size || -1 == fsync(fd))
+	{
+		perror(path);
+		unlink(path);
+		exit(EXIT_FAILURE);
+	}
+	free(data);
+
+	printf("%zu byte file in %s, %s with the %s kernel\n", size, dir, cksum_algo_name(algo),
+			CKSUM_ALGO_SUM == algo ? cksum_kernel_name(cksum_kernel_current()) :
+			cksum_crc32c_hw() ? "hw crc" : "table");
+	printf("%-6s %-7s %8s %10s\n", "mode", "cache", "GB/s", "resident");
+	for (cold = 0; cold <= 1; cold++)
+	{
+		for (mode = 0; mode < NUM_MODES; mode++)
+		{
+			best = 0;
+			cached = 0;
+			for (r = 0; r < runs; r++)
+			{
+				if (cold)
+					posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+				else if (0 == r)
+					(void)run(mode, fd, algo, &result); // warm it up
+				cached = resident(fd, size);
+				start = now();
+				if (-1 == run(mode, fd, algo, &result) || result != expected)
+				{
+					printf("MISMATCH: %s %s: %llx, expected %llx\n", mode_names[mode],
+							cold ? "cold" : "cached", (unsigned long long)result,
+							(unsigned long long)expected);
+					failed = 1;
+					break;
+				}
+				elapsed = now() - start;
+				if (size / elapsed > best)
+					best = size / elapsed;
+			}
+			printf("%-6s %-7s %8.2f %9.0f%%\n", mode_names[mode], cold ? "cold" : "cached",
+					best / 1e9, cached);
+		}
+	}
+
+	close(fd);
+	unlink(path);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_hist.c
+//
+// HDR-style latency histogram, see cksum_hist.h
+//
+// Values below 128 get a bucket each.  Above that, a value whose top bit is
+// bit m is shifted right by e = m - 6, leaving a 7 bit mantissa from 64 to
+// 127, and lands in bucket e * 64 + mantissa; the buckets of consecutive
+// powers of two follow on from each other with no gaps.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cksum_hist.h"
+
+#define SUB_BITS 7
+#define HALF (1u << (SUB_BITS - 1)) // buckets per power of two
+#define NUM_BUCKETS ((64 - SUB_BITS + 1) * HALF + HALF)
+
+struct cksum_hist
+{
+	uint64_t count;
+	uint64_t min;
+	uint64_t max;
+	double sum;
+	uint64_t buckets[NUM_BUCKETS];
+};
+
+static inline unsigned bucket_index(uint64_t value)
+{
+	unsigned e;
+
+	if (value < 2 * HALF)
+		return value;
+	e = (63 - __builtin_clzll(value)) - (SUB_BITS - 1);
+	return e * HALF + (unsigned)(value >> e);
+}
+
+// smallest and largest value that land in a bucket
+static inline uint64_t bucket_low(unsigned idx)
+{
+	unsigned e;
+
+	if (idx < 2 * HALF)
+		return idx;
+	e = idx / HALF - 1;
+	return (uint64_t)(idx - e * HALF) << e;
+}
+
+static inline uint64_t bucket_high(unsigned idx)
+{
+	if (idx < 2 * HALF)
+		return idx;
+	return bucket_low(idx) + (((uint64_t)1 << (idx / HALF - 1)) - 1);
+}
+
+cksum_hist_t *cksum_hist_create(void)
+{
+	cksum_hist_t *hist;
+
+	hist = malloc(sizeof(*hist));
+	if (NULL == hist)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+	cksum_hist_reset(hist);
+	return hist;
+}
+
+void cksum_hist_destroy(cksum_hist_t *hist)
+{
+	free(hist);
+}
+
+void cksum_hist_reset(cksum_hist_t *hist)
+{
+	memset(hist, 0, sizeof(*hist));
+	hist->min = UINT64_MAX;
+}
+
+void cksum_hist_record(cksum_hist_t *hist, uint64_t value)
+{
+	hist->buckets[bucket_index(value)]++;
+	hist->count++;
+	hist->sum += value;
+	if (value < hist->min)
+		hist->min = value;
+	if (value > hist->max)
+		hist->max = value;
+}
+
+void cksum_hist_merge(cksum_hist_t *dst, const cksum_hist_t *src)
+{
+	unsigned i;
+
+	for (i = 0; i < NUM_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+	dst->count += src->count;
+	dst->sum += src->sum;
+	if (src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+uint64_t cksum_hist_count(const cksum_hist_t *hist)
+{
+	return hist->count;
+}
+
+uint64_t cksum_hist_min(const cksum_hist_t *hist)
+{
+	return hist->count ? hist->min : 0;
+}
+
+uint64_t cksum_hist_max(const cksum_hist_t *hist)
+{
+	return hist->max;
+}
+
+double cksum_hist_mean(const cksum_hist_t *hist)
+{
+	return hist->count ? hist->sum / hist->count : 0.0;
+}
+
+uint64_t cksum_hist_percentile(const cksum_hist_t *hist, double percentile)
+{
+	uint64_t rank, seen = 0, value;
+	unsigned i;
+
+	if (0 == hist->count)
+		return 0;
+	// the rank of the value we want, 1 based
+	rank = (uint64_t)(percentile / 100.0 * hist->count + 0.5);
+	if (rank < 1)
+		rank = 1;
+	if (rank > hist->count)
+		rank = hist->count;
+
+	for (i = 0; i < NUM_BUCKETS; i++)
+	{
+		seen += hist->buckets[i];
+		if (seen >= rank)
+			break;
+	}
+	value = bucket_high(i);
+	return value < hist->max ? value : hist->max;
+}
+
+int cksum_hist_write_csv(const cksum_hist_t *hist, FILE *fp)
+{
+	uint64_t seen = 0;
+	unsigned i;
+
+	if (fprintf(fp, "low,high,count,cumulative_fraction\n") < 0)
+		return -1;
+	for (i = 0; i < NUM_BUCKETS; i++)
+	{
+		if (0 == hist->buckets[i])
+			continue;
+		seen += hist->buckets[i];
+		if (fprintf(fp, "%llu,%llu,%llu,%.6f\n", (unsigned long long)bucket_low(i),
+				(unsigned long long)bucket_high(i), (unsigned long long)hist->buckets[i],
+				(double)seen / hist->count) < 0)
+			return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef _CKSUM_HIST_H_
+#define _CKSUM_HIST_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// cksum_hist.h
+//
+// HDR-style latency histogram for the checksum benchmarks.
+//
+// Values (nanoseconds, or any other unsigned 64 bit quantity) are counted in
+// log-linear buckets: every power of two range is split into 64 equal
+// buckets, so any recorded value is known to within 1/64 (1.6%) over the
+// whole range, in a fixed 30k of counters.  Recording is a few instructions
+// and never allocates; give each thread its own histogram and merge them
+// afterwards.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct cksum_hist cksum_hist_t;
+
+// a new, empty histogram, or NULL (errno ENOMEM)
+cksum_hist_t *cksum_hist_create(void);
+
+void cksum_hist_destroy(cksum_hist_t *hist);
+
+void cksum_hist_reset(cksum_hist_t *hist);
+
+void cksum_hist_record(cksum_hist_t *hist, uint64_t value);
+
+// add all of src's counts into dst
+void cksum_hist_merge(cksum_hist_t *dst, const cksum_hist_t *src);
+
+uint64_t cksum_hist_count(const cksum_hist_t *hist);
+
+// exact smallest, largest and mean of the recorded values (0 when empty)
+uint64_t cksum_hist_min(const cksum_hist_t *hist);
+uint64_t cksum_hist_max(const cksum_hist_t *hist);
+double cksum_hist_mean(const cksum_hist_t *hist);
+
+// the value at or below which percentile (0 to 100) percent of the recorded
+// values lie, rounded up to the top of its bucket, and never above the max
+uint64_t cksum_hist_percentile(const cksum_hist_t *hist, double percentile);
+
+// write the non-empty buckets as CSV: the bucket's range, its count, and the
+// fraction of all values at or below it.  Returns -1 on a write error.
+int cksum_hist_write_csv(const cksum_hist_t *hist, FILE *fp);
+
+#endif //_CKSUM_HIST_H_
@@ -0,0 +1,163 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_kernel_bench.c
+//
+// Throughput benchmark for the checksum kernels in cksum.c.  Plain POSIX so it
+// runs on the Linux build hosts as well as on a QNX target.
+//
+// For every kernel the cpu supports, and every input size, the kernel is
+// first checked against the scalar kernel (at several misalignments) and
+// then run repeatedly for the given time, reporting GB/s.
+//
+// -t seconds  time spent on each kernel/size pair (default 0.25)
+// -s bytes    benchmark only this input size
+// -v          verbose
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cksum.h"
+
+static const size_t default_sizes[] =
+{ 16, 64, 256, 1024, 4096, 16 * 1024, 256 * 1024, 1024 * 1024, 16 * 1024 * 1024, 64 * 1024 * 1024 };
+
+#define NUM_DEFAULT_SIZES (sizeof(default_sizes) / sizeof(default_sizes[0]))
+
+int verbose = 0;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// every kernel must agree with the scalar kernel, including for unaligned
+// buffers and lengths that aren't a multiple of the vector width
+static int verify(cksum_kernel_t kernel, const char *buf, size_t len)
+{
+	size_t offset;
+	int expected, got;
+
+	for (offset = 0; offset < 4 && offset < len; offset++)
+	{
+		cksum_kernel_run(CKSUM_KERNEL_SCALAR, buf + offset, len - offset, &expected);
+		cksum_kernel_run(kernel, buf + offset, len - offset, &got);
+		if (got != expected)
+		{
+			printf("MISMATCH: kernel %s, len %zu, offset %zu: got %d expected %d\n",
+					cksum_kernel_name(kernel), len - offset, offset, got, expected);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static double bench(cksum_kernel_t kernel, const char *buf, size_t len, double seconds)
+{
+	unsigned long iters = 0, batch = 1;
+	double start, elapsed;
+	int cksum;
+	volatile int sink = 0;
+
+	start = now();
+	do
+	{
+		unsigned long i;
+
+		for (i = 0; i < batch; i++)
+		{
+			cksum_kernel_run(kernel, buf, len, &cksum);
+			sink += cksum;
+		}
+		iters += batch;
+		if (batch < (1UL << 20))
+			batch *= 2;
+		elapsed = now() - start;
+	} while (elapsed < seconds);
+
+	return (double)len * iters / elapsed / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	double seconds = 0.25;
+	size_t one_size = 0;
+	const size_t *sizes = default_sizes;
+	unsigned num_sizes = NUM_DEFAULT_SIZES;
+	size_t max_size, i;
+	unsigned s;
+	char *buf;
+	cksum_kernel_t k;
+	int failed = 0;
+
+	while ((opt = getopt(argc, argv, "t:s:v")) != -1)
+	{
+		switch (opt)
+		{
+		case 't':
+			seconds = atof(optarg);
+			break;
+		case 's':
+			one_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'v':
+			verbose++;
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (one_size)
+	{
+		sizes = &one_size;
+		num_sizes = 1;
+	}
+
+	max_size = 0;
+	for (s = 0; s < num_sizes; s++)
+		if (sizes[s] > max_size)
+			max_size = sizes[s];
+
+	buf = malloc(max_size);
+	if (NULL == buf)
+	{
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	// full byte range, so both signed and unsigned char handling is exercised
+	srand(1);
+	for (i = 0; i < max_size; i++)
+		buf[i] = rand();
+
+	printf("auto-selected kernel: %s\n", cksum_kernel_name(cksum_kernel_current()));
+	printf("%-8s %12s %10s\n", "kernel", "bytes", "GB/s");
+
+	for (k = CKSUM_KERNEL_SCALAR; k < CKSUM_KERNEL_COUNT; k++)
+	{
+		if (!cksum_kernel_supported(k))
+		{
+			if (verbose)
+				printf("%-8s not supported on this cpu\n", cksum_kernel_name(k));
+			continue;
+		}
+		for (s = 0; s < num_sizes; s++)
+		{
+			if (-1 == verify(k, buf, sizes[s]))
+			{
+				failed = 1;
+				continue;
+			}
+			printf("%-8s %12zu %10.2f\n", cksum_kernel_name(k), sizes[s],
+					bench(k, buf, sizes[s], seconds));
+		}
+	}
+
+	free(buf);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,284 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_par.c
+//
+// Worker pool for checksumming large buffers in chunks, see cksum_par.h.
+//
+// A request is a job on the pool's queue with its chunks handed out in
+// order, one at a time under the pool lock; the work per chunk is tens of
+// microseconds, so the lock is nowhere near busy.  Each chunk's result goes
+// in its own slot and the asking thread puts them together once the last
+// one is in.  Jobs live on their callers' stacks: a worker touches a job
+// only between taking a chunk and counting it finished, and the caller
+// doesn't return before every chunk has been counted.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "cksum_par.h"
+
+typedef struct job
+{
+	cksum_algo_t algo;
+	const char *data;
+	size_t len;
+	const int *cancel;
+	uint32_t *partial; // one result per chunk
+	unsigned nchunks;
+	unsigned next; // next chunk to hand out
+	unsigned finished; // chunks done
+	int cancelled;
+	struct job *next_job;
+} job_t;
+
+struct cksum_par
+{
+	unsigned workers;
+	size_t chunk;
+	size_t threshold;
+	uint32_t chunk_op; // cksum_crc32c_combine_gen(chunk)
+	pthread_t *threads;
+	pthread_mutex_t lock; // everything below, and the jobs' next and finished
+	pthread_cond_t work; // a job was queued, or stop was set
+	pthread_cond_t done; // some job's last chunk finished
+	job_t *head, *tail; // jobs with chunks still to hand out
+	int stop;
+	unsigned long split;
+	unsigned long worker_chunks;
+};
+
+// the next chunk of job, taking the job off the queue with its last one.
+// Called with the lock held.
+static unsigned take_chunk(cksum_par_t *par, job_t *job)
+{
+	unsigned idx = job->next++;
+	job_t **pp;
+
+	if (job->next == job->nchunks)
+	{
+		for (pp = &par->head; *pp != job; pp = &(*pp)->next_job)
+			;
+		*pp = job->next_job;
+		if (par->tail == job)
+		{
+			par->tail = NULL;
+			for (job = par->head; NULL != job; job = job->next_job)
+				par->tail = job;
+		}
+	}
+	return idx;
+}
+
+static void run_chunk(const cksum_par_t *par, job_t *job, unsigned idx)
+{
+	size_t offset = (size_t)idx * par->chunk;
+	size_t n = job->len - offset < par->chunk ? job->len - offset : par->chunk;
+
+	if (NULL != job->cancel && __atomic_load_n(job->cancel, __ATOMIC_RELAXED))
+	{
+		__atomic_store_n(&job->cancelled, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	if (CKSUM_ALGO_SUM == job->algo)
+		job->partial[idx] = (uint32_t)calculate_checksum_len(job->data + offset, n);
+	else
+		job->partial[idx] = cksum_crc32c(0, job->data + offset, n);
+}
+
+// count a chunk of job done, called with the lock held.  job may be gone
+// as soon as the lock is dropped.
+static void finish_chunk(cksum_par_t *par, job_t *job)
+{
+	if (++job->finished == job->nchunks)
+		pthread_cond_broadcast(&par->done);
+}
+
+static void *worker(void *arg)
+{
+	cksum_par_t *par = arg;
+	job_t *job;
+	unsigned idx;
+
+	pthread_mutex_lock(&par->lock);
+	for (;;)
+	{
+		while (!par->stop && NULL == par->head)
+			pthread_cond_wait(&par->work, &par->lock);
+		if (par->stop)
+			break;
+		job = par->head;
+		idx = take_chunk(par, job);
+		par->worker_chunks++;
+		pthread_mutex_unlock(&par->lock);
+		run_chunk(par, job, idx);
+		pthread_mutex_lock(&par->lock);
+		finish_chunk(par, job);
+	}
+	pthread_mutex_unlock(&par->lock);
+	return NULL;
+}
+
+// put the chunks' results back together, in order
+static uint64_t combine(const cksum_par_t *par, const job_t *job)
+{
+	size_t last = job->len - (size_t)(job->nchunks - 1) * par->chunk;
+	uint32_t result = job->partial[0];
+	unsigned i;
+
+	if (CKSUM_ALGO_SUM == job->algo)
+	{
+		for (i = 1; i < job->nchunks; i++)
+			result += job->partial[i];
+		return result;
+	}
+	for (i = 1; i < job->nchunks - 1; i++)
+		result = cksum_crc32c_combine_op(result, job->partial[i], par->chunk_op);
+	if (job->nchunks > 1)
+		result = cksum_crc32c_combine(result, job->partial[i], last);
+	return result;
+}
+
+static void stop_workers(cksum_par_t *par, unsigned started)
+{
+	unsigned i;
+
+	pthread_mutex_lock(&par->lock);
+	par->stop = 1;
+	pthread_cond_broadcast(&par->work);
+	pthread_mutex_unlock(&par->lock);
+	for (i = 0; i < started; i++)
+		pthread_join(par->threads[i], NULL);
+}
+
+cksum_par_t *cksum_par_create(unsigned workers, size_t chunk, size_t threshold)
+{
+	cksum_par_t *par;
+	unsigned i;
+	int ret;
+
+	par = calloc(1, sizeof(*par));
+	if (NULL == par)
+		return NULL;
+	par->threads = calloc(workers ? workers : 1, sizeof(*par->threads));
+	if (NULL == par->threads)
+	{
+		free(par);
+		errno = ENOMEM;
+		return NULL;
+	}
+	par->workers = workers;
+	par->chunk = chunk ? chunk : CKSUM_PAR_DEFAULT_CHUNK;
+	par->threshold = threshold ? threshold : CKSUM_PAR_DEFAULT_THRESHOLD;
+	par->chunk_op = cksum_crc32c_combine_gen(par->chunk);
+	pthread_mutex_init(&par->lock, NULL);
+	pthread_cond_init(&par->work, NULL);
+	pthread_cond_init(&par->done, NULL);
+
+	for (i = 0; i < workers; i++)
+	{
+		ret = pthread_create(&par->threads[i], NULL, worker, par);
+		if (0 != ret)
+		{
+			stop_workers(par, i);
+			cksum_par_destroy(par);
+			errno = ret;
+			return NULL;
+		}
+	}
+	return par;
+}
+
+void cksum_par_destroy(cksum_par_t *par)
+{
+	if (!par->stop)
+		stop_workers(par, par->workers);
+	pthread_cond_destroy(&par->done);
+	pthread_cond_destroy(&par->work);
+	pthread_mutex_destroy(&par->lock);
+	free(par->threads);
+	free(par);
+}
+
+int cksum_par_run(cksum_par_t *par, cksum_algo_t algo, const void *data, size_t len,
+		const int *cancel, uint64_t *result)
+{
+	job_t job;
+	unsigned idx;
+
+	if (algo >= CKSUM_ALGO_COUNT)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	if (len < par->threshold || len <= par->chunk || CKSUM_ALGO_XXH64 == algo)
+	{
+		if (NULL == cancel)
+			return cksum_algo_run(algo, data, len, result);
+		return cksum_algo_run_cancellable(algo, data, len, cancel, result);
+	}
+
+	job.algo = algo;
+	job.data = data;
+	job.len = len;
+	job.cancel = cancel;
+	job.nchunks = (len + par->chunk - 1) / par->chunk;
+	job.next = 0;
+	job.finished = 0;
+	job.cancelled = 0;
+	job.next_job = NULL;
+	job.partial = malloc(job.nchunks * sizeof(*job.partial));
+	if (NULL == job.partial)
+	{
+		// it still gets done, just not in parallel
+		if (NULL == cancel)
+			return cksum_algo_run(algo, data, len, result);
+		return cksum_algo_run_cancellable(algo, data, len, cancel, result);
+	}
+
+	pthread_mutex_lock(&par->lock);
+	if (NULL == par->tail)
+		par->head = &job;
+	else
+		par->tail->next_job = &job;
+	par->tail = &job;
+	par->split++;
+	pthread_cond_broadcast(&par->work);
+	// work on our own request rather than wait
+	while (job.next < job.nchunks)
+	{
+		idx = take_chunk(par, &job);
+		pthread_mutex_unlock(&par->lock);
+		run_chunk(par, &job, idx);
+		pthread_mutex_lock(&par->lock);
+		finish_chunk(par, &job);
+	}
+	while (job.finished < job.nchunks)
+		pthread_cond_wait(&par->done, &par->lock);
+	pthread_mutex_unlock(&par->lock);
+
+	if (job.cancelled)
+	{
+		free(job.partial);
+		errno = ECANCELED;
+		return -1;
+	}
+	*result = combine(par, &job);
+	free(job.partial);
+	return 0;
+}
+
+unsigned cksum_par_workers(const cksum_par_t *par)
+{
+	return par->workers;
+}
+
+unsigned long cksum_par_split(const cksum_par_t *par)
+{
+	return __atomic_load_n(&par->split, __ATOMIC_RELAXED);
+}
+
+unsigned long cksum_par_worker_chunks(const cksum_par_t *par)
+{
+	return __atomic_load_n(&par->worker_chunks, __ATOMIC_RELAXED);
+}
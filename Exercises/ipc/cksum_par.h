@@ -0,0 +1,60 @@
+#ifndef _CKSUM_PAR_H_
+#define _CKSUM_PAR_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// cksum_par.h
+//
+// Parallel checksum of very large buffers.  One core summing or CRCing
+// hundreds of megabytes tops out well below what memory can deliver, so a
+// request of at least the threshold is cut into chunks small enough to stay
+// in cache and the chunks are shared out over a pool of worker threads.  The
+// thread asking works on its own request's chunks too, so a pool of N
+// workers gets N + 1 threads onto one request.
+//
+// The pieces are put back together in order: additive sums just add up
+// (wrapping as one long sum does), CRC-32C pieces are combined with
+// cksum_crc32c_combine_op().  The result is bit for bit what cksum_algo_run()
+// gives.  XXH64 can't be split like that and runs on the calling thread, as
+// does anything under the threshold.
+//
+// Any number of threads may call cksum_par_run() at once; the workers take
+// chunks from the oldest request that still has any.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cksum.h"
+
+// chunks of this many bytes go to one worker at a time, a multiple of the
+// widest kernel's block and small enough for a per-core cache
+#define CKSUM_PAR_DEFAULT_CHUNK (256 * 1024)
+
+// smallest request worth splitting
+#define CKSUM_PAR_DEFAULT_THRESHOLD (4 * 1024 * 1024)
+
+typedef struct cksum_par cksum_par_t;
+
+// a pool of this many worker threads (0 leaves everything to the calling
+// threads, for comparison), splitting requests of at least threshold bytes
+// into chunks of chunk bytes.  chunk 0 or threshold 0 pick the defaults.  NULL
+// with errno set.
+cksum_par_t *cksum_par_create(unsigned workers, size_t chunk, size_t threshold);
+
+// stops the workers.  No cksum_par_run() on par may still be going.
+void cksum_par_destroy(cksum_par_t *par);
+
+// checksum len bytes of data with algo as cksum_algo_run(), in parallel if
+// it's worth it.  If cancel isn't NULL the work stops at the next chunk once
+// *cancel is non-zero, as cksum_algo_run_cancellable().  Returns 0, or -1
+// with errno EINVAL (unknown algorithm) or ECANCELED.
+int cksum_par_run(cksum_par_t *par, cksum_algo_t algo, const void *data, size_t len,
+		const int *cancel, uint64_t *result);
+
+unsigned cksum_par_workers(const cksum_par_t *par);
+
+// requests that were split, and chunks the workers (not the callers) did
+unsigned long cksum_par_split(const cksum_par_t *par);
+unsigned long cksum_par_worker_chunks(const cksum_par_t *par);
+
+#endif //_CKSUM_PAR_H_
@@ -0,0 +1,182 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_par_bench.c
+//
+// Scaling of the parallel checksum (cksum_par.h) over a large buffer: GB/s
+// of the additive sum and CRC-32C with 1 to N threads on the request (the
+// caller plus N - 1 workers), against one cksum_algo_run().  Plain POSIX so
+// it runs on the Linux build hosts as well as on a QNX target.
+//
+// Before timing anything, the parallel results are checked bit for bit
+// against cksum_algo_run() at lengths around the chunk boundaries.
+//
+// -s bytes    buffer size (default 256M)
+// -n threads  go up to this many threads (default the number of CPUs)
+// -c bytes    chunk size (default CKSUM_PAR_DEFAULT_CHUNK)
+// -t seconds  time spent on each measurement (default 0.5)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cksum.h"
+#include "cksum_par.h"
+
+static const cksum_algo_t algos[] =
+{ CKSUM_ALGO_SUM, CKSUM_ALGO_CRC32C };
+
+#define NUM_ALGOS (sizeof(algos) / sizeof(algos[0]))
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// the pool has to agree with the plain checksum at every length near a
+// chunk boundary, and at the ends of the buffer
+static int verify(cksum_par_t *par, const char *buf, size_t size, size_t chunk)
+{
+	const size_t lengths[] =
+	{ 2 * chunk - 1, 2 * chunk, 2 * chunk + 1, 7 * chunk + 13, size - 1, size };
+	uint64_t expected, result;
+	unsigned a, l;
+
+	for (a = 0; a < NUM_ALGOS; a++)
+	{
+		for (l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++)
+		{
+			if (lengths[l] > size)
+				continue;
+			cksum_algo_run(algos[a], buf + size - lengths[l], lengths[l], &expected);
+			if (-1 == cksum_par_run(par, algos[a], buf + size - lengths[l], lengths[l], NULL,
+					&result) || result != expected)
+			{
+				printf("MISMATCH: %s len %zu with %u workers: %llx, expected %llx\n",
+						cksum_algo_name(algos[a]), lengths[l], cksum_par_workers(par),
+						(unsigned long long)result, (unsigned long long)expected);
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+// GB/s of one checksum after another over the buffer
+static double bench(cksum_par_t *par, cksum_algo_t algo, const char *buf, size_t size,
+		double seconds)
+{
+	unsigned long iters = 0;
+	double start, elapsed;
+	uint64_t result;
+	volatile uint64_t sink = 0;
+
+	start = now();
+	do
+	{
+		if (NULL == par)
+			cksum_algo_run(algo, buf, size, &result);
+		else
+			cksum_par_run(par, algo, buf, size, NULL, &result);
+		sink += result;
+		iters++;
+		elapsed = now() - start;
+	} while (elapsed < seconds);
+
+	return (double)size * iters / elapsed / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t size = 256 * 1024 * 1024;
+	size_t chunk = CKSUM_PAR_DEFAULT_CHUNK;
+	long max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	double seconds = 0.5;
+	double base[NUM_ALGOS], gbps;
+	cksum_par_t *par;
+	char *buf;
+	size_t i;
+	unsigned a;
+	long threads;
+	int failed = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "s:n:c:t:")) != -1)
+	{
+		switch (opt)
+		{
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			max_threads = atol(optarg);
+			break;
+		case 'c':
+			chunk = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = atof(optarg);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (max_threads < 1)
+		max_threads = 1;
+	if (0 == chunk || size < 2 * chunk)
+	{
+		fprintf(stderr, "%s: the buffer has to hold at least two chunks\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	buf = malloc(size);
+	if (NULL == buf)
+	{
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	srand(1);
+	for (i = 0; i < size; i++)
+		buf[i] = rand();
+
+	printf("%zu bytes in %zu byte chunks, sum kernel: %s, crc32c: %s\n", size, chunk,
+			cksum_kernel_name(cksum_kernel_current()),
+			cksum_crc32c_hw() ? "crc instructions" : "tables");
+	printf("%-8s %8s %10s %8s\n", "algo", "threads", "GB/s", "speedup");
+	for (a = 0; a < NUM_ALGOS; a++)
+	{
+		base[a] = bench(NULL, algos[a], buf, size, seconds);
+		printf("%-8s %8s %10.2f %8s\n", cksum_algo_name(algos[a]), "plain", base[a], "");
+	}
+
+	for (threads = 1; threads <= max_threads; threads++)
+	{
+		// split everything, even with no workers, to show what splitting costs
+		par = cksum_par_create(threads - 1, chunk, 1);
+		if (NULL == par)
+		{
+			perror("cksum_par_create");
+			exit(EXIT_FAILURE);
+		}
+		if (-1 == verify(par, buf, size, chunk))
+		{
+			failed = 1;
+			cksum_par_destroy(par);
+			continue;
+		}
+		for (a = 0; a < NUM_ALGOS; a++)
+		{
+			gbps = bench(par, algos[a], buf, size, seconds);
+			printf("%-8s %8ld %10.2f %7.2fx\n", cksum_algo_name(algos[a]), threads, gbps,
+					gbps / base[a]);
+		}
+		cksum_par_destroy(par);
+	}
+
+	free(buf);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,276 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_region.c
+//
+// Shared memory regions for zero-copy checksums, see cksum_region.h
+//
+// Regions are reference counted: the table holds one reference and every
+// request working on the region holds another, so a disconnect (or a new
+// attach) from one thread never unmaps memory another thread is still
+// checksumming.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "cksum.h"
+#include "cksum_region.h"
+
+#define REGION_BUCKETS 256
+
+#ifndef __QNX__
+// the stand-in handles' names, followed by the creator's pid and a count
+#define SHM_NAME_PREFIX "/cksum_region."
+#endif
+
+struct cksum_region
+{
+	int client;
+	void *base;
+	size_t size;
+	int refs;
+	struct cksum_region *next;
+};
+
+static cksum_region_t *buckets[REGION_BUCKETS];
+static pthread_mutex_t region_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int cksum_shm_create(size_t size, pid_t server_pid, int server_oflag, void **ptr,
+		cksum_shm_handle_t *handle)
+{
+	int fd;
+#ifndef __QNX__
+	static unsigned counter = 0;
+#endif
+
+#ifdef __QNX__
+	fd = shm_open(SHM_ANON, O_RDWR | O_CREAT, 0600);
+#else
+	snprintf(handle->name, sizeof(handle->name), SHM_NAME_PREFIX "%d.%u", getpid(),
+			__atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED));
+	fd = shm_open(handle->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+#endif
+	if (-1 == fd)
+		return -1;
+
+	if (-1 == ftruncate(fd, size))
+		goto fail;
+
+	*ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (MAP_FAILED == *ptr)
+		goto fail;
+
+#ifdef __QNX__
+	if (-1 == shm_create_handle(fd, server_pid, server_oflag, handle, 0))
+	{
+		munmap(*ptr, size);
+		goto fail;
+	}
+#else
+	(void)server_oflag;
+#endif
+
+	close(fd);
+	return 0;
+
+fail:
+#ifndef __QNX__
+	shm_unlink(handle->name);
+#endif
+	close(fd);
+	return -1;
+}
+
+int cksum_region_create(size_t size, pid_t server_pid, void **ptr, cksum_shm_handle_t *handle)
+{
+	// the server only gets to read it
+	return cksum_shm_create(size, server_pid, O_RDONLY, ptr, handle);
+}
+
+void cksum_region_destroy(void *ptr, size_t size)
+{
+	munmap(ptr, size);
+}
+
+#ifndef __QNX__
+// whether a stand-in handle is a name cksum_shm_create() gave owner, not
+// some other object the client would have us open and unlink
+static int handle_is_owners(const cksum_shm_handle_t *handle, pid_t owner)
+{
+	char prefix[sizeof(handle->name)];
+	const char *count;
+	int len;
+
+	if (NULL == memchr(handle->name, '\0', sizeof(handle->name)))
+		return 0;
+	len = snprintf(prefix, sizeof(prefix), SHM_NAME_PREFIX "%d.", owner);
+	if (0 != strncmp(handle->name, prefix, len))
+		return 0;
+	count = handle->name + len;
+	return '\0' != *count && '\0' == count[strspn(count, "0123456789")];
+}
+#endif
+
+// open the object behind a handle, which uses the handle up
+static int open_handle(const cksum_shm_handle_t *handle, pid_t owner, int oflag)
+{
+#ifdef __QNX__
+	// the handle itself says which process may open it, and how
+	(void)owner;
+	return shm_open_handle(*handle, oflag);
+#else
+	int fd;
+
+	if (!handle_is_owners(handle, owner))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	fd = shm_open(handle->name, oflag, 0);
+	if (-1 != fd)
+		shm_unlink(handle->name);
+	return fd;
+#endif
+}
+
+void *cksum_shm_map(const cksum_shm_handle_t *handle, pid_t owner, size_t size, int oflag)
+{
+	struct stat st;
+	void *ptr;
+	int fd;
+
+	fd = open_handle(handle, owner, oflag);
+	if (-1 == fd)
+		return NULL;
+
+	// mapping past the end of the object would fault when we touch it
+	if (-1 == fstat(fd, &st) || (uint64_t)st.st_size < size || 0 == size)
+	{
+		close(fd);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	ptr = mmap(NULL, size, O_RDWR == (oflag & O_ACCMODE) ? PROT_READ | PROT_WRITE : PROT_READ,
+			MAP_SHARED, fd, 0);
+	close(fd);
+	return MAP_FAILED == ptr ? NULL : ptr;
+}
+
+static void region_free(cksum_region_t *region)
+{
+	munmap(region->base, region->size);
+	free(region);
+}
+
+// unlink the client's region from the table, returns it (with the table's
+// reference now owned by the caller) or NULL.  Called with the lock held.
+static cksum_region_t *table_remove(int client)
+{
+	cksum_region_t **link = &buckets[(unsigned)client % REGION_BUCKETS];
+	cksum_region_t *region;
+
+	for (; NULL != (region = *link); link = &region->next)
+	{
+		if (region->client == client)
+		{
+			*link = region->next;
+			return region;
+		}
+	}
+	return NULL;
+}
+
+cksum_region_t *cksum_region_attach(int client, pid_t owner, const cksum_shm_handle_t *handle,
+		size_t size)
+{
+	cksum_region_t *region, *old;
+
+	region = malloc(sizeof(*region));
+	if (NULL == region)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+	region->base = cksum_shm_map(handle, owner, size, O_RDONLY);
+	if (NULL == region->base)
+	{
+		free(region);
+		return NULL;
+	}
+	region->client = client;
+	region->size = size;
+	region->refs = 2; // the table's and the caller's
+
+	pthread_mutex_lock(&region_lock);
+	old = table_remove(client);
+	region->next = buckets[(unsigned)client % REGION_BUCKETS];
+	buckets[(unsigned)client % REGION_BUCKETS] = region;
+	pthread_mutex_unlock(&region_lock);
+
+	if (NULL != old)
+		cksum_region_put(old);
+	return region;
+}
+
+cksum_region_t *cksum_region_get(int client)
+{
+	cksum_region_t *region;
+
+	pthread_mutex_lock(&region_lock);
+	for (region = buckets[(unsigned)client % REGION_BUCKETS]; NULL != region;
+			region = region->next)
+	{
+		if (region->client == client)
+		{
+			region->refs++;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&region_lock);
+
+	if (NULL == region)
+		errno = ENOENT;
+	return region;
+}
+
+void cksum_region_put(cksum_region_t *region)
+{
+	int refs;
+
+	pthread_mutex_lock(&region_lock);
+	refs = --region->refs;
+	pthread_mutex_unlock(&region_lock);
+
+	if (0 == refs)
+		region_free(region);
+}
+
+void cksum_region_detach(int client)
+{
+	cksum_region_t *region;
+
+	pthread_mutex_lock(&region_lock);
+	region = table_remove(client);
+	pthread_mutex_unlock(&region_lock);
+
+	if (NULL != region)
+		cksum_region_put(region);
+}
+
+int cksum_region_checksum(const cksum_region_t *region, uint64_t offset, uint64_t length,
+		int *cksum)
+{
+	if (offset > region->size || length > region->size - offset)
+	{
+		errno = EBADMSG;
+		return -1;
+	}
+	*cksum = calculate_checksum_len((const char *)region->base + offset, length);
+	return 0;
+}
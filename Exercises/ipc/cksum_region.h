@@ -0,0 +1,81 @@
+#ifndef _CKSUM_REGION_H_
+#define _CKSUM_REGION_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// cksum_region.h
+//
+// Zero-copy checksums over shared memory.
+//
+// The client puts its data in a shared memory object and hands the server a
+// handle to it (as shmem_qnx_server.c does, but in the other direction).  The
+// server maps the whole object read-only once per client, keeps the mapping
+// in a table keyed by the client's id (its scoid), and checksums any
+// offset/length inside it in place.  The mapping goes away when the client
+// attaches a different object or disconnects.
+//
+// On QNX the handle is a shm_handle_t from shm_create_handle().  Elsewhere
+// (the Linux build hosts) a POSIX shm_open() name stands in for it: the
+// server unlinks the name when it opens it, so like a real handle it can
+// only be used once.  The server only takes names of the form
+// cksum_shm_create() gives them, made by the client that sent them, so a
+// client can't have it open or unlink any other object.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+
+#ifdef __QNX__
+typedef shm_handle_t cksum_shm_handle_t;
+#else
+typedef struct
+{
+	char name[32];
+} cksum_shm_handle_t;
+#endif
+
+typedef struct cksum_region cksum_region_t;
+
+// create a size byte shared memory object, mapped read/write at *ptr, and a
+// handle that server_pid can open once with server_oflag (O_RDONLY or O_RDWR).
+// Returns 0 or -1.
+int cksum_shm_create(size_t size, pid_t server_pid, int server_oflag, void **ptr,
+		cksum_shm_handle_t *handle);
+
+// open the object behind a handle that process owner created and map its
+// first size bytes, read/write if oflag is O_RDWR.  Returns NULL with errno
+// set (EINVAL if the object is smaller than size, or the handle isn't one
+// of owner's).  Unmap it with munmap().
+void *cksum_shm_map(const cksum_shm_handle_t *handle, pid_t owner, size_t size, int oflag);
+
+
+// client side: cksum_shm_create() for a region the server can only read
+int cksum_region_create(size_t size, pid_t server_pid, void **ptr, cksum_shm_handle_t *handle);
+
+// client side: unmap an object from cksum_region_create()
+void cksum_region_destroy(void *ptr, size_t size);
+
+// server side: map the object behind handle for client, whose process is
+// owner, replacing any region the client had.  Returns the region with a
+// reference held for the caller (release it with cksum_region_put()), or
+// NULL with errno set (EINVAL if the object is smaller than size).
+cksum_region_t *cksum_region_attach(int client, pid_t owner, const cksum_shm_handle_t *handle,
+		size_t size);
+
+// server side: the client's current region with a reference held, or NULL
+// (errno ENOENT) if it hasn't attached one
+cksum_region_t *cksum_region_get(int client);
+
+// drop a reference, the last one unmaps a detached region
+void cksum_region_put(cksum_region_t *region);
+
+// server side: forget the client's region, e.g. on its disconnect pulse
+void cksum_region_detach(int client);
+
+// checksum length bytes at offset in the region, without copying.  Returns 0
+// or -1 (errno EBADMSG if the range isn't inside the region).
+int cksum_region_checksum(const cksum_region_t *region, uint64_t offset, uint64_t length,
+		int *cksum);
+
+#endif //_CKSUM_REGION_H_
@@ -0,0 +1,231 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_ring.c
+//
+// Shared memory submission/completion rings, see cksum_ring.h
+//
+// Lost wakeups are ruled out the way Dekker's algorithm rules out two threads
+// entering a critical section: the producer stores its head and then loads
+// the consumer's tail, the consumer stores its tail and then loads the
+// producer's head, all sequentially consistent.  So either the consumer sees
+// the new entry before it decides the ring is empty, or the producer sees
+// that the consumer had caught up with it and rings the doorbell.
+//
+// The data area is allocated like a ring too.  Completions come back in
+// submission order, so space is freed in the order it was handed out; a
+// payload that won't fit before the end of the area starts again at the
+// beginning.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cksum.h"
+#include "cksum_ring.h"
+
+#define CACHE_LINE 64
+
+static size_t sq_offset(void)
+{
+	return sizeof(cksum_ring_t);
+}
+
+static size_t cq_offset(uint32_t entries)
+{
+	return sq_offset() + entries * sizeof(cksum_sqe_t);
+}
+
+static size_t data_offset(uint32_t entries)
+{
+	return (cq_offset(entries) + entries * sizeof(cksum_cqe_t) + CACHE_LINE - 1)
+			& ~(size_t)(CACHE_LINE - 1);
+}
+
+static cksum_sqe_t *ring_sq(cksum_ring_t *ring)
+{
+	return (cksum_sqe_t *)((char *)ring + sq_offset());
+}
+
+static cksum_cqe_t *ring_cq(cksum_ring_t *ring, uint32_t entries)
+{
+	return (cksum_cqe_t *)((char *)ring + cq_offset(entries));
+}
+
+static char *ring_data(cksum_ring_t *ring, uint32_t entries)
+{
+	return (char *)ring + data_offset(entries);
+}
+
+size_t cksum_ring_bytes(uint32_t entries, size_t data_size)
+{
+	if (0 == entries || entries > CKSUM_RING_MAX_ENTRIES || (entries & (entries - 1))
+			|| 0 == data_size || data_size > UINT32_MAX)
+		return 0;
+	return data_offset(entries) + data_size;
+}
+
+void cksum_ring_init(cksum_ring_t *ring, uint32_t entries, size_t data_size)
+{
+	memset(ring, 0, data_offset(entries));
+	ring->entries = entries;
+	ring->data_size = data_size;
+}
+
+int cksum_ring_server_init(cksum_ring_server_t *server, cksum_ring_t *ring, size_t bytes)
+{
+	// one read of each, the client could change them while we look
+	uint32_t entries = *(volatile uint32_t *)&ring->entries;
+	uint32_t data_size = *(volatile uint32_t *)&ring->data_size;
+	size_t need = cksum_ring_bytes(entries, data_size);
+
+	if (0 == need || need > bytes)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	server->ring = ring;
+	server->entries = entries;
+	server->data_size = data_size;
+	server->sq_tail = __atomic_load_n(&ring->sq_tail, __ATOMIC_ACQUIRE);
+	server->cq_head = __atomic_load_n(&ring->cq_head, __ATOMIC_ACQUIRE);
+	return 0;
+}
+
+int cksum_ring_client_init(cksum_ring_client_t *client, cksum_ring_t *ring)
+{
+	memset(client, 0, sizeof(*client));
+	client->data_end = malloc(ring->entries * sizeof(client->data_end[0]));
+	if (NULL == client->data_end)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+	client->ring = ring;
+	return 0;
+}
+
+void cksum_ring_client_fini(cksum_ring_client_t *client)
+{
+	free(client->data_end);
+	client->data_end = NULL;
+}
+
+int cksum_ring_submit(cksum_ring_client_t *client, uint16_t algorithm, const void *data,
+		size_t len, uint32_t tag, int *doorbell)
+{
+	cksum_ring_t *ring = client->ring;
+	uint32_t slot = client->submitted & (ring->entries - 1);
+	uint64_t pos = client->data_head;
+	uint32_t offset;
+	cksum_sqe_t *sqe;
+
+	*doorbell = 0;
+	if (len > ring->data_size)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	// never more in flight than the completion ring can hold
+	if (client->submitted - client->reaped >= ring->entries)
+	{
+		errno = EAGAIN;
+		return -1;
+	}
+	offset = pos % ring->data_size;
+	if (offset + len > ring->data_size)
+	{
+		pos += ring->data_size - offset;
+		offset = 0;
+	}
+	if (pos + len - client->data_tail > ring->data_size)
+	{
+		errno = EAGAIN;
+		return -1;
+	}
+
+	memcpy(ring_data(ring, ring->entries) + offset, data, len);
+	sqe = &ring_sq(ring)[slot];
+	sqe->tag = tag;
+	sqe->algorithm = algorithm;
+	sqe->zero = 0;
+	sqe->offset = offset;
+	sqe->length = len;
+	client->data_end[slot] = client->data_head = pos + len;
+
+	__atomic_store_n(&ring->sq_head, client->submitted + 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&ring->sq_tail, __ATOMIC_SEQ_CST) == client->submitted)
+		*doorbell = 1;
+	client->submitted++;
+	return 0;
+}
+
+uint32_t cksum_ring_outstanding(const cksum_ring_client_t *client)
+{
+	return client->submitted - client->reaped;
+}
+
+int cksum_ring_reap(cksum_ring_client_t *client, cksum_cqe_t *cqes, int max)
+{
+	cksum_ring_t *ring = client->ring;
+	uint32_t mask = ring->entries - 1;
+	cksum_cqe_t *cq = ring_cq(ring, ring->entries);
+	uint32_t head;
+	int n = 0;
+
+	head = __atomic_load_n(&ring->cq_head, __ATOMIC_SEQ_CST);
+	// the server can't complete what we never submitted
+	if (head - client->reaped > client->submitted - client->reaped)
+		head = client->submitted;
+	while (n < max && client->reaped != head)
+	{
+		cqes[n++] = cq[client->reaped & mask];
+		client->data_tail = client->data_end[client->reaped & mask];
+		client->reaped++;
+	}
+	if (n)
+		__atomic_store_n(&ring->cq_tail, client->reaped, __ATOMIC_SEQ_CST);
+	return n;
+}
+
+unsigned cksum_ring_serve(cksum_ring_server_t *server, unsigned max, int *doorbell)
+{
+	cksum_ring_t *ring = server->ring;
+	uint32_t mask = server->entries - 1;
+	cksum_sqe_t *sq = ring_sq(ring);
+	cksum_cqe_t *cq = ring_cq(ring, server->entries);
+	const char *data = ring_data(ring, server->entries);
+	cksum_sqe_t sqe;
+	cksum_cqe_t cqe;
+	unsigned n = 0;
+
+	*doorbell = 0;
+	while (n < max)
+	{
+		if (__atomic_load_n(&ring->sq_head, __ATOMIC_SEQ_CST) == server->sq_tail)
+			break;
+		// a client that doesn't reap gets no more service
+		if (server->cq_head - __atomic_load_n(&ring->cq_tail, __ATOMIC_ACQUIRE)
+				>= server->entries)
+			break;
+
+		// copy the entry out before checking it, the client can still write it
+		sqe = sq[server->sq_tail & mask];
+		cqe.tag = sqe.tag;
+		cqe.error = 0;
+		cqe.result = 0;
+		if (sqe.offset > server->data_size || sqe.length > server->data_size - sqe.offset)
+			cqe.error = EBADMSG;
+		else if (-1 == cksum_algo_run(sqe.algorithm, data + sqe.offset, sqe.length, &cqe.result))
+			cqe.error = errno;
+		cq[server->cq_head & mask] = cqe;
+
+		__atomic_store_n(&ring->cq_head, server->cq_head + 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&ring->cq_tail, __ATOMIC_SEQ_CST) == server->cq_head)
+			*doorbell = 1;
+		server->cq_head++;
+		server->sq_tail++;
+		__atomic_store_n(&ring->sq_tail, server->sq_tail, __ATOMIC_SEQ_CST);
+		n++;
+	}
+	return n;
+}
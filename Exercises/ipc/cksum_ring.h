@@ -0,0 +1,117 @@
+#ifndef _CKSUM_RING_H_
+#define _CKSUM_RING_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// cksum_ring.h
+//
+// Submission and completion rings for asynchronous checksum requests, laid
+// out in one shared memory object between a client and the server.
+//
+// The client copies each payload into the object's data area and pushes a
+// submission entry naming it; the server pops submissions, checksums the data
+// in place and pushes a completion entry (in submission order) for each.
+// Each ring has one producer and one consumer, so no locks are needed, only
+// ordered loads and stores of the head and tail indices.
+//
+// Neither side polls.  Whoever pushes onto a ring that was empty is told to
+// ring the doorbell (the transport's business, a pulse on QNX), and the other
+// side drains a ring until it is empty before waiting for one.  The empty
+// check and the push are ordered so that one of the two always sees the
+// other: no wakeup is lost, though a stale one can arrive.
+//
+// This file is plain C and knows nothing of the transport; see cksum_async.h
+// for the QNX client and server.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CKSUM_RING_MAX_ENTRIES 4096
+
+typedef struct
+{
+	uint32_t tag; // the client's, handed back in the completion
+	uint16_t algorithm; // cksum_algo_t
+	uint16_t zero;
+	uint32_t offset; // of the data in the data area
+	uint32_t length;
+} cksum_sqe_t;
+
+typedef struct
+{
+	uint32_t tag;
+	int32_t error; // 0, or an errno value
+	uint64_t result;
+} cksum_cqe_t;
+
+// the indices count up forever (wrapping at 2^32); entry i is in slot
+// i & (entries - 1).  Each one is on its own cache line.
+typedef struct
+{
+	uint32_t sq_head __attribute__((aligned(64))); // written by the client
+	uint32_t sq_tail __attribute__((aligned(64))); // written by the server
+	uint32_t cq_head __attribute__((aligned(64))); // written by the server
+	uint32_t cq_tail __attribute__((aligned(64))); // written by the client
+	uint32_t entries __attribute__((aligned(64))); // power of two
+	uint32_t data_size;
+	// followed by cksum_sqe_t sq[entries], cksum_cqe_t cq[entries], then the
+	// data area
+} cksum_ring_t;
+
+// the server's private view of a ring: the geometry it checked at attach
+// time and its own indices, none of which the client can change under it
+typedef struct
+{
+	cksum_ring_t *ring;
+	uint32_t entries;
+	uint32_t data_size;
+	uint32_t sq_tail;
+	uint32_t cq_head;
+} cksum_ring_server_t;
+
+// the client's private bookkeeping for its ring
+typedef struct
+{
+	cksum_ring_t *ring;
+	uint32_t submitted; // sequence number of the next submission
+	uint32_t reaped; // sequence number of the next completion
+	uint64_t data_head; // data area allocation, in bytes ever allocated
+	uint64_t data_tail; // everything before this has completed
+	uint64_t *data_end; // per slot, data_head after that submission
+} cksum_ring_client_t;
+
+// shared memory needed for a ring, 0 if entries isn't a power of two up to
+// CKSUM_RING_MAX_ENTRIES or the data area is empty or 4G or more
+size_t cksum_ring_bytes(uint32_t entries, size_t data_size);
+
+// lay out an empty ring in cksum_ring_bytes() of memory
+void cksum_ring_init(cksum_ring_t *ring, uint32_t entries, size_t data_size);
+
+// server side: check a ring's header against the size of the memory it was
+// found in (the client could have put anything there).  Returns 0 or -1
+// (errno EINVAL).
+int cksum_ring_server_init(cksum_ring_server_t *server, cksum_ring_t *ring, size_t bytes);
+
+// client side: returns 0 or -1 (errno ENOMEM)
+int cksum_ring_client_init(cksum_ring_client_t *client, cksum_ring_t *ring);
+void cksum_ring_client_fini(cksum_ring_client_t *client);
+
+// client side: copy len bytes into the data area and queue them.  Sets
+// *doorbell if the server has to be woken.  Returns -1 with errno EAGAIN if
+// there's no room until completions are reaped, or EINVAL if the data could
+// never fit.
+int cksum_ring_submit(cksum_ring_client_t *client, uint16_t algorithm, const void *data,
+		size_t len, uint32_t tag, int *doorbell);
+
+// client side: submissions not reaped yet
+uint32_t cksum_ring_outstanding(const cksum_ring_client_t *client);
+
+// client side: take up to max completions, returns how many (0 if none)
+int cksum_ring_reap(cksum_ring_client_t *client, cksum_cqe_t *cqes, int max);
+
+// server side: process up to max submissions.  Sets *doorbell if the client
+// has to be woken for its completions.  Returns the number processed; if
+// that is max there may be more, and nobody will ring for them.
+unsigned cksum_ring_serve(cksum_ring_server_t *server, unsigned max, int *doorbell);
+
+#endif //_CKSUM_RING_H_
@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_stream.c
+//
+// Streaming checksum with a preallocated per-thread window, see cksum_stream.h
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "cksum.h"
+#include "cksum_stream.h"
+
+typedef struct
+{
+	size_t size;
+	char data[];
+} window_t;
+
+static size_t chunk_size = CKSUM_STREAM_DEFAULT_CHUNK;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t window_key;
+
+static void window_free(void *window)
+{
+	free(window);
+}
+
+static void key_create(void)
+{
+	(void)pthread_key_create(&window_key, window_free);
+}
+
+// this thread's window, allocated on first use
+static window_t *get_window(void)
+{
+	window_t *window;
+
+	pthread_once(&key_once, key_create);
+	window = pthread_getspecific(window_key);
+	if (NULL == window)
+	{
+		window = malloc(sizeof(*window) + chunk_size);
+		if (NULL == window)
+		{
+			errno = ENOMEM;
+			return NULL;
+		}
+		window->size = chunk_size;
+		if (0 != pthread_setspecific(window_key, window))
+		{
+			free(window);
+			errno = ENOMEM;
+			return NULL;
+		}
+	}
+	return window;
+}
+
+int cksum_stream_set_chunk_size(size_t size)
+{
+	if (0 == size)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	chunk_size = size;
+	return 0;
+}
+
+size_t cksum_stream_chunk_size(void)
+{
+	return chunk_size;
+}
+
+int cksum_stream(cksum_read_fn_t read_fn, void *handle, size_t offset, size_t nbytes,
+		int *cksum, size_t *nread)
+{
+	window_t *window;
+	size_t done = 0;
+	size_t want;
+	ssize_t got;
+	int sum = 0;
+
+	window = get_window();
+	if (NULL == window)
+		return -1;
+
+	while (done < nbytes)
+	{
+		want = nbytes - done;
+		if (want > window->size)
+			want = window->size;
+
+		got = read_fn(handle, window->data, want, offset + done);
+		if (-1 == got)
+			return -1;
+		if (0 == got)
+			break; // the source had less data than it claimed
+
+		sum = cksum_update(sum, window->data, got);
+		done += got;
+	}
+
+	*cksum = sum;
+	if (NULL != nread)
+		*nread = done;
+	return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef _CKSUM_STREAM_H_
+#define _CKSUM_STREAM_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// cksum_stream.h
+//
+// Streaming checksum of a payload that is pulled in a chunk at a time, e.g.
+// with repeated MsgRead() calls at increasing offsets.  Each thread gets one
+// fixed-size window, allocated on its first use and reused for every request,
+// so memory use doesn't depend on the payload size.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define CKSUM_STREAM_DEFAULT_CHUNK	(64 * 1024)
+
+// reads up to nbytes at offset into buf, returns the number of bytes read
+// (0 at the end of the data) or -1 with errno set.  MsgRead() fits this with
+// the rcvid as the handle.
+typedef ssize_t (*cksum_read_fn_t)(void *handle, void *buf, size_t nbytes, size_t offset);
+
+// set the window size used by threads that haven't allocated their window
+// yet, call it before the first cksum_stream().  Returns -1 (errno EINVAL)
+// for a zero size.
+int cksum_stream_set_chunk_size(size_t chunk_size);
+
+size_t cksum_stream_chunk_size(void);
+
+// checksum nbytes starting at offset, a window at a time.  If the source
+// runs out early the checksum covers what was read.  The number of bytes
+// checksummed is stored in *nread if nread isn't NULL.  Returns 0, or -1 with
+// errno set (ENOMEM if the window can't be allocated, or the read error).
+int cksum_stream(cksum_read_fn_t read_fn, void *handle, size_t offset, size_t nbytes,
+		int *cksum, size_t *nread);
+
+#endif //_CKSUM_STREAM_H_
@@ -13,6 +13,7 @@
 #include <sys/neutrino.h>
 
 #include "msg_def.h"
+#include "cksum.h"
 
 typedef union
 {
@@ -30,7 +31,6 @@ struct listNode
 
 typedef struct listNode listNode_t;
 
-int calculate_checksum(char *text);
 listNode_t* add_client_to_list(listNode_t* listp, int scoid);
 listNode_t* remove_client_from_list(listNode_t* list_ptr, int scoid);
 int print_list(listNode_t* list_ptr);
@@ -109,15 +109,6 @@ int main(void)
 	return 0;
 }
 
-int calculate_checksum(char *text)
-{
-	char *c;
-	int cksum = 0;
-
-	for (c = text; *c != '\0'; c++)
-		cksum += *c;
-	return cksum;
-}
 
 listNode_t* add_client_to_list(listNode_t* listp, int scoid)
 {
@@ -189,4 +180,3 @@ listNode_t* remove_client_from_list(listNode_t* listp, int scoid)
 	free(curp);
 	return listp;
 }
-
@@ -0,0 +1,1445 @@
+////////////////////////////////////////////////////////////////////////////////
+// neutrino_host.c
+//
+// QNX Neutrino message passing for Linux hosts, see sys/neutrino.h and
+// sys/dispatch.h in this directory.
+//
+// A channel is a listening UNIX domain socket, bound in the abstract
+// namespace as "qnx/<pid>/<chid>", so ConnectAttach() finds it with nothing
+// more than the pid and chid, as on QNX.  Each thread that uses a connection
+// gets its own stream socket to the channel, made the first time it sends on
+// it, so every message on a socket has at most one reply outstanding and
+// threads sharing a coid don't have to take turns.
+//
+// The blocking states carry over as they are:
+// - SEND blocked: the message sits in the socket until a server thread's
+//   MsgReceive() takes it.  A message bigger than the socket buffer holds
+//   the client in write() until then, just as QNX holds it until the copy.
+// - REPLY blocked: the client waits in read() for the reply.  The server
+//   takes the socket out of its epoll set when it receives a message, and
+//   only puts it back when it replies, so nothing more is read from that
+//   client thread in between.
+//
+// The server keeps a copy of every message it hasn't replied to yet, which
+// is what MsgRead() reads from (QNX reads the client's memory instead).
+// Pulses are frames on the same sockets, or for the ones the "kernel" sends
+// (_PULSE_CODE_DISCONNECT) an in-process queue behind an eventfd.
+//
+// Not provided: priorities (nothing is inherited, a pulse's priority is
+// ignored), unblock pulses and timeouts other than on receiving (a client
+// interrupted by a signal while REPLY blocked keeps waiting, as if the
+// channel had _NTO_CHF_UNBLOCK), and anything across nodes.  TimerTimeout()
+// only takes _NTO_TIMEOUT_RECEIVE, and only for the next MsgReceive().
+//
+// Tables are small fixed arrays behind one mutex; the message paths only take
+// it to allocate and free receive ids.
+////////////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+
+#include "sys/neutrino.h"
+#include "sys/dispatch.h"
+
+#define MAX_CHANNELS 64
+#define MAX_COIDS 1024
+#define MAX_CLIENTS 1024
+#define MAX_RCVIDS 4096 // a power of two, the low bits of a rcvid
+#define MAX_IOV 64
+
+// scoids live in their own range so ConnectDetach() can tell them apart
+#define SCOID_BASE 0x00010000
+
+enum
+{
+	FRAME_SEND = 1, FRAME_PULSE = 2
+};
+
+// what a client thread writes, followed by len bytes of message
+typedef struct
+{
+	uint16_t kind;
+	int8_t code; // pulses
+	uint8_t zero;
+	int32_t tid;
+	int32_t coid;
+	int32_t value; // pulses
+	uint32_t len;
+	uint32_t rbytes; // room for the reply
+} frame_t;
+
+// what the server writes back, followed by len bytes of reply
+typedef struct
+{
+	int32_t status;
+	int32_t err; // MsgError()
+	uint32_t len;
+} reply_t;
+
+enum
+{
+	OBJ_LISTENER, OBJ_PULSES, OBJ_CONN
+};
+
+typedef struct chan chan_t;
+typedef struct client client_t;
+
+// something on a channel's epoll set
+typedef struct sconn
+{
+	int kind;
+	int fd;
+	chan_t *chan;
+	client_t *client; // OBJ_CONN
+	struct sconn *next; // on the channel's list of connections
+} sconn_t;
+
+struct chan
+{
+	int chid;
+	unsigned flags;
+	int epfd;
+	sconn_t listener;
+	sconn_t pulses; // the eventfd counting queued pulses
+	sconn_t *conns;
+	struct _pulse *queue; // pulses from us, a ring
+	unsigned queue_head, queue_tail, queue_size;
+};
+
+// a client process's connections to one channel, named by its scoid
+struct client
+{
+	int in_use;
+	int gone; // disconnected, waiting for the server's ConnectDetach()
+	chan_t *chan;
+	pid_t pid;
+	unsigned nconns;
+};
+
+// a message received and not yet replied to
+typedef struct
+{
+	int in_use;
+	unsigned gen;
+	sconn_t *conn;
+	int32_t coid, tid;
+	uint32_t rbytes;
+	char *buf; // the message
+	size_t len, cap;
+} rcv_t;
+
+// our side of a connection; fds are the threads' sockets to the channel
+typedef struct
+{
+	int in_use;
+	unsigned gen; // changes on every attach and detach
+	pid_t pid;
+	int chid;
+	int *fds;
+	unsigned nfds, cap;
+} coid_t;
+
+typedef struct
+{
+	unsigned gen;
+	int fd;
+} tls_conn_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static chan_t *channels[MAX_CHANNELS];
+static client_t clients[MAX_CLIENTS];
+static rcv_t rcvs[MAX_RCVIDS];
+static coid_t coids[MAX_COIDS];
+static char *names[MAX_CHANNELS]; // name_attach()ed link, by chid
+
+static pthread_once_t tls_once = PTHREAD_ONCE_INIT;
+static pthread_key_t tls_key;
+static __thread tls_conn_t *tls_conns; // indexed like coids[]
+static __thread int64_t tls_timeout_ns = -1; // TimerTimeout() for the next receive
+
+////////////////////////////////////////////////////////////////////////////////
+// helpers
+
+static int gettid_(void)
+{
+	return syscall(SYS_gettid);
+}
+
+static socklen_t chan_address(struct sockaddr_un *addr, pid_t pid, int chid)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	// abstract namespace: leading nul, no file to clean up
+	return offsetof(struct sockaddr_un, sun_path) + 1
+			+ snprintf(addr->sun_path + 1, sizeof(addr->sun_path) - 1, "qnx/%d/%d", pid, chid);
+}
+
+static size_t iov_total(const iov_t *iov, size_t parts)
+{
+	size_t total = 0;
+	size_t i;
+
+	for (i = 0; i < parts; i++)
+		total += iov[i].iov_len;
+	return total;
+}
+
+// copy len bytes of src into an iov list, returns how many fit
+static size_t copy_to_iov(const iov_t *iov, size_t parts, const char *src, size_t len)
+{
+	size_t done = 0, n;
+	size_t i;
+
+	for (i = 0; i < parts && done < len; i++)
+	{
+		n = iov[i].iov_len < len - done ? iov[i].iov_len : len - done;
+		memcpy(iov[i].iov_base, src + done, n);
+		done += n;
+	}
+	return done;
+}
+
+// read exactly len bytes, 0 on success, -1 on error or end of file
+static int read_full(int fd, void *buf, size_t len)
+{
+	char *p = buf;
+	ssize_t n;
+
+	while (len)
+	{
+		n = read(fd, p, len);
+		if (-1 == n && EINTR == errno)
+			continue;
+		if (n <= 0)
+		{
+			if (0 == n)
+				errno = ECONNRESET;
+			return -1;
+		}
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+// read exactly total bytes into an iov list (which it changes)
+static int readv_full(int fd, iov_t *iov, int parts, size_t total)
+{
+	ssize_t n;
+
+	while (total)
+	{
+		n = readv(fd, iov, parts);
+		if (-1 == n && EINTR == errno)
+			continue;
+		if (n <= 0)
+		{
+			if (0 == n)
+				errno = ECONNRESET;
+			return -1;
+		}
+		total -= n;
+		while (parts && (size_t)n >= iov->iov_len)
+		{
+			n -= iov->iov_len;
+			iov++;
+			parts--;
+		}
+		if (parts)
+		{
+			iov->iov_base = (char *)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+	return 0;
+}
+
+// write a whole iov list (which it changes), without SIGPIPE if the other
+// end has gone
+static int writev_full(int fd, iov_t *iov, int parts)
+{
+	struct msghdr mh;
+	ssize_t n;
+
+	while (parts)
+	{
+		memset(&mh, 0, sizeof(mh));
+		mh.msg_iov = iov;
+		mh.msg_iovlen = parts;
+		n = sendmsg(fd, &mh, MSG_NOSIGNAL);
+		if (-1 == n)
+		{
+			if (EINTR == errno)
+				continue;
+			return -1;
+		}
+		while (parts && (size_t)n >= iov->iov_len)
+		{
+			n -= iov->iov_len;
+			iov++;
+			parts--;
+		}
+		if (parts)
+		{
+			iov->iov_base = (char *)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+	return 0;
+}
+
+static chan_t *chan_get(int chid)
+{
+	chan_t *chan = NULL;
+
+	pthread_mutex_lock(&lock);
+	if (chid > 0 && chid < MAX_CHANNELS)
+		chan = channels[chid];
+	pthread_mutex_unlock(&lock);
+	if (NULL == chan)
+		errno = EINVAL;
+	return chan;
+}
+
+// put the socket back on the epoll set, it came off (EPOLLONESHOT) when its
+// message was received
+static void rearm(sconn_t *conn)
+{
+	struct epoll_event ev;
+
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.ptr = conn;
+	(void)epoll_ctl(conn->chan->epfd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+// queue a pulse from the "kernel", lock held
+static void queue_pulse(chan_t *chan, int code, int value, int scoid)
+{
+	struct _pulse *pulse;
+	struct _pulse *bigger;
+	uint64_t one = 1;
+	unsigned i;
+
+	if (chan->queue_tail - chan->queue_head == chan->queue_size)
+	{
+		bigger = malloc(2 * chan->queue_size * sizeof(*bigger));
+		if (NULL == bigger)
+			return;
+		for (i = 0; i < chan->queue_size; i++)
+			bigger[i] = chan->queue[(chan->queue_head + i) % chan->queue_size];
+		free(chan->queue);
+		chan->queue = bigger;
+		chan->queue_head = 0;
+		chan->queue_tail = chan->queue_size;
+		chan->queue_size *= 2;
+	}
+	pulse = &chan->queue[chan->queue_tail++ % chan->queue_size];
+	memset(pulse, 0, sizeof(*pulse));
+	pulse->type = _PULSE_TYPE;
+	pulse->subtype = _PULSE_SUBTYPE;
+	pulse->code = code;
+	pulse->value.sival_int = value;
+	pulse->scoid = scoid;
+	(void)write(chan->pulses.fd, &one, sizeof(one));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// channels
+
+int ChannelCreate(unsigned flags)
+{
+	chan_t *chan;
+	struct sockaddr_un addr;
+	socklen_t addrlen;
+	struct epoll_event ev;
+	int chid;
+	int err;
+
+	chan = calloc(1, sizeof(*chan));
+	if (NULL == chan)
+	{
+		errno = EAGAIN;
+		return -1;
+	}
+	chan->flags = flags;
+	chan->listener.kind = OBJ_LISTENER;
+	chan->pulses.kind = OBJ_PULSES;
+	chan->listener.chan = chan->pulses.chan = chan;
+	chan->listener.fd = chan->pulses.fd = chan->epfd = -1;
+	chan->queue_size = 16;
+	chan->queue = malloc(chan->queue_size * sizeof(*chan->queue));
+	if (NULL == chan->queue)
+	{
+		free(chan);
+		errno = EAGAIN;
+		return -1;
+	}
+
+	pthread_mutex_lock(&lock);
+	for (chid = 1; chid < MAX_CHANNELS && NULL != channels[chid]; chid++)
+		;
+	if (MAX_CHANNELS == chid)
+	{
+		pthread_mutex_unlock(&lock);
+		free(chan->queue);
+		free(chan);
+		errno = EAGAIN;
+		return -1;
+	}
+	channels[chid] = chan;
+	chan->chid = chid;
+	pthread_mutex_unlock(&lock);
+
+	addrlen = chan_address(&addr, getpid(), chid);
+	chan->listener.fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	chan->pulses.fd = eventfd(0, EFD_SEMAPHORE | EFD_NONBLOCK | EFD_CLOEXEC);
+	chan->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (-1 == chan->listener.fd || -1 == chan->pulses.fd || -1 == chan->epfd
+			|| -1 == bind(chan->listener.fd, (struct sockaddr *)&addr, addrlen)
+			|| -1 == listen(chan->listener.fd, SOMAXCONN))
+		goto fail;
+
+	// these two stay armed, any number of receiving threads can race for them
+	ev.events = EPOLLIN;
+	ev.data.ptr = &chan->listener;
+	if (-1 == epoll_ctl(chan->epfd, EPOLL_CTL_ADD, chan->listener.fd, &ev))
+		goto fail;
+	ev.data.ptr = &chan->pulses;
+	if (-1 == epoll_ctl(chan->epfd, EPOLL_CTL_ADD, chan->pulses.fd, &ev))
+		goto fail;
+	return chid;
+
+fail:
+	err = errno;
+	if (-1 != chan->listener.fd)
+		close(chan->listener.fd);
+	if (-1 != chan->pulses.fd)
+		close(chan->pulses.fd);
+	if (-1 != chan->epfd)
+		close(chan->epfd);
+	pthread_mutex_lock(&lock);
+	channels[chid] = NULL;
+	pthread_mutex_unlock(&lock);
+	free(chan->queue);
+	free(chan);
+	errno = err;
+	return -1;
+}
+
+int ChannelDestroy(int chid)
+{
+	chan_t *chan;
+	sconn_t *conn, *next;
+	int i;
+
+	pthread_mutex_lock(&lock);
+	if (chid <= 0 || chid >= MAX_CHANNELS || NULL == channels[chid])
+	{
+		pthread_mutex_unlock(&lock);
+		errno = EINVAL;
+		return -1;
+	}
+	chan = channels[chid];
+	channels[chid] = NULL;
+
+	// clients waiting on us see their socket close, and fail with ESRCH
+	for (i = 0; i < MAX_RCVIDS; i++)
+	{
+		if (rcvs[i].in_use && rcvs[i].conn->chan == chan)
+		{
+			rcvs[i].in_use = 0;
+			rcvs[i].gen++;
+		}
+	}
+	for (i = 0; i < MAX_CLIENTS; i++)
+		if (clients[i].in_use && clients[i].chan == chan)
+			clients[i].in_use = 0;
+	for (conn = chan->conns; NULL != conn; conn = next)
+	{
+		next = conn->next;
+		close(conn->fd);
+		free(conn);
+	}
+	pthread_mutex_unlock(&lock);
+
+	close(chan->listener.fd);
+	close(chan->pulses.fd);
+	close(chan->epfd);
+	free(chan->queue);
+	free(chan);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// server side
+
+static void accept_client(chan_t *chan)
+{
+	struct ucred cred;
+	socklen_t credlen = sizeof(cred);
+	struct epoll_event ev;
+	sconn_t *conn;
+	client_t *client = NULL;
+	int fd;
+	int i, spare = -1;
+
+	// non-blocking listener: another receiving thread may have got it first
+	fd = accept4(chan->listener.fd, NULL, NULL, SOCK_CLOEXEC);
+	if (-1 == fd)
+		return;
+	conn = calloc(1, sizeof(*conn));
+	if (NULL == conn || -1 == getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &credlen))
+	{
+		free(conn);
+		close(fd);
+		return;
+	}
+	conn->kind = OBJ_CONN;
+	conn->fd = fd;
+	conn->chan = chan;
+
+	// all of a process's sockets to this channel share one scoid
+	pthread_mutex_lock(&lock);
+	for (i = 0; i < MAX_CLIENTS; i++)
+	{
+		if (!clients[i].in_use)
+		{
+			if (-1 == spare)
+				spare = i;
+		}
+		else if (clients[i].chan == chan && clients[i].pid == cred.pid && !clients[i].gone)
+		{
+			client = &clients[i];
+			break;
+		}
+	}
+	if (NULL == client && -1 != spare)
+	{
+		client = &clients[spare];
+		memset(client, 0, sizeof(*client));
+		client->in_use = 1;
+		client->chan = chan;
+		client->pid = cred.pid;
+	}
+	if (NULL == client)
+	{
+		pthread_mutex_unlock(&lock);
+		free(conn);
+		close(fd);
+		return;
+	}
+	client->nconns++;
+	conn->client = client;
+	conn->next = chan->conns;
+	chan->conns = conn;
+	pthread_mutex_unlock(&lock);
+
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.ptr = conn;
+	(void)epoll_ctl(chan->epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+// the client thread closed its socket (or died)
+static void close_conn(sconn_t *conn)
+{
+	chan_t *chan = conn->chan;
+	client_t *client = conn->client;
+	sconn_t **pp;
+
+	(void)epoll_ctl(chan->epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+	close(conn->fd);
+
+	pthread_mutex_lock(&lock);
+	for (pp = &chan->conns; *pp != conn; pp = &(*pp)->next)
+		;
+	*pp = conn->next;
+	if (0 == --client->nconns)
+	{
+		// the scoid stays ours until the server detaches it, if it asked to hear
+		if (chan->flags & _NTO_CHF_DISCONNECT)
+		{
+			client->gone = 1;
+			queue_pulse(chan, _PULSE_CODE_DISCONNECT, 0, SCOID_BASE + (client - clients));
+		}
+		else
+			client->in_use = 0;
+	}
+	pthread_mutex_unlock(&lock);
+	free(conn);
+}
+
+static int rcvid_alloc(sconn_t *conn)
+{
+	int i;
+
+	pthread_mutex_lock(&lock);
+	for (i = 1; i < MAX_RCVIDS && rcvs[i].in_use; i++)
+		;
+	if (MAX_RCVIDS == i)
+	{
+		pthread_mutex_unlock(&lock);
+		return -1;
+	}
+	rcvs[i].in_use = 1;
+	rcvs[i].gen = (rcvs[i].gen + 1) & 0x7FFFF;
+	if (0 == rcvs[i].gen)
+		rcvs[i].gen = 1;
+	rcvs[i].conn = conn;
+	pthread_mutex_unlock(&lock);
+	return rcvs[i].gen * MAX_RCVIDS + i;
+}
+
+static rcv_t *rcvid_get(int rcvid)
+{
+	int i = rcvid & (MAX_RCVIDS - 1);
+	rcv_t *rcv = NULL;
+
+	pthread_mutex_lock(&lock);
+	if (rcvid > 0 && rcvs[i].in_use && rcvs[i].gen == (unsigned)rcvid / MAX_RCVIDS)
+		rcv = &rcvs[i];
+	pthread_mutex_unlock(&lock);
+	if (NULL == rcv)
+		errno = ESRCH;
+	return rcv;
+}
+
+static void rcvid_free(rcv_t *rcv)
+{
+	pthread_mutex_lock(&lock);
+	rcv->in_use = 0;
+	pthread_mutex_unlock(&lock);
+}
+
+// read the message after frame into a new receive id, returns it or -1
+static int take_message(sconn_t *conn, const frame_t *frame)
+{
+	rcv_t *rcv;
+	char *buf;
+	int rcvid;
+
+	rcvid = rcvid_alloc(conn);
+	if (-1 == rcvid)
+		return -1;
+	rcv = &rcvs[rcvid & (MAX_RCVIDS - 1)];
+	if (frame->len > rcv->cap)
+	{
+		buf = realloc(rcv->buf, frame->len);
+		if (NULL == buf)
+		{
+			rcvid_free(rcv);
+			return -1;
+		}
+		rcv->buf = buf;
+		rcv->cap = frame->len;
+	}
+	if (-1 == read_full(conn->fd, rcv->buf, frame->len))
+	{
+		rcvid_free(rcv);
+		return -1;
+	}
+	rcv->len = frame->len;
+	rcv->coid = frame->coid;
+	rcv->tid = frame->tid;
+	rcv->rbytes = frame->rbytes;
+	return rcvid;
+}
+
+static void fill_info(struct _msg_info *info, const sconn_t *conn, const rcv_t *rcv,
+		size_t copied)
+{
+	memset(info, 0, sizeof(*info));
+	info->pid = conn->client->pid;
+	info->tid = rcv->tid;
+	info->chid = conn->chan->chid;
+	info->scoid = SCOID_BASE + (conn->client - clients);
+	info->coid = rcv->coid;
+	info->msglen = copied;
+	info->srcmsglen = rcv->len;
+	info->dstmsglen = rcv->rbytes;
+}
+
+static void copy_pulse(const iov_t *iov, size_t parts, const struct _pulse *pulse,
+		struct _msg_info *info)
+{
+	(void)copy_to_iov(iov, parts, (const char *)pulse, sizeof(*pulse));
+	if (NULL != info)
+	{
+		memset(info, 0, sizeof(*info));
+		info->scoid = pulse->scoid;
+	}
+}
+
+int TimerTimeout(clockid_t id, int flags, const struct sigevent *notify, const uint64_t *ntime,
+		uint64_t *otime)
+{
+	if (flags & ~_NTO_TIMEOUT_RECEIVE)
+	{
+		errno = ENOTSUP;
+		return -1;
+	}
+	if (NULL != notify && SIGEV_UNBLOCK != notify->sigev_notify)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	if (NULL != otime)
+		*otime = 0;
+	// no time is no waiting at all
+	tls_timeout_ns = 0 == flags ? -1 : NULL == ntime ? 0 : (int64_t)*ntime;
+	return 0;
+}
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// what's left of a receive timeout, for epoll_wait()
+static int timeout_ms(int64_t deadline)
+{
+	int64_t left;
+
+	if (-1 == deadline)
+		return -1;
+	left = deadline - now_ns();
+	return left <= 0 ? 0 : (int)((left + 999999) / 1000000);
+}
+
+int MsgReceivev(int chid, const iov_t *iov, size_t parts, struct _msg_info *info)
+{
+	chan_t *chan;
+	struct epoll_event ev;
+	sconn_t *obj;
+	frame_t frame;
+	struct _pulse pulse;
+	uint64_t count;
+	rcv_t *rcv;
+	int64_t deadline = -1;
+	int rcvid;
+	int n;
+
+	// a timeout only lasts for one receive
+	if (-1 != tls_timeout_ns)
+	{
+		deadline = now_ns() + tls_timeout_ns;
+		tls_timeout_ns = -1;
+	}
+	chan = chan_get(chid);
+	if (NULL == chan)
+		return -1;
+
+	for (;;)
+	{
+		n = epoll_wait(chan->epfd, &ev, 1, timeout_ms(deadline));
+		if (-1 == n)
+			return -1; // EINTR, as MsgReceive() is interrupted by a signal
+		if (0 == n)
+		{
+			if (-1 == deadline)
+				continue;
+			errno = ETIMEDOUT;
+			return -1;
+		}
+		obj = ev.data.ptr;
+
+		switch (obj->kind)
+		{
+		case OBJ_LISTENER:
+			accept_client(chan);
+			break;
+
+		case OBJ_PULSES:
+			// the eventfd counts queued pulses, whoever decrements it takes one
+			if (sizeof(count) != read(chan->pulses.fd, &count, sizeof(count)))
+				break;
+			pthread_mutex_lock(&lock);
+			pulse = chan->queue[chan->queue_head++ % chan->queue_size];
+			pthread_mutex_unlock(&lock);
+			copy_pulse(iov, parts, &pulse, info);
+			return 0;
+
+		case OBJ_CONN:
+			if (-1 == read_full(obj->fd, &frame, sizeof(frame)))
+			{
+				close_conn(obj);
+				break;
+			}
+			if (FRAME_PULSE == frame.kind)
+			{
+				memset(&pulse, 0, sizeof(pulse));
+				pulse.type = _PULSE_TYPE;
+				pulse.subtype = _PULSE_SUBTYPE;
+				pulse.code = frame.code;
+				pulse.value.sival_int = frame.value;
+				pulse.scoid = SCOID_BASE + (obj->client - clients);
+				rearm(obj);
+				copy_pulse(iov, parts, &pulse, info);
+				return 0;
+			}
+			rcvid = take_message(obj, &frame);
+			if (-1 == rcvid)
+			{
+				// out of memory or the client went away mid-message: drop it,
+				// the client sees its socket close
+				close_conn(obj);
+				break;
+			}
+			rcv = &rcvs[rcvid & (MAX_RCVIDS - 1)];
+			n = copy_to_iov(iov, parts, rcv->buf, rcv->len);
+			if (NULL != info)
+				fill_info(info, obj, rcv, n);
+			return rcvid;
+		}
+	}
+}
+
+int MsgReceive(int chid, void *msg, size_t bytes, struct _msg_info *info)
+{
+	iov_t iov;
+
+	SETIOV(&iov, msg, bytes);
+	return MsgReceivev(chid, &iov, 1, info);
+}
+
+long MsgReadv(int rcvid, const iov_t *iov, size_t parts, size_t offset)
+{
+	rcv_t *rcv;
+
+	rcv = rcvid_get(rcvid);
+	if (NULL == rcv)
+		return -1;
+	if (offset >= rcv->len)
+		return 0;
+	return copy_to_iov(iov, parts, rcv->buf + offset, rcv->len - offset);
+}
+
+long MsgRead(int rcvid, void *msg, size_t bytes, size_t offset)
+{
+	iov_t iov;
+
+	SETIOV(&iov, msg, bytes);
+	return MsgReadv(rcvid, &iov, 1, offset);
+}
+
+static int reply(int rcvid, long status, int err, const iov_t *iov, size_t parts)
+{
+	iov_t wiov[MAX_IOV + 1];
+	reply_t hdr;
+	sconn_t *conn;
+	rcv_t *rcv;
+	size_t len, left;
+	size_t i, n;
+	int ret;
+
+	if (parts > MAX_IOV)
+	{
+		errno = EOVERFLOW;
+		return -1;
+	}
+	rcv = rcvid_get(rcvid);
+	if (NULL == rcv)
+		return -1;
+	conn = rcv->conn;
+
+	// never more than the client has room for
+	len = iov_total(iov, parts);
+	if (len > rcv->rbytes)
+		len = rcv->rbytes;
+	hdr.status = status;
+	hdr.err = err;
+	hdr.len = len;
+	SETIOV(&wiov[0], &hdr, sizeof(hdr));
+	// and send only that much, the client reads exactly hdr.len bytes and
+	// anything more would be taken for the next reply
+	left = len;
+	for (i = n = 0; i < parts && left > 0; i++)
+	{
+		if (0 == iov[i].iov_len)
+			continue;
+		wiov[n + 1] = iov[i];
+		if (wiov[n + 1].iov_len > left)
+			wiov[n + 1].iov_len = left;
+		left -= wiov[n + 1].iov_len;
+		n++;
+	}
+	rcvid_free(rcv);
+
+	ret = writev_full(conn->fd, wiov, n + 1);
+	// the client's next message (or its end of file) can be received now
+	rearm(conn);
+	if (-1 == ret)
+	{
+		errno = ESRCH;
+		return -1;
+	}
+	return 0;
+}
+
+int MsgReplyv(int rcvid, long status, const iov_t *iov, size_t parts)
+{
+	return reply(rcvid, status, 0, iov, parts);
+}
+
+int MsgReply(int rcvid, long status, const void *msg, size_t bytes)
+{
+	iov_t iov;
+
+	SETIOV(&iov, msg, bytes);
+	return reply(rcvid, status, 0, &iov, NULL == msg ? 0 : 1);
+}
+
+int MsgError(int rcvid, int err)
+{
+	// MsgError(rcvid, EOK) unblocks the client with a status of 0
+	return reply(rcvid, EOK == err ? 0 : -1, err, NULL, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// client side
+
+static void tls_destroy(void *arg)
+{
+	tls_conn_t *conns = arg;
+	coid_t *c;
+	unsigned i;
+	int idx;
+
+	// close this thread's sockets, unless a ConnectDetach() already has
+	pthread_mutex_lock(&lock);
+	for (idx = 0; idx < MAX_COIDS; idx++)
+	{
+		c = &coids[idx];
+		if (!c->in_use || conns[idx].gen != c->gen)
+			continue;
+		for (i = 0; i < c->nfds; i++)
+		{
+			if (c->fds[i] == conns[idx].fd)
+			{
+				c->fds[i] = c->fds[--c->nfds];
+				close(conns[idx].fd);
+				break;
+			}
+		}
+	}
+	pthread_mutex_unlock(&lock);
+	free(conns);
+}
+
+static void tls_init(void)
+{
+	(void)pthread_key_create(&tls_key, tls_destroy);
+}
+
+static int connect_chan(pid_t pid, int chid)
+{
+	struct sockaddr_un addr;
+	socklen_t addrlen;
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (-1 == fd)
+		return -1;
+	addrlen = chan_address(&addr, pid, chid);
+	if (-1 == connect(fd, (struct sockaddr *)&addr, addrlen))
+	{
+		close(fd);
+		// no such process or channel
+		errno = ESRCH;
+		return -1;
+	}
+	return fd;
+}
+
+// remember fd as this thread's socket for idx (generation gen), lock held
+static int adopt_fd(int idx, unsigned gen, int fd)
+{
+	coid_t *c = &coids[idx];
+	int *fds;
+
+	if (!c->in_use || c->gen != gen)
+	{
+		errno = EBADF;
+		return -1;
+	}
+	if (c->nfds == c->cap)
+	{
+		fds = realloc(c->fds, (c->cap ? 2 * c->cap : 4) * sizeof(*fds));
+		if (NULL == fds)
+		{
+			errno = ENOMEM;
+			return -1;
+		}
+		c->fds = fds;
+		c->cap = c->cap ? 2 * c->cap : 4;
+	}
+	c->fds[c->nfds++] = fd;
+	tls_conns[idx].gen = gen;
+	tls_conns[idx].fd = fd;
+	return 0;
+}
+
+static int tls_setup(void)
+{
+	if (NULL != tls_conns)
+		return 0;
+	pthread_once(&tls_once, tls_init);
+	tls_conns = calloc(MAX_COIDS, sizeof(*tls_conns));
+	if (NULL == tls_conns)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+	(void)pthread_setspecific(tls_key, tls_conns);
+	return 0;
+}
+
+// this thread's socket for coid, connecting it the first time
+static int thread_fd(int coid)
+{
+	int idx = coid - _NTO_SIDE_CHANNEL;
+	coid_t *c;
+	unsigned gen;
+	pid_t pid;
+	int chid, fd;
+
+	if (idx < 0 || idx >= MAX_COIDS)
+	{
+		errno = EBADF;
+		return -1;
+	}
+	if (-1 == tls_setup())
+		return -1;
+	c = &coids[idx];
+	gen = __atomic_load_n(&c->gen, __ATOMIC_ACQUIRE);
+	if (tls_conns[idx].gen == gen && 0 != gen && c->in_use)
+		return tls_conns[idx].fd;
+
+	pthread_mutex_lock(&lock);
+	if (!c->in_use)
+	{
+		pthread_mutex_unlock(&lock);
+		errno = EBADF;
+		return -1;
+	}
+	gen = c->gen;
+	pid = c->pid;
+	chid = c->chid;
+	pthread_mutex_unlock(&lock);
+
+	fd = connect_chan(pid, chid);
+	if (-1 == fd)
+		return -1;
+	pthread_mutex_lock(&lock);
+	if (-1 == adopt_fd(idx, gen, fd))
+	{
+		pthread_mutex_unlock(&lock);
+		close(fd);
+		return -1;
+	}
+	pthread_mutex_unlock(&lock);
+	return fd;
+}
+
+int ConnectAttach(uint32_t nd, pid_t pid, int chid, unsigned index, int flags)
+{
+	int idx;
+	int fd;
+	unsigned gen;
+
+	if (0 != nd)
+	{
+		errno = EHOSTUNREACH; // there are no other nodes
+		return -1;
+	}
+	if (0 == pid)
+		pid = getpid();
+	if (-1 == tls_setup())
+		return -1;
+
+	// connect now, so a wrong pid or chid fails here as it does on QNX
+	fd = connect_chan(pid, chid);
+	if (-1 == fd)
+		return -1;
+
+	pthread_mutex_lock(&lock);
+	for (idx = 0; idx < MAX_COIDS && coids[idx].in_use; idx++)
+		;
+	if (MAX_COIDS == idx)
+	{
+		pthread_mutex_unlock(&lock);
+		close(fd);
+		errno = EAGAIN;
+		return -1;
+	}
+	gen = coids[idx].gen + 1;
+	if (0 == gen)
+		gen = 1;
+	coids[idx].in_use = 1;
+	coids[idx].pid = pid;
+	coids[idx].chid = chid;
+	coids[idx].nfds = 0;
+	__atomic_store_n(&coids[idx].gen, gen, __ATOMIC_RELEASE);
+	if (-1 == adopt_fd(idx, gen, fd))
+	{
+		coids[idx].in_use = 0;
+		pthread_mutex_unlock(&lock);
+		close(fd);
+		return -1;
+	}
+	pthread_mutex_unlock(&lock);
+	return _NTO_SIDE_CHANNEL + idx;
+}
+
+int ConnectDetach(int coid)
+{
+	int idx;
+	coid_t *c;
+	client_t *client;
+	unsigned i;
+
+	pthread_mutex_lock(&lock);
+	// a server letting go of a client's scoid after its disconnect pulse
+	idx = coid - SCOID_BASE;
+	if (idx >= 0 && idx < MAX_CLIENTS)
+	{
+		client = &clients[idx];
+		if (!client->in_use)
+		{
+			pthread_mutex_unlock(&lock);
+			errno = EINVAL;
+			return -1;
+		}
+		if (0 == client->nconns)
+			client->in_use = 0;
+		pthread_mutex_unlock(&lock);
+		return 0;
+	}
+
+	idx = coid - _NTO_SIDE_CHANNEL;
+	if (idx < 0 || idx >= MAX_COIDS || !coids[idx].in_use)
+	{
+		pthread_mutex_unlock(&lock);
+		errno = EINVAL;
+		return -1;
+	}
+	c = &coids[idx];
+	c->in_use = 0;
+	__atomic_store_n(&c->gen, c->gen + 1, __ATOMIC_RELEASE);
+	for (i = 0; i < c->nfds; i++)
+		close(c->fds[i]);
+	c->nfds = 0;
+	pthread_mutex_unlock(&lock);
+	return 0;
+}
+
+static long send_frame(int coid, const iov_t *siov, size_t sparts, const iov_t *riov,
+		size_t rparts)
+{
+	iov_t wiov[MAX_IOV + 1];
+	iov_t rdiov[MAX_IOV + 1];
+	frame_t frame;
+	reply_t hdr;
+	char discard[256];
+	size_t rcap, want, n, chunk;
+	int fd;
+
+	if (sparts > MAX_IOV || rparts > MAX_IOV)
+	{
+		errno = EOVERFLOW;
+		return -1;
+	}
+	fd = thread_fd(coid);
+	if (-1 == fd)
+		return -1;
+
+	memset(&frame, 0, sizeof(frame));
+	frame.kind = FRAME_SEND;
+	frame.tid = gettid_();
+	frame.coid = coid;
+	frame.len = iov_total(siov, sparts);
+	rcap = iov_total(riov, rparts);
+	frame.rbytes = rcap;
+	SETIOV(&wiov[0], &frame, sizeof(frame));
+	memcpy(&wiov[1], siov, sparts * sizeof(*siov));
+
+	// SEND blocked until the server has read it all ...
+	if (-1 == writev_full(fd, wiov, sparts + 1))
+	{
+		errno = ESRCH;
+		return -1;
+	}
+	// ... then REPLY blocked
+	if (-1 == read_full(fd, &hdr, sizeof(hdr)))
+	{
+		errno = ESRCH;
+		return -1;
+	}
+	want = hdr.len < rcap ? hdr.len : rcap;
+	memcpy(rdiov, riov, rparts * sizeof(*riov));
+	// only the reply is in the socket, so this can't read past it
+	if (-1 == readv_full(fd, rdiov, rparts, want))
+	{
+		errno = ESRCH;
+		return -1;
+	}
+	// a server that ignored rbytes
+	for (n = hdr.len - want; n; n -= chunk)
+	{
+		chunk = n < sizeof(discard) ? n : sizeof(discard);
+		if (-1 == read_full(fd, discard, chunk))
+		{
+			errno = ESRCH;
+			return -1;
+		}
+	}
+
+	if (0 != hdr.err)
+	{
+		errno = hdr.err;
+		return -1;
+	}
+	return hdr.status;
+}
+
+long MsgSendv(int coid, const iov_t *siov, size_t sparts, const iov_t *riov, size_t rparts)
+{
+	return send_frame(coid, siov, sparts, riov, rparts);
+}
+
+long MsgSendvs(int coid, const iov_t *siov, size_t sparts, void *rmsg, size_t rbytes)
+{
+	iov_t riov;
+
+	SETIOV(&riov, rmsg, rbytes);
+	return send_frame(coid, siov, sparts, &riov, NULL == rmsg ? 0 : 1);
+}
+
+long MsgSendsv(int coid, const void *smsg, size_t sbytes, const iov_t *riov, size_t rparts)
+{
+	iov_t siov;
+
+	SETIOV(&siov, smsg, sbytes);
+	return send_frame(coid, &siov, 1, riov, rparts);
+}
+
+long MsgSend(int coid, const void *smsg, size_t sbytes, void *rmsg, size_t rbytes)
+{
+	iov_t siov, riov;
+
+	SETIOV(&siov, smsg, sbytes);
+	SETIOV(&riov, rmsg, rbytes);
+	return send_frame(coid, &siov, 1, &riov, NULL == rmsg ? 0 : 1);
+}
+
+int MsgSendPulse(int coid, int priority, int code, int value)
+{
+	frame_t frame;
+	iov_t iov;
+	int fd;
+
+	fd = thread_fd(coid);
+	if (-1 == fd)
+		return -1;
+	memset(&frame, 0, sizeof(frame));
+	frame.kind = FRAME_PULSE;
+	frame.tid = gettid_();
+	frame.coid = coid;
+	frame.code = code;
+	frame.value = value;
+	SETIOV(&iov, &frame, sizeof(frame));
+	if (-1 == writev_full(fd, &iov, 1))
+	{
+		errno = ESRCH;
+		return -1;
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// names
+
+static int name_path(char *buf, size_t size, const char *name)
+{
+	const char *dir = getenv("NTO_HOST_NAME_DIR");
+	char def[64];
+
+	if (NULL == name || '\0' == *name || NULL != strchr(name, '/'))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	if (NULL == dir)
+	{
+		snprintf(def, sizeof(def), "/tmp/nto-host-%u", (unsigned)getuid());
+		dir = def;
+	}
+	if (-1 == mkdir(dir, 0700) && EEXIST != errno)
+		return -1;
+	if ((size_t)snprintf(buf, size, "%s/%s", dir, name) >= size)
+	{
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	return 0;
+}
+
+// the pid and chid a name points at, 0 or -1
+static int name_lookup(const char *path, pid_t *pid, int *chid)
+{
+	char target[64];
+	ssize_t n;
+
+	n = readlink(path, target, sizeof(target) - 1);
+	if (-1 == n)
+		return -1;
+	target[n] = '\0';
+	if (2 != sscanf(target, "%d.%d", pid, chid))
+	{
+		errno = ENOENT;
+		return -1;
+	}
+	return 0;
+}
+
+name_attach_t *name_attach(dispatch_t *dpp, const char *path, unsigned flags)
+{
+	name_attach_t *attach;
+	char link[PATH_MAX];
+	char target[64];
+	pid_t pid;
+	int chid;
+	int err;
+
+	if (NULL != dpp)
+	{
+		errno = ENOTSUP;
+		return NULL;
+	}
+	if (-1 == name_path(link, sizeof(link), path))
+		return NULL;
+	attach = calloc(1, sizeof(*attach));
+	if (NULL == attach)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+	attach->chid = ChannelCreate(_NTO_CHF_DISCONNECT | _NTO_CHF_COID_DISCONNECT
+			| _NTO_CHF_UNBLOCK);
+	if (-1 == attach->chid)
+	{
+		err = errno;
+		free(attach);
+		errno = err;
+		return NULL;
+	}
+
+	snprintf(target, sizeof(target), "%d.%d", getpid(), attach->chid);
+	while (-1 == symlink(target, link))
+	{
+		// a name left behind by a process that has died can be taken over
+		if (EEXIST == errno && 0 == name_lookup(link, &pid, &chid)
+				&& -1 == kill(pid, 0) && ESRCH == errno && 0 == unlink(link))
+			continue;
+		err = EEXIST == errno || ESRCH == errno || EPERM == errno ? EEXIST : errno;
+		ChannelDestroy(attach->chid);
+		free(attach);
+		errno = err;
+		return NULL;
+	}
+
+	// for name_detach(), name_attach_t has nowhere to keep it
+	pthread_mutex_lock(&lock);
+	names[attach->chid] = strdup(link);
+	pthread_mutex_unlock(&lock);
+	return attach;
+}
+
+int name_detach(name_attach_t *attach, unsigned flags)
+{
+	char target[64];
+	char want[64];
+	char *link;
+	ssize_t n;
+	int ret;
+
+	pthread_mutex_lock(&lock);
+	link = names[attach->chid];
+	names[attach->chid] = NULL;
+	pthread_mutex_unlock(&lock);
+
+	// don't remove the name if someone else has attached it since
+	if (NULL != link)
+	{
+		snprintf(want, sizeof(want), "%d.%d", getpid(), attach->chid);
+		n = readlink(link, target, sizeof(target) - 1);
+		if (-1 != n)
+		{
+			target[n] = '\0';
+			if (0 == strcmp(target, want))
+				(void)unlink(link);
+		}
+		free(link);
+	}
+	ret = ChannelDestroy(attach->chid);
+	free(attach);
+	return ret;
+}
+
+int name_open(const char *name, int flags)
+{
+	struct _io_connect msg;
+	char link[PATH_MAX];
+	pid_t pid;
+	int chid;
+	int coid;
+	int err;
+
+	if (-1 == name_path(link, sizeof(link), name))
+		return -1;
+	if (-1 == name_lookup(link, &pid, &chid))
+	{
+		errno = ENOENT;
+		return -1;
+	}
+	coid = ConnectAttach(0, pid, chid, _NTO_SIDE_CHANNEL, 0);
+	if (-1 == coid)
+	{
+		errno = ENOENT;
+		return -1;
+	}
+
+	// like the real one, tell the server with a connect message; servers that
+	// don't handle it answer ENOSYS, which doesn't stop the open
+	memset(&msg, 0, sizeof(msg));
+	msg.type = _IO_CONNECT;
+	msg.subtype = _IO_CONNECT_OPEN;
+	if (-1 == MsgSend(coid, &msg, sizeof(msg), NULL, 0) && ESRCH == errno)
+	{
+		err = errno;
+		ConnectDetach(coid);
+		errno = err;
+		return -1;
+	}
+	return coid;
+}
+
+int name_close(int coid)
+{
+	return ConnectDetach(coid);
+}
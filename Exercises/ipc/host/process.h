@@ -0,0 +1,8 @@
+#ifndef _PROCESS_HOST_H_
+#define _PROCESS_HOST_H_
+
+// process.h (host): getpid() and the like live in <unistd.h>
+
+#include <unistd.h>
+
+#endif //_PROCESS_HOST_H_
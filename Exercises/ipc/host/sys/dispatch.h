@@ -0,0 +1,33 @@
+#ifndef _DISPATCH_HOST_H_
+#define _DISPATCH_HOST_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// sys/dispatch.h (host)
+//
+// name_attach() and friends.  Names are kept as symbolic links in a directory
+// (NTO_HOST_NAME_DIR, default /tmp/nto-host-<uid>), each pointing at
+// "<pid>.<chid>" of the channel that attached it.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <sys/neutrino.h>
+#include <sys/iomsg.h>
+
+#define NAME_FLAG_ATTACH_GLOBAL 0x00000002
+#define NAME_FLAG_DETACH_SAVEDPP 0x00000001
+
+typedef struct _dispatch dispatch_t;
+
+typedef struct _name_attach
+{
+	dispatch_t *dpp;
+	int chid;
+	int mntid;
+	int zero[2];
+} name_attach_t;
+
+name_attach_t *name_attach(dispatch_t *dpp, const char *path, unsigned flags);
+int name_detach(name_attach_t *attach, unsigned flags);
+int name_open(const char *name, int flags);
+int name_close(int coid);
+
+#endif //_DISPATCH_HOST_H_
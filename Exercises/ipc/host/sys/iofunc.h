@@ -0,0 +1,8 @@
+#ifndef _IOFUNC_HOST_H_
+#define _IOFUNC_HOST_H_
+
+// sys/iofunc.h (host): the exercises only include it for the message types
+
+#include <sys/iomsg.h>
+
+#endif //_IOFUNC_HOST_H_
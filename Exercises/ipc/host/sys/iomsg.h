@@ -0,0 +1,40 @@
+#ifndef _IOMSG_HOST_H_
+#define _IOMSG_HOST_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// sys/iomsg.h (host)
+//
+// The resource manager message range, so the exercises can number their own
+// messages above _IO_MAX, and the connect message name_open() sends.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <sys/neutrino.h>
+
+#define _IO_BASE 0x100
+#define _IO_CONNECT (_IO_BASE + 0)
+#define _IO_MAX (_IO_BASE + 0xFF)
+
+#define _IO_CONNECT_OPEN 1
+
+struct _io_connect
+{
+	uint16_t type;
+	uint16_t subtype;
+	uint32_t file_type;
+	uint16_t reply_max;
+	uint16_t entry_max;
+	uint32_t key;
+	uint32_t handle;
+	uint32_t ioflag;
+	uint32_t mode;
+	uint16_t sflag;
+	uint16_t access;
+	uint16_t zero;
+	uint16_t path_len;
+	uint8_t eflag;
+	uint8_t extra_type;
+	uint16_t extra_len;
+	char path[1];
+};
+
+#endif //_IOMSG_HOST_H_
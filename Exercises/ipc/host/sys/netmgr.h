@@ -0,0 +1,10 @@
+#ifndef _NETMGR_HOST_H_
+#define _NETMGR_HOST_H_
+
+// sys/netmgr.h (host): there is only the local node
+
+#include <sys/neutrino.h>
+
+#define ND_LOCAL_NODE 0
+
+#endif //_NETMGR_HOST_H_
@@ -0,0 +1,121 @@
+#ifndef _NEUTRINO_HOST_H_
+#define _NEUTRINO_HOST_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// sys/neutrino.h (host)
+//
+// The part of the QNX Neutrino message passing API the exercises use, for
+// building them on Linux ("make host").  The calls are implemented in
+// neutrino_host.c on top of UNIX domain sockets; see there for how.
+//
+// Only what is declared here is provided.  A program that needs anything else
+// (MsgDeliverEvent(), MsgReceivePulse(), thread pools, timers that deliver
+// pulses...) won't compile on the host, rather than silently misbehaving.
+// TimerTimeout() is declared but takes only receive timeouts, it fails with
+// ENOTSUP for anything else.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#ifndef EOK
+#define EOK 0
+#endif
+
+typedef struct iovec iov_t;
+
+#define SETIOV(_iov, _addr, _len) ((_iov)->iov_base = (void *)(_addr), (_iov)->iov_len = (_len))
+#define GETIOVBASE(_iov) ((_iov)->iov_base)
+#define GETIOVLEN(_iov) ((_iov)->iov_len)
+
+// ConnectAttach() index
+#define _NTO_SIDE_CHANNEL 0x40000000
+
+// ChannelCreate() flags
+#define _NTO_CHF_FIXED_PRIORITY 0x0001
+#define _NTO_CHF_UNBLOCK 0x0002
+#define _NTO_CHF_THREAD_DEATH 0x0004
+#define _NTO_CHF_DISCONNECT 0x0008
+#define _NTO_CHF_NET_MSG 0x0010
+#define _NTO_CHF_COID_DISCONNECT 0x0040
+#define _NTO_CHF_PRIVATE 0x0100
+
+#define _NTO_COF_CLOEXEC 0x0001
+
+#define _PULSE_TYPE 0
+#define _PULSE_SUBTYPE 0
+
+#define _PULSE_CODE_UNBLOCK (-32)
+#define _PULSE_CODE_DISCONNECT (-33)
+#define _PULSE_CODE_THREADDEATH (-34)
+#define _PULSE_CODE_COIDDEATH (-35)
+
+#define _PULSE_CODE_MINAVAIL 0
+#define _PULSE_CODE_MAXAVAIL 127
+
+struct _pulse
+{
+	uint16_t type;
+	uint16_t subtype;
+	int8_t code;
+	uint8_t zero[3];
+	union sigval value;
+	int32_t scoid;
+};
+
+struct _msg_info
+{
+	uint32_t nd;
+	uint32_t srcnd;
+	pid_t pid;
+	int32_t tid;
+	int32_t chid;
+	int32_t scoid;
+	int32_t coid;
+	int16_t priority;
+	int16_t flags;
+	size_t msglen;
+	size_t srcmsglen;
+	size_t dstmsglen;
+};
+
+int ChannelCreate(unsigned flags);
+int ChannelDestroy(int chid);
+
+int ConnectAttach(uint32_t nd, pid_t pid, int chid, unsigned index, int flags);
+int ConnectDetach(int coid);
+
+long MsgSend(int coid, const void *smsg, size_t sbytes, void *rmsg, size_t rbytes);
+long MsgSendv(int coid, const iov_t *siov, size_t sparts, const iov_t *riov, size_t rparts);
+long MsgSendvs(int coid, const iov_t *siov, size_t sparts, void *rmsg, size_t rbytes);
+long MsgSendsv(int coid, const void *smsg, size_t sbytes, const iov_t *riov, size_t rparts);
+int MsgSendPulse(int coid, int priority, int code, int value);
+
+int MsgReceive(int chid, void *msg, size_t bytes, struct _msg_info *info);
+int MsgReceivev(int chid, const iov_t *iov, size_t parts, struct _msg_info *info);
+long MsgRead(int rcvid, void *msg, size_t bytes, size_t offset);
+long MsgReadv(int rcvid, const iov_t *iov, size_t parts, size_t offset);
+int MsgReply(int rcvid, long status, const void *msg, size_t bytes);
+int MsgReplyv(int rcvid, long status, const iov_t *iov, size_t parts);
+int MsgError(int rcvid, int err);
+
+// TimerTimeout() states, only receiving is supported
+#define _NTO_TIMEOUT_RECEIVE (1 << 3)
+#define _NTO_TIMEOUT_SEND (1 << 4)
+#define _NTO_TIMEOUT_REPLY (1 << 5)
+
+// a sigevent that just unblocks, Linux doesn't use this value
+#ifndef SIGEV_UNBLOCK
+#define SIGEV_UNBLOCK 5
+#endif
+
+int TimerTimeout(clockid_t id, int flags, const struct sigevent *notify, const uint64_t *ntime,
+		uint64_t *otime);
+
+#endif //_NEUTRINO_HOST_H_
@@ -0,0 +1,8 @@
+#ifndef _SIGINFO_HOST_H_
+#define _SIGINFO_HOST_H_
+
+// sys/siginfo.h (host): struct sigevent comes from <signal.h>
+
+#include <signal.h>
+
+#endif //_SIGINFO_HOST_H_
@@ -2,6 +2,9 @@
 #define _MSG_DEF_H_
 
 #include <sys/iomsg.h>
+#include <sys/siginfo.h>
+
+#include "cksum_region.h"
 
 #define MAX_STRING_LEN    256
 #define CKSUM_MSG_TYPE (_IO_MAX + 1)
@@ -16,6 +19,127 @@ typedef struct
 
 // checksum reply is an int
 
+// checksum a string of any length.  cksum_msg_t always carries
+// MAX_STRING_LEN + 1 bytes and can't carry more; this header says how long
+// the string is and exactly that many bytes follow it, with no nul.  The
+// reply is an int checksum, as for CKSUM_MSG_TYPE, which servers keep
+// accepting from older clients.  A server answers a version it doesn't know
+// with ENOTSUP, and flags it doesn't know with EINVAL.
+#define CKSUM_STR_MSG_TYPE (_IO_MAX + 8)
+#define CKSUM_STR_VERSION 1
+#define CKSUM_STR_MAX_LEN (16 * 1024 * 1024)
+
+// flags: a uint32_t deadline, in microseconds from when the server receives
+// the message, comes between the header and the string.  A server that
+// schedules by deadline fails the request with ETIMEDOUT once it has passed.
+#define CKSUM_STR_DEADLINE 0x01
+// flags: a cksum_str_trace_t comes next (after the deadline, if there is
+// one), so the server can record when it handled the request against the
+// client's trace id.  Servers not tracing skip it.
+#define CKSUM_STR_TRACE 0x02
+
+typedef struct
+{
+	uint16_t msg_type;
+	uint8_t version;
+	uint8_t flags;
+	uint32_t length;
+} cksum_str_hdr_t; // followed by length bytes of string
+
+typedef struct
+{
+	uint64_t trace_id; // chosen by the client, unique among its requests
+	uint64_t client_ns; // CLOCK_MONOTONIC when the client sent it
+} cksum_str_trace_t;
+
+// A batch of strings checksummed in one round trip.  The message is sent as a
+// 3 part iov: this header, an offset table of count entries, then data_size
+// bytes of packed string data.  String i starts at offsets[i] in the data and
+// ends where the next one starts (the last one ends at data_size), strings
+// need not be nul-terminated.  The reply is an array of count int checksums.
+#define CKSUM_BATCH_MSG_TYPE (_IO_MAX + 3)
+#define CKSUM_BATCH_MAX_COUNT 1024
+#define CKSUM_BATCH_MAX_DATA (1024 * 1024)
+
+typedef struct
+{
+	uint16_t msg_type;
+	uint16_t count;
+	uint32_t data_size;
+} cksum_batch_hdr_t; // followed by uint32_t offsets[count], then the data
+
+// ask the server for its result cache counters, the message is just the
+// msg_type and the reply is a cksum_cache_stats_t (see cksum_cache.h)
+#define CKSUM_CACHE_STATS_MSG_TYPE (_IO_MAX + 4)
+
+// checksum with a selectable algorithm, one of cksum_algo_t in cksum.h
+// (additive sum, CRC-32C or XXH64).  The header is followed by data_size
+// bytes of data and the reply is a cksum_algo_reply_t, the sum is the same
+// value a CKSUM_MSG_TYPE request replies with, as an unsigned 32 bit number.
+#define CKSUM_ALGO_MSG_TYPE (_IO_MAX + 5)
+
+typedef struct
+{
+	uint16_t msg_type;
+	uint16_t algorithm;
+	uint32_t data_size;
+} cksum_algo_hdr_t; // followed by the data
+
+typedef struct
+{
+	uint64_t result;
+} cksum_algo_reply_t;
+
+// checksum a file the server opens itself, instead of the client reading it
+// and sending what it read (cksum_file.h).  The header is followed by
+// path_len bytes of absolute path, with no nul.  The server only opens it if
+// the client's own credentials would let it read it, answering EACCES
+// otherwise and EINVAL for a relative path or anything but a regular file.
+// The reply is a cksum_file_reply_t.
+#define CKSUM_FILE_MSG_TYPE (_IO_MAX + 9)
+#define CKSUM_FILE_MAX_PATH 1024
+
+typedef struct
+{
+	uint16_t msg_type;
+	uint16_t algorithm; // cksum_algo_t
+	uint16_t path_len;
+	uint16_t zero;
+} cksum_file_hdr_t; // followed by the path
+
+typedef struct
+{
+	uint64_t result;
+	uint64_t size; // bytes checksummed
+} cksum_file_reply_t;
+
+// asynchronous requests through a pair of shared memory rings, see
+// cksum_async.h.  The client lays out a ring (cksum_ring.h) in a shared
+// memory object the server may write, and attaches it with this message; the
+// event is how the server tells it completions have arrived.  The reply is a
+// uint32_t ring id.  To say there are new submissions the client sends a
+// CKSUM_RING_DOORBELL_CODE pulse with the ring id as its value.
+#define CKSUM_RING_ATTACH_MSG_TYPE (_IO_MAX + 6)
+#define CKSUM_RING_DETACH_MSG_TYPE (_IO_MAX + 7)
+#define CKSUM_RING_DOORBELL_CODE (_PULSE_CODE_MINAVAIL + 4)
+
+typedef struct
+{
+	uint16_t msg_type;
+	uint16_t zero;
+	uint32_t zero2;
+	cksum_shm_handle_t handle; // O_RDWR, for the server's pid
+	uint64_t size; // of the shared memory object
+	struct sigevent event; // delivered when completions arrive
+} cksum_ring_attach_t;
+
+typedef struct
+{
+	uint16_t msg_type;
+	uint16_t zero;
+	uint32_t ring_id;
+} cksum_ring_detach_t; // no reply data
+
 // If you are sharing a target with other people, please customize these server names
 // so as not to conflict with the other person.
 
@@ -25,6 +149,9 @@ typedef struct
 
 #define SERVER_NAME		"cksum_server"  
 
+// where the checksum server attaches when cksum_proxy has SERVER_NAME
+#define SERVER_BACKEND_NAME	"cksum_server_backend"
+
 #define DISCONNECT_SERVER "disconnect_server"
 
 #define UNBLOCK_SERVER "unblock_server"
@@ -0,0 +1,803 @@
+////////////////////////////////////////////////////////////////////////////////
+// msggen.c
+//
+// Message schema compiler: turns a protocol described in a .msg file into
+// the C a server and its clients share, instead of hand-writing the
+// structs, the _IO_MAX + n codes, the receive union and the switch.
+//
+//     msggen [-o dir] protocol.msg
+//
+// writes name_msgs.h and name_msgs.c (name from the protocol line) next to
+// the schema, or in dir, and prints the layout of every message.
+//
+// The schema is a line at a time, # starts a comment:
+//
+//     protocol rbt              # prefix for everything generated
+//     base _IO_MAX + 1          # type code of the first message
+//     stubs name                # client stubs send by name (name_cache.h),
+//                               # or "stubs coid" to a connection
+//
+//     # comment lines before a message are copied to its struct
+//     message say
+//         string text 100       # up to 100 chars of text after the header
+//         reply int32_t status  # fields of the reply, if it has one
+//
+//     message move
+//         int32_t x             # scalar fields: [u]int8_t to [u]int64_t, char
+//         uint8_t axes[3]       # and fixed arrays of them
+//
+// Messages are numbered from base in the order they appear.  Each message's
+// struct starts with a uint16_t type; its fields are laid out biggest
+// alignment first wherever that leaves no hole, and any padding left is
+// made an explicit reservedN member, so what goes over is all named bytes,
+// zeroed by the stubs.  Every size and offset is checked with
+// _Static_assert against what the compiler makes of the struct.
+//
+// A message can end with one "string" or "bytes" field of at most some
+// length.  It isn't in the struct: the struct gets a name_len field and the
+// data follows the header, so only the bytes there are go over, straight
+// from the caller's buffer in a second iov.  The receive union is sized for
+// the largest message with all of its data (and a nul after a string), so
+// it always arrives whole.
+//
+// The generated .c has a dispatcher, which checks each message against its
+// type's layout from a table before calling the handler for it from a table
+// indexed by type, and a stub per message for clients: rbt_say(name, text)
+// for the say message above.
+//
+// -o dir     write the generated files to dir
+////////////////////////////////////////////////////////////////////////////////
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_NAME 32
+#define MAX_FIELDS 32
+#define MAX_MSGS 64
+#define MAX_COMMENT 1024
+
+typedef struct
+{
+	char type[MAX_NAME]; // "uint32_t", or "uint8_t" for padding
+	char name[MAX_NAME];
+	char comment[128];
+	unsigned count; // array elements, 0 for a scalar
+	unsigned size; // of one element
+	unsigned offset; // once laid out
+} field_t;
+
+typedef struct
+{
+	field_t fields[2 * MAX_FIELDS + 1]; // as laid out, padding included
+	unsigned nfields;
+	unsigned size;
+	unsigned padding;
+} layout_t;
+
+typedef enum
+{
+	TRAILER_NONE, TRAILER_BYTES, TRAILER_STRING
+} trailer_t;
+
+typedef struct
+{
+	char name[MAX_NAME];
+	char comment[MAX_COMMENT];
+	field_t fields[MAX_FIELDS]; // as declared
+	unsigned nfields;
+	field_t replies[MAX_FIELDS];
+	unsigned nreplies;
+	trailer_t trailer;
+	char trailer_name[MAX_NAME];
+	unsigned long trailer_max;
+	layout_t layout;
+	layout_t reply_layout;
+} msg_t;
+
+typedef struct
+{
+	char name[MAX_NAME];
+	char base[128];
+	int stubs_by_name;
+	msg_t msgs[MAX_MSGS];
+	unsigned nmsgs;
+} protocol_t;
+
+static const struct
+{
+	const char *name;
+	unsigned size;
+} types[] =
+{
+	{ "char", 1 }, { "int8_t", 1 }, { "uint8_t", 1 }, { "int16_t", 2 }, { "uint16_t", 2 },
+	{ "int32_t", 4 }, { "uint32_t", 4 }, { "int64_t", 8 }, { "uint64_t", 8 } };
+
+#define NUM_TYPES (sizeof(types) / sizeof(types[0]))
+
+static const char *schema_path;
+static int lineno;
+
+static void fail(const char *fmt, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "%s:%d: ", schema_path, lineno);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	exit(EXIT_FAILURE);
+}
+
+static void upper(char *dst, const char *src)
+{
+	while ('\0' != *src)
+		*dst++ = toupper((unsigned char)*src++);
+	*dst = '\0';
+}
+
+static void check_name(const char *name)
+{
+	const char *p;
+
+	if (strlen(name) >= MAX_NAME || !(isalpha((unsigned char)*name) || '_' == *name))
+		fail("bad name '%s'", name);
+	for (p = name; '\0' != *p; p++)
+		if (!isalnum((unsigned char)*p) && '_' != *p)
+			fail("bad name '%s'", name);
+}
+
+// names the stubs use for themselves
+static const char *reserved[] = { "msg", "siov", "name", "coid", "reply" };
+
+// a field of msg can't be called name: taken, or used by the stubs
+static void check_field_name(const msg_t *msg, const char *name)
+{
+	unsigned i;
+
+	for (i = 0; i < sizeof(reserved) / sizeof(reserved[0]); i++)
+		if (0 == strcmp(name, reserved[i]))
+			fail("'%s' is used by the stubs, call it something else", name);
+	for (i = 0; i < msg->nfields; i++)
+		if (0 == strcmp(name, msg->fields[i].name))
+			fail("%s has two '%s'", msg->name, name);
+}
+
+// parse "type name" or "type name[count]" into f
+static void parse_field(const char *type, const char *decl, field_t *f)
+{
+	const char *bracket;
+	unsigned i;
+	size_t len;
+
+	memset(f, 0, sizeof(*f));
+	for (i = 0; i < NUM_TYPES; i++)
+		if (0 == strcmp(type, types[i].name))
+			break;
+	if (NUM_TYPES == i)
+		fail("unknown type '%s'", type);
+	strcpy(f->type, type);
+	f->size = types[i].size;
+
+	bracket = strchr(decl, '[');
+	len = NULL != bracket ? (size_t)(bracket - decl) : strlen(decl);
+	if (0 == len || len >= MAX_NAME)
+		fail("bad field '%s'", decl);
+	memcpy(f->name, decl, len);
+	f->name[len] = '\0';
+	check_name(f->name);
+	if (NULL != bracket)
+	{
+		f->count = strtoul(bracket + 1, NULL, 0);
+		if (0 == f->count || NULL == strchr(bracket, ']'))
+			fail("bad array '%s'", decl);
+	}
+}
+
+static unsigned field_bytes(const field_t *f)
+{
+	return f->count ? f->size * f->count : f->size;
+}
+
+static void add_padding(layout_t *l, unsigned bytes)
+{
+	field_t *pad = &l->fields[l->nfields];
+
+	memset(pad, 0, sizeof(*pad));
+	strcpy(pad->type, "uint8_t");
+	snprintf(pad->name, sizeof(pad->name), "reserved%u", l->padding);
+	pad->size = 1;
+	pad->count = bytes;
+	pad->offset = l->size;
+	l->nfields++;
+	l->size += bytes;
+	l->padding += bytes;
+}
+
+// lay out n fields after the first start ones, which stay where they are:
+// each time the biggest alignment that goes at the current offset without a
+// hole, in the order declared among equals.  Only when nothing fits is it
+// padded, and then just to where the smallest alignment still to go does.
+static void lay_out(const field_t *in, unsigned n, unsigned start, layout_t *l)
+{
+	int placed[MAX_FIELDS] = { 0 };
+	unsigned i, done, best, align = 1;
+
+	memset(l, 0, sizeof(*l));
+	for (i = 0; i < start; i++)
+	{
+		l->fields[l->nfields] = in[i];
+		l->fields[l->nfields].offset = l->size;
+		l->size += field_bytes(&in[i]);
+		l->nfields++;
+		placed[i] = 1;
+	}
+	for (done = start; done < n; done++)
+	{
+		best = n;
+		for (i = start; i < n; i++)
+			if (!placed[i] && 0 == l->size % in[i].size
+					&& (n == best || in[i].size > in[best].size))
+				best = i;
+		if (n == best)
+		{
+			// nothing fits here: pad to where the smallest still to go does,
+			// and look again for the biggest that fits there
+			for (i = start; i < n; i++)
+				if (!placed[i] && (n == best || in[i].size < in[best].size))
+					best = i;
+			add_padding(l, in[best].size - l->size % in[best].size);
+			done--;
+			continue;
+		}
+		l->fields[l->nfields] = in[best];
+		l->fields[l->nfields].offset = l->size;
+		l->size += field_bytes(&in[best]);
+		l->nfields++;
+		placed[best] = 1;
+	}
+	for (i = 0; i < n; i++)
+		if (in[i].size > align)
+			align = in[i].size;
+	if (0 != l->size % align)
+		add_padding(l, align - l->size % align);
+}
+
+static void parse(FILE *fp, protocol_t *proto)
+{
+	char line[512], raw[512], comment[MAX_COMMENT] = "";
+	char *hash, *words[4], *p;
+	msg_t *msg = NULL;
+	field_t *f;
+	unsigned nwords;
+	unsigned i;
+
+	memset(proto, 0, sizeof(*proto));
+	proto->stubs_by_name = 0;
+	while (NULL != fgets(line, sizeof(line), fp))
+	{
+		lineno++;
+		line[strcspn(line, "\r\n")] = '\0';
+		hash = strchr(line, '#');
+		if (NULL != hash)
+			*hash++ = '\0';
+		strcpy(raw, line);
+
+		nwords = 0;
+		for (p = strtok(line, " \t"); NULL != p && nwords < 4; p = strtok(NULL, " \t"))
+			words[nwords++] = p;
+		if (0 == nwords)
+		{
+			// a comment on a line of its own is for the next message,
+			// a blank line ends it
+			if (NULL != hash && strlen(comment) + strlen(hash) + 2 < sizeof(comment))
+			{
+				strcat(comment, hash);
+				strcat(comment, "\n");
+			}
+			else if (NULL == hash)
+				comment[0] = '\0';
+			continue;
+		}
+		while (NULL != hash && isspace((unsigned char)*hash))
+			hash++;
+
+		if (0 == strcmp(words[0], "protocol") && 2 == nwords)
+		{
+			check_name(words[1]);
+			strcpy(proto->name, words[1]);
+		}
+		else if (0 == strcmp(words[0], "base") && nwords >= 2)
+		{
+			// the rest of the line, an expression copied as it is
+			p = raw + strspn(raw, " \t") + strlen("base");
+			p += strspn(p, " \t");
+			snprintf(proto->base, sizeof(proto->base), "%s", p);
+			for (p = proto->base + strlen(proto->base); p > proto->base && isspace(p[-1]); p--)
+				p[-1] = '\0';
+		}
+		else if (0 == strcmp(words[0], "stubs") && 2 == nwords)
+		{
+			if (0 == strcmp(words[1], "name"))
+				proto->stubs_by_name = 1;
+			else if (0 != strcmp(words[1], "coid"))
+				fail("stubs is name or coid");
+		}
+		else if (0 == strcmp(words[0], "message") && 2 == nwords)
+		{
+			if (MAX_MSGS == proto->nmsgs)
+				fail("too many messages");
+			check_name(words[1]);
+			if (0 == strcmp(words[1], "rx") || 0 == strcmp(words[1], "handler")
+					|| 0 == strcmp(words[1], "dispatch"))
+				fail("'%s' is taken by what is generated, call it something else", words[1]);
+			for (i = 0; i < proto->nmsgs; i++)
+				if (0 == strcmp(words[1], proto->msgs[i].name))
+					fail("two messages called %s", words[1]);
+			msg = &proto->msgs[proto->nmsgs++];
+			strcpy(msg->name, words[1]);
+			strcpy(msg->comment, comment);
+			// every message starts with its type
+			parse_field("uint16_t", "type", &msg->fields[msg->nfields++]);
+		}
+		else if (NULL == msg)
+			fail("expected protocol, base, stubs or message");
+		else if ((0 == strcmp(words[0], "string") || 0 == strcmp(words[0], "bytes"))
+				&& 3 == nwords)
+		{
+			if (TRAILER_NONE != msg->trailer)
+				fail("%s already ends with %s", msg->name, msg->trailer_name);
+			check_name(words[1]);
+			msg->trailer = 's' == words[0][0] ? TRAILER_STRING : TRAILER_BYTES;
+			strcpy(msg->trailer_name, words[1]);
+			msg->trailer_max = strtoul(words[2], NULL, 0);
+			if (0 == msg->trailer_max || msg->trailer_max > 0xffffffffUL)
+				fail("bad length %s", words[2]);
+			if (strlen(words[1]) + 4 >= MAX_NAME || MAX_FIELDS == msg->nfields)
+				fail("too much in %s", msg->name);
+			f = &msg->fields[msg->nfields];
+			parse_field(msg->trailer_max <= 0xffff ? "uint16_t" : "uint32_t", words[1], f);
+			strcat(f->name, "_len");
+			check_field_name(msg, words[1]);
+			check_field_name(msg, f->name);
+			msg->nfields++;
+			snprintf(f->comment, sizeof(f->comment), "bytes of %s after the header",
+					msg->trailer_name);
+		}
+		else if (0 == strcmp(words[0], "reply") && 3 == nwords)
+		{
+			if (MAX_FIELDS == msg->nreplies)
+				fail("too many reply fields in %s", msg->name);
+			f = &msg->replies[msg->nreplies++];
+			parse_field(words[1], words[2], f);
+			if (NULL != hash)
+				snprintf(f->comment, sizeof(f->comment), "%s", hash);
+		}
+		else if (2 == nwords)
+		{
+			if (TRAILER_NONE != msg->trailer)
+				fail("fields go before the %s at the end of %s", msg->trailer_name, msg->name);
+			if (MAX_FIELDS == msg->nfields)
+				fail("too many fields in %s", msg->name);
+			f = &msg->fields[msg->nfields];
+			parse_field(words[0], words[1], f);
+			check_field_name(msg, f->name);
+			msg->nfields++;
+			if (NULL != hash)
+				snprintf(f->comment, sizeof(f->comment), "%s", hash);
+		}
+		else
+			fail("can't make sense of this");
+		comment[0] = '\0';
+	}
+	if ('\0' == proto->name[0] || '\0' == proto->base[0] || 0 == proto->nmsgs)
+	{
+		fprintf(stderr, "%s: needs a protocol, a base and messages\n", schema_path);
+		exit(EXIT_FAILURE);
+	}
+}
+
+// the most that can be received of msg: its header and all its data
+static unsigned long rx_bytes(const msg_t *msg)
+{
+	return msg->layout.size + msg->trailer_max + (TRAILER_STRING == msg->trailer);
+}
+
+static void write_struct(FILE *fp, const char *proto, const char *msg_name, const char *suffix,
+		const layout_t *l)
+{
+	const field_t *f;
+	unsigned i;
+
+	fprintf(fp, "typedef struct\n{\n");
+	for (i = 0; i < l->nfields; i++)
+	{
+		f = &l->fields[i];
+		fprintf(fp, "\t%s %s", f->type, f->name);
+		if (f->count)
+			fprintf(fp, "[%u]", f->count);
+		fprintf(fp, ";");
+		if ('\0' != f->comment[0])
+			fprintf(fp, " // %s", f->comment);
+		fprintf(fp, "\n");
+	}
+	fprintf(fp, "} %s_%s%s_t;\n", proto, msg_name, suffix);
+	fprintf(fp, "_Static_assert(sizeof(%s_%s%s_t) == %u, \"%s_%s%s_t is %u bytes\");\n", proto,
+			msg_name, suffix, l->size, proto, msg_name, suffix, l->size);
+	for (i = 1; i < l->nfields; i++)
+		fprintf(fp, "_Static_assert(offsetof(%s_%s%s_t, %s) == %u, \"%s at %u\");\n", proto,
+				msg_name, suffix, l->fields[i].name, l->fields[i].offset, l->fields[i].name,
+				l->fields[i].offset);
+}
+
+// the parameters of msg's stub after the connection, the fields in the
+// order declared
+static void write_params(FILE *fp, const msg_t *msg, const char *proto)
+{
+	const field_t *f;
+	unsigned i;
+
+	for (i = 1; i < msg->nfields - (TRAILER_NONE != msg->trailer); i++)
+	{
+		f = &msg->fields[i];
+		if (f->count)
+			fprintf(fp, ", const %s %s[%u]", f->type, f->name, f->count);
+		else
+			fprintf(fp, ", %s %s", f->type, f->name);
+	}
+	if (TRAILER_STRING == msg->trailer)
+		fprintf(fp, ", const char *%s", msg->trailer_name);
+	else if (TRAILER_BYTES == msg->trailer)
+		fprintf(fp, ", const void *%s, size_t %s_len", msg->trailer_name, msg->trailer_name);
+	if (msg->nreplies)
+		fprintf(fp, ", %s_%s_reply_t *reply", proto, msg->name);
+}
+
+static void write_header(FILE *fp, const protocol_t *proto, const char *header,
+		const char *schema)
+{
+	char up[MAX_NAME], msg_up[MAX_NAME], trailer_up[MAX_NAME], guard[2 * MAX_NAME];
+	const msg_t *msg;
+	unsigned long rx = 0;
+	const char *p, *nl;
+	unsigned i;
+
+	upper(up, proto->name);
+	snprintf(guard, sizeof(guard), "_%s_MSGS_H_", up);
+	fprintf(fp, "#ifndef %s\n#define %s\n\n", guard, guard);
+	fprintf(fp, "////////////////////////////////////////////////////////////////////////////////\n");
+	fprintf(fp, "// %s\n//\n", header);
+	fprintf(fp, "// Generated by msggen from %s, don't edit: change that and run\n", schema);
+	fprintf(fp, "// \"make msgs\".\n//\n");
+	fprintf(fp, "// What each message puts on the wire (header, then its data), with the\n");
+	fprintf(fp, "// padding left in it:\n//\n");
+	for (i = 0; i < proto->nmsgs; i++)
+	{
+		msg = &proto->msgs[i];
+		fprintf(fp, "//   %-20s %3u bytes", msg->name, msg->layout.size);
+		if (TRAILER_NONE != msg->trailer)
+			fprintf(fp, " + up to %lu of %s", msg->trailer_max, msg->trailer_name);
+		if (msg->layout.padding)
+			fprintf(fp, ", %u padding", msg->layout.padding);
+		fprintf(fp, "\n");
+		if (rx_bytes(msg) > rx)
+			rx = rx_bytes(msg);
+	}
+	fprintf(fp, "////////////////////////////////////////////////////////////////////////////////\n\n");
+	fprintf(fp, "#include <stddef.h>\n#include <stdint.h>\n#include <sys/neutrino.h>\n"
+			"#include <sys/iomsg.h>\n\n");
+
+	fprintf(fp, "#define %s_MSG_BASE (%s)\n", up, proto->base);
+	fprintf(fp, "#define %s_NUM_MSGS %u\n\n", up, proto->nmsgs);
+	fprintf(fp, "// message types, and their places in a handler table\n");
+	for (i = 0; i < proto->nmsgs; i++)
+	{
+		upper(msg_up, proto->msgs[i].name);
+		fprintf(fp, "#define %s_MSG_%s (%s_MSG_BASE + %u)\n", up, msg_up, up, i);
+		fprintf(fp, "#define %s_IDX_%s %u\n", up, msg_up, i);
+	}
+
+	for (i = 0; i < proto->nmsgs; i++)
+	{
+		msg = &proto->msgs[i];
+		upper(msg_up, msg->name);
+		upper(trailer_up, msg->trailer_name);
+		fprintf(fp, "\n");
+		for (p = msg->comment; '\0' != *p; p = nl + 1)
+		{
+			nl = strchr(p, '\n');
+			fprintf(fp, "//%.*s\n", (int)(nl - p), p);
+		}
+		write_struct(fp, proto->name, msg->name, "", &msg->layout);
+		if (TRAILER_NONE != msg->trailer)
+		{
+			fprintf(fp, "// followed by %s_len bytes of %s, at most:\n", msg->trailer_name,
+					msg->trailer_name);
+			fprintf(fp, "#define %s_%s_%s_MAX %lu\n", up, msg_up, trailer_up,
+					msg->trailer_max);
+			fprintf(fp, "// where they are in a received message%s\n",
+					TRAILER_STRING == msg->trailer ? ", nul terminated by the dispatcher" : "");
+			fprintf(fp, "#define %s_%s_%s(msg) ((%s *)((msg) + 1))\n", up, msg_up,
+					trailer_up, TRAILER_STRING == msg->trailer ? "char" : "uint8_t");
+		}
+		if (msg->nreplies)
+		{
+			fprintf(fp, "\n// the reply to %s\n", msg->name);
+			write_struct(fp, proto->name, msg->name, "_reply", &msg->reply_layout);
+		}
+	}
+
+	fprintf(fp, "\n// everything the server receives: a pulse, or any message with all of\n");
+	fprintf(fp, "// its data (and a nul after a string), so one MsgReceive() gets it all\n");
+	fprintf(fp, "#define %s_RX_SIZE %lu\n\n", up, rx);
+	fprintf(fp, "typedef union\n{\n\tuint16_t type;\n\tstruct _pulse pulse;\n");
+	for (i = 0; i < proto->nmsgs; i++)
+		fprintf(fp, "\t%s_%s_t %s;\n", proto->name, proto->msgs[i].name, proto->msgs[i].name);
+	fprintf(fp, "\tchar max[%s_RX_SIZE];\n} %s_rx_t;\n\n", up, proto->name);
+
+	fprintf(fp, "// handles one message; what it returns, %s_dispatch() does\n", proto->name);
+	fprintf(fp, "typedef int (*%s_handler_t)(int rcvid, %s_rx_t *msg, size_t received, "
+			"void *ctx);\n\n", proto->name, proto->name);
+	fprintf(fp, "// server side: check the message received into msg (received bytes of it)\n");
+	fprintf(fp, "// against the layout of its type and call handlers[type - %s_MSG_BASE]\n", up);
+	fprintf(fp, "// with it.  Types outside the protocol, or without a handler, go to other\n");
+	fprintf(fp, "// (or, if that is NULL, get MsgError(ENOSYS)).  A message too short for\n");
+	fprintf(fp, "// its type gets MsgError(EBADMSG), one with too much data EMSGSIZE, and\n");
+	fprintf(fp, "// -1 is returned.\n");
+	fprintf(fp, "int %s_dispatch(int rcvid, %s_rx_t *msg, size_t received,\n"
+			"\t\tconst %s_handler_t handlers[%s_NUM_MSGS], %s_handler_t other, void *ctx);\n\n",
+			proto->name, proto->name, proto->name, up, proto->name);
+
+	if (proto->stubs_by_name)
+		fprintf(fp, "// client side: send each message to the server attached as name, waiting\n"
+				"// for it and sending again if it restarts (name_cache_send()).  The\n");
+	else
+		fprintf(fp, "// client side: send each message on the connection coid.  The\n");
+	fprintf(fp, "// header goes from the stack and any data straight from the caller's\n");
+	fprintf(fp, "// buffer.  Return 0, or -1 with errno set (EMSGSIZE for too much data).\n");
+	for (i = 0; i < proto->nmsgs; i++)
+	{
+		msg = &proto->msgs[i];
+		fprintf(fp, "int %s_%s(%s", proto->name, msg->name,
+				proto->stubs_by_name ? "const char *name" : "int coid");
+		write_params(fp, msg, proto->name);
+		fprintf(fp, ");\n");
+	}
+	fprintf(fp, "\n#endif //%s\n", guard);
+}
+
+static void write_source(FILE *fp, const protocol_t *proto, const char *header,
+		const char *source, const char *schema)
+{
+	char up[MAX_NAME], msg_up[MAX_NAME], trailer_up[MAX_NAME];
+	const msg_t *msg;
+	const field_t *f;
+	unsigned i, j;
+
+	upper(up, proto->name);
+	fprintf(fp, "////////////////////////////////////////////////////////////////////////////////\n");
+	fprintf(fp, "// %s\n//\n", source);
+	fprintf(fp, "// Generated by msggen from %s, don't edit, see %s\n", schema, header);
+	fprintf(fp, "////////////////////////////////////////////////////////////////////////////////\n\n");
+	fprintf(fp, "#include <errno.h>\n#include <stdio.h>\n#include <string.h>\n"
+			"#include <sys/neutrino.h>\n\n");
+	if (proto->stubs_by_name)
+		fprintf(fp, "#include \"name_cache.h\"\n");
+	fprintf(fp, "#include \"%s\"\n\n", header);
+
+	fprintf(fp, "// each type's header size, where the length of the data after it is (and\n");
+	fprintf(fp, "// its size, 0 for none), the most data it can have and if it is a string\n");
+	fprintf(fp, "static const struct\n{\n\tuint16_t size;\n\tuint16_t len_offset;\n"
+			"\tuint8_t len_size;\n\tuint8_t string;\n\tuint32_t max;\n} layouts[%s_NUM_MSGS] =\n{\n",
+			up);
+	for (i = 0; i < proto->nmsgs; i++)
+	{
+		msg = &proto->msgs[i];
+		upper(msg_up, msg->name);
+		upper(trailer_up, msg->trailer_name);
+		if (TRAILER_NONE == msg->trailer)
+			fprintf(fp, "\t{ sizeof(%s_%s_t), 0, 0, 0, 0 },\n", proto->name, msg->name);
+		else
+			fprintf(fp, "\t{ sizeof(%s_%s_t), offsetof(%s_%s_t, %s_len), %u, %d, %s_%s_%s_MAX },\n",
+					proto->name, msg->name, proto->name, msg->name, msg->trailer_name,
+					msg->fields[msg->nfields - 1].size, TRAILER_STRING == msg->trailer, up, msg_up,
+					trailer_up);
+	}
+	fprintf(fp, "};\n\n");
+
+	fprintf(fp, "static int refuse(int rcvid, int error)\n{\n"
+			"\tif (-1 == MsgError(rcvid, error))\n\t\tperror(\"MsgError\");\n\treturn -1;\n}\n\n");
+
+	fprintf(fp, "int %s_dispatch(int rcvid, %s_rx_t *msg, size_t received,\n"
+			"\t\tconst %s_handler_t handlers[%s_NUM_MSGS], %s_handler_t other, void *ctx)\n{\n",
+			proto->name, proto->name, proto->name, up, proto->name);
+	fprintf(fp, "\tunsigned idx;\n\tuint32_t len = 0;\n\tuint16_t len16;\n\n");
+	fprintf(fp, "\tif (received > sizeof(*msg))\n\t\treceived = sizeof(*msg);\n");
+	fprintf(fp, "\tif (received < sizeof(msg->type))\n\t\treturn refuse(rcvid, EBADMSG);\n");
+	fprintf(fp, "\t// below the base wraps round to far past the end\n");
+	fprintf(fp, "\tidx = (unsigned)(msg->type - %s_MSG_BASE);\n", up);
+	fprintf(fp, "\tif (idx >= %s_NUM_MSGS || NULL == handlers[idx])\n\t{\n", up);
+	fprintf(fp, "\t\tif (NULL != other)\n\t\t\treturn other(rcvid, msg, received, ctx);\n");
+	fprintf(fp, "\t\treturn refuse(rcvid, ENOSYS);\n\t}\n");
+	fprintf(fp, "\tif (received < layouts[idx].size)\n\t\treturn refuse(rcvid, EBADMSG);\n");
+	fprintf(fp, "\tif (layouts[idx].len_size)\n\t{\n");
+	fprintf(fp, "\t\tif (sizeof(len16) == layouts[idx].len_size)\n\t\t{\n");
+	fprintf(fp, "\t\t\tmemcpy(&len16, msg->max + layouts[idx].len_offset, sizeof(len16));\n");
+	fprintf(fp, "\t\t\tlen = len16;\n\t\t}\n\t\telse\n");
+	fprintf(fp, "\t\t\tmemcpy(&len, msg->max + layouts[idx].len_offset, sizeof(len));\n");
+	fprintf(fp, "\t\tif (len > layouts[idx].max)\n\t\t\treturn refuse(rcvid, EMSGSIZE);\n");
+	fprintf(fp, "\t\tif (received < layouts[idx].size + len)\n"
+			"\t\t\treturn refuse(rcvid, EBADMSG);\n");
+	fprintf(fp, "\t\tif (layouts[idx].string)\n"
+			"\t\t\tmsg->max[layouts[idx].size + len] = '\\0';\n\t}\n");
+	fprintf(fp, "\treturn handlers[idx](rcvid, msg, received, ctx);\n}\n");
+
+	for (i = 0; i < proto->nmsgs; i++)
+	{
+		msg = &proto->msgs[i];
+		upper(msg_up, msg->name);
+		upper(trailer_up, msg->trailer_name);
+		fprintf(fp, "\nint %s_%s(%s", proto->name, msg->name,
+				proto->stubs_by_name ? "const char *name" : "int coid");
+		write_params(fp, msg, proto->name);
+		fprintf(fp, ")\n{\n\t%s_%s_t msg;\n", proto->name, msg->name);
+		if (TRAILER_NONE != msg->trailer)
+			fprintf(fp, "\tiov_t siov[2];\n");
+		if (TRAILER_STRING == msg->trailer)
+			fprintf(fp, "\tsize_t %s_len = strlen(%s);\n", msg->trailer_name, msg->trailer_name);
+		fprintf(fp, "\n");
+		if (TRAILER_NONE != msg->trailer)
+			fprintf(fp, "\tif (%s_len > %s_%s_%s_MAX)\n\t{\n\t\terrno = EMSGSIZE;\n"
+					"\t\treturn -1;\n\t}\n", msg->trailer_name, up, msg_up, trailer_up);
+		if (msg->layout.padding)
+			fprintf(fp, "\tmemset(&msg, 0, sizeof(msg));\n");
+		fprintf(fp, "\tmsg.type = %s_MSG_%s;\n", up, msg_up);
+		for (j = 1; j < msg->nfields; j++)
+		{
+			f = &msg->fields[j];
+			if (f->count)
+				fprintf(fp, "\tmemcpy(msg.%s, %s, sizeof(msg.%s));\n", f->name, f->name, f->name);
+			else
+				fprintf(fp, "\tmsg.%s = %s;\n", f->name, f->name);
+		}
+		if (TRAILER_NONE != msg->trailer)
+		{
+			fprintf(fp, "\tSETIOV(&siov[0], &msg, sizeof(msg));\n");
+			fprintf(fp, "\tSETIOV(&siov[1], %s, %s_len);\n", msg->trailer_name,
+					msg->trailer_name);
+			fprintf(fp, "\tif (-1 == %s(%s, siov, 2, %s))\n",
+					proto->stubs_by_name ? "name_cache_sendvs" : "MsgSendvs",
+					proto->stubs_by_name ? "name" : "coid",
+					msg->nreplies ? "reply, sizeof(*reply)" : "NULL, 0");
+		}
+		else
+			fprintf(fp, "\tif (-1 == %s(%s, &msg, sizeof(msg), %s))\n",
+					proto->stubs_by_name ? "name_cache_send" : "MsgSend",
+					proto->stubs_by_name ? "name" : "coid",
+					msg->nreplies ? "reply, sizeof(*reply)" : "NULL, 0");
+		fprintf(fp, "\t\treturn -1;\n\treturn 0;\n}\n");
+	}
+}
+
+// base name of path, without its directory
+static const char *base_name(const char *path)
+{
+	const char *slash = strrchr(path, '/');
+
+	return NULL != slash ? slash + 1 : path;
+}
+
+static FILE *create(const char *dir, const char *name)
+{
+	char path[1024];
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	fp = fopen(path, "w");
+	if (NULL == fp)
+	{
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+	return fp;
+}
+
+static void finish(FILE *fp, const char *name)
+{
+	if (ferror(fp) || EOF == fclose(fp))
+	{
+		perror(name);
+		exit(EXIT_FAILURE);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	static protocol_t proto;
+	char dir[1024], header[2 * MAX_NAME], source[2 * MAX_NAME];
+	const char *slash;
+	const msg_t *msg;
+	msg_t *m;
+	FILE *fp;
+	unsigned long rx = 0;
+	unsigned i;
+	int opt;
+
+	dir[0] = '\0';
+	while ((opt = getopt(argc, argv, "o:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'o':
+			snprintf(dir, sizeof(dir), "%s", optarg);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (argc - optind != 1)
+	{
+		fprintf(stderr, "usage: %s [-o dir] protocol.msg\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	schema_path = argv[optind];
+	if ('\0' == dir[0])
+	{
+		slash = strrchr(schema_path, '/');
+		if (NULL != slash)
+			snprintf(dir, sizeof(dir), "%.*s", (int)(slash - schema_path), schema_path);
+		else
+			strcpy(dir, ".");
+	}
+
+	fp = fopen(schema_path, "r");
+	if (NULL == fp)
+	{
+		perror(schema_path);
+		exit(EXIT_FAILURE);
+	}
+	parse(fp, &proto);
+	fclose(fp);
+
+	for (i = 0; i < proto.nmsgs; i++)
+	{
+		m = &proto.msgs[i];
+		// the type stays first, where the dispatcher looks for it
+		lay_out(m->fields, m->nfields, 1, &m->layout);
+		lay_out(m->replies, m->nreplies, 0, &m->reply_layout);
+		if (m->layout.size > 0xffff)
+			fail("%s is too big", m->name);
+	}
+
+	snprintf(header, sizeof(header), "%s_msgs.h", proto.name);
+	snprintf(source, sizeof(source), "%s_msgs.c", proto.name);
+	fp = create(dir, header);
+	write_header(fp, &proto, header, base_name(schema_path));
+	finish(fp, header);
+	fp = create(dir, source);
+	write_source(fp, &proto, header, source, base_name(schema_path));
+	finish(fp, source);
+
+	for (i = 0; i < proto.nmsgs; i++)
+	{
+		msg = &proto.msgs[i];
+		printf("  %-20s %3u bytes", msg->name, msg->layout.size);
+		if (TRAILER_NONE != msg->trailer)
+			printf(" + up to %lu", msg->trailer_max);
+		printf(", %u padding", msg->layout.padding);
+		if (msg->nreplies)
+			printf("; reply %u bytes, %u padding", msg->reply_layout.size,
+					msg->reply_layout.padding);
+		printf("\n");
+		if (rx_bytes(msg) > rx)
+			rx = rx_bytes(msg);
+	}
+	printf("%s: %u messages, largest %lu bytes, in %s/%s and %s/%s\n", schema_path,
+			proto.nmsgs, rx, dir, header, dir, source);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,481 @@
+////////////////////////////////////////////////////////////////////////////////
+// name_cache.c
+//
+// Cached name_open() with reconnecting, see name_cache.h.
+//
+// name_cache_wait() arms its wakeup before it first tries the name, so a
+// server attaching in between still wakes it.  Each waiter has a wakeup of
+// its own (a private channel for the pulse on QNX, an inotify descriptor on
+// the host), so waiting threads don't have to share.  If the wakeup can't be
+// armed it falls back on the backoff alone.
+//
+// An entry stays in the table after it is dropped until its last holder
+// lets go, still owning its coid, so the coid can't be handed out again
+// meanwhile; only find() skips it.  Generations count openings across all
+// names, so one identifies an entry without its name.
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __QNX__
+#define _GNU_SOURCE // ppoll()
+#endif
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/neutrino.h>
+#include <sys/dispatch.h>
+
+#ifdef __QNX__
+#include <sys/procmgr.h>
+#else
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#endif
+
+#include "name_cache.h"
+
+#define NAME_MAX_LEN 64
+
+#define BACKOFF_MIN_NS 10000ULL
+#define BACKOFF_MAX_NS 100000000ULL
+
+// the pulse a name being attached sends us
+#define PATHSPACE_PULSE_CODE (_PULSE_CODE_MINAVAIL + 7)
+
+typedef struct
+{
+	char name[NAME_MAX_LEN];
+	int coid; // -1 when unused
+	unsigned gen;
+	unsigned holders; // name_cache_hold()s not yet released
+	int dropped; // closed once holders gets to 0
+} entry_t;
+
+typedef struct
+{
+#ifdef __QNX__
+	int chid;
+	int coid;
+	int id; // from procmgr_event_notify_add()
+#else
+	int fd;
+#endif
+} watch_t;
+
+static entry_t cache[NAME_CACHE_MAX];
+static unsigned last_gen;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+static void init(void)
+{
+	int i;
+
+	for (i = 0; i < NAME_CACHE_MAX; i++)
+		cache[i].coid = -1;
+}
+
+// name's current connection, lock held
+static entry_t *find(const char *name)
+{
+	int i;
+
+	for (i = 0; i < NAME_CACHE_MAX; i++)
+		if (-1 != cache[i].coid && !cache[i].dropped && 0 == strcmp(cache[i].name, name))
+			return &cache[i];
+	return NULL;
+}
+
+// the entry of generation gen, dropped or not, lock held
+static entry_t *find_gen(unsigned gen)
+{
+	int i;
+
+	for (i = 0; i < NAME_CACHE_MAX; i++)
+		if (-1 != cache[i].coid && cache[i].gen == gen)
+			return &cache[i];
+	return NULL;
+}
+
+// drop e, lock held.  Returns the coid to close once the lock is released,
+// or -1 if it is still held.
+static int drop(entry_t *e)
+{
+	int coid = e->coid;
+
+	e->dropped = 1;
+	if (0 != e->holders)
+		return -1;
+	e->coid = -1;
+	return coid;
+}
+
+// name_open() failed because there is no server, yet
+static int absent(int err)
+{
+	// ESRCH: it died while we opened it
+	return ENOENT == err || ESRCH == err;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#ifdef __QNX__
+
+static int watch_start(watch_t *w)
+{
+	struct sigevent ev;
+	int err;
+
+	w->chid = ChannelCreate(_NTO_CHF_PRIVATE);
+	if (-1 == w->chid)
+		return -1;
+	w->coid = ConnectAttach(0, 0, w->chid, _NTO_SIDE_CHANNEL, _NTO_COF_CLOEXEC);
+	if (-1 != w->coid)
+	{
+		SIGEV_PULSE_INIT(&ev, w->coid, SIGEV_PULSE_PRIO_INHERIT, PATHSPACE_PULSE_CODE, 0);
+		w->id = procmgr_event_notify_add(PROCMGR_EVENT_PATHSPACE, &ev);
+		if (-1 != w->id)
+			return 0;
+	}
+	err = errno;
+	if (-1 != w->coid)
+		ConnectDetach(w->coid);
+	ChannelDestroy(w->chid);
+	errno = err;
+	return -1;
+}
+
+// 1 if something changed in the path space, 0 if timeout_ns passed first
+static int watch_wait(watch_t *w, uint64_t timeout_ns)
+{
+	struct _pulse pulse;
+
+	TimerTimeout(CLOCK_MONOTONIC, _NTO_TIMEOUT_RECEIVE, NULL, &timeout_ns, NULL);
+	if (-1 == MsgReceivePulse(w->chid, &pulse, sizeof(pulse), NULL))
+		return ETIMEDOUT == errno ? 0 : -1;
+	return 1;
+}
+
+static void watch_stop(watch_t *w)
+{
+	procmgr_event_notify_delete(w->id);
+	ConnectDetach(w->coid);
+	ChannelDestroy(w->chid);
+}
+
+#else
+
+static pthread_key_t watch_key;
+static pthread_once_t watch_once = PTHREAD_ONCE_INIT;
+
+static void watch_close(void *arg)
+{
+	close((int)(intptr_t)arg - 1);
+}
+
+static void watch_key_init(void)
+{
+	pthread_key_create(&watch_key, watch_close);
+}
+
+static void drain(int fd)
+{
+	char events[4096];
+
+	while (read(fd, events, sizeof(events)) > 0)
+		;
+}
+
+// The host stand-in keeps names as links in a directory, see sys/dispatch.h.
+// Closing an inotify descriptor waits out an RCU grace period, which takes
+// milliseconds, so each thread keeps its own open and just drains whatever
+// it saw since it last waited.
+static int watch_start(watch_t *w)
+{
+	const char *dir = getenv("NTO_HOST_NAME_DIR");
+	char def[64];
+
+	pthread_once(&watch_once, watch_key_init);
+	w->fd = (int)(intptr_t)pthread_getspecific(watch_key) - 1;
+	if (-1 != w->fd)
+	{
+		drain(w->fd);
+		return 0;
+	}
+
+	if (NULL == dir)
+	{
+		snprintf(def, sizeof(def), "/tmp/nto-host-%u", (unsigned)getuid());
+		dir = def;
+	}
+	if (-1 == mkdir(dir, 0700) && EEXIST != errno)
+		return -1;
+	w->fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+	if (-1 == w->fd)
+		return -1;
+	// a name is attached by making its link, or taken over by replacing it
+	if (-1 == inotify_add_watch(w->fd, dir, IN_CREATE | IN_MOVED_TO))
+	{
+		close(w->fd);
+		return -1;
+	}
+	pthread_setspecific(watch_key, (void *)(intptr_t)(w->fd + 1));
+	return 0;
+}
+
+static int watch_wait(watch_t *w, uint64_t timeout_ns)
+{
+	struct pollfd pfd;
+	struct timespec ts;
+	int n;
+
+	pfd.fd = w->fd;
+	pfd.events = POLLIN;
+	ts.tv_sec = timeout_ns / 1000000000;
+	ts.tv_nsec = timeout_ns % 1000000000;
+	n = ppoll(&pfd, 1, &ts, NULL);
+	if (n <= 0)
+		return -1 == n && EINTR != errno ? -1 : 0;
+	drain(w->fd);
+	return 1;
+}
+
+static void watch_stop(watch_t *w)
+{
+	// kept for the next wait, see watch_start()
+}
+
+#endif
+
+int name_cache_open(const char *name)
+{
+	entry_t *e, *free_entry = NULL;
+	int coid, i;
+
+	if (strlen(name) >= NAME_MAX_LEN)
+	{
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	pthread_once(&once, init);
+
+	pthread_mutex_lock(&lock);
+	e = find(name);
+	coid = NULL == e ? -1 : e->coid;
+	pthread_mutex_unlock(&lock);
+	if (-1 != coid)
+		return coid;
+
+	// name_open() waits on the server, don't hold everyone else up meanwhile
+	coid = name_open(name, 0);
+	if (-1 == coid)
+		return -1;
+
+	pthread_mutex_lock(&lock);
+	e = find(name);
+	if (NULL != e)
+	{
+		// another thread opened it too, use theirs
+		i = e->coid;
+		pthread_mutex_unlock(&lock);
+		name_close(coid);
+		return i;
+	}
+	for (i = 0; i < NAME_CACHE_MAX && NULL == free_entry; i++)
+		if (-1 == cache[i].coid)
+			free_entry = &cache[i];
+	if (NULL == free_entry)
+	{
+		pthread_mutex_unlock(&lock);
+		name_close(coid);
+		errno = ENFILE;
+		return -1;
+	}
+	strcpy(free_entry->name, name);
+	free_entry->coid = coid;
+	if (0 == ++last_gen)
+		last_gen = 1;
+	free_entry->gen = last_gen;
+	free_entry->holders = 0;
+	free_entry->dropped = 0;
+	pthread_mutex_unlock(&lock);
+	return coid;
+}
+
+int name_cache_wait(const char *name, uint64_t timeout_ns)
+{
+	watch_t w;
+	uint64_t start, elapsed, backoff, wait;
+	struct timespec ts;
+	unsigned seed;
+	int watching;
+	int coid, err;
+
+	// no waiting at all if it is there
+	coid = name_cache_open(name);
+	if (-1 != coid || !absent(errno))
+		return coid;
+
+	// without the wakeup it still gets there, just later
+	watching = 0 == watch_start(&w);
+	start = now_ns();
+	seed = start ^ getpid();
+	backoff = BACKOFF_MIN_NS;
+	while (1)
+	{
+		coid = name_cache_open(name);
+		if (-1 != coid || !absent(errno))
+			break;
+
+		elapsed = now_ns() - start;
+		if (NAME_CACHE_FOREVER != timeout_ns && elapsed >= timeout_ns)
+		{
+			errno = ETIMEDOUT;
+			break;
+		}
+		// somewhere in the second half of the backoff, so clients that lost
+		// their server together don't all come back at the same moment
+		wait = backoff / 2 + rand_r(&seed) % (backoff / 2 + 1);
+		if (NAME_CACHE_FOREVER != timeout_ns && wait > timeout_ns - elapsed)
+			wait = timeout_ns - elapsed;
+		if (watching)
+		{
+			if (-1 == watch_wait(&w, wait))
+				break;
+		}
+		else
+		{
+			ts.tv_sec = wait / 1000000000;
+			ts.tv_nsec = wait % 1000000000;
+			nanosleep(&ts, NULL);
+		}
+		if (backoff < BACKOFF_MAX_NS)
+			backoff *= 2;
+	}
+	err = errno;
+	if (watching)
+		watch_stop(&w);
+	errno = err;
+	return coid;
+}
+
+int name_cache_hold(const char *name, uint64_t timeout_ns, name_cache_conn_t *conn)
+{
+	entry_t *e;
+
+	while (1)
+	{
+		if (-1 == name_cache_wait(name, timeout_ns))
+			return -1;
+		pthread_mutex_lock(&lock);
+		e = find(name);
+		if (NULL != e)
+		{
+			e->holders++;
+			conn->coid = e->coid;
+			conn->gen = e->gen;
+			pthread_mutex_unlock(&lock);
+			return 0;
+		}
+		// dropped between the open and here, open the next one
+		pthread_mutex_unlock(&lock);
+	}
+}
+
+void name_cache_release(const char *name, const name_cache_conn_t *conn, int gone)
+{
+	entry_t *e;
+	int coid = -1;
+
+	pthread_mutex_lock(&lock);
+	e = find_gen(conn->gen);
+	if (NULL != e)
+	{
+		e->holders--;
+		if (gone || e->dropped)
+			coid = drop(e);
+	}
+	pthread_mutex_unlock(&lock);
+	if (-1 != coid)
+		name_close(coid);
+}
+
+void name_cache_drop(const char *name)
+{
+	entry_t *e;
+	int coid = -1;
+
+	pthread_once(&once, init);
+	pthread_mutex_lock(&lock);
+	e = find(name);
+	if (NULL != e)
+		coid = drop(e);
+	pthread_mutex_unlock(&lock);
+	if (-1 != coid)
+		name_close(coid);
+}
+
+// whether a failed send means the server has gone
+static int server_gone(long ret)
+{
+	return -1 == ret && (ESRCH == errno || EBADF == errno);
+}
+
+long name_cache_send(const char *name, const void *smsg, size_t sbytes, void *rmsg,
+		size_t rbytes)
+{
+	name_cache_conn_t conn;
+	long ret;
+	int gone, err;
+
+	while (1)
+	{
+		if (-1 == name_cache_hold(name, NAME_CACHE_FOREVER, &conn))
+			return -1;
+		ret = MsgSend(conn.coid, smsg, sbytes, rmsg, rbytes);
+		err = errno;
+		gone = server_gone(ret);
+		name_cache_release(name, &conn, gone);
+		if (!gone)
+		{
+			errno = err;
+			return ret;
+		}
+		// the server has gone, wait for the next one
+	}
+}
+
+long name_cache_sendvs(const char *name, const iov_t *siov, size_t sparts, void *rmsg,
+		size_t rbytes)
+{
+	name_cache_conn_t conn;
+	long ret;
+	int gone, err;
+
+	while (1)
+	{
+		if (-1 == name_cache_hold(name, NAME_CACHE_FOREVER, &conn))
+			return -1;
+		ret = MsgSendvs(conn.coid, siov, sparts, rmsg, rbytes);
+		err = errno;
+		gone = server_gone(ret);
+		name_cache_release(name, &conn, gone);
+		if (!gone)
+		{
+			errno = err;
+			return ret;
+		}
+	}
+}
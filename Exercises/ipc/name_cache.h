@@ -0,0 +1,80 @@
+#ifndef _NAME_CACHE_H_
+#define _NAME_CACHE_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// name_cache.h
+//
+// name_open() for clients whose server may not be up yet, or may restart.
+//
+// Connections are opened once per name and cached.  name_cache_wait()
+// blocks until a name can be opened, woken as soon as something attaches a
+// name rather than polling for it: on QNX by a PROCMGR_EVENT_PATHSPACE pulse,
+// on the Linux build hosts by inotify on the directory the host stand-in
+// keeps names in.  Between attempts it also backs off exponentially, from
+// 10 us to 100 ms with jitter, which covers a name that is attached before
+// its server is ready to take messages.
+//
+// name_cache_send() is MsgSend() to a name, name_cache_sendvs() MsgSendvs():
+// if the server has gone (ESRCH or EBADF) they drop the connection, wait for
+// the name to come back and send again.  Only use them for requests that
+// are safe to repeat, a server that died while handling one may or may not
+// have acted on it.
+//
+// Each opening of a name is a generation of its entry.  A connection being
+// sent on is held (name_cache_hold()), and is only closed once the last
+// holder lets go, so its coid can't be reused for another connection under
+// anyone still sending on it; and a holder that finds the server gone drops
+// only the generation it held, never a newer connection another thread has
+// opened since.  Coids from name_cache_open() and name_cache_wait() aren't
+// held: they stay good until the connection is dropped.
+//
+// All of it is thread safe.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/neutrino.h>
+
+// names cached at once
+#define NAME_CACHE_MAX 16
+
+#define NAME_CACHE_FOREVER UINT64_MAX
+
+// the connection to name, opened now if it isn't already.  -1 with errno set
+// (ENOENT if nothing has attached name) if it can't be opened.
+int name_cache_open(const char *name);
+
+// wait up to timeout_ns (or NAME_CACHE_FOREVER) for name to be attached,
+// then open it.  Returns the connection, or -1 with errno ETIMEDOUT or the
+// error that stopped it.
+int name_cache_wait(const char *name, uint64_t timeout_ns);
+
+// a held connection to a name
+typedef struct
+{
+	int coid;
+	unsigned gen; // which opening of the name it is
+} name_cache_conn_t;
+
+// name_cache_wait() for name and hold the connection in *conn until
+// name_cache_release().  Returns 0, or -1 with errno as name_cache_wait().
+int name_cache_hold(const char *name, uint64_t timeout_ns, name_cache_conn_t *conn);
+
+// done with conn.  gone says its server has gone (ESRCH or EBADF): it is
+// dropped, unless a newer connection has replaced it already.
+void name_cache_release(const char *name, const name_cache_conn_t *conn, int gone);
+
+// forget the connection to name, say after its server was killed; it is
+// closed once nothing holds it, the next open makes a new one
+void name_cache_drop(const char *name);
+
+// MsgSend() to name, waiting for it to be attached and sending again after
+// the server goes away, as above
+long name_cache_send(const char *name, const void *smsg, size_t sbytes, void *rmsg,
+		size_t rbytes);
+
+// the same with the message in sparts parts, as MsgSendvs()
+long name_cache_sendvs(const char *name, const iov_t *siov, size_t sparts, void *rmsg,
+		size_t rbytes);
+
+#endif //_NAME_CACHE_H_
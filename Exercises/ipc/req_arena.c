@@ -0,0 +1,179 @@
+////////////////////////////////////////////////////////////////////////////////
+// req_arena.c
+//
+// Per-thread bump arenas, see req_arena.h.
+//
+// An arena is one malloc()ed block, found through a thread specific key and
+// created on the thread's first allocation.  Allocations that don't fit are
+// malloc()ed with a header chaining them to the arena, so the reset can free
+// them; the arena itself is emptied by setting its used count back to 0.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "req_arena.h"
+
+// what malloc() guarantees, enough for any type
+#define ALIGN 16
+#define ROUND(n) (((n) + ALIGN - 1) & ~(size_t)(ALIGN - 1))
+
+typedef struct heap_block
+{
+	struct heap_block *next;
+} heap_block_t;
+
+#define HEAP_HEADER ROUND(sizeof(heap_block_t))
+
+typedef struct
+{
+	size_t size;
+	size_t used;
+	char *data; // size bytes, just after the arena in the same block
+	heap_block_t *heap; // what didn't fit, since the last reset
+	req_arena_stats_t stats;
+} arena_t;
+
+static size_t arena_size = REQ_ARENA_DEFAULT_SIZE;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t arena_key;
+
+static void free_heap(arena_t *arena)
+{
+	heap_block_t *block, *next;
+
+	for (block = arena->heap; NULL != block; block = next)
+	{
+		next = block->next;
+		free(block);
+	}
+	arena->heap = NULL;
+}
+
+static void arena_free(void *arena)
+{
+	free_heap(arena);
+	free(arena);
+}
+
+static void key_create(void)
+{
+	(void)pthread_key_create(&arena_key, arena_free);
+}
+
+// this thread's arena, created on first use
+static arena_t *get_arena(void)
+{
+	arena_t *arena;
+	size_t size;
+
+	pthread_once(&key_once, key_create);
+	arena = pthread_getspecific(arena_key);
+	if (NULL == arena)
+	{
+		size = ROUND(arena_size);
+		arena = malloc(ROUND(sizeof(*arena)) + size);
+		if (NULL == arena)
+		{
+			errno = ENOMEM;
+			return NULL;
+		}
+		arena->size = size;
+		arena->used = 0;
+		arena->data = (char *)arena + ROUND(sizeof(*arena));
+		arena->heap = NULL;
+		memset(&arena->stats, 0, sizeof(arena->stats));
+		if (0 != pthread_setspecific(arena_key, arena))
+		{
+			free(arena);
+			errno = ENOMEM;
+			return NULL;
+		}
+	}
+	return arena;
+}
+
+int req_arena_set_size(size_t size)
+{
+	if (0 == size || size > SIZE_MAX / 2)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	arena_size = size;
+	return 0;
+}
+
+size_t req_arena_size(void)
+{
+	return arena_size;
+}
+
+void *req_arena_alloc(size_t size)
+{
+	arena_t *arena = get_arena();
+	heap_block_t *block;
+	size_t rounded;
+	void *ptr;
+
+	if (NULL == arena)
+		return NULL;
+	arena->stats.allocs++;
+	// what it takes of the arena, 0 bytes still getting a pointer of its own;
+	// sizes that would round past SIZE_MAX can't fit anyway
+	rounded = size > SIZE_MAX - ALIGN ? SIZE_MAX : ROUND(size ? size : 1);
+	if (rounded <= arena->size - arena->used)
+	{
+		ptr = arena->data + arena->used;
+		arena->used += rounded;
+		if (arena->used > arena->stats.high_water)
+			arena->stats.high_water = arena->used;
+		return ptr;
+	}
+
+	// too big for what is left
+	arena->stats.heap++;
+	if (size > SIZE_MAX - HEAP_HEADER)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+	block = malloc(HEAP_HEADER + size);
+	if (NULL == block)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+	block->next = arena->heap;
+	arena->heap = block;
+	return (char *)block + HEAP_HEADER;
+}
+
+void req_arena_reset(void)
+{
+	arena_t *arena;
+
+	pthread_once(&key_once, key_create);
+	arena = pthread_getspecific(arena_key);
+	if (NULL == arena)
+		return;
+	if (NULL != arena->heap)
+		free_heap(arena);
+	arena->used = 0;
+	arena->stats.resets++;
+}
+
+void req_arena_stats(req_arena_stats_t *stats)
+{
+	arena_t *arena;
+
+	pthread_once(&key_once, key_create);
+	arena = pthread_getspecific(arena_key);
+	if (NULL == arena)
+		memset(stats, 0, sizeof(*stats));
+	else
+		*stats = arena->stats;
+}
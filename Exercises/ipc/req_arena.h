@@ -0,0 +1,50 @@
+#ifndef _REQ_ARENA_H_
+#define _REQ_ARENA_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// req_arena.h
+//
+// Request scoped memory for message handlers.  Each thread gets an arena
+// that allocations are carved off the front of; nothing is freed on its own,
+// the whole arena is emptied at once by req_arena_reset() when the request
+// is over (after its MsgReply()).  That takes no locks and leaves nothing
+// behind to fragment the heap, where a malloc()/free() per request takes the
+// allocator's lock twice and, with many threads and mixed sizes, spreads the
+// heap out.
+//
+// What doesn't fit in what is left of the arena comes from malloc(), and is
+// freed by the same req_arena_reset().  Nothing allocated here may be kept
+// past the reset.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+
+// bytes in each thread's arena
+#define REQ_ARENA_DEFAULT_SIZE (64 * 1024)
+
+// allocations in one thread's arena since it was created
+typedef struct
+{
+	unsigned long allocs; // all of them
+	unsigned long heap; // the ones that didn't fit and came from malloc()
+	unsigned long resets;
+	size_t high_water; // most of the arena one request has used
+} req_arena_stats_t;
+
+// set the size of arenas created from now on, before the handler threads
+// start.  Returns 0, or -1 with errno EINVAL for 0.
+int req_arena_set_size(size_t size);
+size_t req_arena_size(void);
+
+// size bytes for the current request, aligned for any type.  Returns NULL
+// with errno ENOMEM if neither the arena nor the heap has room.
+void *req_arena_alloc(size_t size);
+
+// end the current request: everything req_arena_alloc() returned on this
+// thread since the last reset is gone
+void req_arena_reset(void);
+
+// this thread's counts, zero if it hasn't allocated anything
+void req_arena_stats(req_arena_stats_t *stats);
+
+#endif //_REQ_ARENA_H_
@@ -0,0 +1,232 @@
+////////////////////////////////////////////////////////////////////////////////
+// req_arena_bench.c
+//
+// What handlers' per-request allocations cost with malloc()/free() against
+// req_arena.h.  Each thread plays a server thread handling one request after
+// another: one to four buffers of 16 bytes to 8k, now and then a payload too
+// big for the arena, each one written a byte per page the way a MsgRead()
+// into it would, then all of them given back (free(), or req_arena_reset()
+// as after the MsgReply()).
+//
+// The CPU time per request includes the writes, the system time is mostly
+// the heap getting and giving back pages.  Every mode runs in its own
+// process so the peak RSS it reports is its own.
+// Plain POSIX so it runs on the Linux build hosts as well as on a QNX target.
+//
+// -n threads   handler threads (default 4)
+// -r requests  requests per thread (default 1000000)
+// -a bytes     arena size (default REQ_ARENA_DEFAULT_SIZE)
+// -p percent   requests with an oversized payload (default 1)
+// -b bytes     size of those payloads (default 256k)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "req_arena.h"
+
+#define MAX_ALLOCS 5 // four buffers and the payload
+
+typedef struct
+{
+	pthread_t tid;
+	unsigned seed;
+	req_arena_stats_t stats; // the thread's arena at the end
+} handler_t;
+
+typedef enum
+{
+	MODE_MALLOC, MODE_ARENA, NUM_MODES
+} bench_mode_t;
+
+static const char *mode_names[NUM_MODES] =
+{ "malloc", "arena" };
+
+static bench_mode_t mode;
+static unsigned long requests = 1000000;
+static unsigned percent = 1;
+static size_t payload = 256 * 1024;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// what a handler does with a buffer it was given
+static void touch(char *buf, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i += 4096)
+		buf[i] = (char)i;
+	buf[size - 1] = 0;
+}
+
+static void *handler(void *arg)
+{
+	handler_t *h = arg;
+	unsigned seed = h->seed;
+	char *bufs[MAX_ALLOCS];
+	size_t size;
+	unsigned long r;
+	unsigned i, n;
+
+	for (r = 0; r < requests; r++)
+	{
+		n = 1 + rand_r(&seed) % 4;
+		for (i = 0; i <= n; i++)
+		{
+			if (i == n)
+			{
+				if ((unsigned)rand_r(&seed) % 100 >= percent)
+					break;
+				size = payload;
+			}
+			else
+				size = 16 << rand_r(&seed) % 10; // 16 bytes to 8k
+			bufs[i] = MODE_MALLOC == mode ? malloc(size) : req_arena_alloc(size);
+			if (NULL == bufs[i])
+			{
+				perror("alloc");
+				exit(EXIT_FAILURE);
+			}
+			touch(bufs[i], size);
+		}
+		if (MODE_MALLOC == mode)
+		{
+			while (i-- > 0)
+				free(bufs[i]);
+		}
+		else
+			req_arena_reset();
+	}
+	req_arena_stats(&h->stats);
+	return NULL;
+}
+
+// one mode's run, in a child process so its RSS is its own
+static void run(unsigned nthreads)
+{
+	handler_t *threads = calloc(nthreads, sizeof(*threads));
+	unsigned long allocs = 0, heap = 0;
+	size_t high_water = 0;
+	struct rusage ru;
+	double start, elapsed, cpu;
+	unsigned t;
+
+	if (NULL == threads)
+	{
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+	start = now();
+	for (t = 0; t < nthreads; t++)
+	{
+		threads[t].seed = t + 1;
+		if (0 != pthread_create(&threads[t].tid, NULL, handler, &threads[t]))
+		{
+			perror("pthread_create");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (t = 0; t < nthreads; t++)
+		pthread_join(threads[t].tid, NULL);
+	elapsed = now() - start;
+	getrusage(RUSAGE_SELF, &ru);
+	cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec
+			+ ru.ru_stime.tv_usec / 1e6;
+
+	printf("%-7s %12.0f %10.1f %10.1f %10ld", mode_names[mode], nthreads * requests / elapsed,
+			cpu * 1e9 / (nthreads * requests), ru.ru_stime.tv_sec * 1e3
+			+ ru.ru_stime.tv_usec / 1e3, ru.ru_maxrss);
+	if (MODE_ARENA == mode)
+	{
+		for (t = 0; t < nthreads; t++)
+		{
+			allocs += threads[t].stats.allocs;
+			heap += threads[t].stats.heap;
+			if (threads[t].stats.high_water > high_water)
+				high_water = threads[t].stats.high_water;
+		}
+		printf("  %.2f%% from the heap, high water %zu", 100.0 * heap / allocs, high_water);
+	}
+	printf("\n");
+	free(threads);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned nthreads = 4;
+	int status;
+	pid_t pid;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:r:a:p:b:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			nthreads = atoi(optarg);
+			break;
+		case 'r':
+			requests = strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			if (-1 == req_arena_set_size(strtoul(optarg, NULL, 0)))
+			{
+				perror("arena size");
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'p':
+			percent = atoi(optarg);
+			break;
+		case 'b':
+			payload = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (0 == nthreads || 0 == requests || 0 == payload)
+	{
+		fprintf(stderr, "%s: nothing to do\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	printf("%u threads, %lu requests each, %zu byte arenas, %u%% with a %zu byte payload\n",
+			nthreads, requests, req_arena_size(), percent, payload);
+	printf("%-7s %12s %10s %10s %10s\n", "mode", "requests/s", "CPU ns/req", "sys ms",
+			"max RSS kB");
+	for (mode = 0; mode < NUM_MODES; mode++)
+	{
+		fflush(stdout);
+		pid = fork();
+		if (-1 == pid)
+		{
+			perror("fork");
+			exit(EXIT_FAILURE);
+		}
+		if (0 == pid)
+		{
+			run(nthreads);
+			exit(EXIT_SUCCESS);
+		}
+		if (-1 == waitpid(pid, &status, 0) || !WIFEXITED(status)
+				|| EXIT_SUCCESS != WEXITSTATUS(status))
+		{
+			fprintf(stderr, "%s run failed\n", mode_names[mode]);
+			exit(EXIT_FAILURE);
+		}
+	}
+	return EXIT_SUCCESS;
+}
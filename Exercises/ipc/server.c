@@ -18,9 +18,7 @@
 #include <process.h>
 
 #include "msg_def.h"  //layout of msg's should be defined by a struct, here's its definition
-
-int
-calculate_checksum(char *text);
+#include "cksum.h"
 
 int main(void)
 {
@@ -64,14 +62,3 @@ int main(void)
 	}
 	return 0;
 }
-
-int calculate_checksum(char *text)
-{
-	char *c;
-	int cksum = 0;
-
-	for (c = text; *c != '\0'; c++)
-		cksum += *c;
-	return cksum;
-}
-
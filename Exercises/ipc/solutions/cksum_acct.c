@@ -0,0 +1,271 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_acct.c
+//
+// Per connection accounting table, see cksum_acct.h.  The resource manager
+// serving it is in cksum_acct_rm.c.
+//
+// Open addressing with linear probing.  A slot's gen is 0 while it has never
+// been used, odd while it holds a live connection, and even once that has
+// gone; it is bumped on every change, so a reader that sees the same odd
+// gen before and after copying a slot has a copy of one connection's
+// counters.  Inserting and removing happen under insert_lock, which is what
+// keeps two threads from inserting the same scoid twice, and lets an insert
+// check its client is still there without a disconnect slipping in between.
+// A request remembers its slot's gen from when it was received and counts
+// nothing if it has changed by the time it is done.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/neutrino.h>
+
+#include "cksum_acct.h"
+
+typedef struct
+{
+	uint32_t gen;
+	int32_t scoid;
+	int32_t pid;
+	uint64_t requests;
+	uint64_t bytes;
+	uint64_t service_ns;
+	uint64_t max_latency_ns;
+} acct_slot_t;
+
+static acct_slot_t slots[CKSUM_ACCT_SLOTS];
+static pthread_mutex_t insert_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t untracked;
+
+static unsigned home(int scoid)
+{
+	// scoids are small and dense, with flag bits on top
+	return ((uint32_t)scoid * 2654435761u) & (CKSUM_ACCT_SLOTS - 1);
+}
+
+// scoid's live slot and, in *genp, its gen when it was found
+static acct_slot_t *lookup(int scoid, uint32_t *genp)
+{
+	acct_slot_t *slot;
+	uint32_t gen;
+	unsigned i, n;
+
+	for (i = home(scoid), n = 0; n < CKSUM_ACCT_SLOTS; i = (i + 1) & (CKSUM_ACCT_SLOTS - 1), n++)
+	{
+		slot = &slots[i];
+		gen = __atomic_load_n(&slot->gen, __ATOMIC_ACQUIRE);
+		if (0 == gen)
+			return NULL;
+		if ((gen & 1) && __atomic_load_n(&slot->scoid, __ATOMIC_RELAXED) == scoid)
+		{
+			// a slot reused meanwhile could have had scoid put in it for
+			// some other connection; let the caller go the locked way
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (__atomic_load_n(&slot->gen, __ATOMIC_RELAXED) != gen)
+				return NULL;
+			*genp = gen;
+			return slot;
+		}
+	}
+	return NULL;
+}
+
+// NULL with *full set if there's no room, or without if the client is gone
+static acct_slot_t *insert(int rcvid, int scoid, pid_t pid, uint32_t *genp, int *full)
+{
+	acct_slot_t *slot, *free_slot = NULL;
+	struct _msg_info info;
+	uint32_t gen;
+	unsigned i, n;
+
+	*full = 0;
+	pthread_mutex_lock(&insert_lock);
+	// its disconnect takes insert_lock too, so a client still there now has
+	// its entry removed after this, not before
+	if (-1 == MsgInfo(rcvid, &info))
+	{
+		pthread_mutex_unlock(&insert_lock);
+		return NULL;
+	}
+	for (i = home(scoid), n = 0; n < CKSUM_ACCT_SLOTS; i = (i + 1) & (CKSUM_ACCT_SLOTS - 1), n++)
+	{
+		slot = &slots[i];
+		gen = slot->gen;
+		if (gen & 1)
+		{
+			// another thread got here first
+			if (slot->scoid == scoid)
+			{
+				*genp = gen;
+				pthread_mutex_unlock(&insert_lock);
+				return slot;
+			}
+			continue;
+		}
+		if (NULL == free_slot)
+			free_slot = slot;
+		if (0 == gen)
+			break;
+	}
+	if (NULL != free_slot)
+	{
+		slot = free_slot;
+		__atomic_store_n(&slot->scoid, scoid, __ATOMIC_RELAXED);
+		__atomic_store_n(&slot->pid, pid, __ATOMIC_RELAXED);
+		__atomic_store_n(&slot->requests, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&slot->bytes, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&slot->service_ns, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&slot->max_latency_ns, 0, __ATOMIC_RELAXED);
+		*genp = slot->gen + 1;
+		__atomic_store_n(&slot->gen, *genp, __ATOMIC_RELEASE);
+	}
+	else
+		*full = 1;
+	pthread_mutex_unlock(&insert_lock);
+	return free_slot;
+}
+
+void cksum_acct_begin(cksum_acct_ref_t *ref, int rcvid, int scoid, pid_t pid)
+{
+	ref->full = 0;
+	ref->gen = 0;
+	ref->slot = lookup(scoid, &ref->gen);
+	if (NULL == ref->slot)
+		ref->slot = insert(rcvid, scoid, pid, &ref->gen, &ref->full);
+}
+
+void cksum_acct_record(const cksum_acct_ref_t *ref, uint64_t bytes, uint64_t service_ns,
+		uint64_t latency_ns)
+{
+	acct_slot_t *slot = ref->slot;
+	uint64_t max;
+
+	if (NULL == slot)
+	{
+		if (ref->full)
+			__atomic_fetch_add(&untracked, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	// disconnected (and maybe reused) since the request came in
+	if (__atomic_load_n(&slot->gen, __ATOMIC_ACQUIRE) != ref->gen)
+		return;
+	__atomic_fetch_add(&slot->requests, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&slot->bytes, bytes, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&slot->service_ns, service_ns, __ATOMIC_RELAXED);
+	max = __atomic_load_n(&slot->max_latency_ns, __ATOMIC_RELAXED);
+	while (latency_ns > max
+			&& !__atomic_compare_exchange_n(&slot->max_latency_ns, &max, latency_ns, 1,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+void cksum_acct_disconnect(int scoid)
+{
+	acct_slot_t *slot;
+	uint32_t gen;
+
+	pthread_mutex_lock(&insert_lock);
+	slot = lookup(scoid, &gen);
+	if (NULL != slot)
+		__atomic_store_n(&slot->gen, slot->gen + 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&insert_lock);
+}
+
+unsigned cksum_acct_snapshot(cksum_acct_entry_t *entries, unsigned max)
+{
+	acct_slot_t *slot;
+	cksum_acct_entry_t *e;
+	uint32_t gen;
+	unsigned i, count = 0;
+
+	for (i = 0; i < CKSUM_ACCT_SLOTS && count < max; i++)
+	{
+		slot = &slots[i];
+		gen = __atomic_load_n(&slot->gen, __ATOMIC_ACQUIRE);
+		if (!(gen & 1))
+			continue;
+		e = &entries[count];
+		e->scoid = __atomic_load_n(&slot->scoid, __ATOMIC_RELAXED);
+		e->pid = __atomic_load_n(&slot->pid, __ATOMIC_RELAXED);
+		e->requests = __atomic_load_n(&slot->requests, __ATOMIC_RELAXED);
+		e->bytes = __atomic_load_n(&slot->bytes, __ATOMIC_RELAXED);
+		e->service_ns = __atomic_load_n(&slot->service_ns, __ATOMIC_RELAXED);
+		e->max_latency_ns = __atomic_load_n(&slot->max_latency_ns, __ATOMIC_RELAXED);
+		// removed or reused while we copied, skip it
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slot->gen, __ATOMIC_RELAXED) != gen)
+			continue;
+		count++;
+	}
+	return count;
+}
+
+static int by_service_time(const void *a, const void *b)
+{
+	const cksum_acct_entry_t *x = a, *y = b;
+
+	if (x->service_ns != y->service_ns)
+		return x->service_ns < y->service_ns ? 1 : -1;
+	return x->scoid - y->scoid;
+}
+
+char *cksum_acct_text(size_t *len)
+{
+	cksum_acct_entry_t *entries;
+	unsigned count, i;
+	size_t size, used;
+	char *text;
+
+	entries = malloc(CKSUM_ACCT_SLOTS * sizeof(*entries));
+	if (NULL == entries)
+		return NULL;
+	count = cksum_acct_snapshot(entries, CKSUM_ACCT_SLOTS);
+	qsort(entries, count, sizeof(*entries), by_service_time);
+
+	// each line is well under 128 characters
+	size = (count + 2) * 128;
+	text = malloc(size);
+	if (NULL == text)
+	{
+		free(entries);
+		return NULL;
+	}
+	used = snprintf(text, size, "%-10s %8s %12s %14s %12s %12s\n", "scoid", "pid", "requests",
+			"bytes", "service_us", "max_lat_us");
+	for (i = 0; i < count; i++)
+	{
+		used += snprintf(text + used, size - used, "%-#10x %8d %12llu %14llu %12llu %12llu\n",
+				entries[i].scoid, entries[i].pid, (unsigned long long)entries[i].requests,
+				(unsigned long long)entries[i].bytes,
+				(unsigned long long)(entries[i].service_ns / 1000),
+				(unsigned long long)(entries[i].max_latency_ns / 1000));
+	}
+	i = __atomic_load_n(&untracked, __ATOMIC_RELAXED);
+	if (i)
+		used += snprintf(text + used, size - used, "untracked requests %u\n", i);
+	free(entries);
+	*len = used;
+	return text;
+}
+
+void *cksum_acct_binary(size_t *len)
+{
+	cksum_acct_snap_hdr_t *hdr;
+	struct timespec ts;
+
+	hdr = malloc(sizeof(*hdr) + CKSUM_ACCT_SLOTS * sizeof(cksum_acct_entry_t));
+	if (NULL == hdr)
+		return NULL;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	hdr->magic = CKSUM_ACCT_MAGIC;
+	hdr->version = CKSUM_ACCT_VERSION;
+	hdr->entry_size = sizeof(cksum_acct_entry_t);
+	hdr->untracked = __atomic_load_n(&untracked, __ATOMIC_RELAXED);
+	hdr->time_ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	hdr->count = cksum_acct_snapshot((cksum_acct_entry_t *)(hdr + 1), CKSUM_ACCT_SLOTS);
+	*len = sizeof(*hdr) + hdr->count * sizeof(cksum_acct_entry_t);
+	return hdr;
+}
@@ -0,0 +1,90 @@
+#ifndef _CKSUM_ACCT_H_
+#define _CKSUM_ACCT_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// cksum_acct.h
+//
+// Per connection accounting for the checksum server: for each scoid, how
+// many requests it sent, how many bytes, the server time spent on them and
+// the longest any one took from being received to being replied to.
+//
+// The request path records into a fixed hash table with atomic adds, and
+// only takes a lock for the first request on a connection, to insert it.
+// Snapshots don't lock at all: they copy each live entry and drop it if it
+// was removed or reused meanwhile, so scraping never waits for the request
+// path or makes it wait.  An entry's counters are each exact but may be
+// from slightly different moments.
+//
+// cksum_acct_resmgr_start() serves snapshots read-only at a path, as text,
+// and at the path plus ".bin" as a cksum_acct_snap_hdr_t followed by
+// count cksum_acct_entry_t.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// most connections tracked at once, a power of two
+#define CKSUM_ACCT_SLOTS 1024
+
+#define CKSUM_ACCT_PATH "/dev/cksum/stats"
+
+#define CKSUM_ACCT_MAGIC 0x54434b43 // "CKCT"
+#define CKSUM_ACCT_VERSION 1
+
+typedef struct
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t entry_size; // sizeof(cksum_acct_entry_t), to skip fields added later
+	uint32_t count; // entries following
+	uint32_t untracked; // requests not counted because the table was full
+	uint64_t time_ns; // CLOCK_MONOTONIC when the snapshot was taken
+} cksum_acct_snap_hdr_t;
+
+typedef struct
+{
+	int32_t scoid;
+	int32_t pid;
+	uint64_t requests;
+	uint64_t bytes;
+	uint64_t service_ns; // total time handling its requests
+	uint64_t max_latency_ns; // longest from received to replied
+} cksum_acct_entry_t;
+
+// a request's hold on its connection's entry, from cksum_acct_begin()
+typedef struct
+{
+	void *slot; // NULL if it isn't counted
+	uint32_t gen; // the slot's, when the request was received
+	int full; // not counted because the table was full
+} cksum_acct_ref_t;
+
+// find or add the entry for scoid (a connection from process pid) that the
+// message rcvid came in on, as soon as it has been received.  A client
+// that is already gone, its disconnect pulse maybe handled by another
+// thread, doesn't get an entry again, so nothing is left behind for a scoid
+// that has been detached and may be reused.
+void cksum_acct_begin(cksum_acct_ref_t *ref, int rcvid, int scoid, pid_t pid);
+
+// count the request ref was taken for, unless its connection has gone in
+// the meantime
+void cksum_acct_record(const cksum_acct_ref_t *ref, uint64_t bytes, uint64_t service_ns,
+		uint64_t latency_ns);
+
+// the connection is gone, forget it
+void cksum_acct_disconnect(int scoid);
+
+// copy up to max live entries into entries, returns how many were copied
+unsigned cksum_acct_snapshot(cksum_acct_entry_t *entries, unsigned max);
+
+// a snapshot as text, busiest connection first, or as the binary layout
+// above.  Returns a buffer to free(), its length in *len, or NULL.
+char *cksum_acct_text(size_t *len);
+void *cksum_acct_binary(size_t *len);
+
+// serve the snapshots at path and path.bin from a thread of their own.
+// Returns 0 or -1 with errno set.
+int cksum_acct_resmgr_start(const char *path);
+
+#endif //_CKSUM_ACCT_H_
@@ -0,0 +1,155 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_acct_rm.c
+//
+// Read-only resource manager serving the accounting snapshots, see
+// cksum_acct.h.  It runs on its own channel and thread, so a slow reader
+// never holds up a client of the checksum server.
+//
+// Each open takes its snapshot then and reads from that, so a reader going
+// through it in small read()s sees one consistent snapshot.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+// our OCB carries the snapshot being read
+struct stats_ocb;
+#define IOFUNC_OCB_T struct stats_ocb
+#include <sys/iofunc.h>
+#include <sys/dispatch.h>
+
+#include "cksum_acct.h"
+
+typedef struct stats_ocb
+{
+	iofunc_ocb_t hdr; // must come first
+	char *data;
+	size_t len;
+} stats_ocb_t;
+
+static iofunc_attr_t text_attr;
+static iofunc_attr_t binary_attr;
+
+static stats_ocb_t *stats_ocb_calloc(resmgr_context_t *ctp, iofunc_attr_t *attr)
+{
+	stats_ocb_t *ocb;
+
+	ocb = calloc(1, sizeof(*ocb));
+	if (NULL == ocb)
+		return NULL;
+	if (&binary_attr == attr)
+		ocb->data = cksum_acct_binary(&ocb->len);
+	else
+		ocb->data = cksum_acct_text(&ocb->len);
+	if (NULL == ocb->data)
+	{
+		free(ocb);
+		return NULL;
+	}
+	// so stat() gives the size of the latest snapshot
+	attr->nbytes = ocb->len;
+	return ocb;
+}
+
+static void stats_ocb_free(stats_ocb_t *ocb)
+{
+	free(ocb->data);
+	free(ocb);
+}
+
+static int stats_open(resmgr_context_t *ctp, io_open_t *msg, iofunc_attr_t *handle, void *extra)
+{
+	// read only, even for root
+	if (msg->connect.ioflag & _IO_FLAG_WR)
+		return EROFS;
+	return iofunc_open_default(ctp, msg, handle, extra);
+}
+
+static int stats_read(resmgr_context_t *ctp, io_read_t *msg, stats_ocb_t *ocb)
+{
+	size_t nbytes;
+	int status;
+
+	if (EOK != (status = iofunc_read_verify(ctp, msg, &ocb->hdr, NULL)))
+		return status;
+	if ((msg->i.xtype & _IO_XTYPE_MASK) != _IO_XTYPE_NONE)
+		return ENOSYS;
+
+	nbytes = ocb->hdr.offset < ocb->len ? ocb->len - ocb->hdr.offset : 0;
+	if (nbytes > msg->i.nbytes)
+		nbytes = msg->i.nbytes;
+	MsgReply(ctp->rcvid, nbytes, ocb->data + ocb->hdr.offset, nbytes);
+	ocb->hdr.offset += nbytes;
+	if (nbytes > 0)
+		ocb->hdr.attr->flags |= IOFUNC_ATTR_ATIME;
+	return _RESMGR_NOREPLY;
+}
+
+static void *stats_thread(void *arg)
+{
+	dispatch_context_t *ctp = arg;
+
+	while (1)
+	{
+		if (NULL == dispatch_block(ctp))
+		{
+			perror("dispatch_block");
+			continue;
+		}
+		dispatch_handler(ctp);
+	}
+	return NULL;
+}
+
+int cksum_acct_resmgr_start(const char *path)
+{
+	static resmgr_connect_funcs_t connect_funcs;
+	static resmgr_io_funcs_t io_funcs;
+	static iofunc_funcs_t ocb_funcs =
+	{ _IOFUNC_NFUNCS, stats_ocb_calloc, stats_ocb_free };
+	static iofunc_mount_t mount;
+	resmgr_attr_t rattr;
+	dispatch_t *dpp;
+	dispatch_context_t *ctp;
+	char binary_path[PATH_MAX];
+	pthread_t tid;
+	int err;
+
+	dpp = dispatch_create();
+	if (NULL == dpp)
+		return -1;
+
+	memset(&rattr, 0, sizeof(rattr));
+	iofunc_func_init(_RESMGR_CONNECT_NFUNCS, &connect_funcs, _RESMGR_IO_NFUNCS, &io_funcs);
+	connect_funcs.open = stats_open;
+	io_funcs.read = stats_read;
+
+	mount.funcs = &ocb_funcs;
+	iofunc_attr_init(&text_attr, S_IFREG | 0444, NULL, NULL);
+	text_attr.mount = &mount;
+	iofunc_attr_init(&binary_attr, S_IFREG | 0444, NULL, NULL);
+	binary_attr.mount = &mount;
+
+	snprintf(binary_path, sizeof(binary_path), "%s.bin", path);
+	if (-1 == resmgr_attach(dpp, &rattr, path, _FTYPE_ANY, 0, &connect_funcs, &io_funcs,
+			&text_attr)
+			|| -1 == resmgr_attach(dpp, &rattr, binary_path, _FTYPE_ANY, 0, &connect_funcs,
+					&io_funcs, &binary_attr))
+		return -1;
+
+	ctp = dispatch_context_alloc(dpp);
+	if (NULL == ctp)
+		return -1;
+	err = pthread_create(&tid, NULL, stats_thread, ctp);
+	if (EOK != err)
+	{
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
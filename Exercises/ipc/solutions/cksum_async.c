@@ -0,0 +1,321 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_async.c
+//
+// Asynchronous checksum requests over shared memory rings, client and server
+// sides, see cksum_async.h
+//
+// The server keeps a fixed table of rings.  A ring's lock is held while it is
+// served, so two pool threads woken by doorbells for the same ring take turns
+// instead of both consuming it, and a detach can't unmap it mid-request.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/neutrino.h>
+
+#include "cksum_async.h"
+
+struct cksum_async
+{
+	int coid; // to the server
+	int chid; // our private channel for completion pulses
+	int self_coid;
+	uint32_t ring_id;
+	void *mem;
+	size_t bytes;
+	cksum_ring_client_t client;
+};
+
+typedef struct
+{
+	pthread_mutex_t lock; // held while the ring is served
+	int in_use;
+	int scoid;
+	int rcvid; // of the attach message, to deliver the event
+	struct sigevent event;
+	void *mem;
+	size_t bytes;
+	cksum_ring_server_t server;
+} server_ring_t;
+
+static server_ring_t rings[CKSUM_ASYNC_MAX_RINGS];
+static int allocated[CKSUM_ASYNC_MAX_RINGS]; // protected by table_lock
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+static int self_coid = -1; // to pulse ourselves about rings we left unfinished
+
+////////////////////////////////////////////////////////////////////////////////
+// client side
+
+cksum_async_t *cksum_async_create(int coid, uint32_t entries, size_t data_size)
+{
+	cksum_async_t *async;
+	struct _server_info info;
+	cksum_ring_attach_t msg;
+	int err;
+
+	async = calloc(1, sizeof(*async));
+	if (NULL == async)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+	async->coid = coid;
+	async->chid = async->self_coid = -1;
+
+	async->bytes = cksum_ring_bytes(entries, data_size);
+	if (0 == async->bytes)
+	{
+		free(async);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	// the handle has to be made out to the server's process
+	memset(&msg, 0, sizeof(msg));
+	if (-1 == ConnectServerInfo(0, coid, &info)
+			|| -1 == cksum_shm_create(async->bytes, info.pid, O_RDWR, &async->mem, &msg.handle))
+	{
+		err = errno;
+		free(async);
+		errno = err;
+		return NULL;
+	}
+	cksum_ring_init(async->mem, entries, data_size);
+	if (-1 == cksum_ring_client_init(&async->client, async->mem))
+		goto fail;
+
+	async->chid = ChannelCreate(_NTO_CHF_PRIVATE);
+	if (-1 == async->chid)
+		goto fail;
+	async->self_coid = ConnectAttach(0, 0, async->chid, _NTO_SIDE_CHANNEL, 0);
+	if (-1 == async->self_coid)
+		goto fail;
+
+	msg.msg_type = CKSUM_RING_ATTACH_MSG_TYPE;
+	msg.size = async->bytes;
+	SIGEV_PULSE_INIT(&msg.event, async->self_coid, SIGEV_PULSE_PRIO_INHERIT,
+			CKSUM_ASYNC_COMPLETION_CODE, 0);
+	if (-1 == MsgRegisterEvent(&msg.event, coid))
+		goto fail;
+	if (-1 == MsgSend(coid, &msg, sizeof(msg), &async->ring_id, sizeof(async->ring_id)))
+		goto fail;
+	return async;
+
+fail:
+	err = errno;
+	if (-1 != async->self_coid)
+		ConnectDetach(async->self_coid);
+	if (-1 != async->chid)
+		ChannelDestroy(async->chid);
+	cksum_ring_client_fini(&async->client);
+	munmap(async->mem, async->bytes);
+	free(async);
+	errno = err;
+	return NULL;
+}
+
+void cksum_async_destroy(cksum_async_t *async)
+{
+	cksum_ring_detach_t msg;
+
+	msg.msg_type = CKSUM_RING_DETACH_MSG_TYPE;
+	msg.zero = 0;
+	msg.ring_id = async->ring_id;
+	(void)MsgSend(async->coid, &msg, sizeof(msg), NULL, 0);
+
+	ConnectDetach(async->self_coid);
+	ChannelDestroy(async->chid);
+	cksum_ring_client_fini(&async->client);
+	munmap(async->mem, async->bytes);
+	free(async);
+}
+
+int cksum_async_submit(cksum_async_t *async, cksum_algo_t algorithm, const void *data,
+		size_t len, uint32_t tag)
+{
+	int doorbell;
+
+	if (-1 == cksum_ring_submit(&async->client, algorithm, data, len, tag, &doorbell))
+		return -1;
+	if (doorbell && -1 == MsgSendPulse(async->coid, -1, CKSUM_RING_DOORBELL_CODE,
+			async->ring_id))
+		return -1;
+	return 0;
+}
+
+int cksum_async_poll(cksum_async_t *async, cksum_cqe_t *cqes, int max)
+{
+	return cksum_ring_reap(&async->client, cqes, max);
+}
+
+int cksum_async_wait(cksum_async_t *async, cksum_cqe_t *cqes, int max)
+{
+	struct _pulse pulse;
+	int n;
+
+	// a pulse can be stale, for completions an earlier poll already took
+	while (0 == (n = cksum_ring_reap(&async->client, cqes, max)))
+	{
+		if (0 == cksum_ring_outstanding(&async->client))
+			return 0;
+		if (-1 == MsgReceivePulse(async->chid, &pulse, sizeof(pulse), NULL))
+			return -1;
+	}
+	return n;
+}
+
+uint32_t cksum_async_outstanding(const cksum_async_t *async)
+{
+	return cksum_ring_outstanding(&async->client);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// server side
+
+int cksum_async_server_init(int chid)
+{
+	int i;
+
+	for (i = 0; i < CKSUM_ASYNC_MAX_RINGS; i++)
+		pthread_mutex_init(&rings[i].lock, NULL);
+	self_coid = ConnectAttach(0, 0, chid, _NTO_SIDE_CHANNEL, 0);
+	return -1 == self_coid ? -1 : 0;
+}
+
+static int reply_error(int rcvid, int err)
+{
+	if (-1 == MsgError(rcvid, err))
+	{
+		perror("MsgError");
+		return -1;
+	}
+	return 0;
+}
+
+int cksum_async_attach(int rcvid, const cksum_ring_attach_t *msg, int scoid, pid_t pid)
+{
+	server_ring_t *r;
+	void *mem;
+	uint32_t id;
+
+	if (-1 == MsgVerifyEvent(rcvid, &msg->event))
+		return reply_error(rcvid, EINVAL);
+
+	mem = cksum_shm_map(&msg->handle, pid, msg->size, O_RDWR);
+	if (NULL == mem)
+		return reply_error(rcvid, errno);
+
+	pthread_mutex_lock(&table_lock);
+	for (id = 0; id < CKSUM_ASYNC_MAX_RINGS && allocated[id]; id++)
+		;
+	if (CKSUM_ASYNC_MAX_RINGS == id)
+	{
+		pthread_mutex_unlock(&table_lock);
+		munmap(mem, msg->size);
+		return reply_error(rcvid, EAGAIN);
+	}
+	allocated[id] = 1;
+	pthread_mutex_unlock(&table_lock);
+
+	r = &rings[id];
+	pthread_mutex_lock(&r->lock);
+	if (-1 == cksum_ring_server_init(&r->server, mem, msg->size))
+	{
+		pthread_mutex_unlock(&r->lock);
+		munmap(mem, msg->size);
+		pthread_mutex_lock(&table_lock);
+		allocated[id] = 0;
+		pthread_mutex_unlock(&table_lock);
+		return reply_error(rcvid, EINVAL);
+	}
+	r->scoid = scoid;
+	r->rcvid = rcvid;
+	r->event = msg->event;
+	r->mem = mem;
+	r->bytes = msg->size;
+	r->in_use = 1;
+	pthread_mutex_unlock(&r->lock);
+
+	if (-1 == MsgReply(rcvid, EOK, &id, sizeof(id)))
+	{
+		perror("MsgReply");
+		return -1;
+	}
+	return 0;
+}
+
+// drop a ring if it belongs to scoid, returns 0 if it did
+static int ring_release(uint32_t id, int scoid)
+{
+	server_ring_t *r = &rings[id];
+	int found;
+
+	pthread_mutex_lock(&r->lock);
+	found = r->in_use && r->scoid == scoid;
+	if (found)
+	{
+		r->in_use = 0;
+		munmap(r->mem, r->bytes);
+	}
+	pthread_mutex_unlock(&r->lock);
+	if (!found)
+		return -1;
+
+	pthread_mutex_lock(&table_lock);
+	allocated[id] = 0;
+	pthread_mutex_unlock(&table_lock);
+	return 0;
+}
+
+int cksum_async_detach(int rcvid, const cksum_ring_detach_t *msg, int scoid)
+{
+	if (msg->ring_id >= CKSUM_ASYNC_MAX_RINGS || -1 == ring_release(msg->ring_id, scoid))
+		return reply_error(rcvid, EINVAL);
+	if (-1 == MsgReply(rcvid, EOK, NULL, 0))
+	{
+		perror("MsgReply");
+		return -1;
+	}
+	return 0;
+}
+
+void cksum_async_doorbell(const struct _pulse *pulse)
+{
+	uint32_t id = pulse->value.sival_int;
+	server_ring_t *r;
+	unsigned n;
+	int doorbell;
+
+	// any client can ring any doorbell, but that only gets a ring served
+	if (id >= CKSUM_ASYNC_MAX_RINGS)
+		return;
+	r = &rings[id];
+
+	pthread_mutex_lock(&r->lock);
+	if (r->in_use)
+	{
+		// one ring's worth at a time, so one busy client can't keep a thread
+		n = cksum_ring_serve(&r->server, r->server.entries, &doorbell);
+		if (doorbell && -1 == MsgDeliverEvent(r->rcvid, &r->event))
+			perror("MsgDeliverEvent");
+		// the client won't ring again for what's left, so we do
+		if (n == r->server.entries
+				&& -1 == MsgSendPulse(self_coid, -1, CKSUM_RING_DOORBELL_CODE, id))
+			perror("MsgSendPulse");
+	}
+	pthread_mutex_unlock(&r->lock);
+}
+
+void cksum_async_disconnect(int scoid)
+{
+	uint32_t id;
+
+	for (id = 0; id < CKSUM_ASYNC_MAX_RINGS; id++)
+		(void)ring_release(id, scoid);
+}
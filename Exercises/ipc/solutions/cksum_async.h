@@ -0,0 +1,76 @@
+#ifndef _CKSUM_ASYNC_H_
+#define _CKSUM_ASYNC_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// cksum_async.h
+//
+// Asynchronous checksum requests over shared memory rings (cksum_ring.h).
+//
+// MsgSend() blocks a client thread for the whole round trip.  Here the client
+// queues requests in a submission ring and collects the results from a
+// completion ring whenever it likes, so one thread can keep hundreds of
+// requests in flight.  The kernel is only involved for doorbells: a pulse to
+// the server when the submission ring goes from empty to non-empty, and an
+// event back to the client when the completion ring does.
+//
+// Client side: create one cksum_async_t per thread, on a connection to the
+// checksum server.  Server side: call cksum_async_server_init() once, then
+// hand the attach/detach messages, doorbell pulses and disconnect pulses to
+// the functions below.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <sys/neutrino.h>
+
+#include "msg_def.h"
+#include "cksum.h"
+#include "cksum_ring.h"
+
+// completion pulse code on the client's private channel
+#define CKSUM_ASYNC_COMPLETION_CODE (_PULSE_CODE_MINAVAIL + 5)
+
+// most rings the server serves at once
+#define CKSUM_ASYNC_MAX_RINGS 256
+
+typedef struct cksum_async cksum_async_t;
+
+// client side: set up a ring of entries requests (a power of two) and a
+// data_size byte data area, and attach it to the server at the other end of
+// coid.  Returns NULL with errno set.
+cksum_async_t *cksum_async_create(int coid, uint32_t entries, size_t data_size);
+
+// detach the ring and free everything, any outstanding requests are lost
+void cksum_async_destroy(cksum_async_t *async);
+
+// queue a request, tag comes back in its completion.  Returns 0, or -1 with
+// errno EAGAIN if the ring is full (reap some completions first) or EINVAL
+// if len is larger than the data area.
+int cksum_async_submit(cksum_async_t *async, cksum_algo_t algorithm, const void *data,
+		size_t len, uint32_t tag);
+
+// take up to max completions without blocking, returns how many
+int cksum_async_poll(cksum_async_t *async, cksum_cqe_t *cqes, int max);
+
+// take up to max completions, blocking until there is at least one.  Returns
+// 0 at once if nothing is outstanding, or -1 with errno set.
+int cksum_async_wait(cksum_async_t *async, cksum_cqe_t *cqes, int max);
+
+// requests submitted but not yet reaped
+uint32_t cksum_async_outstanding(const cksum_async_t *async);
+
+// server side: chid is the channel the doorbells arrive on.  Returns 0 or -1.
+int cksum_async_server_init(int chid);
+
+// server side: handle CKSUM_RING_ATTACH_MSG_TYPE / CKSUM_RING_DETACH_MSG_TYPE,
+// replying to the client, whose process is pid.  Return 0, or -1 if
+// replying failed.
+int cksum_async_attach(int rcvid, const cksum_ring_attach_t *msg, int scoid, pid_t pid);
+int cksum_async_detach(int rcvid, const cksum_ring_detach_t *msg, int scoid);
+
+// server side: a CKSUM_RING_DOORBELL_CODE pulse arrived
+void cksum_async_doorbell(const struct _pulse *pulse);
+
+// server side: a client went away, drop its rings
+void cksum_async_disconnect(int scoid);
+
+#endif //_CKSUM_ASYNC_H_
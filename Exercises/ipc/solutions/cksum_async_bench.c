@@ -0,0 +1,222 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_async_bench.c
+//
+// One client thread against the checksum server (name_lookup_server -q):
+// blocking MsgSend() requests against asynchronous ring requests
+// (cksum_async.h) kept 1 to 256 deep.  Reports requests/s and the CPU time
+// per request, the client's and the server's together.  Every reply is checked.
+//
+// -n count    requests per run (default 200000)
+// -l length   payload length (default 64)
+// -a algorithm sum, crc32c or xxh64 (default sum)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/neutrino.h>
+#include <sys/iofunc.h>
+#include <sys/dispatch.h>
+
+#include "msg_def.h"
+#include "cksum.h"
+#include "cksum_async.h"
+
+#define NUM_PAYLOADS 64
+
+static char *payloads[NUM_PAYLOADS];
+static uint64_t expected[NUM_PAYLOADS];
+static size_t len = 64;
+static cksum_algo_t algorithm = CKSUM_ALGO_SUM;
+static clockid_t server_clock;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// CPU time used so far by us and the server
+static double cpu_time(void)
+{
+	struct timespec ours, theirs;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ours);
+	clock_gettime(server_clock, &theirs);
+	return ours.tv_sec + ours.tv_nsec / 1e9 + theirs.tv_sec + theirs.tv_nsec / 1e9;
+}
+
+static void report(const char *mode, unsigned depth, unsigned count, double start, double cpu)
+{
+	double elapsed = now() - start;
+
+	printf("%-8s %6u %12.0f %14.2f\n", mode, depth, count / elapsed,
+			(cpu_time() - cpu) * 1e6 / count);
+}
+
+static void bench_blocking(int coid, unsigned count)
+{
+	cksum_algo_hdr_t hdr;
+	cksum_algo_reply_t reply;
+	iov_t siov[2];
+	double start, cpu;
+	unsigned i;
+
+	hdr.msg_type = CKSUM_ALGO_MSG_TYPE;
+	hdr.algorithm = algorithm;
+	hdr.data_size = len;
+	SETIOV(&siov[0], &hdr, sizeof(hdr));
+
+	start = now();
+	cpu = cpu_time();
+	for (i = 0; i < count; i++)
+	{
+		SETIOV(&siov[1], payloads[i % NUM_PAYLOADS], len);
+		if (-1 == MsgSendvs(coid, siov, 2, &reply, sizeof(reply)))
+		{
+			perror("MsgSendvs");
+			exit(EXIT_FAILURE);
+		}
+		if (reply.result != expected[i % NUM_PAYLOADS])
+		{
+			fprintf(stderr, "blocking: wrong result for request %u\n", i);
+			exit(EXIT_FAILURE);
+		}
+	}
+	report("MsgSend", 1, count, start, cpu);
+}
+
+static void check(const cksum_cqe_t *cqes, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		if (0 != cqes[i].error || cqes[i].result != expected[cqes[i].tag % NUM_PAYLOADS])
+		{
+			fprintf(stderr, "async: request %u failed (%s) or was wrong\n", cqes[i].tag,
+					strerror(cqes[i].error));
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+static void bench_async(int coid, unsigned count, unsigned depth)
+{
+	cksum_async_t *async;
+	cksum_cqe_t cqes[256];
+	double start, cpu;
+	unsigned submitted = 0;
+	int n;
+
+	async = cksum_async_create(coid, 256, 256 * len + 4096);
+	if (NULL == async)
+	{
+		perror("cksum_async_create");
+		exit(EXIT_FAILURE);
+	}
+
+	start = now();
+	cpu = cpu_time();
+	while (submitted < count || cksum_async_outstanding(async))
+	{
+		// top the ring up to the depth, then collect what has finished
+		while (submitted < count && cksum_async_outstanding(async) < depth)
+		{
+			if (-1 == cksum_async_submit(async, algorithm, payloads[submitted % NUM_PAYLOADS],
+					len, submitted))
+			{
+				perror("cksum_async_submit");
+				exit(EXIT_FAILURE);
+			}
+			submitted++;
+		}
+		n = cksum_async_wait(async, cqes, 256);
+		if (-1 == n)
+		{
+			perror("cksum_async_wait");
+			exit(EXIT_FAILURE);
+		}
+		check(cqes, n);
+	}
+	report("async", depth, count, start, cpu);
+
+	cksum_async_destroy(async);
+}
+
+int main(int argc, char *argv[])
+{
+	static const unsigned depths[] =
+	{ 1, 4, 16, 64, 256 };
+	int opt;
+	unsigned count = 200000;
+	struct _server_info info;
+	int coid;
+	unsigned i, d;
+	size_t j;
+
+	while ((opt = getopt(argc, argv, "n:l:a:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			len = strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			for (algorithm = 0; algorithm < CKSUM_ALGO_COUNT; algorithm++)
+				if (0 == strcmp(optarg, cksum_algo_name(algorithm)))
+					break;
+			if (CKSUM_ALGO_COUNT == algorithm)
+			{
+				fprintf(stderr, "unknown algorithm %s\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	srand(9);
+	for (i = 0; i < NUM_PAYLOADS; i++)
+	{
+		payloads[i] = malloc(len + 1);
+		if (NULL == payloads[i])
+		{
+			perror("malloc");
+			exit(EXIT_FAILURE);
+		}
+		for (j = 0; j < len; j++)
+			payloads[i][j] = rand();
+		cksum_algo_run(algorithm, payloads[i], len, &expected[i]);
+	}
+
+	coid = name_open(SERVER_NAME, 0);
+	if (-1 == coid)
+	{
+		perror("name_open");
+		exit(EXIT_FAILURE);
+	}
+	if (-1 == ConnectServerInfo(0, coid, &info)
+			|| -1 == (server_clock = ClockId(info.pid, 0)))
+	{
+		perror("server cpu clock");
+		exit(EXIT_FAILURE);
+	}
+
+	printf("%u requests of %zu bytes, %s\n", count, len, cksum_algo_name(algorithm));
+	printf("%-8s %6s %12s %14s\n", "mode", "depth", "requests/s", "cpu us/request");
+	bench_blocking(coid, count);
+	for (d = 0; d < sizeof(depths) / sizeof(depths[0]); d++)
+		bench_async(coid, count, depths[d]);
+
+	return EXIT_SUCCESS;
+}
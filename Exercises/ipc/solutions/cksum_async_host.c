@@ -0,0 +1,334 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_async_host.c
+//
+// Linux stand-in for cksum_async_bench: one client thread making blocking
+// request/reply round trips against keeping 1 to 256 ring requests in flight.
+//
+// A server thread stands in for name_lookup_server.  The blocking path is a
+// write()/read() round trip over a socketpair, which like MsgSend() costs
+// two context switches per request.  The async path is the real cksum_ring
+// code in a POSIX shared memory object the server maps for itself
+// (cksum_shm_create() / cksum_shm_map()), with eventfds standing in for the
+// doorbell pulse and the completion event.  CPU time is for the whole
+// process, so it counts the client and the server together.
+//
+// -n count    requests per run (default 200000)
+// -l length   payload length (default 64)
+// -a algorithm sum, crc32c or xxh64 (default sum)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "cksum.h"
+#include "cksum_ring.h"
+#include "cksum_region.h"
+
+#define NUM_PAYLOADS 64
+#define RING_ENTRIES 256
+
+static char *payloads[NUM_PAYLOADS];
+static uint64_t expected[NUM_PAYLOADS];
+static size_t len = 64;
+static cksum_algo_t algorithm = CKSUM_ALGO_SUM;
+
+// the async server's side of things
+typedef struct
+{
+	cksum_shm_handle_t handle;
+	size_t bytes;
+	int doorbell_fd; // client -> server
+	int completion_fd; // server -> client
+	volatile int stop;
+} async_server_t;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double cpu_time(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec
+			+ ru.ru_stime.tv_usec / 1e6;
+}
+
+static void report(const char *mode, unsigned depth, unsigned count, double start, double cpu)
+{
+	double elapsed = now() - start;
+
+	printf("%-8s %6u %12.0f %14.2f\n", mode, depth, count / elapsed,
+			(cpu_time() - cpu) * 1e6 / count);
+}
+
+static void ring_bell(int fd)
+{
+	uint64_t one = 1;
+
+	if (sizeof(one) != write(fd, &one, sizeof(one)))
+	{
+		perror("write eventfd");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void wait_bell(int fd)
+{
+	uint64_t value;
+
+	if (sizeof(value) != read(fd, &value, sizeof(value)))
+	{
+		perror("read eventfd");
+		exit(EXIT_FAILURE);
+	}
+}
+
+// blocking server: one request per read, one reply per write
+static void *blocking_server(void *arg)
+{
+	int fd = *(int *)arg;
+	char *buf;
+	ssize_t n;
+	uint64_t result;
+
+	buf = malloc(len + 1);
+	if (NULL == buf)
+	{
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	while ((n = read(fd, buf, len + 1)) > 0)
+	{
+		cksum_algo_run(algorithm, buf, n, &result);
+		if (sizeof(result) != write(fd, &result, sizeof(result)))
+			break;
+	}
+	free(buf);
+	return NULL;
+}
+
+static void bench_blocking(unsigned count)
+{
+	pthread_t tid;
+	int sv[2];
+	uint64_t result;
+	double start, cpu;
+	unsigned i;
+
+	// SOCK_SEQPACKET keeps each request one message, like MsgSend()
+	if (-1 == socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv))
+	{
+		perror("socketpair");
+		exit(EXIT_FAILURE);
+	}
+	pthread_create(&tid, NULL, blocking_server, &sv[1]);
+
+	start = now();
+	cpu = cpu_time();
+	for (i = 0; i < count; i++)
+	{
+		if (len != write(sv[0], payloads[i % NUM_PAYLOADS], len)
+				|| sizeof(result) != read(sv[0], &result, sizeof(result)))
+		{
+			perror("round trip");
+			exit(EXIT_FAILURE);
+		}
+		if (result != expected[i % NUM_PAYLOADS])
+		{
+			fprintf(stderr, "blocking: wrong result for request %u\n", i);
+			exit(EXIT_FAILURE);
+		}
+	}
+	report("blocking", 1, count, start, cpu);
+
+	close(sv[0]);
+	pthread_join(tid, NULL);
+	close(sv[1]);
+}
+
+// async server: the same loop as cksum_async_doorbell(), with the doorbell
+// pulses to ourselves replaced by just going round again
+static void *async_server(void *arg)
+{
+	async_server_t *s = arg;
+	cksum_ring_server_t server;
+	void *mem;
+	unsigned n;
+	int doorbell;
+
+	mem = cksum_shm_map(&s->handle, getpid(), s->bytes, O_RDWR);
+	if (NULL == mem || -1 == cksum_ring_server_init(&server, mem, s->bytes))
+	{
+		perror("server ring");
+		exit(EXIT_FAILURE);
+	}
+	for (;;)
+	{
+		wait_bell(s->doorbell_fd);
+		if (s->stop)
+			break;
+		do
+		{
+			n = cksum_ring_serve(&server, server.entries, &doorbell);
+			if (doorbell)
+				ring_bell(s->completion_fd);
+		} while (n == server.entries);
+	}
+	munmap(mem, s->bytes);
+	return NULL;
+}
+
+static void check(const cksum_cqe_t *cqes, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		if (0 != cqes[i].error || cqes[i].result != expected[cqes[i].tag % NUM_PAYLOADS])
+		{
+			fprintf(stderr, "async: request %u failed (%s) or was wrong\n", cqes[i].tag,
+					strerror(cqes[i].error));
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+static void bench_async(unsigned count, unsigned depth)
+{
+	async_server_t s;
+	cksum_ring_client_t client;
+	cksum_cqe_t cqes[RING_ENTRIES];
+	pthread_t tid;
+	void *mem;
+	double start, cpu;
+	unsigned submitted = 0;
+	size_t data_size = RING_ENTRIES * len + 4096;
+	int n, doorbell;
+
+	memset(&s, 0, sizeof(s));
+	s.bytes = cksum_ring_bytes(RING_ENTRIES, data_size);
+	s.doorbell_fd = eventfd(0, 0);
+	s.completion_fd = eventfd(0, 0);
+	if (-1 == s.doorbell_fd || -1 == s.completion_fd
+			|| -1 == cksum_shm_create(s.bytes, getpid(), O_RDWR, &mem, &s.handle))
+	{
+		perror("async setup");
+		exit(EXIT_FAILURE);
+	}
+	cksum_ring_init(mem, RING_ENTRIES, data_size);
+	if (-1 == cksum_ring_client_init(&client, mem))
+	{
+		perror("cksum_ring_client_init");
+		exit(EXIT_FAILURE);
+	}
+	pthread_create(&tid, NULL, async_server, &s);
+
+	start = now();
+	cpu = cpu_time();
+	while (submitted < count || cksum_ring_outstanding(&client))
+	{
+		while (submitted < count && cksum_ring_outstanding(&client) < depth)
+		{
+			if (-1 == cksum_ring_submit(&client, algorithm, payloads[submitted % NUM_PAYLOADS],
+					len, submitted, &doorbell))
+			{
+				perror("cksum_ring_submit");
+				exit(EXIT_FAILURE);
+			}
+			if (doorbell)
+				ring_bell(s.doorbell_fd);
+			submitted++;
+		}
+		// as cksum_async_wait() does
+		while (0 == (n = cksum_ring_reap(&client, cqes, RING_ENTRIES)))
+			wait_bell(s.completion_fd);
+		check(cqes, n);
+	}
+	report("async", depth, count, start, cpu);
+
+	s.stop = 1;
+	ring_bell(s.doorbell_fd);
+	pthread_join(tid, NULL);
+	cksum_ring_client_fini(&client);
+	munmap(mem, s.bytes);
+	close(s.doorbell_fd);
+	close(s.completion_fd);
+}
+
+int main(int argc, char *argv[])
+{
+	static const unsigned depths[] =
+	{ 1, 4, 16, 64, 256 };
+	int opt;
+	unsigned count = 200000;
+	unsigned i, d;
+	size_t j;
+
+	while ((opt = getopt(argc, argv, "n:l:a:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			len = strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			for (algorithm = 0; algorithm < CKSUM_ALGO_COUNT; algorithm++)
+				if (0 == strcmp(optarg, cksum_algo_name(algorithm)))
+					break;
+			if (CKSUM_ALGO_COUNT == algorithm)
+			{
+				fprintf(stderr, "unknown algorithm %s\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (0 == len)
+	{
+		fprintf(stderr, "length must be at least 1\n");
+		exit(EXIT_FAILURE);
+	}
+
+	srand(9);
+	for (i = 0; i < NUM_PAYLOADS; i++)
+	{
+		payloads[i] = malloc(len);
+		if (NULL == payloads[i])
+		{
+			perror("malloc");
+			exit(EXIT_FAILURE);
+		}
+		for (j = 0; j < len; j++)
+			payloads[i][j] = rand();
+		cksum_algo_run(algorithm, payloads[i], len, &expected[i]);
+	}
+
+	printf("%u requests of %zu bytes, %s\n", count, len, cksum_algo_name(algorithm));
+	printf("%-8s %6s %12s %14s\n", "mode", "depth", "requests/s", "cpu us/request");
+	bench_blocking(count);
+	for (d = 0; d < sizeof(depths) / sizeof(depths[0]); d++)
+		bench_async(count, depths[d]);
+
+	return EXIT_SUCCESS;
+}
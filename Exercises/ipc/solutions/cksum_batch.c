@@ -0,0 +1,204 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_batch.c
+//
+// Client-side batching queue and server-side handler for the
+// CKSUM_BATCH_MSG_TYPE message, see cksum_batch.h
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/neutrino.h>
+
+#include "cksum.h"
+#include "cksum_cache.h"
+#include "cksum_batch.h"
+
+struct cksum_batch
+{
+	int coid;
+	unsigned max_count;
+	size_t max_bytes;
+	uint64_t max_delay_ns;
+	unsigned count; // requests queued
+	size_t data_size; // bytes of data queued
+	uint64_t first_queued_ns; // when the oldest queued request was added
+	uint32_t offsets[CKSUM_BATCH_MAX_COUNT];
+	int *results[CKSUM_BATCH_MAX_COUNT];
+	int cksums[CKSUM_BATCH_MAX_COUNT];
+	char *data;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+cksum_batch_t *cksum_batch_create(int coid, unsigned max_count, size_t max_bytes,
+		unsigned max_delay_us)
+{
+	cksum_batch_t *batch;
+
+	if (0 == max_count || max_count > CKSUM_BATCH_MAX_COUNT)
+		max_count = CKSUM_BATCH_MAX_COUNT;
+	if (0 == max_bytes || max_bytes > CKSUM_BATCH_MAX_DATA)
+		max_bytes = CKSUM_BATCH_MAX_DATA;
+
+	batch = calloc(1, sizeof(*batch));
+	if (NULL == batch)
+		return NULL;
+	batch->data = malloc(max_bytes);
+	if (NULL == batch->data)
+	{
+		free(batch);
+		return NULL;
+	}
+	batch->coid = coid;
+	batch->max_count = max_count;
+	batch->max_bytes = max_bytes;
+	batch->max_delay_ns = max_delay_us * 1000ULL;
+	return batch;
+}
+
+void cksum_batch_destroy(cksum_batch_t *batch)
+{
+	free(batch->data);
+	free(batch);
+}
+
+unsigned cksum_batch_pending(const cksum_batch_t *batch)
+{
+	return batch->count;
+}
+
+// send the queued requests as one message.  The queue is emptied whether or
+// not the send worked, on failure the results are left untouched.
+int cksum_batch_flush(cksum_batch_t *batch)
+{
+	cksum_batch_hdr_t hdr;
+	iov_t siov[3];
+	unsigned i;
+	int status;
+
+	if (0 == batch->count)
+		return 0;
+
+	hdr.msg_type = CKSUM_BATCH_MSG_TYPE;
+	hdr.count = batch->count;
+	hdr.data_size = batch->data_size;
+
+	SETIOV(&siov[0], &hdr, sizeof hdr);
+	SETIOV(&siov[1], batch->offsets, batch->count * sizeof(batch->offsets[0]));
+	SETIOV(&siov[2], batch->data, batch->data_size);
+
+	status = MsgSendvs(batch->coid, siov, 3, batch->cksums,
+			batch->count * sizeof(batch->cksums[0]));
+	if (-1 != status)
+	{
+		for (i = 0; i < batch->count; i++)
+			*batch->results[i] = batch->cksums[i];
+	}
+
+	batch->count = 0;
+	batch->data_size = 0;
+	return (-1 == status) ? -1 : 0;
+}
+
+int cksum_batch_poll(cksum_batch_t *batch)
+{
+	if (batch->count && batch->max_delay_ns
+			&& now_ns() - batch->first_queued_ns >= batch->max_delay_ns)
+		return cksum_batch_flush(batch);
+	return 0;
+}
+
+int cksum_batch_add(cksum_batch_t *batch, const void *data, size_t len, int *result)
+{
+	int status = 0;
+
+	if (len > batch->max_bytes)
+	{
+		errno = EMSGSIZE;
+		return -1;
+	}
+
+	// make room if this one doesn't fit
+	if (batch->count == batch->max_count || batch->data_size + len > batch->max_bytes)
+		status = cksum_batch_flush(batch);
+
+	if (0 == batch->count)
+		batch->first_queued_ns = now_ns();
+	batch->offsets[batch->count] = batch->data_size;
+	batch->results[batch->count] = result;
+	memcpy(batch->data + batch->data_size, data, len);
+	batch->data_size += len;
+	batch->count++;
+
+	if (batch->count == batch->max_count || batch->data_size == batch->max_bytes)
+	{
+		if (-1 == cksum_batch_flush(batch))
+			status = -1;
+	}
+	else if (-1 == cksum_batch_poll(batch))
+	{
+		status = -1;
+	}
+	return status;
+}
+
+static int batch_error(int rcvid, int error)
+{
+	if (-1 == MsgError(rcvid, error))
+		perror("MsgError");
+	return -1;
+}
+
+int cksum_batch_handle(int rcvid, const cksum_batch_hdr_t *hdr)
+{
+	uint32_t offsets[CKSUM_BATCH_MAX_COUNT];
+	int cksums[CKSUM_BATCH_MAX_COUNT];
+	unsigned count = hdr->count;
+	size_t table_size = count * sizeof(offsets[0]);
+	uint32_t end;
+	char *data;
+	unsigned i;
+
+	if (0 == count || count > CKSUM_BATCH_MAX_COUNT || hdr->data_size > CKSUM_BATCH_MAX_DATA)
+		return batch_error(rcvid, EINVAL);
+
+	if (MsgRead(rcvid, offsets, table_size, sizeof(*hdr)) != table_size)
+		return batch_error(rcvid, EBADMSG);
+
+	data = malloc(hdr->data_size + 1);
+	if (NULL == data)
+		return batch_error(rcvid, ENOMEM);
+	if (MsgRead(rcvid, data, hdr->data_size, sizeof(*hdr) + table_size) != hdr->data_size)
+	{
+		free(data);
+		return batch_error(rcvid, EBADMSG);
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		end = (i + 1 < count) ? offsets[i + 1] : hdr->data_size;
+		if (offsets[i] > end || end > hdr->data_size)
+		{
+			free(data);
+			return batch_error(rcvid, EBADMSG);
+		}
+		cksums[i] = cksum_cache_checksum(data + offsets[i], end - offsets[i]);
+	}
+	free(data);
+
+	if (-1 == MsgReply(rcvid, EOK, cksums, count * sizeof(cksums[0])))
+	{
+		perror("MsgReply");
+		return -1;
+	}
+	return 0;
+}
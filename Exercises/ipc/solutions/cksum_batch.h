@@ -0,0 +1,51 @@
+#ifndef _CKSUM_BATCH_H_
+#define _CKSUM_BATCH_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// cksum_batch.h
+//
+// Both sides of the CKSUM_BATCH_MSG_TYPE message (see msg_def.h).
+//
+// Client side: requests are queued and sent to the server as one batch when
+// the queue reaches max_count strings or max_bytes of data, or when the
+// oldest queued request has waited max_delay_us (checked on every add and by
+// cksum_batch_poll()).  Each request's checksum is stored through the result
+// pointer given to cksum_batch_add() once its batch has been replied to.
+//
+// Server side: cksum_batch_handle() reads the rest of a batch whose header
+// was received and replies with the checksums.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "msg_def.h"
+
+typedef struct cksum_batch cksum_batch_t;
+
+// create a queue sending to the server on coid.  Limits of 0 pick the
+// protocol maximums, a max_delay_us of 0 means no time limit.
+cksum_batch_t *cksum_batch_create(int coid, unsigned max_count, size_t max_bytes,
+		unsigned max_delay_us);
+
+void cksum_batch_destroy(cksum_batch_t *batch);
+
+// queue len bytes of data (copied), *result gets the checksum when the batch
+// is flushed.  Returns 0, or -1 with errno set if a flush this triggered
+// failed (EMSGSIZE if len alone is larger than the batch data limit).
+int cksum_batch_add(cksum_batch_t *batch, const void *data, size_t len, int *result);
+
+// send whatever is queued now.  Returns 0, or -1 with errno set.
+int cksum_batch_flush(cksum_batch_t *batch);
+
+// flush if the oldest queued request is past the time limit
+int cksum_batch_poll(cksum_batch_t *batch);
+
+// number of requests waiting to be sent
+unsigned cksum_batch_pending(const cksum_batch_t *batch);
+
+// server side: handle a batch message whose header has been received
+// into hdr.  Always replies (or MsgError()s) to rcvid.  Returns 0 or -1.
+int cksum_batch_handle(int rcvid, const cksum_batch_hdr_t *hdr);
+
+#endif //_CKSUM_BATCH_H_
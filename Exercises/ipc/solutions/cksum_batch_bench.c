@@ -0,0 +1,161 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_batch_bench.c
+//
+// Measures checksum requests per second against the checksum server
+// (name_lookup_server -q) for batch sizes 1 through 1024, with plain
+// one-string-per-MsgSend() CKSUM_MSG_TYPE requests as the baseline.
+//
+// -n count   strings to checksum per batch size (default 100000)
+// -l length  length of each string (default 16)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/neutrino.h>
+#include <sys/iofunc.h>
+#include <sys/dispatch.h>
+
+#include "msg_def.h"
+#include "cksum.h"
+#include "cksum_batch.h"
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// strings are taken round robin from a small table, so they vary a little
+#define NUM_STRINGS 64
+
+static char strings[NUM_STRINGS][MAX_STRING_LEN + 1];
+
+static double bench_single(int coid, unsigned count, size_t len)
+{
+	cksum_msg_t msg;
+	int checksum;
+	unsigned i;
+	double start;
+
+	msg.msg_type = CKSUM_MSG_TYPE;
+	start = now();
+	for (i = 0; i < count; i++)
+	{
+		memcpy(msg.string_to_cksum, strings[i % NUM_STRINGS], len + 1);
+		if (-1 == MsgSend(coid, &msg, sizeof(msg.msg_type) + len + 1, &checksum,
+				sizeof(checksum)))
+		{
+			perror("MsgSend");
+			exit(EXIT_FAILURE);
+		}
+	}
+	return count / (now() - start);
+}
+
+static double bench_batch(int coid, unsigned count, size_t len, unsigned batch_size)
+{
+	cksum_batch_t *batch;
+	int *results;
+	unsigned i;
+	double start, elapsed;
+
+	results = malloc(count * sizeof(*results));
+	batch = cksum_batch_create(coid, batch_size, 0, 0);
+	if (NULL == results || NULL == batch)
+	{
+		perror("cksum_batch_create");
+		exit(EXIT_FAILURE);
+	}
+
+	start = now();
+	for (i = 0; i < count; i++)
+	{
+		if (-1 == cksum_batch_add(batch, strings[i % NUM_STRINGS], len, &results[i]))
+		{
+			perror("cksum_batch_add");
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (-1 == cksum_batch_flush(batch))
+	{
+		perror("cksum_batch_flush");
+		exit(EXIT_FAILURE);
+	}
+	elapsed = now() - start;
+
+	// make sure the server's answers are right
+	for (i = 0; i < count; i++)
+	{
+		if (results[i] != calculate_checksum_len(strings[i % NUM_STRINGS], len))
+		{
+			printf("batch size %u: wrong checksum for request %u\n", batch_size, i);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	cksum_batch_destroy(batch);
+	free(results);
+	return count / elapsed;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	int coid;
+	unsigned count = 100000;
+	size_t len = 16;
+	unsigned batch_size;
+	double single, rate;
+	unsigned i, j;
+
+	while ((opt = getopt(argc, argv, "n:l:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'l':
+			len = atoi(optarg);
+			if (len > MAX_STRING_LEN)
+				len = MAX_STRING_LEN;
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (i = 0; i < NUM_STRINGS; i++)
+	{
+		for (j = 0; j < len; j++)
+			strings[i][j] = 'a' + (i + j) % 26;
+		strings[i][len] = '\0';
+	}
+
+	coid = name_open(SERVER_NAME, 0);
+	if (-1 == coid)
+	{
+		perror("name_open");
+		exit(EXIT_FAILURE);
+	}
+
+	single = bench_single(coid, count, len);
+	printf("%u strings of %zu bytes\n", count, len);
+	printf("%-10s %14s %10s\n", "batch", "requests/s", "speedup");
+	printf("%-10s %14.0f %10.2f\n", "single", single, 1.0);
+
+	for (batch_size = 1; batch_size <= CKSUM_BATCH_MAX_COUNT; batch_size *= 2)
+	{
+		rate = bench_batch(coid, count, len, batch_size);
+		printf("%-10u %14.0f %10.2f\n", batch_size, rate, rate / single);
+	}
+
+	name_close(coid);
+	return EXIT_SUCCESS;
+}
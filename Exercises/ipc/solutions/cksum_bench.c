@@ -0,0 +1,513 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_bench.c
+//
+// Load generator for the checksum server (name_lookup_server, run it with -q).
+//
+// Each thread opens its own connections to the server and sends
+// CKSUM_ALGO_MSG_TYPE requests round robin over them until the time is up.
+// Closed loop (the default) a thread sends its next request as soon as the
+// reply to the last one is in.  Open loop (-r) requests fall due at fixed
+// intervals whatever the server does, and latency is measured from when a
+// request was due rather than when it was sent, so a server that falls
+// behind shows up as latency instead of quietly lowering the offered load.
+//
+// Payload sizes are drawn from a comma separated list of sizes or min-max
+// ranges (picked from uniformly), each optionally weighted with :weight, for
+// example "64:90,4096:9,65536-1048576:1".
+//
+// Built for Linux ("make host", as cksum_bench_host) it runs against a local
+// stand-in instead of the server: every connection is a socketpair served by
+// its own thread, which checksums the requests just as the server does.
+//
+// -t threads      sending threads (default 1)
+// -c connections  connections per thread (default 1)
+// -s sizes        payload size distribution (default 256)
+// -r rate         open loop, this many requests/s over all threads (default 0,
+//                 closed loop)
+// -d seconds      how long to run (default 10)
+// -a algorithm    sum, crc32c or xxh64 (default sum)
+// -o file         write the latency histogram (ns) to file as CSV
+// -v              verify every reply
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+#ifdef __QNX__
+#include <sys/neutrino.h>
+#include <sys/iofunc.h>
+#include <sys/dispatch.h>
+#include "msg_def.h"
+#else
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+#include "cksum.h"
+#include "cksum_hist.h"
+
+#define MAX_SIZE_CLASSES 32
+// payloads start at a random offset this far into the buffer, so they vary
+#define PAYLOAD_SPREAD 4096
+
+typedef struct
+{
+	size_t min;
+	size_t max;
+	double weight;
+} size_class_t;
+
+typedef struct
+{
+	pthread_t tid;
+	unsigned seed;
+	double phase; // open loop: offset into the interval, 0 to 1
+	int *conns;
+	cksum_hist_t *hist;
+	unsigned long requests;
+	unsigned long errors;
+	unsigned long mismatches;
+} worker_t;
+
+static size_class_t size_classes[MAX_SIZE_CLASSES];
+static unsigned num_size_classes;
+static double total_weight;
+
+static int nconns = 1;
+static double interval_ns; // per thread, 0 for closed loop
+static uint64_t start_ns, end_ns;
+static cksum_algo_t algorithm = CKSUM_ALGO_SUM;
+static int verify = 0;
+static char *payload; // max size + PAYLOAD_SPREAD bytes
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t when)
+{
+	struct timespec ts;
+
+	ts.tv_sec = when / 1000000000;
+	ts.tv_nsec = when % 1000000000;
+	while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL))
+		;
+}
+
+// timer wakeups are late by tens of microseconds (more in a VM), which at
+// high rates would be mistaken for server latency: sleep most of the way and
+// spin the rest
+#define SPIN_NS 200000
+
+static void wait_until_ns(uint64_t when)
+{
+	if (now_ns() + SPIN_NS < when)
+		sleep_until_ns(when - SPIN_NS);
+	while (now_ns() < when)
+		;
+}
+
+#ifdef __QNX__
+
+static int conn_open(void)
+{
+	return name_open(SERVER_NAME, 0);
+}
+
+static void conn_close(int coid)
+{
+	name_close(coid);
+}
+
+static int conn_request(int coid, const void *data, size_t len, uint64_t *result)
+{
+	cksum_algo_hdr_t hdr;
+	cksum_algo_reply_t reply;
+	iov_t siov[2];
+
+	hdr.msg_type = CKSUM_ALGO_MSG_TYPE;
+	hdr.algorithm = algorithm;
+	hdr.data_size = len;
+	SETIOV(&siov[0], &hdr, sizeof(hdr));
+	SETIOV(&siov[1], data, len);
+	if (-1 == MsgSendvs(coid, siov, 2, &reply, sizeof(reply)))
+		return -1;
+	*result = reply.result;
+	return 0;
+}
+
+#else
+
+// the stand-in's requests: this header, then the data
+typedef struct
+{
+	uint32_t algorithm;
+	uint32_t data_size;
+} standin_hdr_t;
+
+static int read_full(int fd, void *buf, size_t len)
+{
+	char *p = buf;
+	ssize_t n;
+
+	while (len)
+	{
+		n = read(fd, p, len);
+		if (n <= 0)
+		{
+			if (n < 0 && EINTR == errno)
+				continue;
+			return -1;
+		}
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int writev_full(int fd, struct iovec *iov, int parts)
+{
+	ssize_t n;
+
+	while (parts)
+	{
+		n = writev(fd, iov, parts);
+		if (n < 0)
+		{
+			if (EINTR == errno)
+				continue;
+			return -1;
+		}
+		while (parts && (size_t)n >= iov->iov_len)
+		{
+			n -= iov->iov_len;
+			iov++;
+			parts--;
+		}
+		if (parts)
+		{
+			iov->iov_base = (char *)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+	return 0;
+}
+
+// one per connection: receive, checksum, reply, until the client hangs up
+static void *standin_server(void *arg)
+{
+	int fd = (int)(intptr_t)arg;
+	standin_hdr_t hdr;
+	char *data = NULL, *bigger;
+	size_t data_max = 0;
+	uint64_t result;
+	struct iovec iov;
+
+	while (0 == read_full(fd, &hdr, sizeof(hdr)))
+	{
+		if (hdr.data_size > data_max)
+		{
+			bigger = realloc(data, hdr.data_size);
+			if (NULL == bigger)
+				break;
+			data = bigger;
+			data_max = hdr.data_size;
+		}
+		if (-1 == read_full(fd, data, hdr.data_size))
+			break;
+		if (-1 == cksum_algo_run(hdr.algorithm, data, hdr.data_size, &result))
+			result = 0;
+		iov.iov_base = &result;
+		iov.iov_len = sizeof(result);
+		if (-1 == writev_full(fd, &iov, 1))
+			break;
+	}
+	free(data);
+	close(fd);
+	return NULL;
+}
+
+static int conn_open(void)
+{
+	int sv[2];
+	pthread_t tid;
+
+	if (-1 == socketpair(AF_UNIX, SOCK_STREAM, 0, sv))
+		return -1;
+	if (0 != pthread_create(&tid, NULL, standin_server, (void *)(intptr_t)sv[1]))
+	{
+		close(sv[0]);
+		close(sv[1]);
+		errno = EAGAIN;
+		return -1;
+	}
+	pthread_detach(tid);
+	return sv[0];
+}
+
+static void conn_close(int fd)
+{
+	close(fd);
+}
+
+static int conn_request(int fd, const void *data, size_t len, uint64_t *result)
+{
+	standin_hdr_t hdr;
+	struct iovec iov[2];
+
+	hdr.algorithm = algorithm;
+	hdr.data_size = len;
+	iov[0].iov_base = &hdr;
+	iov[0].iov_len = sizeof(hdr);
+	iov[1].iov_base = (void *)data;
+	iov[1].iov_len = len;
+	if (-1 == writev_full(fd, iov, 2))
+		return -1;
+	return read_full(fd, result, sizeof(*result));
+}
+
+#endif
+
+// "64:90,4096:9,65536-1048576:1", returns the largest size or 0 if it's bad
+static size_t parse_sizes(char *spec)
+{
+	char *tok, *end, *save;
+	size_class_t *sc;
+	size_t max_size = 0;
+
+	num_size_classes = 0;
+	total_weight = 0;
+	for (tok = strtok_r(spec, ",", &save); NULL != tok; tok = strtok_r(NULL, ",", &save))
+	{
+		if (MAX_SIZE_CLASSES == num_size_classes)
+			return 0;
+		sc = &size_classes[num_size_classes++];
+		sc->min = sc->max = strtoul(tok, &end, 0);
+		if ('-' == *end)
+			sc->max = strtoul(end + 1, &end, 0);
+		sc->weight = 1.0;
+		if (':' == *end)
+			sc->weight = strtod(end + 1, &end);
+		if ('\0' != *end || sc->max < sc->min || sc->weight <= 0 || sc->max > UINT32_MAX)
+			return 0;
+		total_weight += sc->weight;
+		if (sc->max > max_size)
+			max_size = sc->max;
+	}
+	return max_size;
+}
+
+static size_t pick_size(unsigned *seed)
+{
+	double r = rand_r(seed) / ((double)RAND_MAX + 1) * total_weight;
+	size_class_t *sc = size_classes;
+	unsigned i;
+
+	for (i = 0; i + 1 < num_size_classes && r >= sc->weight; i++, sc++)
+		r -= sc->weight;
+	return sc->min + (size_t)rand_r(seed) % (sc->max - sc->min + 1);
+}
+
+static void *worker(void *arg)
+{
+	worker_t *w = arg;
+	uint64_t due = start_ns, done, result, expected;
+	unsigned long n;
+	const char *data;
+	size_t len;
+
+	for (n = 0;; n++)
+	{
+		if (interval_ns > 0)
+		{
+			// offset the threads within an interval so they don't send in bursts
+			due = start_ns + (uint64_t)((n + w->phase) * interval_ns);
+			if (due >= end_ns)
+				break;
+			wait_until_ns(due);
+		}
+		else
+		{
+			due = now_ns();
+			if (due >= end_ns)
+				break;
+		}
+
+		len = pick_size(&w->seed);
+		data = payload + rand_r(&w->seed) % PAYLOAD_SPREAD;
+		if (-1 == conn_request(w->conns[n % nconns], data, len, &result))
+		{
+			w->errors++;
+			continue;
+		}
+		done = now_ns();
+		cksum_hist_record(w->hist, done - due);
+		w->requests++;
+
+		if (verify)
+		{
+			cksum_algo_run(algorithm, data, len, &expected);
+			if (result != expected)
+				w->mismatches++;
+		}
+	}
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	int nthreads = 1;
+	double rate = 0, seconds = 10;
+	char default_sizes[] = "256";
+	char *sizes = default_sizes;
+	const char *csv_file = NULL;
+	size_t max_size, i;
+	worker_t *workers;
+	cksum_hist_t *hist;
+	unsigned long requests = 0, errors = 0, mismatches = 0;
+	double elapsed;
+	FILE *fp;
+	int t, c;
+
+	while ((opt = getopt(argc, argv, "t:c:s:r:d:a:o:v")) != -1)
+	{
+		switch (opt)
+		{
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		case 'c':
+			nconns = atoi(optarg);
+			break;
+		case 's':
+			sizes = optarg;
+			break;
+		case 'r':
+			rate = atof(optarg);
+			break;
+		case 'd':
+			seconds = atof(optarg);
+			break;
+		case 'a':
+			for (algorithm = 0; algorithm < CKSUM_ALGO_COUNT; algorithm++)
+				if (0 == strcmp(optarg, cksum_algo_name(algorithm)))
+					break;
+			if (CKSUM_ALGO_COUNT == algorithm)
+			{
+				fprintf(stderr, "unknown algorithm %s\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'o':
+			csv_file = optarg;
+			break;
+		case 'v':
+			verify = 1;
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (nthreads < 1 || nconns < 1 || rate < 0 || seconds <= 0)
+	{
+		fprintf(stderr, "threads, connections and duration must be positive\n");
+		exit(EXIT_FAILURE);
+	}
+	printf("threads %d x connections %d, sizes %s, %s, %s, %.1f s\n", nthreads, nconns, sizes,
+			cksum_algo_name(algorithm), rate > 0 ? "open loop" : "closed loop", seconds);
+	max_size = parse_sizes(sizes);
+	if (0 == max_size)
+	{
+		fprintf(stderr, "bad size distribution\n");
+		exit(EXIT_FAILURE);
+	}
+	if (rate > 0)
+		interval_ns = 1e9 * nthreads / rate;
+
+	payload = malloc(max_size + PAYLOAD_SPREAD);
+	workers = calloc(nthreads, sizeof(*workers));
+	hist = cksum_hist_create();
+	if (NULL == payload || NULL == workers || NULL == hist)
+	{
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	srand(7);
+	for (i = 0; i < max_size + PAYLOAD_SPREAD; i++)
+		payload[i] = rand();
+
+	for (t = 0; t < nthreads; t++)
+	{
+		workers[t].seed = t + 1;
+		workers[t].phase = (double)t / nthreads;
+		workers[t].hist = cksum_hist_create();
+		workers[t].conns = malloc(nconns * sizeof(int));
+		if (NULL == workers[t].hist || NULL == workers[t].conns)
+		{
+			perror("malloc");
+			exit(EXIT_FAILURE);
+		}
+		for (c = 0; c < nconns; c++)
+		{
+			workers[t].conns[c] = conn_open();
+			if (-1 == workers[t].conns[c])
+			{
+				perror("connect");
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	start_ns = now_ns() + 10000000; // give every thread time to start
+	end_ns = start_ns + (uint64_t)(seconds * 1e9);
+	for (t = 0; t < nthreads; t++)
+		pthread_create(&workers[t].tid, NULL, worker, &workers[t]);
+	sleep_until_ns(start_ns);
+	for (t = 0; t < nthreads; t++)
+	{
+		pthread_join(workers[t].tid, NULL);
+		cksum_hist_merge(hist, workers[t].hist);
+		requests += workers[t].requests;
+		errors += workers[t].errors;
+		mismatches += workers[t].mismatches;
+		for (c = 0; c < nconns; c++)
+			conn_close(workers[t].conns[c]);
+	}
+	elapsed = (now_ns() - start_ns) / 1e9;
+
+	printf("requests %lu, %.1f/s", requests, requests / elapsed);
+	if (rate > 0)
+		printf(" (offered %.1f/s)", rate);
+	printf(", errors %lu", errors);
+	if (verify)
+		printf(", mismatches %lu", mismatches);
+	printf("\n");
+	printf("latency us: min %.1f, mean %.1f, p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+			cksum_hist_min(hist) / 1e3, cksum_hist_mean(hist) / 1e3,
+			cksum_hist_percentile(hist, 50) / 1e3, cksum_hist_percentile(hist, 90) / 1e3,
+			cksum_hist_percentile(hist, 99) / 1e3, cksum_hist_percentile(hist, 99.9) / 1e3,
+			cksum_hist_max(hist) / 1e3);
+
+	if (NULL != csv_file)
+	{
+		fp = fopen(csv_file, "w");
+		if (NULL == fp || -1 == cksum_hist_write_csv(hist, fp) || 0 != fclose(fp))
+		{
+			perror(csv_file);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	return (errors || mismatches) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
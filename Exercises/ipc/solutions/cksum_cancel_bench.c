@@ -0,0 +1,216 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_cancel_bench.c
+//
+// Long checksum requests from clients with tight timeouts, alongside patient
+// clients without one, against the checksum server (name_lookup_server -q
+// -t N, or -E N).  Each client thread sends the same large string over and
+// over, the impatient ones with a TimerTimeout() on every MsgSend(), pausing
+// a little after one times out.  A request that times out leaves its client
+// REPLY blocked until the server answers the unblock pulse; with
+// cancellation the server stops work on it at once, with -u it finishes it
+// first.
+//
+// Reports requests completed and timed out per second, the server's CPU
+// use, and how long a timed out client waited past its timeout.  Run it
+// against the server with and without -u: the CPU cancelling saves goes to
+// the patient clients.
+//
+// -c clients  client threads with a timeout (default 4)
+// -p clients  client threads without one (default 2)
+// -l length   string length (default 8 MB)
+// -T us       timeout on each request (default 200)
+// -i us       pause between a client's requests once it has timed out
+//             (default 2000)
+// -d seconds  how long to run (default 5)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/neutrino.h>
+#include <sys/iofunc.h>
+#include <sys/dispatch.h>
+
+#include "msg_def.h"
+#include "cksum.h"
+#include "cksum_str.h"
+
+typedef struct
+{
+	pthread_t tid;
+	int patient; // no timeout
+	uint64_t completed;
+	uint64_t timed_out;
+	uint64_t overrun_ns; // total time timed out requests waited past the timeout
+} client_t;
+
+static int coid;
+static char *payload;
+static size_t len = 8 * 1024 * 1024;
+static int expected;
+static uint64_t timeout_ns = 200000;
+static unsigned pause_us = 2000;
+static volatile int stop;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *client_thread(void *arg)
+{
+	client_t *c = arg;
+	uint64_t start;
+	int checksum;
+
+	while (!stop)
+	{
+		start = now_ns();
+		if (!c->patient)
+			TimerTimeout(CLOCK_MONOTONIC, _NTO_TIMEOUT_SEND | _NTO_TIMEOUT_REPLY, NULL,
+					&timeout_ns, NULL);
+		if (0 == cksum_str_send(coid, payload, len, &checksum))
+		{
+			if (checksum != expected)
+			{
+				fprintf(stderr, "wrong checksum\n");
+				exit(EXIT_FAILURE);
+			}
+			c->completed++;
+		}
+		else if (ETIMEDOUT == errno || EINTR == errno)
+		{
+			c->timed_out++;
+			c->overrun_ns += now_ns() - start - timeout_ns;
+			// a client that gives up comes back a little later
+			usleep(pause_us);
+		}
+		else
+		{
+			perror("MsgSend");
+			exit(EXIT_FAILURE);
+		}
+	}
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	struct _server_info info;
+	struct timespec cpu0, cpu1;
+	clockid_t server_clock;
+	client_t *clients;
+	unsigned impatient = 4;
+	unsigned patient = 2;
+	unsigned nclients;
+	unsigned seconds = 5;
+	uint64_t completed = 0, patient_completed = 0, timed_out = 0, overrun_ns = 0;
+	double elapsed, cpu;
+	uint64_t start;
+	unsigned i;
+	size_t j;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "c:p:l:T:i:d:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'c':
+			impatient = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			patient = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			len = strtoul(optarg, NULL, 0);
+			break;
+		case 'T':
+			timeout_ns = strtoull(optarg, NULL, 0) * 1000;
+			break;
+		case 'i':
+			pause_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	nclients = impatient + patient;
+	if (0 == nclients || 0 == len)
+	{
+		fprintf(stderr, "need clients and a length\n");
+		exit(EXIT_FAILURE);
+	}
+
+	payload = malloc(len);
+	clients = calloc(nclients, sizeof(*clients));
+	if (NULL == payload || NULL == clients)
+	{
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	for (j = 0; j < len; j++)
+		payload[j] = 'a' + j % 26;
+	expected = calculate_checksum_len(payload, len);
+
+	coid = name_open(SERVER_NAME, 0);
+	if (-1 == coid)
+	{
+		perror("name_open");
+		exit(EXIT_FAILURE);
+	}
+	if (-1 == ConnectServerInfo(0, coid, &info)
+			|| -1 == (server_clock = ClockId(info.pid, 0)))
+	{
+		perror("server cpu clock");
+		exit(EXIT_FAILURE);
+	}
+
+	start = now_ns();
+	clock_gettime(server_clock, &cpu0);
+	for (i = 0; i < nclients; i++)
+	{
+		clients[i].patient = i >= impatient;
+		if (EOK != pthread_create(&clients[i].tid, NULL, client_thread, &clients[i]))
+		{
+			fprintf(stderr, "can't create client threads\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	sleep(seconds);
+	stop = 1;
+	for (i = 0; i < nclients; i++)
+	{
+		pthread_join(clients[i].tid, NULL);
+		if (clients[i].patient)
+			patient_completed += clients[i].completed;
+		else
+			completed += clients[i].completed;
+		timed_out += clients[i].timed_out;
+		overrun_ns += clients[i].overrun_ns;
+	}
+	clock_gettime(server_clock, &cpu1);
+	elapsed = (now_ns() - start) / 1e9;
+	cpu = (cpu1.tv_sec - cpu0.tv_sec) + (cpu1.tv_nsec - cpu0.tv_nsec) / 1e9;
+
+	printf("%u clients with a %llu us timeout, %u without, %zu bytes\n", impatient,
+			(unsigned long long)(timeout_ns / 1000), patient, len);
+	printf("completed/s %.0f patient, %.0f in time, timed out/s %.0f\n",
+			patient_completed / elapsed, completed / elapsed, timed_out / elapsed);
+	completed += patient_completed;
+	printf("server cpu %.2f s/s, %.1f us per completed request\n", cpu / elapsed,
+			completed ? cpu * 1e6 / completed : 0.0);
+	if (timed_out)
+		printf("timed out clients waited %.1f us past the timeout on average\n",
+				overrun_ns / 1e3 / timed_out);
+	return EXIT_SUCCESS;
+}
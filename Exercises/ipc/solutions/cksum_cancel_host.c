@@ -0,0 +1,301 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_cancel_host.c
+//
+// Linux stand-in for cksum_cancel_bench: long checksum requests from client
+// threads with tight timeouts, alongside patient clients without one, with
+// the server either finishing the work for clients that timed out or
+// cancelling it.
+//
+// The host message passing stand-in has no timeouts or unblock pulses, so
+// each client thread here has a server thread of its own and hands it
+// requests through a mutex and condition variable.  The server side is the
+// real one: requests go in flight in cksum_inflight, and are checksummed with
+// cksum_algo_run_cancellable().  A client whose wait times out does what the
+// kernel does on QNX for a channel with _NTO_CHF_UNBLOCK, it stays blocked
+// and the "unblock pulse" calls cksum_inflight_cancel() at once.
+//
+// The server threads time each request on their thread CPU clock; what was
+// spent on requests whose client had given up is wasted.  What cancelling
+// saves shows up as less waste and, once the CPUs are busy, as more work
+// done for the patient clients.
+//
+// -c clients  client threads with a timeout (default 4)
+// -p clients  client threads without one (default 2)
+// -l length   string length (default 8 MB)
+// -T us       timeout on each request (default 200)
+// -i us       pause between a client's requests once it has timed out
+//             (default 2000)
+// -d seconds  how long to run each way (default 3)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "cksum.h"
+#include "cksum_inflight.h"
+
+typedef struct
+{
+	pthread_t client_tid;
+	pthread_t server_tid;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int posted; // a request is waiting for the server
+	int replied; // the server has answered it
+	int rcvid;
+	int status; // 0 or the errno the server replied with
+	uint64_t result;
+	uint64_t cpu_ns; // server thread CPU spent on the last request
+	cksum_inflight_t inflight;
+	int patient; // no timeout
+	uint64_t completed;
+	uint64_t wasted_ns;
+	uint64_t timed_out;
+	uint64_t overrun_ns;
+} conn_t;
+
+static char *payload;
+static size_t len = 8 * 1024 * 1024;
+static uint64_t expected;
+static uint64_t timeout_ns = 200000;
+static unsigned pause_us = 2000;
+static int cancelling;
+static volatile int stop;
+static int next_rcvid = 1;
+
+static uint64_t clock_ns(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t now_ns(void)
+{
+	return clock_ns(CLOCK_MONOTONIC);
+}
+
+// what name_lookup_server does with a long CKSUM_STR_MSG_TYPE request
+static void *server_thread(void *arg)
+{
+	conn_t *c = arg;
+	uint64_t result, cpu;
+	int status;
+
+	pthread_mutex_lock(&c->lock);
+	while (1)
+	{
+		while (!c->posted && !stop)
+			pthread_cond_wait(&c->cond, &c->lock);
+		if (!c->posted)
+			break;
+		c->posted = 0;
+		cksum_inflight_begin(&c->inflight, c->rcvid);
+		pthread_mutex_unlock(&c->lock);
+
+		status = 0;
+		cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+		if (-1 == cksum_algo_run_cancellable(CKSUM_ALGO_SUM, payload, len, &c->inflight.cancelled,
+				&result))
+			status = EINTR;
+		cksum_inflight_end(&c->inflight);
+		cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu;
+
+		pthread_mutex_lock(&c->lock);
+		c->cpu_ns = cpu;
+		c->status = status;
+		c->result = result;
+		c->replied = 1;
+		pthread_cond_broadcast(&c->cond);
+	}
+	pthread_mutex_unlock(&c->lock);
+	return NULL;
+}
+
+static void *client_thread(void *arg)
+{
+	conn_t *c = arg;
+	struct timespec deadline;
+	uint64_t start, due;
+
+	pthread_mutex_lock(&c->lock);
+	while (!stop)
+	{
+		start = now_ns();
+		due = start + timeout_ns;
+		deadline.tv_sec = due / 1000000000;
+		deadline.tv_nsec = due % 1000000000;
+
+		c->rcvid = __atomic_fetch_add(&next_rcvid, 1, __ATOMIC_RELAXED);
+		c->replied = 0;
+		c->posted = 1;
+		pthread_cond_broadcast(&c->cond);
+		while (c->patient && !c->replied)
+			pthread_cond_wait(&c->cond, &c->lock);
+		while (!c->replied)
+		{
+			if (ETIMEDOUT == pthread_cond_timedwait(&c->cond, &c->lock, &deadline))
+			{
+				// SEND blocked, not received yet: just leave
+				if (c->posted)
+				{
+					c->posted = 0;
+					break;
+				}
+				// REPLY blocked: the unblock pulse, then wait to be answered
+				if (cancelling)
+					(void)cksum_inflight_cancel(c->rcvid);
+				while (!c->replied)
+					pthread_cond_wait(&c->cond, &c->lock);
+				break;
+			}
+		}
+		if (!c->replied || (!c->patient && now_ns() > due))
+		{
+			c->timed_out++;
+			if (c->replied)
+			{
+				c->overrun_ns += now_ns() - due;
+				c->wasted_ns += c->cpu_ns;
+			}
+			// a client that gives up comes back a little later
+			pthread_mutex_unlock(&c->lock);
+			usleep(pause_us);
+			pthread_mutex_lock(&c->lock);
+		}
+		else if (0 == c->status && c->result == expected)
+		{
+			c->completed++;
+		}
+		else
+		{
+			fprintf(stderr, "request failed or was wrong\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	pthread_cond_broadcast(&c->cond);
+	pthread_mutex_unlock(&c->lock);
+	return NULL;
+}
+
+static void run(const char *mode, unsigned impatient, unsigned patient, unsigned seconds)
+{
+	conn_t *conns, *c;
+	pthread_condattr_t attr;
+	uint64_t completed = 0, patient_completed = 0, timed_out = 0, overrun_ns = 0;
+	uint64_t wasted_ns = 0;
+	double elapsed, start;
+	unsigned i, n = impatient + patient;
+
+	conns = calloc(n, sizeof(*conns));
+	if (NULL == conns)
+	{
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+	stop = 0;
+	start = now_ns() / 1e9;
+	// the clients' timeouts are on CLOCK_MONOTONIC
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	for (i = 0; i < n; i++)
+	{
+		c = &conns[i];
+		c->patient = i >= impatient;
+		pthread_mutex_init(&c->lock, NULL);
+		pthread_cond_init(&c->cond, &attr);
+		pthread_create(&c->server_tid, NULL, server_thread, c);
+		pthread_create(&c->client_tid, NULL, client_thread, c);
+	}
+	sleep(seconds);
+	stop = 1;
+	for (i = 0; i < n; i++)
+	{
+		c = &conns[i];
+		pthread_join(c->client_tid, NULL);
+		pthread_mutex_lock(&c->lock);
+		pthread_cond_broadcast(&c->cond);
+		pthread_mutex_unlock(&c->lock);
+		pthread_join(c->server_tid, NULL);
+		if (c->patient)
+			patient_completed += c->completed;
+		else
+			completed += c->completed;
+		timed_out += c->timed_out;
+		overrun_ns += c->overrun_ns;
+		wasted_ns += c->wasted_ns;
+	}
+	elapsed = now_ns() / 1e9 - start;
+
+	printf("%-8s %10.0f %10.0f %10.0f %12.3f %12.1f\n", mode, patient_completed / elapsed,
+			completed / elapsed, timed_out / elapsed, wasted_ns / 1e9 / elapsed,
+			timed_out ? overrun_ns / 1e3 / timed_out : 0.0);
+	free(conns);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned impatient = 4;
+	unsigned patient = 2;
+	unsigned seconds = 3;
+	size_t j;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "c:p:l:T:i:d:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'c':
+			impatient = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			patient = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			len = strtoul(optarg, NULL, 0);
+			break;
+		case 'T':
+			timeout_ns = strtoull(optarg, NULL, 0) * 1000;
+			break;
+		case 'i':
+			pause_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (0 == impatient + patient || 0 == len)
+	{
+		fprintf(stderr, "need clients and a length\n");
+		exit(EXIT_FAILURE);
+	}
+
+	payload = malloc(len);
+	if (NULL == payload)
+	{
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	for (j = 0; j < len; j++)
+		payload[j] = 'a' + j % 26;
+	cksum_algo_run(CKSUM_ALGO_SUM, payload, len, &expected);
+
+	printf("%u clients with a %llu us timeout, %u without, %zu bytes\n", impatient,
+			(unsigned long long)(timeout_ns / 1000), patient, len);
+	printf("%-8s %10s %10s %10s %12s %12s\n", "server", "patient/s", "in time/s", "late/s",
+			"wasted cpu", "overrun us");
+	cancelling = 0;
+	run("finish", impatient, patient, seconds);
+	cancelling = 1;
+	run("cancel", impatient, patient, seconds);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_edf.c
+//
+// Earliest deadline first request queue, see cksum_edf.h
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "cksum_edf.h"
+
+typedef struct
+{
+	uint64_t deadline_ns;
+	uint64_t seq; // breaks ties, first in first out
+	void *item;
+} edf_entry_t;
+
+struct cksum_edf
+{
+	pthread_mutex_t lock;
+	pthread_cond_t nonempty;
+	unsigned capacity;
+	unsigned count;
+	uint64_t next_seq;
+	int shutdown;
+	edf_entry_t *heap;
+};
+
+static int earlier(const edf_entry_t *a, const edf_entry_t *b)
+{
+	if (a->deadline_ns != b->deadline_ns)
+		return a->deadline_ns < b->deadline_ns;
+	return a->seq < b->seq;
+}
+
+cksum_edf_t *cksum_edf_create(unsigned capacity)
+{
+	cksum_edf_t *edf;
+
+	if (0 == capacity)
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+	edf = calloc(1, sizeof(*edf));
+	if (NULL == edf)
+		return NULL;
+	edf->heap = malloc(capacity * sizeof(*edf->heap));
+	if (NULL == edf->heap)
+	{
+		free(edf);
+		return NULL;
+	}
+	pthread_mutex_init(&edf->lock, NULL);
+	pthread_cond_init(&edf->nonempty, NULL);
+	edf->capacity = capacity;
+	return edf;
+}
+
+void cksum_edf_destroy(cksum_edf_t *edf)
+{
+	pthread_cond_destroy(&edf->nonempty);
+	pthread_mutex_destroy(&edf->lock);
+	free(edf->heap);
+	free(edf);
+}
+
+int cksum_edf_push(cksum_edf_t *edf, uint64_t deadline_ns, void *item)
+{
+	edf_entry_t entry;
+	unsigned i, parent;
+
+	pthread_mutex_lock(&edf->lock);
+	if (edf->count == edf->capacity)
+	{
+		pthread_mutex_unlock(&edf->lock);
+		errno = EAGAIN;
+		return -1;
+	}
+	entry.deadline_ns = deadline_ns;
+	entry.seq = edf->next_seq++;
+	entry.item = item;
+
+	// sift up from the new leaf
+	for (i = edf->count++; i > 0; i = parent)
+	{
+		parent = (i - 1) / 2;
+		if (!earlier(&entry, &edf->heap[parent]))
+			break;
+		edf->heap[i] = edf->heap[parent];
+	}
+	edf->heap[i] = entry;
+
+	pthread_cond_signal(&edf->nonempty);
+	pthread_mutex_unlock(&edf->lock);
+	return 0;
+}
+
+void *cksum_edf_pop(cksum_edf_t *edf, uint64_t *deadline_ns)
+{
+	edf_entry_t top, last;
+	unsigned i, child;
+
+	pthread_mutex_lock(&edf->lock);
+	while (0 == edf->count && !edf->shutdown)
+		pthread_cond_wait(&edf->nonempty, &edf->lock);
+	if (0 == edf->count)
+	{
+		pthread_mutex_unlock(&edf->lock);
+		return NULL;
+	}
+	top = edf->heap[0];
+
+	// sift the last leaf down from the root
+	last = edf->heap[--edf->count];
+	for (i = 0; (child = 2 * i + 1) < edf->count; i = child)
+	{
+		if (child + 1 < edf->count && earlier(&edf->heap[child + 1], &edf->heap[child]))
+			child++;
+		if (!earlier(&edf->heap[child], &last))
+			break;
+		edf->heap[i] = edf->heap[child];
+	}
+	edf->heap[i] = last;
+	pthread_mutex_unlock(&edf->lock);
+
+	if (NULL != deadline_ns)
+		*deadline_ns = top.deadline_ns;
+	return top.item;
+}
+
+void cksum_edf_shutdown(cksum_edf_t *edf)
+{
+	pthread_mutex_lock(&edf->lock);
+	edf->shutdown = 1;
+	pthread_cond_broadcast(&edf->nonempty);
+	pthread_mutex_unlock(&edf->lock);
+}
+
+unsigned cksum_edf_length(cksum_edf_t *edf)
+{
+	unsigned count;
+
+	pthread_mutex_lock(&edf->lock);
+	count = edf->count;
+	pthread_mutex_unlock(&edf->lock);
+	return count;
+}
@@ -0,0 +1,39 @@
+#ifndef _CKSUM_EDF_H_
+#define _CKSUM_EDF_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// cksum_edf.h
+//
+// Earliest deadline first queue between the thread receiving requests and
+// the worker threads serving them.
+//
+// The receiver pushes each request with its absolute deadline, workers block
+// in cksum_edf_pop() and always get the request due soonest (requests with
+// the same deadline come out in the order they went in).  It is a binary
+// heap, so pushing and popping are O(log n) under one lock.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+
+typedef struct cksum_edf cksum_edf_t;
+
+// a queue holding at most capacity requests, or NULL with errno set
+cksum_edf_t *cksum_edf_create(unsigned capacity);
+
+void cksum_edf_destroy(cksum_edf_t *edf);
+
+// queue item, due at deadline_ns (CLOCK_MONOTONIC).  Returns 0, or -1 with
+// errno EAGAIN if the queue is full.
+int cksum_edf_push(cksum_edf_t *edf, uint64_t deadline_ns, void *item);
+
+// take the item due soonest, waiting for one if the queue is empty.  Returns
+// NULL once cksum_edf_shutdown() has been called and the queue is empty.
+void *cksum_edf_pop(cksum_edf_t *edf, uint64_t *deadline_ns);
+
+// wake the waiting workers and make cksum_edf_pop() return NULL when empty
+void cksum_edf_shutdown(cksum_edf_t *edf);
+
+// requests queued right now
+unsigned cksum_edf_length(cksum_edf_t *edf);
+
+#endif //_CKSUM_EDF_H_
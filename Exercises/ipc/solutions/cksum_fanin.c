@@ -0,0 +1,423 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_fanin.c
+//
+// Batching proxy for the checksum service, see cksum_fanin.h
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/neutrino.h>
+#include <sys/dispatch.h>
+
+#include "msg_def.h"
+#include "name_cache.h"
+#include "cksum_str.h"
+#include "cksum_fanin.h"
+
+typedef struct batch
+{
+	struct batch *next;
+	unsigned count;
+	size_t data_size;
+	uint64_t first_ns; // when the first request was added
+	int rcvids[CKSUM_BATCH_MAX_COUNT]; // the clients, in order
+	uint32_t offsets[CKSUM_BATCH_MAX_COUNT];
+	int cksums[CKSUM_BATCH_MAX_COUNT];
+	char *data;
+} batch_t;
+
+typedef union
+{
+	uint16_t type;
+	struct _pulse pulse;
+	cksum_msg_t msg;
+	cksum_str_hdr_t str;
+} recv_buf_t;
+
+// a request that can't be batched, on its way to the server as it is
+typedef struct forward
+{
+	struct forward *next;
+	int rcvid;
+	struct _msg_info info;
+	recv_buf_t rbuf; // what of it came with the receive
+} forward_t;
+
+static cksum_fanin_config_t cfg;
+static const char *server;
+
+// full batches waiting for a sender, and empty ones for the receiver; and
+// the same for requests to forward
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ready_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t free_cond = PTHREAD_COND_INITIALIZER;
+static batch_t *ready_head, *ready_tail;
+static batch_t *free_list;
+static pthread_cond_t fwd_ready_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t fwd_free_cond = PTHREAD_COND_INITIALIZER;
+static forward_t *fwd_ready_head, *fwd_ready_tail;
+static forward_t *fwd_free_list;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void submit(batch_t *batch)
+{
+	pthread_mutex_lock(&lock);
+	batch->next = NULL;
+	if (NULL == ready_tail)
+		ready_head = batch;
+	else
+		ready_tail->next = batch;
+	ready_tail = batch;
+	pthread_cond_signal(&ready_cond);
+	pthread_mutex_unlock(&lock);
+}
+
+static batch_t *get_free(void)
+{
+	batch_t *batch;
+
+	pthread_mutex_lock(&lock);
+	while (NULL == free_list)
+		pthread_cond_wait(&free_cond, &lock);
+	batch = free_list;
+	free_list = batch->next;
+	pthread_mutex_unlock(&lock);
+	batch->count = 0;
+	batch->data_size = 0;
+	return batch;
+}
+
+static void put_free(batch_t *batch)
+{
+	pthread_mutex_lock(&lock);
+	batch->next = free_list;
+	free_list = batch;
+	pthread_cond_signal(&free_cond);
+	pthread_mutex_unlock(&lock);
+}
+
+static void *sender(void *arg)
+{
+	cksum_batch_hdr_t hdr;
+	iov_t siov[3];
+	batch_t *batch;
+	unsigned i;
+	int err;
+
+	hdr.msg_type = CKSUM_BATCH_MSG_TYPE;
+	while (1)
+	{
+		pthread_mutex_lock(&lock);
+		while (NULL == ready_head)
+			pthread_cond_wait(&ready_cond, &lock);
+		batch = ready_head;
+		ready_head = batch->next;
+		if (NULL == ready_head)
+			ready_tail = NULL;
+		pthread_mutex_unlock(&lock);
+
+		hdr.count = batch->count;
+		hdr.data_size = batch->data_size;
+		SETIOV(&siov[0], &hdr, sizeof(hdr));
+		SETIOV(&siov[1], batch->offsets, batch->count * sizeof(batch->offsets[0]));
+		SETIOV(&siov[2], batch->data, batch->data_size);
+		// sent again if the server restarts, checksums are safe to repeat
+		if (-1 == name_cache_sendvs(server, siov, 3, batch->cksums,
+				batch->count * sizeof(batch->cksums[0])))
+		{
+			// the clients get what the server said, they can retry
+			err = errno;
+			for (i = 0; i < batch->count; i++)
+				MsgError(batch->rcvids[i], err);
+		}
+		else
+		{
+			for (i = 0; i < batch->count; i++)
+				MsgReply(batch->rcvids[i], EOK, &batch->cksums[i], sizeof(batch->cksums[i]));
+		}
+		put_free(batch);
+	}
+	return NULL;
+}
+
+static void submit_forward(forward_t *fwd)
+{
+	pthread_mutex_lock(&lock);
+	fwd->next = NULL;
+	if (NULL == fwd_ready_tail)
+		fwd_ready_head = fwd;
+	else
+		fwd_ready_tail->next = fwd;
+	fwd_ready_tail = fwd;
+	pthread_cond_signal(&fwd_ready_cond);
+	pthread_mutex_unlock(&lock);
+}
+
+static forward_t *get_free_forward(void)
+{
+	forward_t *fwd;
+
+	pthread_mutex_lock(&lock);
+	while (NULL == fwd_free_list)
+		pthread_cond_wait(&fwd_free_cond, &lock);
+	fwd = fwd_free_list;
+	fwd_free_list = fwd->next;
+	pthread_mutex_unlock(&lock);
+	return fwd;
+}
+
+static void put_free_forward(forward_t *fwd)
+{
+	pthread_mutex_lock(&lock);
+	fwd->next = fwd_free_list;
+	fwd_free_list = fwd;
+	pthread_cond_signal(&fwd_free_cond);
+	pthread_mutex_unlock(&lock);
+}
+
+// send one request on to the server: what came with the receive, then the
+// rest of it read from the client, and relay the reply, as long as the
+// client's reply buffer
+static void forward(forward_t *fwd)
+{
+	size_t received, rest_len, reply_len;
+	char *rest = NULL, *reply = NULL;
+	iov_t siov[2];
+	long status;
+
+	received = fwd->info.msglen < sizeof(fwd->rbuf) ? fwd->info.msglen : sizeof(fwd->rbuf);
+	rest_len = fwd->info.srcmsglen > received ? fwd->info.srcmsglen - received : 0;
+	reply_len = fwd->info.dstmsglen;
+	if ((0 != rest_len && NULL == (rest = malloc(rest_len)))
+			|| (0 != reply_len && NULL == (reply = calloc(1, reply_len))))
+	{
+		MsgError(fwd->rcvid, ENOMEM);
+	}
+	else if (0 != rest_len && MsgRead(fwd->rcvid, rest, rest_len, received) != (long)rest_len)
+	{
+		MsgError(fwd->rcvid, EBADMSG);
+	}
+	else
+	{
+		SETIOV(&siov[0], &fwd->rbuf, received);
+		SETIOV(&siov[1], rest, rest_len);
+		status = name_cache_sendvs(server, siov, 2, reply, reply_len);
+		if (-1 == status)
+			MsgError(fwd->rcvid, errno);
+		else
+			MsgReply(fwd->rcvid, status, reply, reply_len);
+	}
+	free(rest);
+	free(reply);
+}
+
+static void *forwarder(void *arg)
+{
+	forward_t *fwd;
+
+	while (1)
+	{
+		pthread_mutex_lock(&lock);
+		while (NULL == fwd_ready_head)
+			pthread_cond_wait(&fwd_ready_cond, &lock);
+		fwd = fwd_ready_head;
+		fwd_ready_head = fwd->next;
+		if (NULL == fwd_ready_head)
+			fwd_ready_tail = NULL;
+		pthread_mutex_unlock(&lock);
+
+		forward(fwd);
+		put_free_forward(fwd);
+	}
+	return NULL;
+}
+
+// where the string of a request starts in rbuf, and how long it is.  -1 if
+// it can't be batched.
+static int request_string(const recv_buf_t *rbuf, size_t received, size_t *offset,
+		size_t *len)
+{
+	switch (rbuf->type)
+	{
+	case CKSUM_MSG_TYPE:
+		*offset = offsetof(cksum_msg_t, string_to_cksum);
+		*len = cksum_str_fixed_len(&rbuf->msg, received);
+		return 0;
+	case CKSUM_STR_MSG_TYPE:
+		if (received < sizeof(rbuf->str) || CKSUM_STR_VERSION != rbuf->str.version
+				|| 0 != rbuf->str.flags)
+			return -1;
+		*offset = sizeof(rbuf->str);
+		*len = rbuf->str.length;
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+// add the request to batch, reading whatever of its string didn't arrive
+// with it.  -1 if the request has been failed.
+static int add(batch_t *batch, int rcvid, const recv_buf_t *rbuf, size_t received,
+		size_t offset, size_t len)
+{
+	size_t have = received > offset ? received - offset : 0;
+	char *dst = batch->data + batch->data_size;
+
+	if (have > len)
+		have = len;
+	memcpy(dst, (const char *)rbuf + offset, have);
+	if (have < len && MsgRead(rcvid, dst + have, len - have, offset + have) != len - have)
+	{
+		MsgError(rcvid, EBADMSG);
+		return -1;
+	}
+	if (0 == batch->count)
+		batch->first_ns = now_ns();
+	batch->rcvids[batch->count] = rcvid;
+	batch->offsets[batch->count] = batch->data_size;
+	batch->count++;
+	batch->data_size += len;
+	return 0;
+}
+
+int cksum_fanin_run(int chid, const char *server_name, const cksum_fanin_config_t *config)
+{
+	struct _msg_info info;
+	struct sigevent event;
+	recv_buf_t rbuf;
+	batch_t *batch = NULL, *b;
+	forward_t *fwd;
+	pthread_t tid;
+	uint64_t deadline, left, now;
+	size_t offset, len, received;
+	unsigned i;
+	int rcvid;
+
+	cfg = *config;
+	server = server_name;
+	if (0 == cfg.senders)
+		cfg.senders = 1;
+	if (0 == cfg.max_count || cfg.max_count > CKSUM_BATCH_MAX_COUNT)
+		cfg.max_count = CKSUM_BATCH_MAX_COUNT;
+	if (0 == cfg.max_bytes || cfg.max_bytes > CKSUM_BATCH_MAX_DATA)
+		cfg.max_bytes = CKSUM_BATCH_MAX_DATA;
+
+	// one batch filling and one in flight on each sender, and one more
+	// so the receiver needn't wait for a sender to finish replying; one
+	// request being forwarded by each forwarder, and one waiting
+	for (i = 0; i < cfg.senders + 2; i++)
+	{
+		b = malloc(sizeof(*b));
+		if (NULL == b || NULL == (b->data = malloc(cfg.max_bytes)))
+			return -1;
+		b->next = free_list;
+		free_list = b;
+	}
+	for (i = 0; i < cfg.senders + 1; i++)
+	{
+		fwd = malloc(sizeof(*fwd));
+		if (NULL == fwd)
+			return -1;
+		fwd->next = fwd_free_list;
+		fwd_free_list = fwd;
+	}
+
+	if (-1 == name_cache_wait(server_name, NAME_CACHE_FOREVER))
+		return -1;
+	for (i = 0; i < cfg.senders; i++)
+	{
+		errno = pthread_create(&tid, NULL, sender, NULL);
+		if (EOK != errno)
+			return -1;
+		errno = pthread_create(&tid, NULL, forwarder, NULL);
+		if (EOK != errno)
+			return -1;
+	}
+
+	event.sigev_notify = SIGEV_UNBLOCK;
+	while (1)
+	{
+		if (NULL != batch)
+		{
+			// wait no longer than the oldest request's budget, and not at
+			// all once it has run out: then whatever is queued already is
+			// taken and the batch goes
+			deadline = batch->first_ns + cfg.max_delay_us * 1000ULL;
+			now = now_ns();
+			left = deadline > now ? deadline - now : 0;
+			TimerTimeout(CLOCK_MONOTONIC, _NTO_TIMEOUT_RECEIVE, &event, &left, NULL);
+		}
+		rcvid = MsgReceive(chid, &rbuf, sizeof(rbuf), &info);
+		if (-1 == rcvid)
+		{
+			if (ETIMEDOUT == errno && NULL != batch)
+			{
+				submit(batch);
+				batch = NULL;
+			}
+			else if (EINTR != errno)
+			{
+				perror("MsgReceive");
+				exit(EXIT_FAILURE);
+			}
+			continue;
+		}
+		if (0 == rcvid)
+		{
+			// a client's requests are all replied to before it can go
+			if (_PULSE_CODE_DISCONNECT == rbuf.pulse.code)
+				ConnectDetach(rbuf.pulse.scoid);
+			continue;
+		}
+		if (_IO_CONNECT == rbuf.type)
+		{
+			// name_open()
+			MsgReply(rcvid, EOK, NULL, 0);
+			continue;
+		}
+
+		received = info.msglen < sizeof(rbuf) ? info.msglen : sizeof(rbuf);
+		if (-1 == request_string(&rbuf, received, &offset, &len) || len > cfg.max_bytes)
+		{
+			fwd = get_free_forward();
+			fwd->rcvid = rcvid;
+			fwd->info = info;
+			memcpy(&fwd->rbuf, &rbuf, received);
+			submit_forward(fwd);
+			continue;
+		}
+		if (NULL != batch && batch->data_size + len > cfg.max_bytes)
+		{
+			submit(batch);
+			batch = NULL;
+		}
+		if (NULL == batch)
+			batch = get_free();
+		if (-1 == add(batch, rcvid, &rbuf, received, offset, len))
+		{
+			if (0 == batch->count)
+			{
+				put_free(batch);
+				batch = NULL;
+			}
+			continue;
+		}
+		if (batch->count == cfg.max_count || batch->data_size == cfg.max_bytes)
+		{
+			submit(batch);
+			batch = NULL;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef _CKSUM_FANIN_H_
+#define _CKSUM_FANIN_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// cksum_fanin.h
+//
+// Fan-in for the checksum service: many clients' string requests are taken
+// on one channel, packed into CKSUM_BATCH_MSG_TYPE messages (cksum_batch.h)
+// and sent to the server over a long-lived connection, and each client gets
+// its own checksum back from the batch reply.  The server then sees one
+// connection and one message per batch, rather than a connect,
+// a message and a disconnect for every short-lived client.
+//
+// One thread receives and packs; a batch goes out when it holds max_count
+// requests or max_bytes of strings, or when its oldest request has waited
+// max_delay_us and nothing more is queued.  A max_delay_us of 0 batches
+// only the requests that are waiting already, it never holds one back.
+// Batches go out from sender threads, one batch in flight on each, so
+// several can be in flight while the next fills.  When all of them are busy
+// the receiving stops until one comes back, which holds clients up rather
+// than queueing without limit.  The connection is the cached one
+// (name_cache.h): if the server restarts, the batch is sent again to the new
+// one.
+//
+// CKSUM_MSG_TYPE and CKSUM_STR_MSG_TYPE requests without a deadline or a
+// trace id are batched.  Anything else (other algorithms, files, regions,
+// async rings, deadline and traced strings, strings longer than max_bytes)
+// is forwarded to the server as it is, by as many forwarding threads as
+// there are senders, and the server's reply relayed back.  The server sees
+// those as the proxy's requests: a file is opened if the proxy may read it,
+// and a region or ring handle made out to the proxy's pid is refused.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+
+typedef struct
+{
+	unsigned senders; // batches in flight to the server at once, and forwarders
+	unsigned max_count; // requests per batch, up to CKSUM_BATCH_MAX_COUNT
+	size_t max_bytes; // string data per batch, up to CKSUM_BATCH_MAX_DATA
+	unsigned max_delay_us; // longest a request waits for its batch to fill
+} cksum_fanin_config_t;
+
+// serve clients on chid, batching to the server named server_name (waited
+// for if it isn't up yet).  Only returns, with -1 and errno set, if it
+// can't start.
+int cksum_fanin_run(int chid, const char *server_name, const cksum_fanin_config_t *config);
+
+#endif //_CKSUM_FANIN_H_
@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_inflight.c
+//
+// In flight request table for cancelling on unblock, see cksum_inflight.h
+//
+// Chained hash buckets, each with its own lock, so pool threads beginning
+// and ending requests rarely meet.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include "cksum_inflight.h"
+
+#define NUM_BUCKETS 64
+
+typedef struct
+{
+	pthread_mutex_t lock;
+	cksum_inflight_t *head;
+} bucket_t;
+
+static bucket_t buckets[NUM_BUCKETS];
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+
+static void init_buckets(void)
+{
+	int i;
+
+	for (i = 0; i < NUM_BUCKETS; i++)
+		pthread_mutex_init(&buckets[i].lock, NULL);
+}
+
+static bucket_t *bucket_of(int rcvid)
+{
+	pthread_once(&init_once, init_buckets);
+	return &buckets[((unsigned)rcvid * 2654435761u) >> 26];
+}
+
+void cksum_inflight_begin(cksum_inflight_t *req, int rcvid)
+{
+	bucket_t *b = bucket_of(rcvid);
+
+	req->rcvid = rcvid;
+	req->cancelled = 0;
+	pthread_mutex_lock(&b->lock);
+	req->next = b->head;
+	b->head = req;
+	pthread_mutex_unlock(&b->lock);
+}
+
+void cksum_inflight_end(cksum_inflight_t *req)
+{
+	bucket_t *b = bucket_of(req->rcvid);
+	cksum_inflight_t **pp;
+
+	pthread_mutex_lock(&b->lock);
+	for (pp = &b->head; NULL != *pp; pp = &(*pp)->next)
+	{
+		if (*pp == req)
+		{
+			*pp = req->next;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&b->lock);
+}
+
+int cksum_inflight_cancel(int rcvid)
+{
+	bucket_t *b = bucket_of(rcvid);
+	cksum_inflight_t *req;
+	int found = 0;
+
+	pthread_mutex_lock(&b->lock);
+	for (req = b->head; NULL != req; req = req->next)
+	{
+		// the newest of any with this rcvid, the others have been replied to
+		if (req->rcvid == rcvid)
+		{
+			__atomic_store_n(&req->cancelled, 1, __ATOMIC_RELAXED);
+			found = 1;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&b->lock);
+	return found;
+}
+
+int cksum_inflight_cancelled(const cksum_inflight_t *req)
+{
+	return __atomic_load_n(&req->cancelled, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,44 @@
+#ifndef _CKSUM_INFLIGHT_H_
+#define _CKSUM_INFLIGHT_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// cksum_inflight.h
+//
+// Requests the server has received and not yet replied to, by rcvid, so an
+// unblock pulse can cancel the work still being done for them.
+//
+// On a channel with _NTO_CHF_UNBLOCK (name_attach() makes one) a client hit
+// by a signal or timeout while REPLY blocked stays blocked and the server
+// gets a _PULSE_CODE_UNBLOCK pulse with the rcvid.  cksum_inflight_cancel()
+// sets that request's cancel flag; the thread working on it checks the flag
+// between chunks (cksum_algo_run_cancellable()) and, once it stops, answers
+// with MsgError(EINTR) itself, so a request is only ever replied to once.  A
+// pulse for an rcvid that isn't in flight is for a request already replied
+// to, and is ignored.
+//
+// A request must be added before the thread receiving it could have a
+// pulse for it handled by another thread; a pulse that gets ahead of that
+// finds nothing, and the request simply runs to the end.
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct cksum_inflight
+{
+	int rcvid;
+	int cancelled; // set by cksum_inflight_cancel(), read atomically
+	struct cksum_inflight *next;
+} cksum_inflight_t;
+
+// track req (the caller's storage, until cksum_inflight_end()) as rcvid
+void cksum_inflight_begin(cksum_inflight_t *req, int rcvid);
+
+// stop tracking req, after it has been replied to
+void cksum_inflight_end(cksum_inflight_t *req);
+
+// flag the request rcvid as cancelled.  Returns 1 if it was in flight, 0 if
+// not.
+int cksum_inflight_cancel(int rcvid);
+
+// non-zero once req has been cancelled
+int cksum_inflight_cancelled(const cksum_inflight_t *req);
+
+#endif //_CKSUM_INFLIGHT_H_
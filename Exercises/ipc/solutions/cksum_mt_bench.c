@@ -0,0 +1,214 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_mt_bench.c
+//
+// Throughput of the thread pool checksum server against many concurrent
+// clients.
+//
+// For 1, 2, 4, 8 and 16 worker threads (up to -n) it starts the server as
+// "name_lookup_server -q -t N -l N -h N", so all N threads are waiting from
+// the start, then runs the client threads against it for the given time,
+// checking every reply, and reports requests per second.
+//
+// -s path     server binary (default ./name_lookup_server)
+// -c clients  concurrent client threads, each with its own connection (default 32)
+// -d seconds  time to run each thread count (default 5)
+// -n threads  largest worker thread count (default 16)
+// -l length   length of the string sent (default 64)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/neutrino.h>
+#include <sys/iofunc.h>
+#include <sys/dispatch.h>
+
+#include "msg_def.h"
+#include "cksum.h"
+
+extern char **environ;
+
+typedef struct
+{
+	pthread_t tid;
+	int index;
+	unsigned long requests;
+	unsigned long errors;
+} client_t;
+
+volatile int running;
+size_t length = 64;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void *client_thread(void *arg)
+{
+	client_t *client = arg;
+	cksum_msg_t msg;
+	int coid;
+	int checksum, expected;
+	size_t i;
+
+	coid = name_open(SERVER_NAME, 0);
+	if (-1 == coid)
+	{
+		perror("name_open");
+		client->errors++;
+		return NULL;
+	}
+
+	msg.msg_type = CKSUM_MSG_TYPE;
+	for (i = 0; i < length; i++)
+		msg.string_to_cksum[i] = 'a' + (i + client->index) % 26;
+	msg.string_to_cksum[length] = '\0';
+	expected = calculate_checksum(msg.string_to_cksum);
+
+	while (running)
+	{
+		if (-1 == MsgSend(coid, &msg, sizeof(msg.msg_type) + length + 1, &checksum,
+				sizeof(checksum)) || checksum != expected)
+			client->errors++;
+		else
+			client->requests++;
+	}
+
+	name_close(coid);
+	return NULL;
+}
+
+// start the server with all nthreads threads waiting, and wait for its name
+pid_t start_server(const char *path, int nthreads)
+{
+	char arg[16];
+	char *argv[] = { (char *)path, "-q", "-t", arg, "-l", arg, "-h", arg, NULL };
+	pid_t pid;
+	int coid, status, tries;
+
+	snprintf(arg, sizeof(arg), "%d", nthreads);
+	status = posix_spawn(&pid, path, NULL, NULL, argv, environ);
+	if (0 != status)
+	{
+		fprintf(stderr, "posix_spawn %s: %s\n", path, strerror(status));
+		exit(EXIT_FAILURE);
+	}
+
+	for (tries = 0; tries < 500; tries++)
+	{
+		coid = name_open(SERVER_NAME, 0);
+		if (-1 != coid)
+		{
+			name_close(coid);
+			return pid;
+		}
+		usleep(10 * 1000);
+	}
+	fprintf(stderr, "server didn't attach %s\n", SERVER_NAME);
+	kill(pid, SIGTERM);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	const char *server = "./name_lookup_server";
+	int nclients = 32;
+	double seconds = 5;
+	int max_threads = 16;
+	int nthreads, i;
+	client_t *clients;
+	unsigned long requests, errors;
+	double start, elapsed, base = 0;
+	pid_t pid;
+	struct timespec run_time;
+
+	while ((opt = getopt(argc, argv, "s:c:d:n:l:")) != -1)
+	{
+		switch (opt)
+		{
+		case 's':
+			server = optarg;
+			break;
+		case 'c':
+			nclients = atoi(optarg);
+			break;
+		case 'd':
+			seconds = atof(optarg);
+			break;
+		case 'n':
+			max_threads = atoi(optarg);
+			break;
+		case 'l':
+			length = atoi(optarg);
+			if (length > MAX_STRING_LEN)
+				length = MAX_STRING_LEN;
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	clients = calloc(nclients, sizeof(*clients));
+	if (NULL == clients)
+	{
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+
+	printf("%d clients, %zu byte strings, %.1f s per run\n", nclients, length, seconds);
+	printf("%8s %14s %10s %8s\n", "threads", "requests/s", "speedup", "errors");
+
+	for (nthreads = 1; nthreads <= max_threads; nthreads *= 2)
+	{
+		pid = start_server(server, nthreads);
+
+		memset(clients, 0, nclients * sizeof(*clients));
+		running = 1;
+		start = now();
+		for (i = 0; i < nclients; i++)
+		{
+			clients[i].index = i;
+			if (0 != pthread_create(&clients[i].tid, NULL, client_thread, &clients[i]))
+			{
+				perror("pthread_create");
+				exit(EXIT_FAILURE);
+			}
+		}
+		run_time.tv_sec = (time_t)seconds;
+		run_time.tv_nsec = (seconds - run_time.tv_sec) * 1e9;
+		nanosleep(&run_time, NULL);
+		running = 0;
+
+		requests = errors = 0;
+		for (i = 0; i < nclients; i++)
+		{
+			pthread_join(clients[i].tid, NULL);
+			requests += clients[i].requests;
+			errors += clients[i].errors;
+		}
+		elapsed = now() - start;
+
+		kill(pid, SIGTERM);
+		waitpid(pid, NULL, 0);
+
+		if (0 == base)
+			base = requests / elapsed;
+		printf("%8d %14.0f %10.2f %8lu\n", nthreads, requests / elapsed,
+				requests / elapsed / base, errors);
+	}
+
+	free(clients);
+	return EXIT_SUCCESS;
+}
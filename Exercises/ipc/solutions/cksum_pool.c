@@ -0,0 +1,192 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_pool.c
+//
+// Least-outstanding-requests balancing over checksum server instances, see
+// cksum_pool.h
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "name_cache.h"
+#include "cksum_str.h"
+#include "cksum_pool.h"
+
+#define RETRY_MIN_NS 10000000ULL
+#define RETRY_MAX_NS 1000000000ULL
+
+typedef struct
+{
+	char name[64];
+	unsigned outstanding;
+	unsigned long sent;
+	int down; // gone, not to be used before retry_ns
+	uint64_t retry_ns;
+	uint64_t backoff_ns;
+} instance_t;
+
+struct cksum_pool
+{
+	pthread_mutex_t lock; // taking instances down and bringing them back
+	unsigned count;
+	cksum_pool_balance_t balance;
+	unsigned next; // where the next choice starts looking
+	instance_t instances[CKSUM_POOL_MAX];
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+cksum_pool_t *cksum_pool_create(const char *name, unsigned instances,
+		cksum_pool_balance_t balance)
+{
+	cksum_pool_t *pool;
+	unsigned i;
+
+	if (0 == instances || instances > CKSUM_POOL_MAX
+			|| strlen(name) + 4 > sizeof(pool->instances[0].name))
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+	pool = calloc(1, sizeof(*pool));
+	if (NULL == pool)
+		return NULL;
+	pthread_mutex_init(&pool->lock, NULL);
+	pool->count = instances;
+	pool->balance = balance;
+	for (i = 0; i < instances; i++)
+	{
+		snprintf(pool->instances[i].name, sizeof(pool->instances[i].name), "%s.%u", name, i);
+		pool->instances[i].backoff_ns = RETRY_MIN_NS;
+	}
+	return pool;
+}
+
+void cksum_pool_destroy(cksum_pool_t *pool)
+{
+	pthread_mutex_destroy(&pool->lock);
+	free(pool);
+}
+
+static void take_down(cksum_pool_t *pool, instance_t *inst)
+{
+	pthread_mutex_lock(&pool->lock);
+	if (!inst->down)
+	{
+		inst->down = 1;
+		inst->retry_ns = now_ns() + inst->backoff_ns;
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+// a dropped instance whose time has come: is it back?  1 if it can be used
+static int try_again(cksum_pool_t *pool, instance_t *inst)
+{
+	int up = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	if (!inst->down)
+		up = 1;
+	else if (now_ns() >= inst->retry_ns)
+	{
+		if (-1 != name_cache_open(inst->name))
+		{
+			inst->down = 0;
+			inst->backoff_ns = RETRY_MIN_NS;
+			up = 1;
+		}
+		else
+		{
+			if (inst->backoff_ns < RETRY_MAX_NS)
+				inst->backoff_ns *= 2;
+			inst->retry_ns = now_ns() + inst->backoff_ns;
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return up;
+}
+
+// the instance to send to, or NULL if none is up
+static instance_t *choose(cksum_pool_t *pool)
+{
+	instance_t *inst, *best = NULL;
+	unsigned start, i, outstanding, fewest = 0;
+
+	start = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+	for (i = 0; i < pool->count; i++)
+	{
+		inst = &pool->instances[(start + i) % pool->count];
+		if (__atomic_load_n(&inst->down, __ATOMIC_RELAXED) && !try_again(pool, inst))
+			continue;
+		if (CKSUM_POOL_ROUND_ROBIN == pool->balance)
+			return inst;
+		outstanding = __atomic_load_n(&inst->outstanding, __ATOMIC_RELAXED);
+		if (NULL == best || outstanding < fewest)
+		{
+			best = inst;
+			fewest = outstanding;
+			if (0 == fewest)
+				break;
+		}
+	}
+	return best;
+}
+
+int cksum_pool_checksum(cksum_pool_t *pool, const void *data, size_t len, int *checksum)
+{
+	name_cache_conn_t conn;
+	instance_t *inst;
+	int ret, err;
+
+	while (1)
+	{
+		inst = choose(pool);
+		if (NULL == inst)
+		{
+			errno = ESRCH;
+			return -1;
+		}
+		// held, so it can't be closed and its coid reused under us
+		if (-1 == name_cache_hold(inst->name, 0, &conn))
+		{
+			take_down(pool, inst);
+			continue;
+		}
+
+		__atomic_fetch_add(&inst->outstanding, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&inst->sent, 1, __ATOMIC_RELAXED);
+		ret = cksum_str_send(conn.coid, data, len, checksum);
+		err = errno;
+		__atomic_fetch_sub(&inst->outstanding, 1, __ATOMIC_RELAXED);
+		if (-1 != ret || (ESRCH != err && EBADF != err))
+		{
+			name_cache_release(inst->name, &conn, 0);
+			errno = err;
+			return ret;
+		}
+
+		// the instance has gone, send it to another
+		name_cache_release(inst->name, &conn, 1);
+		take_down(pool, inst);
+	}
+}
+
+unsigned long cksum_pool_sent(const cksum_pool_t *pool, unsigned i)
+{
+	return __atomic_load_n(&pool->instances[i].sent, __ATOMIC_RELAXED);
+}
+
+unsigned cksum_pool_outstanding(const cksum_pool_t *pool, unsigned i)
+{
+	return __atomic_load_n(&pool->instances[i].outstanding, __ATOMIC_RELAXED);
+}
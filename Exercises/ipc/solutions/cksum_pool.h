@@ -0,0 +1,53 @@
+#ifndef _CKSUM_POOL_H_
+#define _CKSUM_POOL_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// cksum_pool.h
+//
+// Client side of replicated checksum servers: instances run as
+// "name_lookup_server -i 0", "-i 1"..., attached as SERVER_NAME.0,
+// SERVER_NAME.1..., and the pool keeps a connection to each (name_cache.h).
+//
+// Each request goes to the instance with the fewest requests outstanding
+// from this process, ties going round in turn, so a slow or stalled instance
+// stops getting new work as soon as its requests start piling up, instead
+// of every Nth request waiting behind it.  CKSUM_POOL_ROUND_ROBIN just goes
+// round, for comparison.
+//
+// An instance that has gone (ESRCH or EBADF) is dropped and the request is
+// sent to another.  Dropped instances are tried again, backing off from 10 ms
+// to 1 s, and used again once their name is back.  Requests are only failed
+// with ESRCH when no instance is left.
+//
+// Thread safe; the least-outstanding choice only means something when
+// several threads send through one pool.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+
+#define CKSUM_POOL_MAX 8
+
+typedef enum
+{
+	CKSUM_POOL_LEAST_OUTSTANDING,
+	CKSUM_POOL_ROUND_ROBIN,
+} cksum_pool_balance_t;
+
+typedef struct cksum_pool cksum_pool_t;
+
+// a pool of the instances name.0 to name.(instances - 1), connected as they
+// are first used.  NULL with errno set (EINVAL for more than CKSUM_POOL_MAX).
+cksum_pool_t *cksum_pool_create(const char *name, unsigned instances,
+		cksum_pool_balance_t balance);
+
+void cksum_pool_destroy(cksum_pool_t *pool);
+
+// checksum len bytes of data on an instance, as cksum_str_send().  Returns 0
+// with the checksum in *checksum, or -1 with errno set.
+int cksum_pool_checksum(cksum_pool_t *pool, const void *data, size_t len, int *checksum);
+
+// requests sent to instance i, and how many of them are still outstanding
+unsigned long cksum_pool_sent(const cksum_pool_t *pool, unsigned i);
+unsigned cksum_pool_outstanding(const cksum_pool_t *pool, unsigned i);
+
+#endif //_CKSUM_POOL_H_
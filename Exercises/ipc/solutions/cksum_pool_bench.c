@@ -0,0 +1,355 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_pool_bench.c
+//
+// Replicated checksum servers behind cksum_pool.h.  First the throughput of
+// a multi-threaded client as instances are added, then, with all of them,
+// what happens when one instance stalls (SIGSTOP for a while, then SIGCONT)
+// and later when another dies (SIGKILL), balancing by fewest outstanding
+// requests and round robin.
+//
+// The instances are forked, each a single receive loop serving
+// CKSUM_STR_MSG_TYPE like name_lookup_server's.  Each run reports requests
+// per second, latency percentiles, and requests that failed; the stall
+// runs also report the share of requests sent to the stalled instance, and
+// the rate requests were completed at while it was stalled.
+//
+// Built for QNX as cksum_pool_bench, and for Linux ("make host") as
+// cksum_pool_bench_host against the message passing stand-in in ../host.
+//
+// -i count   most instances (default 4)
+// -t count   client threads (default 8)
+// -s ms      length of each run (default 2000)
+// -l bytes   string length (default 1024)
+// -S ms      how long the instance stalls (default 200)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <sys/neutrino.h>
+#include <sys/dispatch.h>
+
+#include "msg_def.h"
+#include "cksum.h"
+#include "cksum_hist.h"
+#include "cksum_str.h"
+#include "cksum_pool.h"
+#include "name_cache.h"
+
+#define BENCH_NAME "cksum_pool_bench"
+
+typedef union
+{
+	uint16_t type;
+	struct _pulse pulse;
+	cksum_str_hdr_t str;
+	char data[256];
+} recv_buf_t;
+
+typedef struct
+{
+	pthread_t tid;
+	cksum_hist_t *hist;
+	unsigned long failed;
+} worker_t;
+
+static cksum_pool_t *pool;
+static volatile int stop;
+static unsigned long completed;
+static char *string;
+static size_t string_len;
+static int expected;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void serve(const char *name)
+{
+	name_attach_t *att;
+	struct _msg_info info;
+	recv_buf_t rbuf;
+	const void *payload;
+	void *allocated;
+	int rcvid;
+	int checksum;
+
+	att = name_attach(NULL, name, 0);
+	if (NULL == att)
+	{
+		perror("name_attach");
+		exit(EXIT_FAILURE);
+	}
+	while (1)
+	{
+		rcvid = MsgReceive(att->chid, &rbuf, sizeof(rbuf), &info);
+		if (-1 == rcvid)
+		{
+			perror("MsgReceive");
+			exit(EXIT_FAILURE);
+		}
+		if (0 == rcvid)
+		{
+			if (_PULSE_CODE_DISCONNECT == rbuf.pulse.code)
+				ConnectDetach(rbuf.pulse.scoid);
+			continue;
+		}
+		if (_IO_CONNECT == rbuf.type)
+		{
+			MsgReply(rcvid, EOK, NULL, 0);
+			continue;
+		}
+		if (CKSUM_STR_MSG_TYPE != rbuf.type)
+		{
+			MsgError(rcvid, ENOSYS);
+			continue;
+		}
+		payload = cksum_str_payload(rcvid, &rbuf.str,
+				info.msglen < sizeof(rbuf) ? info.msglen : sizeof(rbuf), &allocated);
+		if (NULL == payload)
+		{
+			MsgError(rcvid, errno);
+			continue;
+		}
+		checksum = calculate_checksum_len(payload, rbuf.str.length);
+		free(allocated);
+		MsgReply(rcvid, EOK, &checksum, sizeof(checksum));
+	}
+}
+
+static void instance_name(unsigned i, char *name, size_t size)
+{
+	snprintf(name, size, "%s.%u", BENCH_NAME, i);
+}
+
+static pid_t start_instance(unsigned i)
+{
+	char name[64];
+	pid_t pid;
+
+	instance_name(i, name, sizeof(name));
+	fflush(stdout);
+	pid = fork();
+	if (-1 == pid)
+	{
+		perror("fork");
+		exit(EXIT_FAILURE);
+	}
+	if (0 == pid)
+		serve(name);
+	if (-1 == name_cache_wait(name, 5000000000ULL))
+	{
+		perror(name);
+		exit(EXIT_FAILURE);
+	}
+	return pid;
+}
+
+static void stop_instance(unsigned i, pid_t pid)
+{
+	char name[64];
+
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+	// the next run's instance is a new server under the same name
+	instance_name(i, name, sizeof(name));
+	name_cache_drop(name);
+}
+
+static void *worker(void *arg)
+{
+	worker_t *w = arg;
+	uint64_t t0, t1;
+	int checksum;
+
+	while (!stop)
+	{
+		t0 = now_ns();
+		if (-1 == cksum_pool_checksum(pool, string, string_len, &checksum)
+				|| expected != checksum)
+		{
+			w->failed++;
+			continue;
+		}
+		t1 = now_ns();
+		cksum_hist_record(w->hist, t1 - t0);
+		__atomic_fetch_add(&completed, 1, __ATOMIC_RELAXED);
+	}
+	return NULL;
+}
+
+static void sleep_ms(unsigned ms)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000L;
+	while (-1 == nanosleep(&ts, &ts) && EINTR == errno)
+		;
+}
+
+// one run of run_ms against instances, stalling and killing some if
+// stall_ms is set
+static void run(const char *label, unsigned instances, cksum_pool_balance_t balance,
+		unsigned threads, unsigned run_ms, unsigned stall_ms, worker_t *workers,
+		cksum_hist_t *total)
+{
+	pid_t pids[CKSUM_POOL_MAX];
+	unsigned long failed = 0, sent = 0, stalled = 0;
+	uint64_t start, elapsed;
+	unsigned i;
+
+	for (i = 0; i < instances; i++)
+		pids[i] = start_instance(i);
+	pool = cksum_pool_create(BENCH_NAME, instances, balance);
+	if (NULL == pool)
+	{
+		perror("cksum_pool_create");
+		exit(EXIT_FAILURE);
+	}
+
+	stop = 0;
+	start = now_ns();
+	for (i = 0; i < threads; i++)
+	{
+		cksum_hist_reset(workers[i].hist);
+		workers[i].failed = 0;
+		if (EOK != pthread_create(&workers[i].tid, NULL, worker, &workers[i]))
+		{
+			fprintf(stderr, "pthread_create failed\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (stall_ms)
+	{
+		// a quarter of the way in instance 0 stalls, three quarters of the
+		// way in instance 1 dies
+		sleep_ms(run_ms / 4);
+		kill(pids[0], SIGSTOP);
+		stalled = __atomic_load_n(&completed, __ATOMIC_RELAXED);
+		sleep_ms(stall_ms);
+		stalled = __atomic_load_n(&completed, __ATOMIC_RELAXED) - stalled;
+		kill(pids[0], SIGCONT);
+		sleep_ms(run_ms / 2 - stall_ms);
+		kill(pids[1], SIGKILL);
+		sleep_ms(run_ms / 4);
+	}
+	else
+		sleep_ms(run_ms);
+	stop = 1;
+	for (i = 0; i < threads; i++)
+		pthread_join(workers[i].tid, NULL);
+	elapsed = now_ns() - start;
+
+	cksum_hist_reset(total);
+	for (i = 0; i < threads; i++)
+	{
+		cksum_hist_merge(total, workers[i].hist);
+		failed += workers[i].failed;
+	}
+	for (i = 0; i < instances; i++)
+		sent += cksum_pool_sent(pool, i);
+	printf("%-12s %9u %10.0f %9.1f %9.1f %9.1f %9.1f %7lu", label, instances,
+			cksum_hist_count(total) * 1e9 / elapsed, cksum_hist_percentile(total, 50) / 1e3,
+			cksum_hist_percentile(total, 99) / 1e3, cksum_hist_percentile(total, 99.9) / 1e3,
+			cksum_hist_max(total) / 1e3, failed);
+	if (stall_ms)
+		printf(" %8.1f%% %10.0f", sent ? 100.0 * cksum_pool_sent(pool, 0) / sent : 0.0,
+				stalled * 1000.0 / stall_ms);
+	printf("\n");
+
+	cksum_pool_destroy(pool);
+	for (i = 0; i < instances; i++)
+		stop_instance(i, pids[i]);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned max_instances = 4;
+	unsigned threads = 8;
+	unsigned run_ms = 2000;
+	unsigned stall_ms = 200;
+	worker_t *workers;
+	cksum_hist_t *total;
+	unsigned i;
+	int opt;
+
+	string_len = 1024;
+	while ((opt = getopt(argc, argv, "i:t:s:l:S:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'i':
+			max_instances = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			threads = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			run_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			string_len = strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			stall_ms = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (max_instances < 2 || max_instances > CKSUM_POOL_MAX || 0 == threads
+			|| stall_ms * 2 > run_ms)
+	{
+		fprintf(stderr, "2 to %d instances, at least 1 thread, and stalls under half a run\n",
+				CKSUM_POOL_MAX);
+		exit(EXIT_FAILURE);
+	}
+
+	string = malloc(string_len);
+	workers = calloc(threads, sizeof(*workers));
+	total = cksum_hist_create();
+	if (NULL == string || NULL == workers || NULL == total)
+	{
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < string_len; i++)
+		string[i] = 'a' + i % 26;
+	expected = calculate_checksum_len(string, string_len);
+	for (i = 0; i < threads; i++)
+	{
+		workers[i].hist = cksum_hist_create();
+		if (NULL == workers[i].hist)
+		{
+			perror("cksum_hist_create");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	printf("%u client threads, %zu byte strings, %u ms runs, times in us\n", threads,
+			string_len, run_ms);
+	printf("%-12s %9s %10s %9s %9s %9s %9s %7s\n", "balance", "instances", "requests/s", "p50",
+			"p99", "p99.9", "max", "failed");
+	for (i = 1; i <= max_instances; i++)
+		run("least", i, CKSUM_POOL_LEAST_OUTSTANDING, threads, run_ms, 0, workers, total);
+
+	printf("\ninstance 0 stalled for %u ms, then instance 1 killed\n", stall_ms);
+	printf("%-12s %9s %10s %9s %9s %9s %9s %7s %9s %10s\n", "balance", "instances",
+			"requests/s", "p50", "p99", "p99.9", "max", "failed", "to 0", "stalled/s");
+	run("least", max_instances, CKSUM_POOL_LEAST_OUTSTANDING, threads, run_ms, stall_ms,
+			workers, total);
+	run("round-robin", max_instances, CKSUM_POOL_ROUND_ROBIN, threads, run_ms, stall_ms,
+			workers, total);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_proxy.c
+//
+// Fan-in proxy in front of the checksum server (see cksum_fanin.h), for
+// many short-lived clients each sending one request.  The proxy attaches the
+// server's public name, so clients are unchanged, and batches what they send
+// to the server, which runs under another name, forwarding what it can't:
+//
+//     name_lookup_server -q -n cksum_server_backend &
+//     cksum_proxy &
+//
+// -a name     name to attach for the clients (default SERVER_NAME)
+// -s name     the server's name (default SERVER_BACKEND_NAME)
+// -c count    batches in flight to the server at once (default 2)
+// -n count    most requests in a batch (default 64)
+// -B bytes    most string data in a batch (default 65536)
+// -d us       longest a request waits for its batch to fill (default 100)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/neutrino.h>
+#include <sys/dispatch.h>
+
+#include "msg_def.h"
+#include "cksum_fanin.h"
+
+int main(int argc, char *argv[])
+{
+	const char *name = SERVER_NAME;
+	const char *server_name = SERVER_BACKEND_NAME;
+	cksum_fanin_config_t config;
+	name_attach_t *att;
+	int opt;
+
+	config.senders = 2;
+	config.max_count = 64;
+	config.max_bytes = 65536;
+	config.max_delay_us = 100;
+
+	while ((opt = getopt(argc, argv, "a:s:c:n:B:d:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'a':
+			name = optarg;
+			break;
+		case 's':
+			server_name = optarg;
+			break;
+		case 'c':
+			config.senders = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			config.max_count = strtoul(optarg, NULL, 0);
+			break;
+		case 'B':
+			config.max_bytes = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			config.max_delay_us = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	att = name_attach(NULL, name, 0);
+	if (NULL == att)
+	{
+		perror("name_attach");
+		exit(EXIT_FAILURE);
+	}
+	printf("proxy %s -> %s: %u senders, batches of up to %u requests, %zu bytes, %u us\n",
+			name, server_name, config.senders, config.max_count, config.max_bytes,
+			config.max_delay_us);
+	fflush(stdout);
+
+	cksum_fanin_run(att->chid, server_name, &config);
+	perror("cksum_fanin_run");
+	exit(EXIT_FAILURE);
+}
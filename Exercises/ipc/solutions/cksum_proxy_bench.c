@@ -0,0 +1,330 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_proxy_bench.c
+//
+// Many short-lived clients against the checksum service, each a process of
+// its own that does name_open(), one CKSUM_STR_MSG_TYPE request and
+// name_close(), going straight to the server or through the fan-in proxy
+// (cksum_fanin.h, as cksum_proxy runs it).
+//
+// The server is a plain single receive loop like name_lookup_server's,
+// serving strings and batches, forked along with the proxy.  The parent
+// keeps up to -p clients running at once until -n have been.  Each mode
+// reports clients served per second, the time from a client's name_open()
+// to its reply, and what the server had to do per client: how many
+// messages and pulses it received, and its CPU time.
+//
+// Built for QNX as cksum_proxy_bench, and for Linux ("make host") as
+// cksum_proxy_bench_host against the message passing stand-in in ../host.
+//
+// -n count   clients per mode (default 5000)
+// -p count   clients running at once (default 64)
+// -c count   proxy batches in flight to the server at once (default 2)
+// -b count   most requests in a batch (default 64)
+// -d us      longest a request waits for its batch (default 100)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/neutrino.h>
+#include <sys/dispatch.h>
+
+#include "msg_def.h"
+#include "cksum.h"
+#include "cksum_hist.h"
+#include "cksum_str.h"
+#include "cksum_batch.h"
+#include "cksum_fanin.h"
+#include "name_cache.h"
+
+#define BENCH_NAME "cksum_proxy_bench"
+#define BENCH_BACKEND_NAME "cksum_proxy_bench_backend"
+#define BENCH_STATS_TYPE (_IO_MAX + 100)
+
+#define BENCH_STRING "the quick brown fox jumps over the lazy dog, 64 bytes of string!"
+
+typedef union
+{
+	uint16_t type;
+	struct _pulse pulse;
+	cksum_msg_t msg;
+	cksum_str_hdr_t str;
+	cksum_batch_hdr_t batch;
+} recv_buf_t;
+
+typedef struct
+{
+	uint64_t received; // messages and pulses, but not this one
+	uint64_t cpu_ns;
+} bench_stats_t;
+
+static uint64_t clock_ns(clockid_t id)
+{
+	struct timespec ts;
+
+	clock_gettime(id, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t now_ns(void)
+{
+	return clock_ns(CLOCK_MONOTONIC);
+}
+
+static void serve(const char *name)
+{
+	name_attach_t *att;
+	bench_stats_t stats = { 0 };
+	struct _msg_info info;
+	recv_buf_t rbuf;
+	const void *payload;
+	void *allocated;
+	int rcvid;
+	int checksum;
+
+	att = name_attach(NULL, name, 0);
+	if (NULL == att)
+	{
+		perror("name_attach");
+		exit(EXIT_FAILURE);
+	}
+	while (1)
+	{
+		rcvid = MsgReceive(att->chid, &rbuf, sizeof(rbuf), &info);
+		if (-1 == rcvid)
+		{
+			perror("MsgReceive");
+			exit(EXIT_FAILURE);
+		}
+		stats.received++;
+		if (0 == rcvid)
+		{
+			if (_PULSE_CODE_DISCONNECT == rbuf.pulse.code)
+				ConnectDetach(rbuf.pulse.scoid);
+			continue;
+		}
+		switch (rbuf.type)
+		{
+		case _IO_CONNECT:
+			MsgReply(rcvid, EOK, NULL, 0);
+			break;
+		case CKSUM_STR_MSG_TYPE:
+			payload = cksum_str_payload(rcvid, &rbuf.str,
+					info.msglen < sizeof(rbuf) ? info.msglen : sizeof(rbuf), &allocated);
+			if (NULL == payload)
+			{
+				MsgError(rcvid, errno);
+				break;
+			}
+			checksum = calculate_checksum_len(payload, rbuf.str.length);
+			free(allocated);
+			MsgReply(rcvid, EOK, &checksum, sizeof(checksum));
+			break;
+		case CKSUM_BATCH_MSG_TYPE:
+			cksum_batch_handle(rcvid, &rbuf.batch);
+			break;
+		case BENCH_STATS_TYPE:
+			stats.received--;
+			stats.cpu_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+			MsgReply(rcvid, EOK, &stats, sizeof(stats));
+			break;
+		default:
+			MsgError(rcvid, ENOSYS);
+			break;
+		}
+	}
+}
+
+static pid_t spawn(void)
+{
+	pid_t pid;
+
+	// flush before forking, or the child prints our buffered output again
+	fflush(stdout);
+	pid = fork();
+	if (-1 == pid)
+	{
+		perror("fork");
+		exit(EXIT_FAILURE);
+	}
+	return pid;
+}
+
+// a client's life: connect, one request, disconnect
+static void client(uint64_t *latency)
+{
+	int expected = calculate_checksum(BENCH_STRING);
+	uint64_t start;
+	int checksum;
+	int coid;
+
+	start = now_ns();
+	coid = name_open(BENCH_NAME, 0);
+	if (-1 == coid || -1 == cksum_str_send(coid, BENCH_STRING, strlen(BENCH_STRING), &checksum))
+		_exit(EXIT_FAILURE);
+	*latency = now_ns() - start;
+	name_close(coid);
+	_exit(expected == checksum ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+static void stats(const char *name, bench_stats_t *stats)
+{
+	uint16_t type = BENCH_STATS_TYPE;
+
+	if (-1 == MsgSend(name_cache_open(name), &type, sizeof(type), stats, sizeof(*stats)))
+	{
+		perror("MsgSend");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void run(int proxied, unsigned count, unsigned parallel,
+		const cksum_fanin_config_t *config, uint64_t *latencies, cksum_hist_t *hist)
+{
+	const char *server_name = proxied ? BENCH_BACKEND_NAME : BENCH_NAME;
+	bench_stats_t before, after;
+	pid_t server_pid, proxy_pid = -1, pid;
+	unsigned started = 0, running = 0, failed = 0;
+	uint64_t start, elapsed;
+	unsigned i;
+	int status;
+
+	server_pid = spawn();
+	if (0 == server_pid)
+		serve(server_name);
+	if (-1 == name_cache_wait(server_name, 5000000000ULL))
+	{
+		perror(server_name);
+		exit(EXIT_FAILURE);
+	}
+	if (proxied)
+	{
+		proxy_pid = spawn();
+		if (0 == proxy_pid)
+		{
+			name_attach_t *att = name_attach(NULL, BENCH_NAME, 0);
+
+			if (NULL == att)
+			{
+				perror("name_attach");
+				exit(EXIT_FAILURE);
+			}
+			cksum_fanin_run(att->chid, server_name, config);
+			perror("cksum_fanin_run");
+			exit(EXIT_FAILURE);
+		}
+		if (-1 == name_cache_wait(BENCH_NAME, 5000000000ULL))
+		{
+			perror(BENCH_NAME);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	stats(server_name, &before);
+	start = now_ns();
+	while (started < count || running > 0)
+	{
+		if (started < count && running < parallel)
+		{
+			pid = spawn();
+			if (0 == pid)
+				client(&latencies[started]);
+			started++;
+			running++;
+			continue;
+		}
+		if (-1 == wait(&status))
+			break;
+		running--;
+		if (!WIFEXITED(status) || EXIT_SUCCESS != WEXITSTATUS(status))
+			failed++;
+	}
+	elapsed = now_ns() - start;
+	stats(server_name, &after);
+
+	cksum_hist_reset(hist);
+	for (i = 0; i < count; i++)
+		cksum_hist_record(hist, latencies[i]);
+	printf("%-7s %10.0f %9.1f %9.1f %9.1f %11.2f %11.2f %7u\n", proxied ? "proxy" : "direct",
+			count * 1e9 / elapsed, cksum_hist_percentile(hist, 50) / 1e3,
+			cksum_hist_percentile(hist, 99) / 1e3, cksum_hist_max(hist) / 1e3,
+			(double)(after.received - before.received) / count,
+			(after.cpu_ns - before.cpu_ns) / 1e3 / count, failed);
+
+	if (proxied)
+	{
+		kill(proxy_pid, SIGKILL);
+		waitpid(proxy_pid, NULL, 0);
+		name_cache_drop(BENCH_NAME);
+	}
+	kill(server_pid, SIGKILL);
+	waitpid(server_pid, NULL, 0);
+	name_cache_drop(server_name);
+}
+
+int main(int argc, char *argv[])
+{
+	cksum_fanin_config_t config;
+	unsigned count = 5000;
+	unsigned parallel = 64;
+	uint64_t *latencies;
+	cksum_hist_t *hist;
+	int opt;
+
+	config.senders = 2;
+	config.max_count = 64;
+	config.max_bytes = 65536;
+	config.max_delay_us = 100;
+
+	while ((opt = getopt(argc, argv, "n:p:c:b:d:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			parallel = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			config.senders = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			config.max_count = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			config.max_delay_us = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (0 == count || 0 == parallel)
+	{
+		fprintf(stderr, "count and parallel must be positive\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// the clients write their times straight into this
+	latencies = mmap(NULL, count * sizeof(*latencies), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANON, -1, 0);
+	hist = cksum_hist_create();
+	if (MAP_FAILED == latencies || NULL == hist)
+	{
+		perror("setup");
+		exit(EXIT_FAILURE);
+	}
+
+	printf("%u clients, %u at once, one request each, times in us\n", count, parallel);
+	printf("%-7s %10s %9s %9s %9s %11s %11s %7s\n", "server", "clients/s", "p50", "p99", "max",
+			"server rx", "server cpu", "failed");
+	run(0, count, parallel, &config, latencies, hist);
+	run(1, count, parallel, &config, latencies, hist);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_str.c
+//
+// Client send and server receive helpers for the CKSUM_STR_MSG_TYPE
+// message, see cksum_str.h
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/neutrino.h>
+
+#include "cksum_str.h"
+
+int cksum_str_send(int coid, const void *data, size_t len, int *checksum)
+{
+	cksum_str_hdr_t hdr;
+	iov_t siov[2];
+
+	if (len > CKSUM_STR_MAX_LEN)
+	{
+		errno = EMSGSIZE;
+		return -1;
+	}
+	hdr.msg_type = CKSUM_STR_MSG_TYPE;
+	hdr.version = CKSUM_STR_VERSION;
+	hdr.flags = 0;
+	hdr.length = len;
+
+	SETIOV(&siov[0], &hdr, sizeof(hdr));
+	SETIOV(&siov[1], data, len);
+	if (-1 == MsgSendvs(coid, siov, 2, checksum, sizeof(*checksum)))
+		return -1;
+	return 0;
+}
+
+int cksum_str_send_deadline(int coid, const void *data, size_t len, uint32_t deadline_us,
+		int *checksum)
+{
+	cksum_str_hdr_t hdr;
+	iov_t siov[3];
+
+	if (len > CKSUM_STR_MAX_LEN)
+	{
+		errno = EMSGSIZE;
+		return -1;
+	}
+	hdr.msg_type = CKSUM_STR_MSG_TYPE;
+	hdr.version = CKSUM_STR_VERSION;
+	hdr.flags = CKSUM_STR_DEADLINE;
+	hdr.length = len;
+
+	SETIOV(&siov[0], &hdr, sizeof(hdr));
+	SETIOV(&siov[1], &deadline_us, sizeof(deadline_us));
+	SETIOV(&siov[2], data, len);
+	if (-1 == MsgSendvs(coid, siov, 3, checksum, sizeof(*checksum)))
+		return -1;
+	return 0;
+}
+
+int cksum_str_send_traced(int coid, const void *data, size_t len, uint64_t trace_id,
+		int *checksum)
+{
+	cksum_str_hdr_t hdr;
+	cksum_str_trace_t trace;
+	struct timespec ts;
+	iov_t siov[3];
+
+	if (len > CKSUM_STR_MAX_LEN)
+	{
+		errno = EMSGSIZE;
+		return -1;
+	}
+	hdr.msg_type = CKSUM_STR_MSG_TYPE;
+	hdr.version = CKSUM_STR_VERSION;
+	hdr.flags = CKSUM_STR_TRACE;
+	hdr.length = len;
+	trace.trace_id = trace_id;
+
+	SETIOV(&siov[0], &hdr, sizeof(hdr));
+	SETIOV(&siov[1], &trace, sizeof(trace));
+	SETIOV(&siov[2], data, len);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	trace.client_ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	if (-1 == MsgSendvs(coid, siov, 3, checksum, sizeof(*checksum)))
+		return -1;
+	return 0;
+}
+
+int cksum_str_deadline(const cksum_str_hdr_t *hdr, size_t received, uint32_t *deadline_us)
+{
+	if (!(hdr->flags & CKSUM_STR_DEADLINE) || received < sizeof(*hdr) + sizeof(*deadline_us))
+		return 0;
+	memcpy(deadline_us, hdr + 1, sizeof(*deadline_us));
+	return 1;
+}
+
+int cksum_str_trace(const cksum_str_hdr_t *hdr, size_t received, cksum_str_trace_t *trace)
+{
+	size_t offset = sizeof(*hdr);
+
+	if (!(hdr->flags & CKSUM_STR_TRACE))
+		return 0;
+	if (hdr->flags & CKSUM_STR_DEADLINE)
+		offset += sizeof(uint32_t);
+	if (received < offset + sizeof(*trace))
+		return 0;
+	// after a deadline it isn't 8 byte aligned
+	memcpy(trace, (const char *)hdr + offset, sizeof(*trace));
+	return 1;
+}
+
+const void *cksum_str_payload(int rcvid, const cksum_str_hdr_t *hdr, size_t received,
+		void **allocated)
+{
+	size_t offset = sizeof(*hdr);
+	char *data;
+
+	*allocated = NULL;
+	if (received < sizeof(*hdr))
+	{
+		errno = EBADMSG;
+		return NULL;
+	}
+	if (CKSUM_STR_VERSION != hdr->version)
+	{
+		errno = ENOTSUP;
+		return NULL;
+	}
+	if (0 != (hdr->flags & ~(CKSUM_STR_DEADLINE | CKSUM_STR_TRACE)))
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+	if (hdr->flags & CKSUM_STR_DEADLINE)
+		offset += sizeof(uint32_t);
+	if (hdr->flags & CKSUM_STR_TRACE)
+		offset += sizeof(cksum_str_trace_t);
+	if (received < offset)
+	{
+		errno = EBADMSG;
+		return NULL;
+	}
+	if (hdr->length > CKSUM_STR_MAX_LEN)
+	{
+		errno = EMSGSIZE;
+		return NULL;
+	}
+
+	// a short string came in with the header, the usual case
+	if (hdr->length <= received - offset)
+		return (const char *)hdr + offset;
+
+	// +1 so a 0 length string still gets a pointer that isn't NULL
+	data = malloc(hdr->length + 1);
+	if (NULL == data)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+	if (MsgRead(rcvid, data, hdr->length, offset) != (long)hdr->length)
+	{
+		free(data);
+		errno = EBADMSG;
+		return NULL;
+	}
+	*allocated = data;
+	return data;
+}
+
+size_t cksum_str_fixed_len(const cksum_msg_t *msg, size_t received)
+{
+	size_t max;
+
+	if (received <= sizeof(msg->msg_type))
+		return 0;
+	max = received - sizeof(msg->msg_type);
+	if (max > sizeof(msg->string_to_cksum))
+		max = sizeof(msg->string_to_cksum);
+	return strnlen(msg->string_to_cksum, max);
+}
@@ -0,0 +1,61 @@
+#ifndef _CKSUM_STR_H_
+#define _CKSUM_STR_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// cksum_str.h
+//
+// Both sides of the CKSUM_STR_MSG_TYPE message (see msg_def.h), and of the
+// fixed size CKSUM_MSG_TYPE message it replaces.
+//
+// Client side: cksum_str_send() sends the header and the string straight
+// from where they are, so only the string's own bytes go over.
+// cksum_str_send_deadline() adds a deadline for servers that schedule by it,
+// cksum_str_send_traced() a trace id and send time for servers recording
+// traces (cksum_trace.h).
+//
+// Server side: servers receive into a buffer big enough for the header (and
+// a short string after it).  cksum_str_payload() hands back the string,
+// where it was received if all of it was, otherwise read into memory it
+// allocates.  cksum_str_fixed_len() finds the string in a CKSUM_MSG_TYPE
+// message without trusting it to be nul terminated.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "msg_def.h"
+
+// checksum len bytes of data on the server at coid.  Returns 0 with the
+// checksum in *checksum, or -1 with errno set (EMSGSIZE if len is over
+// CKSUM_STR_MAX_LEN).
+int cksum_str_send(int coid, const void *data, size_t len, int *checksum);
+
+// the same, to be answered within deadline_us of the server receiving it
+int cksum_str_send_deadline(int coid, const void *data, size_t len, uint32_t deadline_us,
+		int *checksum);
+
+// the same, carrying trace_id and the time it was sent (CKSUM_STR_TRACE)
+int cksum_str_send_traced(int coid, const void *data, size_t len, uint64_t trace_id,
+		int *checksum);
+
+// server side: check the header received into hdr (received bytes of the
+// message were received) and find its string.  Returns the string, setting
+// *allocated to what the caller must free() when done (NULL if nothing was
+// allocated), or NULL with errno set to what to MsgError() the client with.
+const void *cksum_str_payload(int rcvid, const cksum_str_hdr_t *hdr, size_t received,
+		void **allocated);
+
+// server side: the deadline of a message with CKSUM_STR_DEADLINE set.
+// Returns 1 with it in *deadline_us, or 0 if the message has none (or is too
+// short to hold one, which cksum_str_payload() will refuse).
+int cksum_str_deadline(const cksum_str_hdr_t *hdr, size_t received, uint32_t *deadline_us);
+
+// server side: the trace id and client send time of a message with
+// CKSUM_STR_TRACE set.  Returns 1 with them in *trace, or 0 if it has none.
+int cksum_str_trace(const cksum_str_hdr_t *hdr, size_t received, cksum_str_trace_t *trace);
+
+// server side: length of the string in a CKSUM_MSG_TYPE message of which
+// received bytes were received
+size_t cksum_str_fixed_len(const cksum_msg_t *msg, size_t received);
+
+#endif //_CKSUM_STR_H_
@@ -0,0 +1,319 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_str_bench.c
+//
+// What the variable length CKSUM_STR_MSG_TYPE message saves over the fixed
+// size cksum_msg_t, for a mix of string lengths like a checksum service
+// sees: mostly short names and keys, some lines of text, a few strings too
+// long for cksum_msg_t.  The parent serves the way server.c does (receive
+// buffer for a header or an old message, anything longer read in), a forked
+// child sends the same strings three ways:
+//
+//   fixed    all of cksum_msg_t, as client.c sent it
+//   trimmed  cksum_msg_t up to the string's nul, as name_lookup_client sent it
+//   str      cksum_str_hdr_t and the string, cksum_str_send()
+//
+// Both old ways cut strings off at MAX_STRING_LEN, those are counted, so the
+// mix is run twice: once with only the strings that fit, where all three
+// ways do the same work, and once with all of them.  Bytes are what the
+// client sends per request, which the kernel copies into the server's
+// receive buffer or, past its end, on MsgRead().
+//
+// Built for QNX as cksum_str_bench, and for Linux ("make host") as
+// cksum_str_bench_host against the message passing stand-in in ../host.
+//
+// -n count   requests per way (default 200000)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <sys/neutrino.h>
+
+#include "msg_def.h"
+#include "cksum.h"
+#include "cksum_hist.h"
+#include "cksum_str.h"
+
+#define NUM_STRINGS 4096
+#define WARMUP 1000
+
+typedef union
+{
+	uint16_t type;
+	cksum_msg_t msg;
+	cksum_str_hdr_t str;
+	struct _pulse pulse;
+} recv_buf_t;
+
+typedef enum
+{
+	SEND_FIXED, SEND_TRIMMED, SEND_STR
+} send_way_t;
+
+static const char *way_names[] =
+{ "fixed", "trimmed", "str" };
+
+static char *strings[NUM_STRINGS];
+static size_t lengths[NUM_STRINGS];
+
+// the strings of each run, by index
+static unsigned fitting[NUM_STRINGS], all[NUM_STRINGS];
+static unsigned num_fitting;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// half are 4-32 bytes, 30% 33-128, 15% 129-256, 5% 257-4096
+static size_t pick_length(void)
+{
+	int r = rand() % 100;
+
+	if (r < 50)
+		return 4 + rand() % 29;
+	if (r < 80)
+		return 33 + rand() % 96;
+	if (r < 95)
+		return 129 + rand() % 128;
+	return 257 + rand() % 3840;
+}
+
+static void serve(int chid)
+{
+	static recv_buf_t rbuf;
+	struct _msg_info info;
+	const void *payload;
+	void *allocated;
+	size_t received;
+	int checksum;
+	int rcvid;
+
+	while (1)
+	{
+		rcvid = MsgReceive(chid, &rbuf, sizeof(rbuf), &info);
+		if (-1 == rcvid)
+		{
+			perror("MsgReceive");
+			exit(EXIT_FAILURE);
+		}
+		if (0 == rcvid)
+		{
+			if (_PULSE_CODE_DISCONNECT == rbuf.pulse.code)
+				return;
+			continue;
+		}
+		received = info.msglen < sizeof(rbuf) ? info.msglen : sizeof(rbuf);
+		if (CKSUM_MSG_TYPE == rbuf.type)
+		{
+			checksum = calculate_checksum_len(rbuf.msg.string_to_cksum,
+					cksum_str_fixed_len(&rbuf.msg, received));
+		}
+		else if (CKSUM_STR_MSG_TYPE == rbuf.type)
+		{
+			payload = cksum_str_payload(rcvid, &rbuf.str, received, &allocated);
+			if (NULL == payload)
+			{
+				if (-1 == MsgError(rcvid, errno))
+					perror("MsgError");
+				continue;
+			}
+			checksum = calculate_checksum_len(payload, rbuf.str.length);
+			free(allocated);
+		}
+		else
+		{
+			if (-1 == MsgError(rcvid, ENOSYS))
+				perror("MsgError");
+			continue;
+		}
+		if (-1 == MsgReply(rcvid, EOK, &checksum, sizeof(checksum)))
+			perror("MsgReply");
+	}
+}
+
+// send string i one way, returning the bytes sent and whether it was cut
+static size_t send_one(int coid, send_way_t way, unsigned i, cksum_msg_t *msg, int *truncated)
+{
+	size_t len = lengths[i];
+	size_t bytes;
+	int checksum;
+	long status;
+
+	*truncated = 0;
+	if (SEND_STR == way)
+	{
+		bytes = sizeof(cksum_str_hdr_t) + len;
+		status = cksum_str_send(coid, strings[i], len, &checksum);
+	}
+	else
+	{
+		if (len > MAX_STRING_LEN)
+		{
+			len = MAX_STRING_LEN;
+			*truncated = 1;
+		}
+		msg->msg_type = CKSUM_MSG_TYPE;
+		memcpy(msg->string_to_cksum, strings[i], len);
+		msg->string_to_cksum[len] = '\0';
+		bytes = SEND_FIXED == way ? sizeof(*msg) : sizeof(msg->msg_type) + len + 1;
+		status = MsgSend(coid, msg, bytes, &checksum, sizeof(checksum));
+	}
+	if (-1 == status)
+	{
+		perror("MsgSend");
+		exit(EXIT_FAILURE);
+	}
+	if (checksum != calculate_checksum_len(strings[i], len))
+	{
+		fprintf(stderr, "%s: wrong checksum for a %zu byte string\n", way_names[way], len);
+		exit(EXIT_FAILURE);
+	}
+	return bytes;
+}
+
+static void measure(int coid, send_way_t way, const unsigned *mix, unsigned mix_size,
+		unsigned count, cksum_hist_t *hist)
+{
+	cksum_msg_t msg;
+	uint64_t start, t0, t1;
+	uint64_t bytes = 0;
+	unsigned truncated = 0;
+	unsigned i;
+	int cut;
+
+	for (i = 0; i < WARMUP; i++)
+		send_one(coid, way, mix[i % mix_size], &msg, &cut);
+
+	cksum_hist_reset(hist);
+	start = t0 = now_ns();
+	for (i = 0; i < count; i++)
+	{
+		bytes += send_one(coid, way, mix[i % mix_size], &msg, &cut);
+		truncated += cut;
+		t1 = now_ns();
+		cksum_hist_record(hist, t1 - t0);
+		t0 = t1;
+	}
+	printf("%-8s %10.0f %10.1f %8.2f %8.2f %8.2f %10u\n", way_names[way],
+			count / ((t0 - start) / 1e9), (double)bytes / count, cksum_hist_percentile(hist, 50) / 1e3,
+			cksum_hist_percentile(hist, 99) / 1e3, (t0 - start) / 1e3 / count, truncated);
+}
+
+static void client(pid_t server_pid, int chid, unsigned count)
+{
+	cksum_hist_t *hist;
+	int coid;
+	send_way_t way;
+
+	coid = ConnectAttach(0, server_pid, chid, _NTO_SIDE_CHANNEL, 0);
+	if (-1 == coid)
+	{
+		perror("ConnectAttach");
+		exit(EXIT_FAILURE);
+	}
+	hist = cksum_hist_create();
+	if (NULL == hist)
+	{
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+
+	printf("%u requests per way, times in us\n", count);
+	printf("\nstrings of at most %d bytes\n", MAX_STRING_LEN);
+	printf("%-8s %10s %10s %8s %8s %8s %10s\n", "way", "requests/s", "bytes/req", "p50",
+			"p99", "mean", "truncated");
+	for (way = SEND_FIXED; way <= SEND_STR; way++)
+		measure(coid, way, fitting, num_fitting, count, hist);
+	printf("\nall strings\n");
+	for (way = SEND_FIXED; way <= SEND_STR; way++)
+		measure(coid, way, all, NUM_STRINGS, count, hist);
+
+	ConnectDetach(coid);
+	cksum_hist_destroy(hist);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned count = 200000;
+	uint64_t total = 0;
+	unsigned i;
+	size_t j;
+	int opt;
+	int chid;
+	int status;
+	pid_t pid;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (0 == count)
+	{
+		fprintf(stderr, "count must be positive\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// printable strings, the old message can't carry a nul
+	srand(11);
+	for (i = 0; i < NUM_STRINGS; i++)
+	{
+		lengths[i] = pick_length();
+		strings[i] = malloc(lengths[i]);
+		if (NULL == strings[i])
+		{
+			perror("malloc");
+			exit(EXIT_FAILURE);
+		}
+		for (j = 0; j < lengths[i]; j++)
+			strings[i][j] = 'a' + rand() % 26;
+		total += lengths[i];
+		all[i] = i;
+		if (lengths[i] <= MAX_STRING_LEN)
+			fitting[num_fitting++] = i;
+	}
+	printf("string lengths: mean %.1f bytes\n", (double)total / NUM_STRINGS);
+
+	chid = ChannelCreate(_NTO_CHF_DISCONNECT);
+	if (-1 == chid)
+	{
+		perror("ChannelCreate");
+		exit(EXIT_FAILURE);
+	}
+
+	// flush before forking, or the child prints our buffered output again
+	fflush(stdout);
+	pid = fork();
+	if (-1 == pid)
+	{
+		perror("fork");
+		exit(EXIT_FAILURE);
+	}
+	if (0 == pid)
+	{
+		client(getppid(), chid, count);
+		exit(EXIT_SUCCESS);
+	}
+
+	serve(chid);
+	if (-1 == waitpid(pid, &status, 0) || !WIFEXITED(status) || EXIT_SUCCESS != WEXITSTATUS(status))
+	{
+		fprintf(stderr, "client failed\n");
+		exit(EXIT_FAILURE);
+	}
+	return EXIT_SUCCESS;
+}
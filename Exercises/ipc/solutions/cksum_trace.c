@@ -0,0 +1,224 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_trace.c
+//
+// Per-thread rings of request trace records, see cksum_trace.h
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "cksum_trace.h"
+
+typedef struct ring
+{
+	unsigned thread;
+	int orphaned; // its thread has exited, the next new thread takes it over
+	uint64_t head; // records ever added, written only by the owning thread
+	struct ring *next;
+	cksum_trace_rec_t recs[CKSUM_TRACE_RING_SIZE];
+} ring_t;
+
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ring_key;
+// every ring there has been: they outlive their threads, to be written out,
+// and are handed on to new threads rather than freed
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static ring_t *rings;
+static unsigned nrings;
+static uint32_t next_id;
+// what cksum_trace_start_writer() was given, for its thread
+static const char *writer_path;
+static const char *writer_who;
+static sigset_t writer_sigs;
+
+// a recording thread exited: its records stay to be written out, but the
+// ring goes to the next thread that needs one
+static void ring_orphan(void *ring)
+{
+	pthread_mutex_lock(&rings_lock);
+	((ring_t *)ring)->orphaned = 1;
+	pthread_mutex_unlock(&rings_lock);
+}
+
+static void key_create(void)
+{
+	(void)pthread_key_create(&ring_key, ring_orphan);
+}
+
+// an exited thread's ring to carry on in, or NULL if there isn't one
+static ring_t *adopt_ring(void)
+{
+	ring_t *ring;
+
+	pthread_mutex_lock(&rings_lock);
+	for (ring = rings; NULL != ring; ring = ring->next)
+	{
+		if (ring->orphaned)
+		{
+			ring->orphaned = 0;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&rings_lock);
+	return ring;
+}
+
+// this thread's ring, taken over or allocated on first use
+static ring_t *get_ring(void)
+{
+	ring_t *ring;
+	int adopted = 0;
+
+	pthread_once(&key_once, key_create);
+	ring = pthread_getspecific(ring_key);
+	if (NULL != ring)
+		return ring;
+
+	ring = adopt_ring();
+	if (NULL != ring)
+		adopted = 1;
+	else
+	{
+		ring = malloc(sizeof(*ring));
+		if (NULL == ring)
+		{
+			errno = ENOMEM;
+			return NULL;
+		}
+	}
+	if (0 != pthread_setspecific(ring_key, ring))
+	{
+		if (adopted)
+			ring_orphan(ring);
+		else
+			free(ring);
+		errno = ENOMEM;
+		return NULL;
+	}
+	if (!adopted)
+	{
+		ring->head = 0;
+		ring->orphaned = 0;
+		pthread_mutex_lock(&rings_lock);
+		ring->thread = nrings++;
+		ring->next = rings;
+		rings = ring;
+		pthread_mutex_unlock(&rings_lock);
+	}
+	return ring;
+}
+
+uint64_t cksum_trace_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+uint64_t cksum_trace_next_id(void)
+{
+	return (uint64_t)getpid() << 32 | __atomic_add_fetch(&next_id, 1, __ATOMIC_RELAXED);
+}
+
+int cksum_trace_record(const cksum_trace_rec_t *rec)
+{
+	ring_t *ring = get_ring();
+
+	if (NULL == ring)
+		return -1;
+	ring->recs[ring->head % CKSUM_TRACE_RING_SIZE] = *rec;
+	// the record is in before cksum_trace_write_csv() can see it counted
+	__atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+long cksum_trace_write_csv(FILE *fp)
+{
+	const cksum_trace_rec_t *rec;
+	ring_t *ring;
+	uint64_t head, i;
+	long written = 0;
+
+	if (fprintf(fp, "%s\n", CKSUM_TRACE_SERVER_CSV) < 0)
+		return -1;
+	pthread_mutex_lock(&rings_lock);
+	for (ring = rings; NULL != ring; ring = ring->next)
+	{
+		head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		i = head > CKSUM_TRACE_RING_SIZE ? head - CKSUM_TRACE_RING_SIZE : 0;
+		for (; i < head; i++)
+		{
+			rec = &ring->recs[i % CKSUM_TRACE_RING_SIZE];
+			if (fprintf(fp, "%llu,%u,%u,%llu,%llu,%llu,%llu,%llu\n",
+					(unsigned long long)rec->trace_id, ring->thread, rec->length,
+					(unsigned long long)rec->client_ns, (unsigned long long)rec->receive_ns,
+					(unsigned long long)rec->dequeue_ns, (unsigned long long)rec->compute_ns,
+					(unsigned long long)rec->reply_ns) < 0)
+			{
+				pthread_mutex_unlock(&rings_lock);
+				return -1;
+			}
+			written++;
+		}
+	}
+	pthread_mutex_unlock(&rings_lock);
+	return written;
+}
+
+// waits for SIGUSR1, blocked in every other thread, and writes out the
+// traces recorded so far each time it comes
+static void *trace_writer(void *arg)
+{
+	FILE *fp;
+	long written;
+	int signo;
+
+	while (1)
+	{
+		if (0 != sigwait(&writer_sigs, &signo))
+			continue;
+		fp = fopen(writer_path, "w");
+		if (NULL == fp)
+		{
+			perror(writer_path);
+			continue;
+		}
+		written = cksum_trace_write_csv(fp);
+		if (EOF == fclose(fp) || -1 == written)
+			perror(writer_path);
+		else
+			printf("%s: wrote %ld trace records to %s\n", writer_who, written, writer_path);
+	}
+	return NULL;
+}
+
+int cksum_trace_start_writer(const char *path, const char *who)
+{
+	pthread_attr_t attr;
+	pthread_t tid;
+	int ret;
+
+	writer_path = path;
+	writer_who = who;
+	sigemptyset(&writer_sigs);
+	sigaddset(&writer_sigs, SIGUSR1);
+	ret = pthread_sigmask(SIG_BLOCK, &writer_sigs, NULL);
+	if (0 == ret)
+	{
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		ret = pthread_create(&tid, &attr, trace_writer, NULL);
+		pthread_attr_destroy(&attr);
+	}
+	if (0 != ret)
+	{
+		errno = ret;
+		return -1;
+	}
+	return 0;
+}
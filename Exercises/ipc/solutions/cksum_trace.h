@@ -0,0 +1,73 @@
+#ifndef _CKSUM_TRACE_H_
+#define _CKSUM_TRACE_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// cksum_trace.h
+//
+// Server side of request tracing.  A client sends its requests with a trace
+// id (cksum_str_send_traced()); the server stamps the times it handled each
+// one and keeps them here, in a ring per thread, so recording takes no lock
+// and never allocates once a thread has its ring.  A full ring overwrites
+// its oldest records.  When a thread exits its ring, records and all, is
+// handed on to the next thread to record, so a server that starts and ends
+// threads keeps as many rings as it ever had threads at once.
+//
+// cksum_trace_write_csv() writes every ring out, for cksum_trace_join to
+// put together with the client's own records.  It can run while threads are
+// still recording; a record being overwritten as it is written out may come
+// out torn, so write traces out once the load has stopped when that matters.
+// cksum_trace_start_writer() does it each time the server gets SIGUSR1.
+//
+// All times are CLOCK_MONOTONIC nanoseconds, comparable between processes on
+// the same machine.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdio.h>
+
+// records kept per thread
+#define CKSUM_TRACE_RING_SIZE 8192
+
+typedef struct
+{
+	uint64_t trace_id;
+	uint64_t client_ns; // the client sent it
+	uint64_t receive_ns; // MsgReceive() returned it
+	uint64_t dequeue_ns; // a thread started serving it (later if it was queued)
+	uint64_t compute_ns; // its data was in, the checksum started
+	uint64_t reply_ns; // the checksum was done, the reply about to go
+	uint32_t length; // bytes checksummed
+} cksum_trace_rec_t;
+
+// the header line cksum_trace_write_csv() starts with
+#define CKSUM_TRACE_SERVER_CSV \
+	"trace_id,thread,length,client_ns,receive_ns,dequeue_ns,compute_ns,reply_ns"
+
+// the header line of the client's records: when each request was sent (as
+// in the message) and when its reply came back
+#define CKSUM_TRACE_CLIENT_CSV "trace_id,send_ns,done_ns"
+
+uint64_t cksum_trace_now(void);
+
+// a trace id no other request from this process has had, and that requests
+// from other processes won't have either
+uint64_t cksum_trace_next_id(void);
+
+// add rec to the calling thread's ring.  Returns 0, or -1 with errno ENOMEM
+// if the thread has no ring yet and one can't be allocated.
+int cksum_trace_record(const cksum_trace_rec_t *rec);
+
+// write the records in every ring as CSV, oldest first per ring, the thread
+// column numbering rings in the order they were allocated (one ring's records
+// can come from threads that had it one after another).  Returns how many
+// records were written, or -1 on a write error.
+long cksum_trace_write_csv(FILE *fp);
+
+// block SIGUSR1 in the calling thread and start a thread that waits for it
+// and writes the records out to path (cksum_trace_write_csv()) each time it
+// comes, reporting how many it wrote on stdout prefixed with who.  Call it
+// before creating any other thread, so they all inherit the mask, and once
+// per process.  Returns 0, or -1 with errno set if the thread can't start.
+int cksum_trace_start_writer(const char *path, const char *who);
+
+#endif //_CKSUM_TRACE_H_
@@ -0,0 +1,490 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_trace_bench.c
+//
+// What request tracing (cksum_trace.h) costs.  Round trips of
+// CKSUM_STR_MSG_TYPE requests against a forked single receive loop serving
+// them like name_lookup_server's, in three modes, run in turn a few times
+// over to even out drift:
+//
+//   off        the server isn't tracing, plain requests
+//   idle       the server is tracing (-T), the requests carry no trace id
+//   traced     every request carries a trace id and is recorded on both sides
+//
+// Each reports requests per second and latency percentiles, with the
+// difference from off.  Then it times cksum_trace_record() and the clock
+// reads that go with it, on their own.
+//
+// With -w the client's and server's records of the last traced run are
+// written to prefix.client.csv and prefix.server.csv, to try out
+// cksum_trace_join on.
+//
+// Built for QNX as cksum_trace_bench, and for Linux ("make host") as
+// cksum_trace_bench_host against the message passing stand-in in ../host.
+//
+// -t count   client threads (default 1)
+// -s ms      length of each run (default 1000)
+// -r count   runs of each mode (default 3)
+// -l bytes   string length (default 64)
+// -w prefix  write the last traced run's records to prefix.*.csv
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <sys/neutrino.h>
+#include <sys/dispatch.h>
+
+#include "msg_def.h"
+#include "cksum.h"
+#include "cksum_hist.h"
+#include "cksum_str.h"
+#include "cksum_trace.h"
+#include "name_cache.h"
+
+#define BENCH_NAME "cksum_trace_bench"
+#define BENCH_WRITE_TYPE (_IO_MAX + 100)
+
+// client records kept per thread for -w, the latest as the server keeps them
+#define CLIENT_RECS CKSUM_TRACE_RING_SIZE
+
+typedef enum
+{
+	MODE_OFF, MODE_IDLE, MODE_TRACED, NUM_MODES
+} bench_mode_t;
+
+static const char *mode_names[NUM_MODES] = { "off", "idle", "traced" };
+
+typedef union
+{
+	uint16_t type;
+	struct _pulse pulse;
+	cksum_str_hdr_t str;
+	char data[256];
+} recv_buf_t;
+
+typedef struct
+{
+	uint64_t trace_id;
+	uint64_t send_ns;
+	uint64_t done_ns;
+} client_rec_t;
+
+typedef struct
+{
+	pthread_t tid;
+	cksum_hist_t *hist;
+	client_rec_t *recs;
+	unsigned long nrecs; // ever recorded, the last CLIENT_RECS are in recs
+	unsigned long failed;
+} worker_t;
+
+static volatile int stop;
+static bench_mode_t mode;
+static char *string;
+static size_t string_len;
+static int expected;
+static const char *prefix;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// one string request, served as name_lookup_server serves it
+static void serve_str(int rcvid, recv_buf_t *rbuf, size_t received, int tracing)
+{
+	cksum_trace_rec_t rec, *trace = NULL;
+	cksum_str_trace_t ids;
+	const void *payload;
+	void *allocated;
+	int checksum;
+
+	if (tracing && (rbuf->str.flags & CKSUM_STR_TRACE))
+	{
+		rec.receive_ns = rec.dequeue_ns = now_ns();
+		if (cksum_str_trace(&rbuf->str, received, &ids))
+			trace = &rec;
+	}
+	payload = cksum_str_payload(rcvid, &rbuf->str, received, &allocated);
+	if (NULL == payload)
+	{
+		MsgError(rcvid, errno);
+		return;
+	}
+	if (NULL != trace)
+		trace->compute_ns = now_ns();
+	checksum = calculate_checksum_len(payload, rbuf->str.length);
+	free(allocated);
+	if (NULL != trace)
+		trace->reply_ns = now_ns();
+	MsgReply(rcvid, EOK, &checksum, sizeof(checksum));
+	if (NULL != trace)
+	{
+		trace->trace_id = ids.trace_id;
+		trace->client_ns = ids.client_ns;
+		trace->length = rbuf->str.length;
+		(void)cksum_trace_record(trace);
+	}
+}
+
+// write the server's records to prefix.server.csv
+static int write_server_csv(void)
+{
+	char path[256];
+	FILE *fp;
+	long written;
+
+	snprintf(path, sizeof(path), "%s.server.csv", prefix);
+	fp = fopen(path, "w");
+	if (NULL == fp)
+		return -1;
+	written = cksum_trace_write_csv(fp);
+	if (EOF == fclose(fp) || -1 == written)
+		return -1;
+	return 0;
+}
+
+static void serve(int tracing)
+{
+	name_attach_t *att;
+	struct _msg_info info;
+	recv_buf_t rbuf;
+	int rcvid;
+
+	att = name_attach(NULL, BENCH_NAME, 0);
+	if (NULL == att)
+	{
+		perror("name_attach");
+		exit(EXIT_FAILURE);
+	}
+	while (1)
+	{
+		rcvid = MsgReceive(att->chid, &rbuf, sizeof(rbuf), &info);
+		if (-1 == rcvid)
+		{
+			perror("MsgReceive");
+			exit(EXIT_FAILURE);
+		}
+		if (0 == rcvid)
+		{
+			if (_PULSE_CODE_DISCONNECT == rbuf.pulse.code)
+				ConnectDetach(rbuf.pulse.scoid);
+			continue;
+		}
+		switch (rbuf.type)
+		{
+		case _IO_CONNECT:
+			MsgReply(rcvid, EOK, NULL, 0);
+			break;
+		case CKSUM_STR_MSG_TYPE:
+			serve_str(rcvid, &rbuf, info.msglen < sizeof(rbuf) ? info.msglen : sizeof(rbuf),
+					tracing);
+			break;
+		case BENCH_WRITE_TYPE:
+			if (-1 == write_server_csv())
+				MsgError(rcvid, errno);
+			else
+				MsgReply(rcvid, EOK, NULL, 0);
+			break;
+		default:
+			MsgError(rcvid, ENOSYS);
+			break;
+		}
+	}
+}
+
+static void *worker(void *arg)
+{
+	worker_t *w = arg;
+	client_rec_t *rec;
+	uint64_t t0, t1, trace_id = 0;
+	int coid;
+	int checksum;
+	int ret;
+
+	coid = name_cache_open(BENCH_NAME);
+	while (!stop)
+	{
+		t0 = now_ns();
+		if (MODE_TRACED == mode)
+		{
+			trace_id = cksum_trace_next_id();
+			ret = cksum_str_send_traced(coid, string, string_len, trace_id, &checksum);
+		}
+		else
+			ret = cksum_str_send(coid, string, string_len, &checksum);
+		t1 = now_ns();
+		if (-1 == ret || expected != checksum)
+		{
+			w->failed++;
+			continue;
+		}
+		cksum_hist_record(w->hist, t1 - t0);
+		if (MODE_TRACED == mode)
+		{
+			rec = &w->recs[w->nrecs++ % CLIENT_RECS];
+			rec->trace_id = trace_id;
+			rec->send_ns = t0;
+			rec->done_ns = t1;
+		}
+	}
+	return NULL;
+}
+
+static void sleep_ms(unsigned ms)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000L;
+	while (-1 == nanosleep(&ts, &ts) && EINTR == errno)
+		;
+}
+
+static void write_traces(worker_t *workers, unsigned threads)
+{
+	uint16_t type = BENCH_WRITE_TYPE;
+	const client_rec_t *rec;
+	char path[256];
+	FILE *fp;
+	unsigned long j;
+	unsigned i;
+
+	if (-1 == MsgSend(name_cache_open(BENCH_NAME), &type, sizeof(type), NULL, 0))
+	{
+		perror("writing the server's traces");
+		exit(EXIT_FAILURE);
+	}
+	snprintf(path, sizeof(path), "%s.client.csv", prefix);
+	fp = fopen(path, "w");
+	if (NULL == fp)
+	{
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+	fprintf(fp, "%s\n", CKSUM_TRACE_CLIENT_CSV);
+	for (i = 0; i < threads; i++)
+	{
+		j = workers[i].nrecs > CLIENT_RECS ? workers[i].nrecs - CLIENT_RECS : 0;
+		for (; j < workers[i].nrecs; j++)
+		{
+			rec = &workers[i].recs[j % CLIENT_RECS];
+			fprintf(fp, "%llu,%llu,%llu\n", (unsigned long long)rec->trace_id,
+					(unsigned long long)rec->send_ns, (unsigned long long)rec->done_ns);
+		}
+	}
+	if (EOF == fclose(fp))
+	{
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+}
+
+// one run of run_ms in mode m, adding its latencies to total.  Returns the
+// requests completed, with its length in *elapsed.
+static uint64_t run(bench_mode_t m, unsigned threads, unsigned run_ms, int write,
+		worker_t *workers, cksum_hist_t *total, uint64_t *elapsed, unsigned long *failed)
+{
+	uint64_t start, count;
+	pid_t pid;
+	unsigned i;
+
+	fflush(stdout);
+	pid = fork();
+	if (-1 == pid)
+	{
+		perror("fork");
+		exit(EXIT_FAILURE);
+	}
+	if (0 == pid)
+		serve(MODE_OFF != m);
+	if (-1 == name_cache_wait(BENCH_NAME, 5000000000ULL))
+	{
+		perror(BENCH_NAME);
+		exit(EXIT_FAILURE);
+	}
+
+	mode = m;
+	stop = 0;
+	start = now_ns();
+	for (i = 0; i < threads; i++)
+	{
+		cksum_hist_reset(workers[i].hist);
+		workers[i].nrecs = 0;
+		workers[i].failed = 0;
+		if (EOK != pthread_create(&workers[i].tid, NULL, worker, &workers[i]))
+		{
+			fprintf(stderr, "pthread_create failed\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	sleep_ms(run_ms);
+	stop = 1;
+	for (i = 0; i < threads; i++)
+		pthread_join(workers[i].tid, NULL);
+	*elapsed = now_ns() - start;
+
+	count = 0;
+	for (i = 0; i < threads; i++)
+	{
+		count += cksum_hist_count(workers[i].hist);
+		cksum_hist_merge(total, workers[i].hist);
+		*failed += workers[i].failed;
+	}
+	if (write)
+		write_traces(workers, threads);
+
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+	name_cache_drop(BENCH_NAME);
+	return count;
+}
+
+// what recording one request costs the server, without the messaging
+static void time_record(void)
+{
+	cksum_trace_rec_t rec;
+	uint64_t start, elapsed;
+	unsigned i, n = 1000000;
+
+	memset(&rec, 0, sizeof(rec));
+	start = now_ns();
+	for (i = 0; i < n; i++)
+	{
+		rec.trace_id = i;
+		rec.receive_ns = rec.dequeue_ns = now_ns();
+		rec.compute_ns = now_ns();
+		rec.reply_ns = now_ns();
+		(void)cksum_trace_record(&rec);
+	}
+	elapsed = now_ns() - start;
+	printf("recording a request: %.1f ns (3 clock reads and cksum_trace_record())\n",
+			(double)elapsed / n);
+	start = now_ns();
+	for (i = 0; i < n; i++)
+		(void)cksum_trace_record(&rec);
+	elapsed = now_ns() - start;
+	printf("cksum_trace_record() alone: %.1f ns\n", (double)elapsed / n);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned threads = 1;
+	unsigned run_ms = 1000;
+	unsigned rounds = 3;
+	worker_t *workers;
+	cksum_hist_t *totals[NUM_MODES];
+	uint64_t counts[NUM_MODES] = { 0 }, times[NUM_MODES] = { 0 };
+	unsigned long failed[NUM_MODES] = { 0 };
+	uint64_t elapsed;
+	double rate, base_rate = 0, base_p50 = 0;
+	unsigned i, r;
+	int opt;
+
+	string_len = 64;
+	while ((opt = getopt(argc, argv, "t:s:r:l:w:")) != -1)
+	{
+		switch (opt)
+		{
+		case 't':
+			threads = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			run_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			rounds = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			string_len = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			prefix = optarg;
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (0 == threads || 0 == rounds)
+	{
+		fprintf(stderr, "at least 1 thread and 1 run\n");
+		exit(EXIT_FAILURE);
+	}
+
+	string = malloc(string_len);
+	workers = calloc(threads, sizeof(*workers));
+	if (NULL == string || NULL == workers)
+	{
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < string_len; i++)
+		string[i] = 'a' + i % 26;
+	expected = calculate_checksum_len(string, string_len);
+	for (i = 0; i < threads; i++)
+	{
+		workers[i].hist = cksum_hist_create();
+		workers[i].recs = malloc(CLIENT_RECS * sizeof(*workers[i].recs));
+		if (NULL == workers[i].hist || NULL == workers[i].recs)
+		{
+			perror("malloc");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (i = 0; i < NUM_MODES; i++)
+	{
+		totals[i] = cksum_hist_create();
+		if (NULL == totals[i])
+		{
+			perror("cksum_hist_create");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (r = 0; r < rounds; r++)
+	{
+		for (i = 0; i < NUM_MODES; i++)
+		{
+			counts[i] += run(i, threads, run_ms, NULL != prefix && MODE_TRACED == i
+					&& r == rounds - 1, workers, totals[i], &elapsed, &failed[i]);
+			times[i] += elapsed;
+		}
+	}
+
+	printf("%u client threads, %zu byte strings, %u runs of %u ms each, times in us\n",
+			threads, string_len, rounds, run_ms);
+	printf("%-8s %10s %8s %9s %9s %9s %9s %9s %7s\n", "tracing", "requests/s", "change",
+			"p50", "change", "p99", "p99.9", "max", "failed");
+	for (i = 0; i < NUM_MODES; i++)
+	{
+		rate = counts[i] * 1e9 / times[i];
+		if (MODE_OFF == i)
+		{
+			base_rate = rate;
+			base_p50 = cksum_hist_percentile(totals[i], 50);
+		}
+		printf("%-8s %10.0f %+7.1f%% %9.2f %+8.0fns %9.2f %9.2f %9.1f %7lu\n", mode_names[i],
+				rate, 100 * (rate - base_rate) / base_rate,
+				cksum_hist_percentile(totals[i], 50) / 1e3,
+				cksum_hist_percentile(totals[i], 50) - base_p50,
+				cksum_hist_percentile(totals[i], 99) / 1e3,
+				cksum_hist_percentile(totals[i], 99.9) / 1e3, cksum_hist_max(totals[i]) / 1e3,
+				failed[i]);
+	}
+	// after the runs, or the forked servers would have these records too
+	printf("\n");
+	time_record();
+	if (NULL != prefix)
+		printf("records of the last traced run in %s.client.csv and %s.server.csv\n", prefix,
+				prefix);
+	return EXIT_SUCCESS;
+}
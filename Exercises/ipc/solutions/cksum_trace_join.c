@@ -0,0 +1,267 @@
+////////////////////////////////////////////////////////////////////////////////
+// cksum_trace_join.c
+//
+// Puts a client's trace records together with the server's (cksum_trace.h)
+// by trace id, and breaks each request's time down into where it went:
+//
+//   send     client sent it, to the server's MsgReceive() returning it
+//   queue    received, to a thread starting to serve it (server -E), or
+//            for hw_server, to it getting the hardware lock
+//   read     served, to its data being in (MsgRead() for long strings)
+//   compute  the checksum
+//   reply    server replying, to the client having the reply
+//
+// and total, from sending to having the reply.  Prints percentiles of each,
+// and with -o writes every request's breakdown as CSV.
+//
+//     cksum_trace_join [-o breakdown.csv] client.csv server.csv...
+//
+// The client file is CKSUM_TRACE_CLIENT_CSV records, the server files what
+// name_lookup_server -T (or system_profiling's hw_server -T) writes on
+// SIGUSR1.  Requests found on only one side
+// (the server's ring wrapped, or the client didn't finish) are counted and
+// left out.
+//
+// -o file    write the per request breakdown to file
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cksum_hist.h"
+#include "cksum_trace.h"
+
+typedef struct
+{
+	unsigned long long trace_id;
+	unsigned long long send_ns;
+	unsigned long long done_ns;
+} client_rec_t;
+
+typedef struct
+{
+	unsigned long long trace_id;
+	unsigned thread;
+	unsigned length;
+	unsigned long long client_ns;
+	unsigned long long receive_ns;
+	unsigned long long dequeue_ns;
+	unsigned long long compute_ns;
+	unsigned long long reply_ns;
+} server_rec_t;
+
+enum
+{
+	PHASE_SEND, PHASE_QUEUE, PHASE_READ, PHASE_COMPUTE, PHASE_REPLY, PHASE_TOTAL, NUM_PHASES
+};
+
+static const char *phase_names[NUM_PHASES] =
+{ "send", "queue", "read", "compute", "reply", "total" };
+
+// grow *array of *count elements of size bytes by one, returning the new one
+static void *append(void **array, size_t *count, size_t *allocated, size_t size)
+{
+	void *grown;
+
+	if (*count == *allocated)
+	{
+		*allocated = *allocated ? *allocated * 2 : 1024;
+		grown = realloc(*array, *allocated * size);
+		if (NULL == grown)
+		{
+			perror("realloc");
+			exit(EXIT_FAILURE);
+		}
+		*array = grown;
+	}
+	return (char *)*array + (*count)++ * size;
+}
+
+static FILE *open_csv(const char *path, const char *header)
+{
+	char line[256];
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (NULL == fp)
+	{
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+	if (NULL == fgets(line, sizeof(line), fp) || 0 != strncmp(line, header, strlen(header)))
+	{
+		fprintf(stderr, "%s: doesn't start with %s\n", path, header);
+		exit(EXIT_FAILURE);
+	}
+	return fp;
+}
+
+static void read_client(const char *path, client_rec_t **recs, size_t *count)
+{
+	size_t allocated = 0;
+	client_rec_t rec;
+	char line[256];
+	FILE *fp;
+
+	fp = open_csv(path, CKSUM_TRACE_CLIENT_CSV);
+	while (NULL != fgets(line, sizeof(line), fp))
+	{
+		if (3 != sscanf(line, "%llu,%llu,%llu", &rec.trace_id, &rec.send_ns, &rec.done_ns))
+			continue;
+		*(client_rec_t *)append((void **)recs, count, &allocated, sizeof(rec)) = rec;
+	}
+	fclose(fp);
+}
+
+static void read_server(const char *path, server_rec_t **recs, size_t *count,
+		size_t *allocated)
+{
+	server_rec_t rec;
+	char line[256];
+	FILE *fp;
+
+	fp = open_csv(path, CKSUM_TRACE_SERVER_CSV);
+	while (NULL != fgets(line, sizeof(line), fp))
+	{
+		if (8 != sscanf(line, "%llu,%u,%u,%llu,%llu,%llu,%llu,%llu", &rec.trace_id, &rec.thread,
+				&rec.length, &rec.client_ns, &rec.receive_ns, &rec.dequeue_ns, &rec.compute_ns,
+				&rec.reply_ns))
+			continue;
+		*(server_rec_t *)append((void **)recs, count, allocated, sizeof(rec)) = rec;
+	}
+	fclose(fp);
+}
+
+static int by_client_id(const void *a, const void *b)
+{
+	const client_rec_t *x = a, *y = b;
+
+	return x->trace_id < y->trace_id ? -1 : x->trace_id > y->trace_id;
+}
+
+static int by_server_id(const void *a, const void *b)
+{
+	const server_rec_t *x = a, *y = b;
+
+	return x->trace_id < y->trace_id ? -1 : x->trace_id > y->trace_id;
+}
+
+// b - a, or 0 if the clocks say it went backwards
+static unsigned long long span(unsigned long long a, unsigned long long b)
+{
+	return b > a ? b - a : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *breakdown_path = NULL;
+	client_rec_t *client = NULL;
+	server_rec_t *server = NULL;
+	size_t nclient = 0, nserver = 0, allocated = 0;
+	size_t c = 0, s = 0, joined = 0, client_only = 0, server_only = 0;
+	cksum_hist_t *hists[NUM_PHASES];
+	unsigned long long phases[NUM_PHASES];
+	FILE *out = NULL;
+	unsigned i;
+	int arg;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "o:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'o':
+			breakdown_path = optarg;
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (argc - optind < 2)
+	{
+		fprintf(stderr, "usage: %s [-o breakdown.csv] client.csv server.csv...\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	read_client(argv[optind], &client, &nclient);
+	for (arg = optind + 1; arg < argc; arg++)
+		read_server(argv[arg], &server, &nserver, &allocated);
+	qsort(client, nclient, sizeof(*client), by_client_id);
+	qsort(server, nserver, sizeof(*server), by_server_id);
+
+	for (i = 0; i < NUM_PHASES; i++)
+	{
+		hists[i] = cksum_hist_create();
+		if (NULL == hists[i])
+		{
+			perror("cksum_hist_create");
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (NULL != breakdown_path)
+	{
+		out = fopen(breakdown_path, "w");
+		if (NULL == out)
+		{
+			perror(breakdown_path);
+			exit(EXIT_FAILURE);
+		}
+		fprintf(out, "trace_id,thread,length,send_ns,queue_ns,read_ns,compute_ns,reply_ns,"
+				"total_ns\n");
+	}
+
+	while (c < nclient && s < nserver)
+	{
+		if (client[c].trace_id < server[s].trace_id)
+		{
+			client_only++;
+			c++;
+			continue;
+		}
+		if (server[s].trace_id < client[c].trace_id)
+		{
+			server_only++;
+			s++;
+			continue;
+		}
+		phases[PHASE_SEND] = span(server[s].client_ns, server[s].receive_ns);
+		phases[PHASE_QUEUE] = span(server[s].receive_ns, server[s].dequeue_ns);
+		phases[PHASE_READ] = span(server[s].dequeue_ns, server[s].compute_ns);
+		phases[PHASE_COMPUTE] = span(server[s].compute_ns, server[s].reply_ns);
+		phases[PHASE_REPLY] = span(server[s].reply_ns, client[c].done_ns);
+		phases[PHASE_TOTAL] = span(client[c].send_ns, client[c].done_ns);
+		for (i = 0; i < NUM_PHASES; i++)
+			cksum_hist_record(hists[i], phases[i]);
+		if (NULL != out)
+		{
+			fprintf(out, "%llu,%u,%u", server[s].trace_id, server[s].thread, server[s].length);
+			for (i = 0; i < NUM_PHASES; i++)
+				fprintf(out, ",%llu", phases[i]);
+			fprintf(out, "\n");
+		}
+		joined++;
+		c++;
+		s++;
+	}
+	client_only += nclient - c;
+	server_only += nserver - s;
+	if (NULL != out && EOF == fclose(out))
+	{
+		perror(breakdown_path);
+		exit(EXIT_FAILURE);
+	}
+
+	printf("%zu requests joined, %zu only in the client's records, %zu only in the server's\n",
+			joined, client_only, server_only);
+	printf("%-8s %9s %9s %9s %9s %9s   (us)\n", "phase", "mean", "p50", "p99", "p99.9", "max");
+	for (i = 0; i < NUM_PHASES; i++)
+	{
+		printf("%-8s %9.2f %9.2f %9.2f %9.2f %9.2f\n", phase_names[i],
+				cksum_hist_mean(hists[i]) / 1e3, cksum_hist_percentile(hists[i], 50) / 1e3,
+				cksum_hist_percentile(hists[i], 99) / 1e3,
+				cksum_hist_percentile(hists[i], 99.9) / 1e3, cksum_hist_max(hists[i]) / 1e3);
+	}
+	return EXIT_SUCCESS;
+}
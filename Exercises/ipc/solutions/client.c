@@ -10,6 +10,9 @@
 //
 // To complete the exercise, put in the code, as explained in the comments below
 // Look up function arguments in the course book or the QNX documentation.
+//
+// The string goes as a cksum_str_hdr_t followed by just its bytes (see
+// cksum_str_send()), so it can be any length.
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <stdio.h>
@@ -17,11 +20,11 @@
 #include <string.h>
 #include <sys/neutrino.h>
 #include "msg_def.h"
+#include "cksum_str.h"
 
 int main(int argc, char* argv[])
 {
 	int coid; //Connection ID to server
-	cksum_msg_t msg;
 	int incoming_checksum; //space for server's reply
 	int status; //status return value used for MsgSend
 	int server_pid; //server's process ID
@@ -53,12 +56,10 @@ int main(int argc, char* argv[])
 		exit(EXIT_FAILURE);
 	}
 
-	msg.msg_type = CKSUM_MSG_TYPE;
-	strcpy(msg.string_to_cksum, argv[3]);
-	printf("Sending string: %s\n", msg.string_to_cksum);
+	printf("Sending string: %s\n", argv[3]);
 
 	//PUT CODE HERE to send message to server and get the reply
-	status = MsgSend(coid, &msg, sizeof(msg), &incoming_checksum, sizeof(incoming_checksum));
+	status = cksum_str_send(coid, argv[3], strlen(argv[3]), &incoming_checksum);
 	if (-1 == status)
 	{ //was there an error sending to server?
 		perror("MsgSend");
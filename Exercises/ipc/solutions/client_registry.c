@@ -0,0 +1,215 @@
+////////////////////////////////////////////////////////////////////////////////
+// client_registry.c
+//
+// Client registry, see client_registry.h.
+//
+// The hash table uses linear probing and is kept at most half full, doubling
+// when it gets there.  Removal shifts the entries after the removed one back
+// instead of leaving tombstones, so lookups never get slower as clients come
+// and go.
+//
+// client_t are allocated a slab at a time and never freed until the
+// registry is destroyed.  live[] holds a pointer to every client_t
+// allocated: the first count are the live clients, the rest are free ones,
+// so adding takes live[count] and removing swaps the client with the last
+// live one.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "client_registry.h"
+
+#define SLAB_CLIENTS 256
+#define MIN_SLOTS 64
+
+typedef struct slab
+{
+	struct slab *next;
+	client_t clients[SLAB_CLIENTS];
+} slab_t;
+
+struct client_registry
+{
+	client_t **slots; // the hash table, NULL where empty
+	unsigned mask; // slots - 1, a power of two less one
+	client_t **live;
+	unsigned count;
+	unsigned allocated; // client_t in all slabs, the length of live[]
+	slab_t *slabs;
+};
+
+static unsigned home(const client_registry_t *reg, int scoid)
+{
+	// scoids are small and dense, with flag bits on top
+	return ((uint32_t)scoid * 2654435761u) & reg->mask;
+}
+
+client_registry_t *client_registry_create(void)
+{
+	client_registry_t *reg;
+
+	reg = calloc(1, sizeof(*reg));
+	if (NULL == reg)
+		return NULL;
+	reg->slots = calloc(MIN_SLOTS, sizeof(*reg->slots));
+	if (NULL == reg->slots)
+	{
+		free(reg);
+		return NULL;
+	}
+	reg->mask = MIN_SLOTS - 1;
+	return reg;
+}
+
+void client_registry_destroy(client_registry_t *reg)
+{
+	slab_t *slab;
+
+	while (NULL != (slab = reg->slabs))
+	{
+		reg->slabs = slab->next;
+		free(slab);
+	}
+	free(reg->live);
+	free(reg->slots);
+	free(reg);
+}
+
+// the slot holding scoid, or the empty one where it would go
+static unsigned probe(const client_registry_t *reg, int scoid)
+{
+	unsigned i;
+
+	for (i = home(reg, scoid); NULL != reg->slots[i]; i = (i + 1) & reg->mask)
+		if (reg->slots[i]->scoid == scoid)
+			break;
+	return i;
+}
+
+static int grow_table(client_registry_t *reg)
+{
+	client_t **old = reg->slots;
+	unsigned old_size = reg->mask + 1;
+	unsigned i;
+
+	reg->slots = calloc(old_size * 2, sizeof(*reg->slots));
+	if (NULL == reg->slots)
+	{
+		reg->slots = old;
+		return -1;
+	}
+	reg->mask = old_size * 2 - 1;
+	for (i = 0; i < old_size; i++)
+		if (NULL != old[i])
+			reg->slots[probe(reg, old[i]->scoid)] = old[i];
+	free(old);
+	return 0;
+}
+
+static int grow_clients(client_registry_t *reg)
+{
+	client_t **live;
+	slab_t *slab;
+	unsigned i;
+
+	live = realloc(reg->live, (reg->allocated + SLAB_CLIENTS) * sizeof(*live));
+	if (NULL == live)
+		return -1;
+	reg->live = live;
+	slab = malloc(sizeof(*slab));
+	if (NULL == slab)
+		return -1;
+	slab->next = reg->slabs;
+	reg->slabs = slab;
+	for (i = 0; i < SLAB_CLIENTS; i++)
+		live[reg->allocated++] = &slab->clients[i];
+	return 0;
+}
+
+client_t *client_registry_add(client_registry_t *reg, int scoid, int *added)
+{
+	client_t *client;
+	unsigned i;
+
+	i = probe(reg, scoid);
+	if (NULL != reg->slots[i])
+	{
+		if (NULL != added)
+			*added = 0;
+		return reg->slots[i];
+	}
+
+	// make room first, so that failing leaves the registry as it was
+	if ((reg->count + 1) * 2 > reg->mask + 1)
+	{
+		if (-1 == grow_table(reg))
+		{
+			errno = ENOMEM;
+			return NULL;
+		}
+		i = probe(reg, scoid);
+	}
+	if (reg->count == reg->allocated && -1 == grow_clients(reg))
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	client = reg->live[reg->count];
+	memset(client, 0, sizeof(*client));
+	client->scoid = scoid;
+	client->index = reg->count++;
+	reg->slots[i] = client;
+	if (NULL != added)
+		*added = 1;
+	return client;
+}
+
+client_t *client_registry_find(client_registry_t *reg, int scoid)
+{
+	return reg->slots[probe(reg, scoid)];
+}
+
+int client_registry_remove(client_registry_t *reg, int scoid)
+{
+	client_t *client, *last, *moved;
+	unsigned i, j, h;
+
+	i = probe(reg, scoid);
+	client = reg->slots[i];
+	if (NULL == client)
+		return -1;
+
+	// shift back any entry after the hole that can't be found past it
+	reg->slots[i] = NULL;
+	for (j = (i + 1) & reg->mask; NULL != (moved = reg->slots[j]); j = (j + 1) & reg->mask)
+	{
+		h = home(reg, moved->scoid);
+		// moved stays put if its home is cyclically in (i, j]
+		if (i <= j ? (i < h && h <= j) : (i < h || h <= j))
+			continue;
+		reg->slots[i] = moved;
+		reg->slots[j] = NULL;
+		i = j;
+	}
+
+	// the last live client takes its place, it goes to the free ones
+	last = reg->live[--reg->count];
+	reg->live[client->index] = last;
+	last->index = client->index;
+	reg->live[reg->count] = client;
+	return 0;
+}
+
+unsigned client_registry_count(client_registry_t *reg)
+{
+	return reg->count;
+}
+
+client_t *client_registry_at(client_registry_t *reg, unsigned i)
+{
+	return reg->live[i];
+}
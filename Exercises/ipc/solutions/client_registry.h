@@ -0,0 +1,50 @@
+#ifndef _CLIENT_REGISTRY_H_
+#define _CLIENT_REGISTRY_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// client_registry.h
+//
+// The clients a server knows about, by scoid.  Adding a client that is
+// already there just returns it, finding and removing one are O(1), and
+// walking them all costs only as much as there are clients.
+//
+// An open addressing hash table maps scoids to client_t, which come from
+// slabs so that thousands of connections don't mean thousands of malloc()s;
+// a dense array of the live ones is what iteration walks.  Not thread safe,
+// a server receiving from more than one thread needs a lock around it.
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+	int scoid;
+	unsigned messages; // received from it so far
+	char text_description[64];
+	unsigned index; // in the registry's live array
+} client_t;
+
+typedef struct client_registry client_registry_t;
+
+// an empty registry, or NULL with errno set
+client_registry_t *client_registry_create(void);
+
+void client_registry_destroy(client_registry_t *reg);
+
+// the client for scoid, added with zeroed state if it wasn't there.  *added
+// (if not NULL) says which.  Returns NULL with errno ENOMEM if it couldn't be
+// added.
+client_t *client_registry_add(client_registry_t *reg, int scoid, int *added);
+
+// the client for scoid, or NULL
+client_t *client_registry_find(client_registry_t *reg, int scoid);
+
+// forget scoid, returns 0 or -1 if it wasn't there
+int client_registry_remove(client_registry_t *reg, int scoid);
+
+unsigned client_registry_count(client_registry_t *reg);
+
+// the i'th live client, for i below client_registry_count().  Removing a
+// client moves the last one into its place, so to remove while walking, walk
+// backwards.
+client_t *client_registry_at(client_registry_t *reg, unsigned i);
+
+#endif //_CLIENT_REGISTRY_H_
@@ -0,0 +1,274 @@
+////////////////////////////////////////////////////////////////////////////////
+// client_registry_bench.c
+//
+// The client bookkeeping in disconnect_server, done with the linked list it
+// used to keep against client_registry_t, for 10 to 100000 simulated
+// connections.  No message passing, just the bookkeeping, so it builds and
+// runs the same on QNX and Linux ("make host", as client_registry_host).
+//
+// For each number of connections it connects them all, then times:
+// - message:  looking up the sender of a message from a random client (the
+//             list scans, and would prepend if it wasn't found)
+// - churn:    a random client disconnecting and a new one connecting
+// - walk:     visiting every client, as printing them does, per client
+//
+// The list is the old code fixed not to add a client once per message;
+// as it was it grew by one node per message whatever the connections.  It
+// does fewer operations at large sizes so the run doesn't take minutes,
+// times are per operation either way.
+//
+// -n count   operations of each kind per size (default 100000)
+// -s sizes   comma separated numbers of connections
+//            (default 10,100,1000,10000,100000)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "client_registry.h"
+
+typedef struct list_node
+{
+	struct list_node *next;
+	int scoid;
+	unsigned messages;
+	char text_description[64];
+} list_node_t;
+
+static int *scoids; // the connected ones
+static int next_scoid;
+static volatile unsigned sink;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static list_node_t *list_find(list_node_t *list, int scoid)
+{
+	while (NULL != list && list->scoid != scoid)
+		list = list->next;
+	return list;
+}
+
+static list_node_t *list_prepend(list_node_t **list, int scoid)
+{
+	list_node_t *node;
+
+	node = calloc(1, sizeof(*node));
+	if (NULL == node)
+	{
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+	node->scoid = scoid;
+	node->next = *list;
+	*list = node;
+	return node;
+}
+
+static list_node_t *list_add(list_node_t **list, int scoid)
+{
+	list_node_t *node;
+
+	node = list_find(*list, scoid);
+	if (NULL != node)
+		return node;
+	return list_prepend(list, scoid);
+}
+
+static void list_remove(list_node_t **list, int scoid)
+{
+	list_node_t **link, *node;
+
+	for (link = list; NULL != (node = *link); link = &node->next)
+	{
+		if (node->scoid == scoid)
+		{
+			*link = node->next;
+			free(node);
+			return;
+		}
+	}
+}
+
+static client_t *registry_add(client_registry_t *reg, int scoid)
+{
+	client_t *client;
+
+	client = client_registry_add(reg, scoid, NULL);
+	if (NULL == client)
+	{
+		perror("client_registry_add");
+		exit(EXIT_FAILURE);
+	}
+	return client;
+}
+
+static void bench_list(unsigned size, unsigned count)
+{
+	list_node_t *list = NULL, *node;
+	uint64_t start, message_ns, churn_ns, walk_ns;
+	unsigned i, j, n;
+
+	// the list is O(size) per operation, keep its run time bounded
+	n = count;
+	if (size > 1000)
+		n = count / (size / 1000);
+	if (n < 100)
+		n = 100;
+
+	// all new, no need to look for them
+	for (i = 0; i < size; i++)
+		list_prepend(&list, scoids[i]);
+
+	start = now_ns();
+	for (i = 0; i < n; i++)
+		list_add(&list, scoids[rand() % size])->messages++;
+	message_ns = now_ns() - start;
+
+	start = now_ns();
+	for (i = 0; i < n; i++)
+	{
+		j = rand() % size;
+		list_remove(&list, scoids[j]);
+		scoids[j] = next_scoid++;
+		list_add(&list, scoids[j]);
+	}
+	churn_ns = now_ns() - start;
+
+	start = now_ns();
+	for (node = list; NULL != node; node = node->next)
+		sink += node->messages;
+	walk_ns = now_ns() - start;
+
+	printf("%-8s %8u %14.1f %14.1f %14.2f\n", "list", size, (double)message_ns / n,
+			(double)churn_ns / n, (double)walk_ns / size);
+
+	while (NULL != (node = list))
+	{
+		list = node->next;
+		free(node);
+	}
+}
+
+static void bench_registry(unsigned size, unsigned count)
+{
+	client_registry_t *reg;
+	uint64_t start, message_ns, churn_ns, walk_ns;
+	unsigned i, j;
+
+	reg = client_registry_create();
+	if (NULL == reg)
+	{
+		perror("client_registry_create");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < size; i++)
+		registry_add(reg, scoids[i]);
+
+	start = now_ns();
+	for (i = 0; i < count; i++)
+		registry_add(reg, scoids[rand() % size])->messages++;
+	message_ns = now_ns() - start;
+
+	start = now_ns();
+	for (i = 0; i < count; i++)
+	{
+		j = rand() % size;
+		if (-1 == client_registry_remove(reg, scoids[j]))
+		{
+			fprintf(stderr, "client %d missing\n", scoids[j]);
+			exit(EXIT_FAILURE);
+		}
+		scoids[j] = next_scoid++;
+		registry_add(reg, scoids[j]);
+	}
+	churn_ns = now_ns() - start;
+
+	start = now_ns();
+	for (i = 0; i < client_registry_count(reg); i++)
+		sink += client_registry_at(reg, i)->messages;
+	walk_ns = now_ns() - start;
+
+	if (client_registry_count(reg) != size)
+	{
+		fprintf(stderr, "%u clients, expected %u\n", client_registry_count(reg), size);
+		exit(EXIT_FAILURE);
+	}
+	printf("%-8s %8u %14.1f %14.1f %14.2f\n", "registry", size, (double)message_ns / count,
+			(double)churn_ns / count, (double)walk_ns / size);
+	client_registry_destroy(reg);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *sizes = "10,100,1000,10000,100000";
+	unsigned count = 100000;
+	char *list, *tok, *save;
+	unsigned size, i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:s:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			sizes = optarg;
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (0 == count)
+	{
+		fprintf(stderr, "count must be positive\n");
+		exit(EXIT_FAILURE);
+	}
+	list = strdup(sizes);
+	if (NULL == list)
+	{
+		perror("strdup");
+		exit(EXIT_FAILURE);
+	}
+
+	printf("times in ns\n");
+	printf("%-8s %8s %14s %14s %14s\n", "", "clients", "per message", "per churn",
+			"walk/client");
+	for (tok = strtok_r(list, ",", &save); NULL != tok; tok = strtok_r(NULL, ",", &save))
+	{
+		size = strtoul(tok, NULL, 0);
+		if (0 == size)
+			continue;
+		scoids = malloc(size * sizeof(*scoids));
+		if (NULL == scoids)
+		{
+			perror("malloc");
+			exit(EXIT_FAILURE);
+		}
+		// both get the same connections
+		for (i = 0; i < size; i++)
+			scoids[i] = i + 1;
+		next_scoid = size + 1;
+		srand(size);
+		bench_list(size, count);
+		for (i = 0; i < size; i++)
+			scoids[i] = i + 1;
+		next_scoid = size + 1;
+		srand(size);
+		bench_registry(size, count);
+		free(scoids);
+	}
+	free(list);
+	return EXIT_SUCCESS;
+}
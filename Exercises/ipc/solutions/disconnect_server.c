@@ -3,16 +3,26 @@
 //
 // demonstrates handling the disconnect pulse
 //
+// Clients are kept by scoid in a client_registry_t (client_registry.h):
+// each message looks its sender up, adding it the first time, and the
+// disconnect pulse removes it and detaches the scoid, both in constant time
+// however many clients there are.  Each connect and disconnect prints just
+// that client and how many are left, the whole list is printed on SIGUSR1.
+//
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <string.h>
+#include <signal.h>
 #include <sys/iofunc.h>
 #include <sys/dispatch.h>
 #include <sys/neutrino.h>
 
 #include "msg_def.h"
+#include "cksum.h"
+#include "client_registry.h"
 
 typedef union
 {
@@ -21,19 +31,17 @@ typedef union
 	struct _pulse pulse;
 } msg_buf_t;
 
-struct listNode
-{
-	struct listNode* next_ptr;
-	int scoid;
-	char text_description[64];
-};
+client_t* add_client(client_registry_t* reg, const struct _msg_info* info);
+void remove_client(client_registry_t* reg, int scoid);
+void print_clients(client_registry_t* reg);
 
-typedef struct listNode listNode_t;
+// set by SIGUSR1, the receive loop prints the clients when it sees it
+static volatile sig_atomic_t print_requested;
 
-int calculate_checksum(char *text);
-listNode_t* add_client_to_list(listNode_t* listp, int scoid);
-listNode_t* remove_client_from_list(listNode_t* list_ptr, int scoid);
-int print_list(listNode_t* list_ptr);
+void print_on_signal(int signo)
+{
+	print_requested = 1;
+}
 
 int main(void)
 {
@@ -43,7 +51,9 @@ int main(void)
 	int status;
 	int checksum;
 	struct _msg_info msg_info;
-	listNode_t* list_ptr = NULL;
+	client_registry_t* clients;
+	client_t* client;
+	struct sigaction sa;
 
 	attach = name_attach(NULL, DISCONNECT_SERVER, 0);
 	if (NULL == attach)
@@ -51,12 +61,32 @@ int main(void)
 		perror("name_attach"); //look up the errno code and print
 		exit(EXIT_FAILURE);
 	}
+	clients = client_registry_create();
+	if (NULL == clients)
+	{
+		perror("client_registry_create");
+		exit(EXIT_FAILURE);
+	}
+	// no SA_RESTART: the signal interrupts MsgReceive(), so the list is
+	// printed at once rather than after the next message
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = print_on_signal;
+	sigaction(SIGUSR1, &sa, NULL);
 
 	while (1)
 	{
+		if (print_requested)
+		{
+			print_requested = 0;
+			print_clients(clients);
+		}
 		printf("Waiting for a message...\n");
 		rcvid = MsgReceive(attach->chid, &msg, sizeof(msg), &msg_info); //PUT CODE HERE to receive msg from client
-		if (-1 == rcvid)
+		if (-1 == rcvid && EINTR == errno)
+		{ //a signal, maybe asking for the clients
+			continue;
+		}
+		else if (-1 == rcvid)
 		{ //was there an error receiving msg?
 			perror("MsgReceive"); //look up errno code and print
 			exit(EXIT_FAILURE); //failure, terminate
@@ -67,8 +97,15 @@ int main(void)
 			{
 			case CKSUM_MSG_TYPE:
 				printf("Message received, client scoid = %x\n", msg_info.scoid);
-				list_ptr = add_client_to_list(list_ptr, msg_info.scoid);
-				print_list(list_ptr);
+				client = add_client(clients, &msg_info);
+				if (NULL == client)
+				{
+					perror("add_client");
+					if (-1 == MsgError(rcvid, errno))
+						perror("MsgError");
+					break;
+				}
+				client->messages++;
 
 				checksum = calculate_checksum(msg.msg.string_to_cksum);
 
@@ -92,10 +129,9 @@ int main(void)
 			{
 			case _PULSE_CODE_DISCONNECT:
 				printf("received disconnect pulse from client, scoid = %x\n", msg.pulse.scoid);
-				//	list_ptr = remove_client_from_list(list_ptr, msg.pulse.scoid);
-				//	if (-1 == ConnectDetach(msg.pulse.scoid))
-				//		perror("ConnectDetach");
-				print_list(list_ptr);
+				remove_client(clients, msg.pulse.scoid);
+				if (-1 == ConnectDetach(msg.pulse.scoid))
+					perror("ConnectDetach");
 				break;
 			default:
 				printf("unknown pulse received, code = %x\n", msg.pulse.code);
@@ -109,84 +145,51 @@ int main(void)
 	return 0;
 }
 
-int calculate_checksum(char *text)
-{
-	char *c;
-	int cksum = 0;
-
-	for (c = text; *c != '\0'; c++)
-		cksum += *c;
-	return cksum;
-}
 
-listNode_t* add_client_to_list(listNode_t* listp, int scoid)
+client_t* add_client(client_registry_t* reg, const struct _msg_info* info)
 {
-	listNode_t* newp;
+	client_t* client;
+	int added;
 
-	printf("adding client to list, scoid: %x\n", scoid);
-
-	newp = malloc(sizeof(listNode_t));
-	if (newp == NULL)
+	client = client_registry_add(reg, info->scoid, &added);
+	if (NULL != client && added)
 	{
-		errno = ENOMEM;
-		return NULL;
+		snprintf(client->text_description, sizeof(client->text_description), "pid %d",
+				(int)info->pid);
+		printf("adding client, scoid: %x, %s, %u connected\n", info->scoid,
+				client->text_description, client_registry_count(reg));
 	}
-	newp->next_ptr = listp;
-	newp->scoid = scoid;
-	return newp;
+	return client;
 }
 
-int print_list(listNode_t* list_ptr)
+// walks every client, so only on request (SIGUSR1), never per message
+void print_clients(client_registry_t* reg)
 {
-	listNode_t* current_ptr = list_ptr;
+	client_t* client;
+	unsigned i;
 
-	if (list_ptr == NULL)
+	if (0 == client_registry_count(reg))
 	{
-		printf("no clients in list\n");
+		printf("no clients connected\n");
 	}
 	else
 	{
-		printf("list of currently connected clients: \n");
-
-		while (current_ptr != NULL)
+		printf("%u currently connected clients: \n", client_registry_count(reg));
+		for (i = 0; i < client_registry_count(reg); i++)
 		{
-			printf("client scoid: %x \n", current_ptr->scoid);
-			current_ptr = current_ptr->next_ptr;
+			client = client_registry_at(reg, i);
+			printf("client scoid: %x, %s, %u messages\n", client->scoid,
+					client->text_description, client->messages);
 		}
 	}
 	printf("\n");
-
-	return 0;
 }
 
-listNode_t* remove_client_from_list(listNode_t* listp, int scoid)
+void remove_client(client_registry_t* reg, int scoid)
 {
-	listNode_t* curp = listp;
-	listNode_t* prevp = NULL;
-
-	printf("removing client from list, scoid: %x\n", scoid);
-
-	while ((curp) && curp->scoid != scoid)
-	{
-		prevp = curp;
-		curp = curp->next_ptr;
-	}
-	if (curp == NULL)
-	{
+	if (-1 == client_registry_remove(reg, scoid))
 		printf("couldn't find client %x\n", scoid);
-		return listp;
-	}
-
-	if (prevp == NULL)
-	{
-		printf("found client at head node\n");
-		prevp = curp->next_ptr;
-		free(curp);
-		return prevp;
-	}
-	printf("found client at node other than head\n");
-	prevp->next_ptr = curp->next_ptr;
-	free(curp);
-	return listp;
+	else
+		printf("removed client, scoid: %x, %u connected\n", scoid,
+				client_registry_count(reg));
 }
-
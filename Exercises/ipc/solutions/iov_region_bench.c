@@ -0,0 +1,180 @@
+////////////////////////////////////////////////////////////////////////////////
+// iov_region_bench.c
+//
+// Compares iov_server's copying path (a header + data IOV message) with its
+// zero-copy region path (CKSUM_REGION_MSG_TYPE), run against iov_server -q.
+//
+// The payload is written once into a shared memory region that is attached
+// to the server with the first request; after that, for each payload size
+// from 4k to 256M, the same bytes are checksummed through both paths and the
+// replies are checked against a local checksum.
+//
+// -b bytes  bytes to push through each path per payload size (default 1G),
+//           but always at least 4 requests
+// -m bytes  largest payload (default 256M)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/neutrino.h>
+#include <sys/iofunc.h>
+#include <sys/dispatch.h>
+
+#include "iov_server.h"
+#include "cksum.h"
+#include "cksum_region.h"
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double bench_copy(int coid, const char *data, size_t size, unsigned count, int expected)
+{
+	cksum_header_t hdr;
+	iov_t siov[2];
+	int checksum;
+	unsigned i;
+	double start;
+
+	hdr.msg_type = CKSUM_IOV_MSG_TYPE;
+	hdr.data_size = size;
+	SETIOV(&siov[0], &hdr, sizeof(hdr));
+	SETIOV(&siov[1], data, size);
+
+	start = now();
+	for (i = 0; i < count; i++)
+	{
+		if (-1 == MsgSendvs(coid, siov, 2, &checksum, sizeof(checksum)))
+		{
+			perror("MsgSendvs");
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (checksum != expected)
+	{
+		fprintf(stderr, "copy path: checksum %d, expected %d\n", checksum, expected);
+		exit(EXIT_FAILURE);
+	}
+	return (double)size * count / (now() - start);
+}
+
+static double bench_region(int coid, size_t size, unsigned count, int expected)
+{
+	cksum_region_msg_t msg;
+	int checksum;
+	unsigned i;
+	double start;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_type = CKSUM_REGION_MSG_TYPE;
+	msg.offset = 0;
+	msg.length = size;
+
+	start = now();
+	for (i = 0; i < count; i++)
+	{
+		if (-1 == MsgSend(coid, &msg, sizeof(msg), &checksum, sizeof(checksum)))
+		{
+			perror("MsgSend");
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (checksum != expected)
+	{
+		fprintf(stderr, "region path: checksum %d, expected %d\n", checksum, expected);
+		exit(EXIT_FAILURE);
+	}
+	return (double)size * count / (now() - start);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	size_t max_size = 256 * 1024 * 1024;
+	double total = 1024.0 * 1024 * 1024;
+	int coid;
+	struct _server_info info;
+	cksum_region_msg_t attach;
+	char *data;
+	size_t size, i;
+	unsigned count;
+	int checksum, expected;
+	double start, copy, region;
+
+	while ((opt = getopt(argc, argv, "b:m:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'b':
+			total = strtod(optarg, NULL);
+			break;
+		case 'm':
+			max_size = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	coid = name_open(CKSUM_SERVER_NAME, 0);
+	if (-1 == coid)
+	{
+		perror("name_open");
+		exit(EXIT_FAILURE);
+	}
+	// the handle has to be made out to the server's process
+	if (-1 == ConnectServerInfo(0, coid, &info))
+	{
+		perror("ConnectServerInfo");
+		exit(EXIT_FAILURE);
+	}
+
+	memset(&attach, 0, sizeof(attach));
+	if (-1 == cksum_region_create(max_size, info.pid, (void **)&data, &attach.handle))
+	{
+		perror("cksum_region_create");
+		exit(EXIT_FAILURE);
+	}
+	srand(5);
+	for (i = 0; i < max_size; i++)
+		data[i] = rand();
+
+	// hand the region over, this is the only request that maps anything
+	attach.msg_type = CKSUM_REGION_MSG_TYPE;
+	attach.flags = CKSUM_REGION_ATTACH;
+	attach.region_size = max_size;
+	attach.length = 0;
+	start = now();
+	if (-1 == MsgSend(coid, &attach, sizeof(attach), &checksum, sizeof(checksum)))
+	{
+		perror("attach MsgSend");
+		exit(EXIT_FAILURE);
+	}
+	printf("attached a %zu byte region in %.1f us\n", max_size, (now() - start) * 1e6);
+
+	printf("%12s %10s %12s %12s %8s\n", "payload", "requests", "copy GB/s", "region GB/s",
+			"speedup");
+	for (size = 4096; size <= max_size; size *= 4)
+	{
+		count = total / size;
+		if (count < 4)
+			count = 4;
+		expected = calculate_checksum_len(data, size);
+
+		copy = bench_copy(coid, data, size, count, expected);
+		region = bench_region(coid, size, count, expected);
+		printf("%12zu %10u %12.2f %12.2f %8.2f\n", size, count, copy / 1e9, region / 1e9,
+				region / copy);
+	}
+
+	cksum_region_destroy(data, max_size);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+////////////////////////////////////////////////////////////////////////////////
+// iov_region_host.c
+//
+// Linux stand-in for iov_region_bench: iov_server's copying path against its
+// zero-copy region path, without the message passing.
+//
+// The "client" writes its payload into a POSIX shared memory object, and
+// the "server" maps it through cksum_region_attach() with its own mapping,
+// just as iov_server does with a QNX handle.  For each payload size from 4k
+// to 256M the copying path does what iov_server's default mode does per
+// request - malloc() a buffer, copy the payload in (memcpy() standing in for
+// MsgRead()) and checksum it - while the region path checksums the mapping
+// in place.
+//
+// -b bytes  bytes to push through each path per payload size (default 1G),
+//           but always at least 4 requests
+// -m bytes  largest payload (default 256M)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "cksum.h"
+#include "cksum_region.h"
+
+#define CLIENT_ID 1
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double bench_copy(const char *client_data, size_t size, unsigned count, int expected)
+{
+	char *data;
+	int checksum = 0;
+	unsigned i;
+	double start;
+
+	start = now();
+	for (i = 0; i < count; i++)
+	{
+		data = malloc(size);
+		if (NULL == data)
+		{
+			perror("malloc");
+			exit(EXIT_FAILURE);
+		}
+		memcpy(data, client_data, size);
+		checksum = calculate_checksum_len(data, size);
+		free(data);
+	}
+	if (checksum != expected)
+	{
+		fprintf(stderr, "copy path: checksum %d, expected %d\n", checksum, expected);
+		exit(EXIT_FAILURE);
+	}
+	return (double)size * count / (now() - start);
+}
+
+static double bench_region(size_t size, unsigned count, int expected)
+{
+	cksum_region_t *region;
+	int checksum = 0;
+	unsigned i;
+	double start;
+
+	start = now();
+	for (i = 0; i < count; i++)
+	{
+		region = cksum_region_get(CLIENT_ID);
+		if (NULL == region || -1 == cksum_region_checksum(region, 0, size, &checksum))
+		{
+			perror("region checksum");
+			exit(EXIT_FAILURE);
+		}
+		cksum_region_put(region);
+	}
+	if (checksum != expected)
+	{
+		fprintf(stderr, "region path: checksum %d, expected %d\n", checksum, expected);
+		exit(EXIT_FAILURE);
+	}
+	return (double)size * count / (now() - start);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	size_t max_size = 256 * 1024 * 1024;
+	double total = 1024.0 * 1024 * 1024;
+	cksum_shm_handle_t handle;
+	cksum_region_t *region;
+	char *data;
+	size_t size, i;
+	unsigned count;
+	int checksum, expected;
+	double start, copy, zero_copy;
+
+	while ((opt = getopt(argc, argv, "b:m:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'b':
+			total = strtod(optarg, NULL);
+			break;
+		case 'm':
+			max_size = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (-1 == cksum_region_create(max_size, getpid(), (void **)&data, &handle))
+	{
+		perror("cksum_region_create");
+		exit(EXIT_FAILURE);
+	}
+	srand(5);
+	for (i = 0; i < max_size; i++)
+		data[i] = rand();
+
+	start = now();
+	region = cksum_region_attach(CLIENT_ID, getpid(), &handle, max_size);
+	if (NULL == region)
+	{
+		perror("cksum_region_attach");
+		exit(EXIT_FAILURE);
+	}
+	cksum_region_put(region);
+	printf("attached a %zu byte region in %.1f us\n", max_size, (now() - start) * 1e6);
+
+	// the handle is used up, and ranges outside the region are refused
+	if (NULL != cksum_region_attach(CLIENT_ID + 1, getpid(), &handle, max_size))
+	{
+		fprintf(stderr, "handle could be attached twice\n");
+		exit(EXIT_FAILURE);
+	}
+	region = cksum_region_get(CLIENT_ID);
+	if (-1 != cksum_region_checksum(region, max_size, 1, &checksum)
+			|| -1 != cksum_region_checksum(region, 1, max_size, &checksum))
+	{
+		fprintf(stderr, "range outside the region was accepted\n");
+		exit(EXIT_FAILURE);
+	}
+	cksum_region_put(region);
+
+	printf("%12s %10s %12s %12s %8s\n", "payload", "requests", "copy GB/s", "region GB/s",
+			"speedup");
+	for (size = 4096; size <= max_size; size *= 4)
+	{
+		count = total / size;
+		if (count < 4)
+			count = 4;
+		expected = calculate_checksum_len(data, size);
+
+		copy = bench_copy(data, size, count, expected);
+		zero_copy = bench_region(size, count, expected);
+		printf("%12zu %10u %12.2f %12.2f %8.2f\n", size, count, copy / 1e9, zero_copy / 1e9,
+				zero_copy / copy);
+	}
+
+	// as on a disconnect pulse
+	cksum_region_detach(CLIENT_ID);
+	if (NULL != cksum_region_get(CLIENT_ID))
+	{
+		fprintf(stderr, "region still attached after detach\n");
+		exit(EXIT_FAILURE);
+	}
+	cksum_region_destroy(data, max_size);
+	return EXIT_SUCCESS;
+}
@@ -3,34 +3,126 @@
 //
 // demonstrates using input/output vector (IOV) messaging
 //
+// -s        streaming mode: rather than reading in the whole payload, pull it
+//           in with repeated MsgRead()s into a fixed per-thread window and
+//           checksum it a chunk at a time, so memory use doesn't grow with
+//           the size of the client's message
+// -c bytes  streaming window size (default 64k), implies -s
+// -a bytes  size of the request arena the payload is read into when not
+//           streaming (default 64k); bigger payloads come from the heap
+// -q        quiet, don't print anything per message (for benchmarking)
+//
+// Clients that keep their data in shared memory can instead send a
+// CKSUM_REGION_MSG_TYPE request, which is checksummed in place without
+// copying it through the kernel (see cksum_region.h)
+//
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <errno.h>
 #include <sys/iofunc.h>
 #include <sys/dispatch.h>
 #include <sys/neutrino.h>
 
 #include "iov_server.h"
+#include "cksum.h"
+#include "cksum_stream.h"
+#include "cksum_region.h"
+#include "req_arena.h"
 
 typedef union
 {
 	uint16_t msg_type;
 	struct _pulse pulse;
 	cksum_header_t cksum_hdr;
+	cksum_region_msg_t region;
 } msg_buf_t;
 
-int calculate_checksum(char *text);
+// cksum_stream() read callback, the handle is the rcvid
+static ssize_t msg_read(void *handle, void *buf, size_t nbytes, size_t offset)
+{
+	return MsgRead(*(int *)handle, buf, nbytes, offset);
+}
 
-int main(void)
+// checksum bytes in the client's shared memory region, mapping it first if
+// the request hands us a new one
+static void handle_region(int rcvid, const cksum_region_msg_t *msg, const struct _msg_info *info)
+{
+	cksum_region_t *region;
+	int checksum;
+
+	if (msg->flags & CKSUM_REGION_ATTACH)
+		region = cksum_region_attach(info->scoid, info->pid, &msg->handle, msg->region_size);
+	else
+		region = cksum_region_get(info->scoid);
+	if (NULL == region)
+	{
+		if (-1 == MsgError(rcvid, errno))
+		{
+			perror("MsgError");
+		}
+		return;
+	}
+
+	if (-1 == cksum_region_checksum(region, msg->offset, msg->length, &checksum))
+	{
+		if (-1 == MsgError(rcvid, errno))
+		{
+			perror("MsgError");
+		}
+	}
+	else if (-1 == MsgReply(rcvid, EOK, &checksum, sizeof(checksum)))
+	{
+		perror("MsgReply");
+	}
+	cksum_region_put(region);
+}
+
+int main(int argc, char* argv[])
 {
 	int rcvid;
+	struct _msg_info info;
 	name_attach_t* attach;
 	msg_buf_t msg;
 	int status;
 	int checksum;
 	char* data;
+	int opt;
+	int streaming = 0;
+	int quiet = 0;
+
+	while ((opt = getopt(argc, argv, "sc:a:q")) != -1)
+	{
+		switch (opt)
+		{
+		case 'a':
+			if (-1 == req_arena_set_size(strtoul(optarg, NULL, 0)))
+			{
+				perror("arena size");
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'c':
+			if (-1 == cksum_stream_set_chunk_size(strtoul(optarg, NULL, 0)))
+			{
+				perror("chunk size");
+				exit(EXIT_FAILURE);
+			}
+			// fall through, a chunk size means streaming mode
+		case 's':
+			streaming = 1;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (streaming)
+		printf("streaming mode, %zu byte window\n", cksum_stream_chunk_size());
 
 	attach = name_attach(NULL, CKSUM_SERVER_NAME, 0);
 	if (attach == NULL)
@@ -41,8 +133,9 @@ int main(void)
 
 	while (1)
 	{
-		printf("Waiting for a message...\n");
-		rcvid = MsgReceive(attach->chid, &msg, sizeof(msg), NULL);
+		if (!quiet)
+			printf("Waiting for a message...\n");
+		rcvid = MsgReceive(attach->chid, &msg, sizeof(msg), &info);
 		if (rcvid == -1)
 		{ //was there an error receiving msg?
 			perror("MsgReceive"); //look up errno code and print
@@ -53,9 +146,29 @@ int main(void)
 			switch (msg.msg_type)
 			{
 			case CKSUM_IOV_MSG_TYPE:
-				printf("Received a checksum request msg, header says the data is %d bytes\n",
-						msg.cksum_hdr.data_size);
-				data = malloc(msg.cksum_hdr.data_size);
+				if (!quiet)
+					printf("Received a checksum request msg, header says the data is %d bytes\n",
+							msg.cksum_hdr.data_size);
+				if (streaming)
+				{
+					if (-1 == cksum_stream(msg_read, &rcvid, sizeof(cksum_header_t),
+							msg.cksum_hdr.data_size, &checksum, NULL))
+					{
+						if (-1 == MsgError(rcvid, errno))
+						{
+							perror("MsgError");
+						}
+						break;
+					}
+					status = MsgReply(rcvid, EOK, &checksum, sizeof(checksum));
+					if (-1 == status)
+					{
+						perror("MsgReply");
+					}
+					break;
+				}
+				// gone again with the arena reset once we've replied
+				data = req_arena_alloc(msg.cksum_hdr.data_size);
 				if (NULL == data)
 				{
 					if (-1 == MsgError(rcvid, ENOMEM ))
@@ -73,8 +186,9 @@ int main(void)
 						exit(EXIT_FAILURE);
 					}
 
-					checksum = calculate_checksum(data);
-					free(data);
+					// MsgRead returns how many bytes the client actually sent,
+					// no need to scan for the nul terminator
+					checksum = calculate_checksum_len(data, status);
 					status = MsgReply(rcvid, EOK, &checksum, sizeof(checksum));
 					if (-1 == status)
 					{
@@ -82,7 +196,25 @@ int main(void)
 						exit(EXIT_FAILURE);
 					}
 				}
+				req_arena_reset();
 
+				break;
+			case CKSUM_REGION_MSG_TYPE:
+				if (!quiet)
+					printf("Received a region checksum request, %llu bytes at offset %llu\n",
+							(unsigned long long)msg.region.length,
+							(unsigned long long)msg.region.offset);
+				// a short one would leave the last request's handle and
+				// range in msg for us to use
+				if (info.msglen < sizeof(msg.region))
+				{
+					if (-1 == MsgError(rcvid, EBADMSG))
+					{
+						perror("MsgError");
+					}
+					break;
+				}
+				handle_region(rcvid, &msg.region, &info);
 				break;
 			default:
 				if (-1 == MsgError(rcvid, ENOSYS))
@@ -97,7 +229,10 @@ int main(void)
 			switch (msg.pulse.code)
 			{
 			case _PULSE_CODE_DISCONNECT:
-				printf("Received disconnect pulse\n");
+				if (!quiet)
+					printf("Received disconnect pulse\n");
+				// the client can't use its region any more, unmap it
+				cksum_region_detach(msg.pulse.scoid);
 				if (-1 == ConnectDetach(msg.pulse.scoid))
 				{
 					perror("ConnectDetach");
@@ -123,14 +258,3 @@ int main(void)
 	}
 	return 0;
 }
-
-int calculate_checksum(char *text)
-{
-	char *c;
-	int cksum = 0;
-
-	for (c = text; *c != '\0'; c++)
-		cksum += *c;
-	return cksum;
-}
-
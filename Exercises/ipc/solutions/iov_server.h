@@ -3,8 +3,12 @@
 
 #include <sys/iomsg.h>
 
+#include "cksum_region.h"
+
 #define CKSUM_SERVER_NAME "cksum"
 #define CKSUM_IOV_MSG_TYPE (_IO_MAX + 2)
+// clear of the codes in msg_def.h, both servers answer to the name "cksum"
+#define CKSUM_REGION_MSG_TYPE (_IO_MAX + 10)
 
 //layout of msg's should always defined by a struct, and ID'd by a msg type 
 // number as the first member
@@ -16,4 +20,25 @@ typedef struct
 
 // checksum reply is an int
 
+// zero-copy checksum of data the client keeps in shared memory, see
+// cksum_region.h.  The first request carries CKSUM_REGION_ATTACH and a handle
+// to the shared memory object (made for the server's pid), the server maps
+// the object and keeps it mapped until the client disconnects or attaches
+// another one.  Later requests just name the bytes to checksum within it.
+#define CKSUM_REGION_ATTACH 0x0001
+
+typedef struct
+{
+	uint16_t msg_type;
+	uint16_t flags;
+	uint32_t zero;
+	cksum_shm_handle_t handle; // only with CKSUM_REGION_ATTACH
+	uint64_t region_size; // size of the object, only with CKSUM_REGION_ATTACH
+	uint64_t offset; // of the data within the object
+	uint64_t length;
+} cksum_region_msg_t;
+
+// the reply is again an int checksum, errors are EINVAL (bad handle or region size),
+// ENOENT (no region attached) or EBADMSG (offset/length outside the region)
+
 #endif //_IOV_SERVER_H_
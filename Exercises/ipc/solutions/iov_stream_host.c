@@ -0,0 +1,169 @@
+////////////////////////////////////////////////////////////////////////////////
+// iov_stream_host.c
+//
+// Linux stand-in for iov_server's streaming mode (iov_server -s).
+//
+// The "client" payload is generated on the fly from a pattern, and the read
+// callback copies it into the server's window the way MsgRead() copies out
+// of the client's address space.  For each payload size from 1k to 1G the
+// streamed checksum is compared against one computed independently from the
+// pattern, and the time taken and the process' peak RSS are reported, which
+// should stay flat however large the payload gets.
+//
+// -c bytes  streaming window size (default 64k)
+// -m bytes  largest payload (default 1G)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "cksum.h"
+#include "cksum_stream.h"
+
+// a prime length, so chunks and pattern repeats don't line up
+#define PATTERN_LEN 4093
+
+static char pattern[PATTERN_LEN];
+
+typedef struct
+{
+	size_t size; // bytes the client "sent"
+	unsigned long reads; // number of read callbacks
+} client_t;
+
+// stands in for MsgRead(): copy up to nbytes at offset out of the client's data
+static ssize_t client_read(void *handle, void *buf, size_t nbytes, size_t offset)
+{
+	client_t *client = handle;
+	char *dst = buf;
+	size_t copied = 0, pos, n;
+
+	client->reads++;
+	if (offset >= client->size)
+		return 0;
+	if (nbytes > client->size - offset)
+		nbytes = client->size - offset;
+
+	while (copied < nbytes)
+	{
+		pos = (offset + copied) % PATTERN_LEN;
+		n = PATTERN_LEN - pos;
+		if (n > nbytes - copied)
+			n = nbytes - copied;
+		memcpy(dst + copied, pattern + pos, n);
+		copied += n;
+	}
+	return copied;
+}
+
+// the checksum of size bytes of the repeated pattern, worked out with a plain
+// byte loop over one copy of the pattern
+static int expected_checksum(size_t size)
+{
+	unsigned full = 0, partial = 0;
+	size_t i, rem = size % PATTERN_LEN;
+
+	for (i = 0; i < PATTERN_LEN; i++)
+	{
+		full += (unsigned)(int)pattern[i];
+		if (i < rem)
+			partial += (unsigned)(int)pattern[i];
+	}
+	return (int)(full * (unsigned)(size / PATTERN_LEN) + partial);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long peak_rss_kb(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_maxrss;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	size_t max_size = 1024UL * 1024 * 1024;
+	size_t size, nread;
+	client_t client;
+	int checksum, expected;
+	double start, elapsed;
+	int failed = 0;
+	int i;
+
+	while ((opt = getopt(argc, argv, "c:m:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'c':
+			if (-1 == cksum_stream_set_chunk_size(strtoul(optarg, NULL, 0)))
+			{
+				perror("chunk size");
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'm':
+			max_size = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	srand(2);
+	for (i = 0; i < PATTERN_LEN; i++)
+		pattern[i] = rand();
+
+	printf("kernel %s, window %zu bytes\n", cksum_kernel_name(cksum_kernel_current()),
+			cksum_stream_chunk_size());
+	printf("%12s %10s %10s %10s %12s %s\n", "bytes", "reads", "seconds", "GB/s", "peak rss kb",
+			"result");
+
+	for (size = 1024; size <= max_size; size *= 4)
+	{
+		client.size = size;
+		client.reads = 0;
+
+		start = now();
+		if (-1 == cksum_stream(client_read, &client, 0, size, &checksum, &nread))
+		{
+			perror("cksum_stream");
+			exit(EXIT_FAILURE);
+		}
+		elapsed = now() - start;
+
+		expected = expected_checksum(size);
+		if (checksum != expected || nread != size)
+			failed = 1;
+		printf("%12zu %10lu %10.4f %10.2f %12ld %s\n", size, client.reads, elapsed,
+				size / elapsed / 1e9, peak_rss_kb(),
+				(checksum == expected && nread == size) ? "ok" : "MISMATCH");
+	}
+
+	// a client that claims more data than it sent gets the checksum of what it did send
+	client.size = 10000;
+	if (-1 == cksum_stream(client_read, &client, 0, 20000, &checksum, &nread)
+			|| nread != 10000 || checksum != expected_checksum(10000))
+	{
+		printf("short payload: MISMATCH\n");
+		failed = 1;
+	}
+	else
+	{
+		printf("short payload: ok\n");
+	}
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,240 @@
+////////////////////////////////////////////////////////////////////////////////
+// msg_latency.c
+//
+// Round trip latency of bare message passing between two processes: the
+// parent creates a channel and serves it, a forked child connects to it and
+// times MsgSend() for each message size, replying with 4 bytes as the
+// checksum servers do.  Then it times a burst of pulses, ended by one
+// MsgSend() so the time covers the server receiving all of them.  The
+// server stops when the client disconnects.
+//
+// Built for QNX as msg_latency, and for Linux ("make host") as
+// msg_latency_host against the message passing stand-in in ../host, so the
+// two can be compared.
+//
+// -n count   round trips per size (default 100000)
+// -s sizes   comma separated message sizes (default 0,64,1024,16384,65536)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <sys/neutrino.h>
+#include <sys/iomsg.h>
+
+#include "cksum_hist.h"
+
+#define LATENCY_MSG_TYPE (_IO_MAX + 1)
+#define LATENCY_PULSE_CODE (_PULSE_CODE_MINAVAIL + 1)
+
+#define MAX_MSG_SIZE (1024 * 1024)
+#define WARMUP 1000
+
+typedef union
+{
+	uint16_t type;
+	struct _pulse pulse;
+	char data[MAX_MSG_SIZE];
+} recv_buf_t;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void serve(int chid)
+{
+	static recv_buf_t rbuf;
+	uint32_t result = 0;
+	int rcvid;
+
+	while (1)
+	{
+		rcvid = MsgReceive(chid, &rbuf, sizeof(rbuf), NULL);
+		if (-1 == rcvid)
+		{
+			perror("MsgReceive");
+			exit(EXIT_FAILURE);
+		}
+		if (0 == rcvid)
+		{
+			// done when the client has gone, however it went
+			if (_PULSE_CODE_DISCONNECT == rbuf.pulse.code)
+				return;
+			continue;
+		}
+		if (-1 == MsgReply(rcvid, EOK, &result, sizeof(result)))
+			perror("MsgReply");
+	}
+}
+
+static void send_or_die(int coid, const void *msg, size_t len)
+{
+	uint32_t result;
+
+	if (-1 == MsgSend(coid, msg, len, &result, sizeof(result)))
+	{
+		perror("MsgSend");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void measure(int coid, char *msg, size_t size, unsigned count, cksum_hist_t *hist)
+{
+	uint16_t type = LATENCY_MSG_TYPE;
+	uint64_t start, t0, t1;
+	unsigned i;
+
+	// every message starts with its type, a 0 byte one is sent as just that
+	if (size < sizeof(type))
+		size = sizeof(type);
+	memcpy(msg, &type, sizeof(type));
+
+	for (i = 0; i < WARMUP; i++)
+		send_or_die(coid, msg, size);
+
+	cksum_hist_reset(hist);
+	start = t0 = now_ns();
+	for (i = 0; i < count; i++)
+	{
+		send_or_die(coid, msg, size);
+		t1 = now_ns();
+		cksum_hist_record(hist, t1 - t0);
+		t0 = t1;
+	}
+	printf("%8zu %12.0f %8.2f %8.2f %8.2f %8.2f %8.2f\n", size,
+			count / ((t0 - start) / 1e9), cksum_hist_min(hist) / 1e3,
+			cksum_hist_percentile(hist, 50) / 1e3, cksum_hist_percentile(hist, 99) / 1e3,
+			cksum_hist_percentile(hist, 99.9) / 1e3, cksum_hist_max(hist) / 1e3);
+}
+
+static void measure_pulses(int coid, unsigned count)
+{
+	uint16_t type = LATENCY_MSG_TYPE;
+	uint64_t start, elapsed;
+	unsigned i;
+
+	start = now_ns();
+	for (i = 0; i < count; i++)
+	{
+		if (-1 == MsgSendPulse(coid, -1, LATENCY_PULSE_CODE, i))
+		{
+			perror("MsgSendPulse");
+			exit(EXIT_FAILURE);
+		}
+	}
+	// the server takes pulses and messages in order, so this waits for all
+	send_or_die(coid, &type, sizeof(type));
+	elapsed = now_ns() - start;
+	printf("pulses: %.0f/s, %.2f us each\n", count / (elapsed / 1e9), elapsed / 1e3 / count);
+}
+
+static void client(pid_t server_pid, int chid, unsigned count, const char *sizes)
+{
+	cksum_hist_t *hist;
+	char *msg;
+	char *list, *tok, *save;
+	size_t size;
+	int coid;
+
+	coid = ConnectAttach(0, server_pid, chid, _NTO_SIDE_CHANNEL, 0);
+	if (-1 == coid)
+	{
+		perror("ConnectAttach");
+		exit(EXIT_FAILURE);
+	}
+	msg = calloc(1, MAX_MSG_SIZE);
+	hist = cksum_hist_create();
+	list = strdup(sizes);
+	if (NULL == msg || NULL == hist || NULL == list)
+	{
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+
+	printf("%u round trips per size, times in us\n", count);
+	printf("%8s %12s %8s %8s %8s %8s %8s\n", "bytes", "round/s", "min", "p50", "p99",
+			"p99.9", "max");
+	for (tok = strtok_r(list, ",", &save); NULL != tok; tok = strtok_r(NULL, ",", &save))
+	{
+		size = strtoul(tok, NULL, 0);
+		if (size > MAX_MSG_SIZE)
+		{
+			fprintf(stderr, "sizes are limited to %d bytes\n", MAX_MSG_SIZE);
+			exit(EXIT_FAILURE);
+		}
+		measure(coid, msg, size, count, hist);
+	}
+	measure_pulses(coid, count);
+
+	ConnectDetach(coid);
+	cksum_hist_destroy(hist);
+	free(list);
+	free(msg);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *sizes = "0,64,1024,16384,65536";
+	unsigned count = 100000;
+	int opt;
+	int chid;
+	int status;
+	pid_t pid;
+
+	while ((opt = getopt(argc, argv, "n:s:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			sizes = optarg;
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (0 == count)
+	{
+		fprintf(stderr, "count must be positive\n");
+		exit(EXIT_FAILURE);
+	}
+
+	chid = ChannelCreate(_NTO_CHF_DISCONNECT);
+	if (-1 == chid)
+	{
+		perror("ChannelCreate");
+		exit(EXIT_FAILURE);
+	}
+
+	// flush before forking, or the child prints our buffered output again
+	fflush(stdout);
+	pid = fork();
+	if (-1 == pid)
+	{
+		perror("fork");
+		exit(EXIT_FAILURE);
+	}
+	if (0 == pid)
+	{
+		client(getppid(), chid, count, sizes);
+		exit(EXIT_SUCCESS);
+	}
+
+	serve(chid);
+	if (-1 == waitpid(pid, &status, 0) || !WIFEXITED(status) || EXIT_SUCCESS != WEXITSTATUS(status))
+	{
+		fprintf(stderr, "client failed\n");
+		exit(EXIT_FAILURE);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,241 @@
+////////////////////////////////////////////////////////////////////////////////
+// name_cache_bench.c
+//
+// Time from a server coming back after a restart to its first request from
+// a client that lost it, with the client finding the server the way
+// rbt_client and the hw_server clients used to (name_open() every interval
+// until it works) and with name_cache_send() (name_cache.h).
+//
+// The parent starts a server process, lets the client use it for a while,
+// kills it, and after a short random pause starts the next one, round after
+// round.  The client sends requests as fast as it can; every reply carries
+// which server it came from and when that server attached its name, so
+// the first reply from each new server gives the time to first request.
+//
+// Built for QNX as name_cache_bench, and for Linux ("make host") as
+// name_cache_bench_host against the message passing stand-in in ../host.
+//
+// -r rounds   server restarts per mode (default 5)
+// -p ms       polling interval (default 1000, as the clients used)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/neutrino.h>
+#include <sys/iomsg.h>
+#include <sys/dispatch.h>
+
+#include "name_cache.h"
+
+#define BENCH_SERVER_NAME "name_cache_bench"
+#define BENCH_MSG_TYPE (_IO_MAX + 1)
+
+typedef struct
+{
+	uint32_t generation;
+	uint64_t attached_ns; // CLOCK_MONOTONIC when its name was attached
+} bench_reply_t;
+
+typedef union
+{
+	uint16_t type;
+	struct _pulse pulse;
+	char data[64];
+} recv_buf_t;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void serve(uint32_t generation)
+{
+	name_attach_t *attach;
+	bench_reply_t reply;
+	recv_buf_t rbuf;
+	int rcvid;
+
+	attach = name_attach(NULL, BENCH_SERVER_NAME, 0);
+	if (NULL == attach)
+	{
+		perror("name_attach");
+		exit(EXIT_FAILURE);
+	}
+	reply.generation = generation;
+	reply.attached_ns = now_ns();
+	while (1)
+	{
+		rcvid = MsgReceive(attach->chid, &rbuf, sizeof(rbuf), NULL);
+		if (-1 == rcvid)
+		{
+			perror("MsgReceive");
+			exit(EXIT_FAILURE);
+		}
+		if (0 == rcvid)
+			continue;
+		// name_open() sends this
+		if (_IO_CONNECT == rbuf.type)
+			MsgReply(rcvid, EOK, NULL, 0);
+		else if (BENCH_MSG_TYPE == rbuf.type)
+			MsgReply(rcvid, EOK, &reply, sizeof(reply));
+		else
+			MsgError(rcvid, ENOSYS);
+	}
+}
+
+// what the clients did: name_open() every poll_ms until it works
+static long send_polling(int *coid, unsigned poll_ms, const void *msg, size_t len,
+		bench_reply_t *reply)
+{
+	long ret;
+
+	while (1)
+	{
+		while (-1 == *coid)
+		{
+			*coid = name_open(BENCH_SERVER_NAME, 0);
+			if (-1 == *coid)
+				usleep(poll_ms * 1000);
+		}
+		ret = MsgSend(*coid, msg, len, reply, sizeof(*reply));
+		if (-1 != ret || (ESRCH != errno && EBADF != errno))
+			return ret;
+		name_close(*coid);
+		*coid = -1;
+	}
+}
+
+static void client(int cached, unsigned rounds, unsigned poll_ms)
+{
+	uint16_t type = BENCH_MSG_TYPE;
+	bench_reply_t reply;
+	uint32_t generation = 0;
+	uint64_t total = 0, worst = 0, t;
+	int coid = -1;
+	long ret;
+
+	while (generation < rounds)
+	{
+		if (cached)
+			ret = name_cache_send(BENCH_SERVER_NAME, &type, sizeof(type), &reply, sizeof(reply));
+		else
+			ret = send_polling(&coid, poll_ms, &type, sizeof(type), &reply);
+		if (-1 == ret)
+		{
+			perror("MsgSend");
+			exit(EXIT_FAILURE);
+		}
+		if (reply.generation == generation)
+			continue;
+		// first reply from a new server
+		generation = reply.generation;
+		t = now_ns() - reply.attached_ns;
+		total += t;
+		if (t > worst)
+			worst = t;
+	}
+	printf("%-8s %12.1f %12.1f\n", cached ? "cached" : "polling", total / 1e3 / rounds,
+			worst / 1e3);
+	exit(EXIT_SUCCESS);
+}
+
+static pid_t start(void)
+{
+	pid_t pid;
+
+	// flush before forking, or the child prints our buffered output again
+	fflush(stdout);
+	pid = fork();
+	if (-1 == pid)
+	{
+		perror("fork");
+		exit(EXIT_FAILURE);
+	}
+	return pid;
+}
+
+static void run(int cached, unsigned rounds, unsigned poll_ms)
+{
+	struct timespec pause;
+	pid_t client_pid, server_pid;
+	unsigned hold_ms;
+	uint32_t generation;
+	int status;
+
+	// long enough for the polling client to find each server
+	hold_ms = poll_ms + 200;
+
+	server_pid = start();
+	if (0 == server_pid)
+		serve(0);
+	// the first server is up before the client starts
+	usleep(100000);
+	client_pid = start();
+	if (0 == client_pid)
+		client(cached, rounds, poll_ms);
+
+	for (generation = 1; generation <= rounds; generation++)
+	{
+		usleep(hold_ms * 1000);
+		kill(server_pid, SIGKILL);
+		waitpid(server_pid, NULL, 0);
+		// the client is left without a server for 0 to 20 ms
+		pause.tv_sec = 0;
+		pause.tv_nsec = (rand() % 20000) * 1000;
+		nanosleep(&pause, NULL);
+		server_pid = start();
+		if (0 == server_pid)
+			serve(generation);
+	}
+	waitpid(client_pid, &status, 0);
+	kill(server_pid, SIGKILL);
+	waitpid(server_pid, NULL, 0);
+	if (!WIFEXITED(status) || EXIT_SUCCESS != WEXITSTATUS(status))
+	{
+		fprintf(stderr, "client failed\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned rounds = 5;
+	unsigned poll_ms = 1000;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "r:p:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'r':
+			rounds = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			poll_ms = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (0 == rounds)
+	{
+		fprintf(stderr, "rounds must be positive\n");
+		exit(EXIT_FAILURE);
+	}
+
+	srand(3);
+	printf("%u server restarts, time to first request in us\n", rounds);
+	printf("%-8s %12s %12s\n", "client", "mean", "max");
+	run(0, rounds, poll_ms);
+	run(1, rounds, poll_ms);
+	return EXIT_SUCCESS;
+}
@@ -10,26 +10,48 @@
 //
 // To complete the exercise, put in the code, as explained in the comments below
 // Look up function arguments in the course book or the QNX documentation.
+//
+// "name_lookup_client -s" prints the server's result cache counters instead.
+// "name_lookup_client -a algorithm text" checksums the text with the given
+// algorithm (sum, crc32c or xxh64) and prints the 64 bit result.
+// "name_lookup_client -d deadline_us text" asks for the checksum within
+// deadline_us, for a server scheduling by deadline (name_lookup_server -E).
+// "name_lookup_client -f algorithm file" has the server checksum the file
+// itself, without sending its contents; we must be able to read it.
+//
+// The string goes as a cksum_str_hdr_t followed by just its bytes, so
+// strings longer than MAX_STRING_LEN are checksummed whole.
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <sys/neutrino.h>
 #include <sys/netmgr.h>     // #define for ND_LOCAL_NODE is in here
 #include "msg_def.h"
+#include "cksum_cache.h"
+#include "cksum.h"
+#include "cksum_str.h"
 #include <sys/iofunc.h>
 #include <sys/dispatch.h>
 
 int main(int argc, char* argv[])
 {
 	int coid; //Connection ID to server
-	cksum_msg_t msg;
 	int incoming_checksum; //space for server's reply
 	int status; //status return value used for MsgSend
 	//	int server_pid;   //server's process ID
 	//	int server_chid;  //server's channel ID
-	int len;
+	size_t len;
+	uint16_t stats_msg_type = CKSUM_CACHE_STATS_MSG_TYPE;
+	cksum_cache_stats_t stats;
+	cksum_algo_hdr_t algo_hdr;
+	cksum_algo_reply_t algo_reply;
+	cksum_file_hdr_t file_hdr;
+	cksum_file_reply_t file_reply;
+	char path[PATH_MAX];
+	iov_t siov[2];
 
 	//	if(4 != argc) {
 	//		printf("ERROR: This program must be started with commandline arguments, for example:\n\n");
@@ -41,7 +63,8 @@ int main(int argc, char* argv[])
 	//		exit(EXIT_FAILURE);
 	//	}
 
-	if (2 != argc)
+	if (2 != argc && !(4 == argc && (0 == strcmp(argv[1], "-a") || 0 == strcmp(argv[1], "-d")
+			|| 0 == strcmp(argv[1], "-f"))))
 	{
 		printf("ERROR: provide a string to send\n");
 		exit(EXIT_FAILURE);
@@ -67,19 +90,90 @@ int main(int argc, char* argv[])
 		exit(EXIT_FAILURE);
 	}
 
-	msg.msg_type = CKSUM_MSG_TYPE;
-	//	strcpy(msg.string_to_cksum, argv[3]);
+	if (0 == strcmp(argv[1], "-s"))
+	{
+		if (-1 == MsgSend(coid, &stats_msg_type, sizeof(stats_msg_type), &stats, sizeof(stats)))
+		{
+			perror("MsgSend");
+			exit(EXIT_FAILURE);
+		}
+		printf("cache hits %llu, misses %llu, evictions %llu, bypassed %llu\n",
+				(unsigned long long)stats.hits, (unsigned long long)stats.misses,
+				(unsigned long long)stats.evictions, (unsigned long long)stats.bypassed);
+		printf("cache entries %u of %u\n", stats.entries, stats.capacity);
+		return EXIT_SUCCESS;
+	}
+
+	if (4 == argc && 0 == strcmp(argv[1], "-d"))
+	{
+		if (-1 == cksum_str_send_deadline(coid, argv[3], strlen(argv[3]),
+				strtoul(argv[2], NULL, 0), &incoming_checksum))
+		{
+			perror("MsgSend");
+			exit(EXIT_FAILURE);
+		}
+		printf("received checksum=%d from server\n", incoming_checksum);
+		return EXIT_SUCCESS;
+	}
+
+	if (4 == argc && 0 == strcmp(argv[1], "-f"))
+	{
+		// the server has its own working directory
+		if (NULL == realpath(argv[3], path))
+		{
+			perror(argv[3]);
+			exit(EXIT_FAILURE);
+		}
+		if (strlen(path) > CKSUM_FILE_MAX_PATH)
+		{
+			fprintf(stderr, "%s: path too long\n", path);
+			exit(EXIT_FAILURE);
+		}
+		file_hdr.msg_type = CKSUM_FILE_MSG_TYPE;
+		for (file_hdr.algorithm = 0; file_hdr.algorithm < CKSUM_ALGO_COUNT; file_hdr.algorithm++)
+			if (0 == strcmp(argv[2], cksum_algo_name(file_hdr.algorithm)))
+				break;
+		file_hdr.path_len = strlen(path);
+		file_hdr.zero = 0;
+		SETIOV(&siov[0], &file_hdr, sizeof(file_hdr));
+		SETIOV(&siov[1], path, file_hdr.path_len);
+		if (-1 == MsgSendvs(coid, siov, 2, &file_reply, sizeof(file_reply)))
+		{
+			perror("MsgSend");
+			exit(EXIT_FAILURE);
+		}
+		printf("received %s=%#llx for %llu bytes of %s from server\n", argv[2],
+				(unsigned long long)file_reply.result, (unsigned long long)file_reply.size, path);
+		return EXIT_SUCCESS;
+	}
+
+	if (4 == argc)
+	{
+		algo_hdr.msg_type = CKSUM_ALGO_MSG_TYPE;
+		for (algo_hdr.algorithm = 0; algo_hdr.algorithm < CKSUM_ALGO_COUNT; algo_hdr.algorithm++)
+			if (0 == strcmp(argv[2], cksum_algo_name(algo_hdr.algorithm)))
+				break;
+		algo_hdr.data_size = strlen(argv[3]);
+		SETIOV(&siov[0], &algo_hdr, sizeof(algo_hdr));
+		SETIOV(&siov[1], argv[3], algo_hdr.data_size);
+		if (-1 == MsgSendvs(coid, siov, 2, &algo_reply, sizeof(algo_reply)))
+		{
+			perror("MsgSend");
+			exit(EXIT_FAILURE);
+		}
+		printf("received %s=%#llx from server\n", argv[2],
+				(unsigned long long)algo_reply.result);
+		return EXIT_SUCCESS;
+	}
 
-	strncpy(msg.string_to_cksum, argv[1], MAX_STRING_LEN );
-	printf("Sending string: %s\n", msg.string_to_cksum);
+	printf("Sending string: %s\n", argv[1]);
 
-	len = strlen(msg.string_to_cksum);
+	len = strlen(argv[1]);
 	if (-1 == MsgSendPulse(coid, PULSE_PRIORITY, CKSUM_PULSE_CODE, len))
 		perror("MsgSendPulse");
 
 	//PUT CODE HERE to send message to server and get the reply
-	status = MsgSend(coid, &msg, sizeof(msg.msg_type) + len + 1, &incoming_checksum,
-			sizeof(incoming_checksum));
+	status = cksum_str_send(coid, argv[1], len, &incoming_checksum);
 	if (-1 == status)
 	{ //was there an error sending to server?
 		perror("MsgSend");
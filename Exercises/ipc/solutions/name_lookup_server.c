@@ -7,49 +7,978 @@
 // The server prints out its pid and chid so that the client can be made aware
 // of them.
 //
-// Using the comments below, put code in to complete the program.  Look up 
+// Using the comments below, put code in to complete the program.  Look up
 // function arguments in the course book or the QNX documentation.
+//
+// By default the server runs a single MsgReceive() loop.  With -t it serves
+// from a thread pool instead, so one slow client doesn't stall the others:
+// the pool keeps between lo_water and hi_water threads blocked in
+// MsgReceive(), creating more (up to the maximum) when too few are waiting.
+//
+// Strings to checksum come as a cksum_str_hdr_t and the string, only as much
+// of which as fits in the receive buffer arrives with the header, or in the
+// fixed size cksum_msg_t older clients send.
+//
+// Clients can also attach shared memory rings and queue requests without
+// blocking (cksum_async.h); those are served when their doorbell pulse comes in.
+//
+// With -E the server schedules by deadline instead: this thread only receives
+// and queues requests, and the workers always serve the one due soonest
+// (cksum_edf.h).  A request's deadline is its own if it carries one
+// (CKSUM_STR_DEADLINE), otherwise it is set by the class the sender's
+// priority falls in.  Requests still queued past their deadline are failed
+// with ETIMEDOUT.  Per class latency percentiles are printed on SIGINT or
+// SIGTERM.
+//
+// An unblock pulse for a request still being worked on (a client timed out
+// or was signalled) cancels it: the checksum stops at the next chunk boundary
+// and the client gets EINTR (cksum_inflight.h).  That needs -t or -E, a
+// single receive loop only sees the pulse once the work is done.  -u turns
+// this off, for comparison.
+//
+// With -S it also accounts requests per connection (cksum_acct.h): count,
+// bytes, service time and worst latency, readable as text at
+// /dev/cksum/stats and as a binary snapshot at /dev/cksum/stats.bin.
+//
+// With -b the single receive loop busy-polls for up to that many
+// microseconds before it blocks, adapting how long to recent gaps between
+// requests (spin_receive.h).  It only pays with a CPU to spare for it.  How
+// the receives went is printed on SIGINT or SIGTERM.
+//
+// With -T it records when it received, started serving, started computing
+// and replied to each string request that carries a trace id
+// (cksum_str_send_traced()), in a ring per thread (cksum_trace.h), and
+// writes them to the given file as CSV on SIGUSR1, for cksum_trace_join.
+// Requests without one cost a flag test.
+//
+// With -P it checksums payloads of at least -L bytes (string, or with any
+// algorithm but XXH64) in chunks spread over a pool of that many worker
+// threads, with the serving thread working on them too (cksum_par.h).
+// One core can't checksum a few hundred megabytes anywhere near as fast as
+// memory delivers them.  The result is the same as in one go.
+//
+// Clients can also name a file for it to checksum (CKSUM_FILE_MSG_TYPE)
+// rather than send its contents.  It is opened only if the client could
+// read it itself and checksummed in place through mapped windows
+// (cksum_file.h).
+//
+// -q          quiet, don't print anything per message (for benchmarking)
+// -t maximum  thread pool mode, with at most this many threads
+// -E workers  deadline scheduling mode, with this many worker threads
+// -l lo_water thread pool: minimum number of threads waiting for work (default 2)
+// -h hi_water thread pool: maximum number of threads waiting for work (default 4)
+// -C bytes    cache results of repeated payloads, using at most this much memory
+// -M bytes    smallest payload worth caching (default 64)
+// -S          per connection accounting, served at /dev/cksum/stats
+// -u          finish requests whose clients unblocked instead of cancelling them
+// -b us       busy-poll for up to this long before blocking in MsgReceive()
+// -n name     attach this name instead of SERVER_NAME, e.g. SERVER_BACKEND_NAME
+//             behind cksum_proxy
+// -i index    attach SERVER_NAME.index, as one of several instances clients
+//             balance over (cksum_pool.h)
+// -T file     record traced requests, written to file on SIGUSR1
+// -P workers  checksum large payloads in parallel, with this many workers
+// -L bytes    smallest payload checksummed in parallel (default 4M)
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
 #include <sys/neutrino.h>
 #include <process.h>
 
 #include "msg_def.h"  //layout of msgs should always defined by a struct, here's its definition
+#include "cksum.h"
+#include "cksum_batch.h"
+#include "cksum_cache.h"
+#include "cksum_async.h"
+#include "cksum_str.h"
+#include "cksum_edf.h"
+#include "cksum_hist.h"
+#include "cksum_acct.h"
+#include "cksum_inflight.h"
+#include "cksum_trace.h"
+#include "cksum_par.h"
+#include "cksum_file.h"
+#include "spin_receive.h"
+
+// the thread pool passes our own per-thread context to its callbacks
+struct server_context;
+#define THREAD_POOL_PARAM_T struct server_context
+#define THREAD_POOL_HANDLE_T name_attach_t
+
 #include <sys/iofunc.h>
 #include <sys/dispatch.h>
 
-int
-calculate_checksum(char *text);
-
 typedef union
 {
 	uint16_t type;
 	cksum_msg_t msg;
+	cksum_str_hdr_t str;
+	cksum_batch_hdr_t batch;
+	cksum_algo_hdr_t algo;
+	cksum_file_hdr_t file;
+	cksum_ring_attach_t ring_attach;
+	cksum_ring_detach_t ring_detach;
 	struct _pulse pulse;
 } recv_buf_t;
 
-int main(void)
+// everything one receiving thread needs, one per pool thread
+typedef struct server_context
+{
+	int chid;
+	int rcvid;
+	struct _msg_info info;
+	cksum_inflight_t inflight;
+	cksum_acct_ref_t acct;
+	recv_buf_t rbuf;
+} server_context_t;
+
+// deadline scheduling (-E): requests are classed by the sender's priority,
+// which also sets their deadline unless the message carries its own
+typedef struct
+{
+	const char *name;
+	int min_priority;
+	uint32_t budget_us;
+} edf_class_t;
+
+static const edf_class_t edf_classes[] =
+{
+	{ "rt", 30, 1000 },
+	{ "high", 16, 5000 },
+	{ "normal", 10, 20000 },
+	{ "bulk", 0, 100000 } };
+
+#define EDF_NUM_CLASSES (sizeof(edf_classes) / sizeof(edf_classes[0]))
+#define EDF_QUEUE_SIZE 4096
+
+typedef struct
+{
+	int rcvid;
+	unsigned cls;
+	uint64_t received_ns;
+	struct _msg_info info;
+	cksum_inflight_t inflight;
+	cksum_acct_ref_t acct;
+	recv_buf_t rbuf;
+} edf_request_t;
+
+typedef struct
+{
+	pthread_mutex_t lock;
+	cksum_hist_t *latency; // received to replied, in ns
+	uint64_t served;
+	uint64_t expired;
+} edf_stats_t;
+
+static cksum_edf_t *edf_queue;
+static edf_stats_t edf_stats[EDF_NUM_CLASSES];
+static volatile sig_atomic_t edf_stop;
+static volatile sig_atomic_t spin_stop;
+
+int quiet = 0;
+int accounting = 0;
+int cancel_on_unblock = 1;
+const char *trace_path = NULL;
+cksum_par_t *par = NULL;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void handle_pulse(struct _pulse *pulse)
+{
+	switch (pulse->code)
+	{
+	case _PULSE_CODE_DISCONNECT:
+		// a client went away, release its server connection
+		if (!quiet)
+			printf("Received disconnect pulse, scoid = %x\n", pulse->scoid);
+		cksum_async_disconnect(pulse->scoid);
+		if (accounting)
+			cksum_acct_disconnect(pulse->scoid);
+		if (-1 == ConnectDetach(pulse->scoid))
+		{
+			perror("ConnectDetach");
+		}
+		break;
+	case _PULSE_CODE_UNBLOCK:
+		// a client hit by a signal or timeout wants out.  Whoever is working
+		// on its request stops and replies EINTR; if nobody is, it has
+		// already had its reply.
+		if (!quiet)
+			printf("Received unblock pulse, rcvid = %x\n", pulse->value.sival_int);
+		if (cancel_on_unblock)
+			(void)cksum_inflight_cancel(pulse->value.sival_int);
+		break;
+	case CKSUM_RING_DOORBELL_CODE:
+		// new submissions on an async client's ring
+		cksum_async_doorbell(pulse);
+		break;
+	default:
+		if (pulse->code < 0)
+		{
+			printf("we got a kernel pulse with a code of %d, and value of %d\n",
+					pulse->code, pulse->value.sival_int);
+		}
+		else
+		{
+			printf("we got a pulse with a code of %d, and value of %d\n", pulse->code,
+					pulse->value.sival_int);
+		}
+	}
+}
+
+// checksum len bytes with algo.  Sums go through the result cache: short
+// ones as they are, longer ones looked up with a hash that, like the
+// checksum on a miss, goes a chunk at a time so a cancel stops it within
+// one chunk.  On a miss the chunks are shared out over the -P workers if it
+// is long enough.  Returns 0, or -1 with errno ECANCELED.
+int checksum_payload(cksum_algo_t algo, const void *payload, size_t len,
+		const cksum_inflight_t *req, uint64_t *result)
+{
+	cksum_cache_key_t key;
+	int cksum;
+	int ret;
+
+	if (CKSUM_ALGO_SUM == algo && len <= CKSUM_CANCEL_CHUNK)
+	{
+		*result = (uint32_t)cksum_cache_checksum(payload, len);
+		return 0;
+	}
+	key.cacheable = 0;
+	if (CKSUM_ALGO_SUM == algo)
+	{
+		ret = cksum_cache_lookup(payload, len, &req->cancelled, &key, &cksum);
+		if (-1 == ret)
+			return -1;
+		if (1 == ret)
+		{
+			*result = (uint32_t)cksum;
+			return 0;
+		}
+	}
+	if (NULL != par)
+		ret = cksum_par_run(par, algo, payload, len, &req->cancelled, result);
+	else
+		ret = cksum_algo_run_cancellable(algo, payload, len, &req->cancelled, result);
+	if (0 == ret)
+		cksum_cache_insert(&key, (int)*result);
+	return ret;
+}
+
+// checksum with the algorithm the client asked for.  Data that fit in the
+// receive buffer arrived with the header, anything longer is read in.
+void handle_algo(int rcvid, recv_buf_t *rbuf, const struct _msg_info *info,
+		const cksum_inflight_t *req)
+{
+	const cksum_algo_hdr_t *hdr = &rbuf->algo;
+	size_t received = info->msglen < sizeof(*rbuf) ? info->msglen : sizeof(*rbuf);
+	cksum_algo_reply_t reply;
+	const void *payload;
+	char *data = NULL;
+
+	// data_size is the client's word: no more than it actually sent, and
+	// nothing allocated on it before that is known
+	if (received < sizeof(*hdr) || info->srcmsglen < sizeof(*hdr)
+			|| hdr->data_size > info->srcmsglen - sizeof(*hdr))
+	{
+		if (-1 == MsgError(rcvid, EBADMSG))
+			perror("MsgError");
+		return;
+	}
+	if (hdr->algorithm >= CKSUM_ALGO_COUNT)
+	{
+		if (-1 == MsgError(rcvid, EINVAL))
+			perror("MsgError");
+		return;
+	}
+
+	if (hdr->data_size <= received - sizeof(*hdr))
+	{
+		payload = hdr + 1;
+	}
+	else
+	{
+		data = malloc(hdr->data_size);
+		if (NULL == data)
+		{
+			if (-1 == MsgError(rcvid, ENOMEM))
+				perror("MsgError");
+			return;
+		}
+		if (MsgRead(rcvid, data, hdr->data_size, sizeof(*hdr)) != hdr->data_size)
+		{
+			free(data);
+			if (-1 == MsgError(rcvid, EBADMSG))
+				perror("MsgError");
+			return;
+		}
+		payload = data;
+	}
+
+	if (-1 == checksum_payload(hdr->algorithm, payload, hdr->data_size, req, &reply.result))
+	{
+		free(data);
+		if (-1 == MsgError(rcvid, EINTR))
+			perror("MsgError");
+		return;
+	}
+	free(data);
+
+	if (-1 == MsgReply(rcvid, EOK, &reply, sizeof(reply)))
+	{
+		perror("MsgReply");
+	}
+}
+
+// checksum a file named by the client, if the client could read it itself
+void handle_file(int rcvid, recv_buf_t *rbuf, const struct _msg_info *info,
+		const cksum_inflight_t *req)
+{
+	const cksum_file_hdr_t *hdr = &rbuf->file;
+	char path[CKSUM_FILE_MAX_PATH + 1];
+	struct _client_info client;
+	cksum_file_cred_t cred;
+	cksum_file_reply_t reply;
+	int error = EOK;
+	int fd;
+
+	if (hdr->algorithm >= CKSUM_ALGO_COUNT || 0 == hdr->path_len)
+		error = EINVAL;
+	else if (hdr->path_len > CKSUM_FILE_MAX_PATH)
+		error = ENAMETOOLONG;
+	else if (MsgRead(rcvid, path, hdr->path_len, sizeof(*hdr)) != hdr->path_len)
+		error = EBADMSG;
+	if (EOK != error)
+	{
+		if (-1 == MsgError(rcvid, error))
+			perror("MsgError");
+		return;
+	}
+	path[hdr->path_len] = '\0';
+	if (strlen(path) != hdr->path_len)
+		error = EINVAL; // a nul in it would have us open something else
+	else if (-1 == ConnectClientInfo(info->scoid, &client, NGROUPS_MAX))
+		error = errno;
+	if (EOK != error)
+	{
+		if (-1 == MsgError(rcvid, error))
+			perror("MsgError");
+		return;
+	}
+
+	// what the kernel would check the client's own open() against
+	cred.uid = client.cred.euid;
+	cred.gid = client.cred.egid;
+	cred.groups = client.cred.grouplist;
+	cred.ngroups = client.cred.ngroups;
+	fd = cksum_file_open(path, &cred);
+	if (-1 == fd)
+	{
+		if (-1 == MsgError(rcvid, errno))
+			perror("MsgError");
+		return;
+	}
+	if (-1 == cksum_file_fd(fd, hdr->algorithm, &req->cancelled, &reply.result, &reply.size))
+	{
+		error = ECANCELED == errno ? EINTR : errno;
+		close(fd);
+		if (-1 == MsgError(rcvid, error))
+			perror("MsgError");
+		return;
+	}
+	close(fd);
+
+	if (-1 == MsgReply(rcvid, EOK, &reply, sizeof(reply)))
+	{
+		perror("MsgReply");
+	}
+}
+
+// checksum a string of any length.  If tracing, trace has when it was
+// received and dequeued, and is filled in and recorded if the message
+// carries a trace id.
+void handle_str(int rcvid, recv_buf_t *rbuf, size_t msglen, const cksum_inflight_t *req,
+		cksum_trace_rec_t *trace)
+{
+	size_t received = msglen < sizeof(*rbuf) ? msglen : sizeof(*rbuf);
+	cksum_str_trace_t ids;
+	const void *payload;
+	void *allocated;
+	uint64_t result;
+	int checksum;
+
+	if (NULL != trace && !cksum_str_trace(&rbuf->str, received, &ids))
+		trace = NULL;
+	payload = cksum_str_payload(rcvid, &rbuf->str, received, &allocated);
+	if (NULL == payload)
+	{
+		if (-1 == MsgError(rcvid, errno))
+			perror("MsgError");
+		return;
+	}
+	if (NULL != trace)
+		trace->compute_ns = now_ns();
+	if (-1 == checksum_payload(CKSUM_ALGO_SUM, payload, rbuf->str.length, req, &result))
+	{
+		free(allocated);
+		if (-1 == MsgError(rcvid, EINTR))
+			perror("MsgError");
+		return;
+	}
+	free(allocated);
+	checksum = result;
+
+	if (NULL != trace)
+		trace->reply_ns = now_ns();
+	if (-1 == MsgReply(rcvid, EOK, &checksum, sizeof(checksum)))
+	{
+		perror("MsgReply");
+	}
+	if (NULL != trace)
+	{
+		trace->trace_id = ids.trace_id;
+		trace->client_ns = ids.client_ns;
+		trace->length = rbuf->str.length;
+		(void)cksum_trace_record(trace);
+	}
+}
+
+void handle_msg(int rcvid, recv_buf_t *rbuf, const struct _msg_info *info,
+		const cksum_inflight_t *req, cksum_trace_rec_t *trace)
+{
+	int status;
+	int checksum;
+	size_t received;
+	cksum_cache_stats_t stats;
+
+	if (!quiet)
+		printf("we got a message with type %d\n", rbuf->type);
+	switch (rbuf->type)
+	{
+	case CKSUM_MSG_TYPE:
+		if (!quiet)
+			printf("Got a checksum message\n");
+		received = info->msglen < sizeof(*rbuf) ? info->msglen : sizeof(*rbuf);
+		checksum = cksum_cache_checksum(rbuf->msg.string_to_cksum,
+				cksum_str_fixed_len(&rbuf->msg, received));
+
+		//PUT CODE HERE TO reply to client with checksum, store the return status in statussum));
+		status = MsgReply(rcvid, EOK, &checksum, sizeof(checksum));
+		if (-1 == status)
+		{
+			perror("MsgReply");
+		}
+		break;
+	case CKSUM_STR_MSG_TYPE:
+		if (!quiet)
+			printf("Got a checksum message of %u bytes\n", rbuf->str.length);
+		handle_str(rcvid, rbuf, info->msglen, req, trace);
+		break;
+	case CKSUM_BATCH_MSG_TYPE:
+		if (!quiet)
+			printf("Got a batch of %u checksum requests\n", rbuf->batch.count);
+		(void)cksum_batch_handle(rcvid, &rbuf->batch);
+		break;
+	case CKSUM_ALGO_MSG_TYPE:
+		if (!quiet)
+			printf("Got a %s checksum request for %u bytes\n",
+					cksum_algo_name(rbuf->algo.algorithm), rbuf->algo.data_size);
+		handle_algo(rcvid, rbuf, info, req);
+		break;
+	case CKSUM_FILE_MSG_TYPE:
+		if (!quiet)
+			printf("Got a %s checksum request for a file\n",
+					cksum_algo_name(rbuf->file.algorithm));
+		handle_file(rcvid, rbuf, info, req);
+		break;
+	case CKSUM_RING_ATTACH_MSG_TYPE:
+		if (!quiet)
+			printf("Got an async ring attach request\n");
+		(void)cksum_async_attach(rcvid, &rbuf->ring_attach, info->scoid, info->pid);
+		break;
+	case CKSUM_RING_DETACH_MSG_TYPE:
+		(void)cksum_async_detach(rcvid, &rbuf->ring_detach, info->scoid);
+		break;
+	case CKSUM_CACHE_STATS_MSG_TYPE:
+		cksum_cache_get_stats(&stats);
+		if (-1 == MsgReply(rcvid, EOK, &stats, sizeof(stats)))
+		{
+			perror("MsgReply");
+		}
+		break;
+	default:
+		// unknown message type, unblock client with an error
+		if (-1 == MsgError(rcvid, ENOSYS))
+			perror("MsgError");
+	}
+}
+
+// what every receive path does as soon as it has a message: make it
+// cancellable, and take hold of its connection's accounting entry before
+// another thread could handle the client's disconnect
+void receive_begin(cksum_inflight_t *req, cksum_acct_ref_t *acct, int rcvid,
+		const struct _msg_info *info)
+{
+	cksum_inflight_begin(req, rcvid);
+	if (accounting)
+		cksum_acct_begin(acct, rcvid, info->scoid, info->pid);
+}
+
+// handle_msg(), accounted to the client's connection, for a request that
+// went in flight (cksum_inflight_begin()) and, with -S, got hold of its
+// connection's entry (receive_begin()) when it was received; it is done
+// with after this.  received_ns is when the message was received if it has
+// been waiting, or 0 if it hasn't.
+void serve_msg(recv_buf_t *rbuf, const struct _msg_info *info, uint64_t received_ns,
+		cksum_inflight_t *req, const cksum_acct_ref_t *acct)
+{
+	cksum_trace_rec_t trace;
+	cksum_trace_rec_t *tracing = NULL;
+	uint64_t start_ns, done_ns;
+
+	// only what the client asked to have traced, the rest go as they are
+	if (NULL != trace_path && CKSUM_STR_MSG_TYPE == rbuf->type
+			&& (rbuf->str.flags & CKSUM_STR_TRACE))
+	{
+		trace.dequeue_ns = now_ns();
+		trace.receive_ns = received_ns ? received_ns : trace.dequeue_ns;
+		tracing = &trace;
+	}
+	if (!accounting)
+	{
+		handle_msg(req->rcvid, rbuf, info, req, tracing);
+		cksum_inflight_end(req);
+		return;
+	}
+	start_ns = now_ns();
+	handle_msg(req->rcvid, rbuf, info, req, tracing);
+	cksum_inflight_end(req);
+	done_ns = now_ns();
+	if (0 == received_ns)
+		received_ns = start_ns;
+	// srcmsglen is all the client sent, msglen only what fitted in rbuf
+	cksum_acct_record(acct, info->srcmsglen ? info->srcmsglen : info->msglen,
+			done_ns - start_ns, done_ns - received_ns);
+}
+
+// thread pool callbacks: each pool thread gets its own context, blocks in
+// MsgReceive() in block_func and handles what it received in handler_func
+server_context_t *context_alloc(name_attach_t *att)
+{
+	server_context_t *ctp;
+
+	ctp = malloc(sizeof(*ctp));
+	if (NULL != ctp)
+		ctp->chid = att->chid;
+	return ctp;
+}
+
+void context_free(server_context_t *ctp)
+{
+	free(ctp);
+}
+
+server_context_t *context_block(server_context_t *ctp)
+{
+	ctp->rcvid = MsgReceive(ctp->chid, &ctp->rbuf, sizeof(ctp->rbuf), &ctp->info);
+	if (ctp->rcvid > 0)
+		receive_begin(&ctp->inflight, &ctp->acct, ctp->rcvid, &ctp->info);
+	return ctp;
+}
+
+int context_handler(server_context_t *ctp)
+{
+	if (-1 == ctp->rcvid)
+		perror("MsgReceive");
+	else if (0 == ctp->rcvid)
+		handle_pulse(&ctp->rbuf.pulse);
+	else
+		serve_msg(&ctp->rbuf, &ctp->info, 0, &ctp->inflight, &ctp->acct);
+	return 0;
+}
+
+void run_thread_pool(name_attach_t *att, int lo_water, int hi_water, int maximum)
+{
+	thread_pool_attr_t pool_attr;
+	thread_pool_t *tpp;
+
+	// keep the water marks consistent with the maximum
+	if (maximum < 1)
+		maximum = 1;
+	if (hi_water > maximum)
+		hi_water = maximum;
+	if (lo_water > hi_water)
+		lo_water = hi_water;
+	if (lo_water < 1)
+		lo_water = 1;
+
+	printf("thread pool: lo_water %d, hi_water %d, maximum %d\n", lo_water, hi_water, maximum);
+
+	memset(&pool_attr, 0, sizeof(pool_attr));
+	pool_attr.handle = att;
+	pool_attr.context_alloc = context_alloc;
+	pool_attr.context_free = context_free;
+	pool_attr.block_func = context_block;
+	pool_attr.handler_func = context_handler;
+	pool_attr.lo_water = lo_water;
+	pool_attr.hi_water = hi_water;
+	pool_attr.increment = 1;
+	pool_attr.maximum = maximum;
+
+	tpp = thread_pool_create(&pool_attr, POOL_FLAG_EXIT_SELF);
+	if (NULL == tpp)
+	{
+		perror("thread_pool_create");
+		exit(EXIT_FAILURE);
+	}
+
+	// doesn't return, this thread exits and the pool carries on
+	thread_pool_start(tpp);
+}
+
+// the tightest class whose budget still covers the deadline
+unsigned edf_class_for_deadline(uint32_t deadline_us)
+{
+	unsigned i;
+
+	for (i = 0; i < EDF_NUM_CLASSES - 1; i++)
+		if (deadline_us <= edf_classes[i].budget_us)
+			break;
+	return i;
+}
+
+unsigned edf_class_for_priority(int priority)
+{
+	unsigned i;
+
+	for (i = 0; i < EDF_NUM_CLASSES - 1; i++)
+		if (priority >= edf_classes[i].min_priority)
+			break;
+	return i;
+}
+
+void *edf_worker(void *arg)
+{
+	edf_request_t *req;
+	edf_stats_t *stats;
+	uint64_t deadline_ns;
+	uint64_t done_ns;
+
+	while (NULL != (req = cksum_edf_pop(edf_queue, &deadline_ns)))
+	{
+		stats = &edf_stats[req->cls];
+		if (cksum_inflight_cancelled(&req->inflight))
+		{
+			// the client gave up while it was queued
+			if (-1 == MsgError(req->rcvid, EINTR))
+				perror("MsgError");
+			cksum_inflight_end(&req->inflight);
+		}
+		else if (now_ns() > deadline_ns)
+		{
+			// too late to be any use, don't spend time on it
+			if (-1 == MsgError(req->rcvid, ETIMEDOUT))
+				perror("MsgError");
+			cksum_inflight_end(&req->inflight);
+			pthread_mutex_lock(&stats->lock);
+			stats->expired++;
+			pthread_mutex_unlock(&stats->lock);
+		}
+		else
+		{
+			serve_msg(&req->rbuf, &req->info, req->received_ns, &req->inflight, &req->acct);
+			done_ns = now_ns();
+			pthread_mutex_lock(&stats->lock);
+			cksum_hist_record(stats->latency, done_ns - req->received_ns);
+			stats->served++;
+			pthread_mutex_unlock(&stats->lock);
+		}
+		free(req);
+	}
+	return NULL;
+}
+
+void edf_report(void)
+{
+	const edf_class_t *cls;
+	edf_stats_t *stats;
+	unsigned i;
+
+	printf("%-8s %5s %10s %10s %10s %9s %9s %9s\n", "class", "prio", "budget_us", "served",
+			"expired", "p50_us", "p99_us", "p99.9_us");
+	for (i = 0; i < EDF_NUM_CLASSES; i++)
+	{
+		cls = &edf_classes[i];
+		stats = &edf_stats[i];
+		pthread_mutex_lock(&stats->lock);
+		printf("%-8s %5d %10u %10llu %10llu %9.1f %9.1f %9.1f\n", cls->name,
+				cls->min_priority, cls->budget_us, (unsigned long long)stats->served,
+				(unsigned long long)stats->expired,
+				cksum_hist_percentile(stats->latency, 50) / 1e3,
+				cksum_hist_percentile(stats->latency, 99) / 1e3,
+				cksum_hist_percentile(stats->latency, 99.9) / 1e3);
+		pthread_mutex_unlock(&stats->lock);
+	}
+}
+
+void edf_on_signal(int signo)
+{
+	edf_stop = 1;
+}
+
+// receive and queue, the workers do the rest.  Doesn't return.
+void run_edf(name_attach_t *att, int workers)
+{
+	edf_request_t *req = NULL;
+	struct sigaction sa;
+	sigset_t sigs;
+	pthread_t tid;
+	uint32_t deadline_us;
+	size_t received;
+	unsigned i;
+
+	edf_queue = cksum_edf_create(EDF_QUEUE_SIZE);
+	if (NULL == edf_queue)
+	{
+		perror("cksum_edf_create");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < EDF_NUM_CLASSES; i++)
+	{
+		pthread_mutex_init(&edf_stats[i].lock, NULL);
+		edf_stats[i].latency = cksum_hist_create();
+		if (NULL == edf_stats[i].latency)
+		{
+			perror("cksum_hist_create");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// the signals that stop us must interrupt this thread's MsgReceive(),
+	// so the workers don't take them
+	sigemptyset(&sigs);
+	sigaddset(&sigs, SIGINT);
+	sigaddset(&sigs, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+	for (i = 0; i < workers; i++)
+	{
+		if (EOK != pthread_create(&tid, NULL, edf_worker, NULL))
+		{
+			fprintf(stderr, "can't create worker threads\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	pthread_sigmask(SIG_UNBLOCK, &sigs, NULL);
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = edf_on_signal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	printf("deadline scheduling: %d workers\n", workers);
+
+	while (!edf_stop)
+	{
+		if (NULL == req)
+		{
+			req = malloc(sizeof(*req));
+			if (NULL == req)
+			{
+				perror("malloc");
+				exit(EXIT_FAILURE);
+			}
+		}
+		req->rcvid = MsgReceive(att->chid, &req->rbuf, sizeof(req->rbuf), &req->info);
+		if (-1 == req->rcvid)
+		{
+			if (EINTR == errno)
+				continue;
+			perror("MsgReceive");
+			exit(EXIT_FAILURE);
+		}
+		if (0 == req->rcvid)
+		{
+			handle_pulse(&req->rbuf.pulse);
+			continue;
+		}
+
+		req->received_ns = now_ns();
+		receive_begin(&req->inflight, &req->acct, req->rcvid, &req->info);
+		received = req->info.msglen < sizeof(req->rbuf) ? req->info.msglen : sizeof(req->rbuf);
+		if (CKSUM_STR_MSG_TYPE == req->rbuf.type
+				&& cksum_str_deadline(&req->rbuf.str, received, &deadline_us))
+		{
+			req->cls = edf_class_for_deadline(deadline_us);
+		}
+		else
+		{
+			req->cls = edf_class_for_priority(req->info.priority);
+			deadline_us = edf_classes[req->cls].budget_us;
+		}
+		if (-1 == cksum_edf_push(edf_queue, req->received_ns + deadline_us * 1000ULL, req))
+		{
+			// the workers are hopelessly behind, shed load
+			cksum_inflight_end(&req->inflight);
+			if (-1 == MsgError(req->rcvid, EAGAIN))
+				perror("MsgError");
+			continue;
+		}
+		req = NULL;
+	}
+
+	edf_report();
+	exit(EXIT_SUCCESS);
+}
+
+void spin_on_signal(int signo)
+{
+	spin_stop = 1;
+}
+
+void spin_report(const spin_receive_t *spin)
+{
+	unsigned long spun = spin->hits + spin->misses;
+
+	printf("busy-poll: %lu hits, %lu misses, %lu blocked, %.3f s spinning (%.2f us a spin)\n",
+			spin->hits, spin->misses, spin->blocks, spin->spin_ns / 1e9,
+			spun ? spin->spin_ns / 1e3 / spun : 0.0);
+}
+
+int main(int argc, char *argv[])
 {
 	//	int chid;
 	int pid;
 	int rcvid;
 	//	cksum_msg_t msg;
 	recv_buf_t rbuf;
-	int status;
-	int checksum;
+	struct _msg_info info;
+	cksum_inflight_t inflight;
+	cksum_acct_ref_t acct;
 	name_attach_t *att;
+	int opt;
+	int maximum = 0;
+	int edf_workers = 0;
+	int lo_water = 2;
+	int hi_water = 4;
+	size_t cache_budget = 0;
+	size_t cache_min_len = CKSUM_CACHE_DEFAULT_MIN_LEN;
+	unsigned spin_us = 0;
+	unsigned par_workers = 0;
+	size_t par_threshold = CKSUM_PAR_DEFAULT_THRESHOLD;
+	spin_receive_t spin;
+	const char *name = SERVER_NAME;
+	char instance_name[64];
+	struct sigaction sa;
+
+	while ((opt = getopt(argc, argv, "qt:E:l:h:C:M:Sub:n:i:T:P:L:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'q':
+			quiet = 1;
+			break;
+		case 't':
+			maximum = atoi(optarg);
+			break;
+		case 'E':
+			edf_workers = atoi(optarg);
+			break;
+		case 'l':
+			lo_water = atoi(optarg);
+			break;
+		case 'h':
+			hi_water = atoi(optarg);
+			break;
+		case 'C':
+			cache_budget = strtoul(optarg, NULL, 0);
+			break;
+		case 'M':
+			cache_min_len = strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			accounting = 1;
+			break;
+		case 'u':
+			cancel_on_unblock = 0;
+			break;
+		case 'b':
+			spin_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			name = optarg;
+			break;
+		case 'i':
+			snprintf(instance_name, sizeof(instance_name), "%s.%d", SERVER_NAME, atoi(optarg));
+			name = instance_name;
+			break;
+		case 'T':
+			trace_path = optarg;
+			break;
+		case 'P':
+			par_workers = strtoul(optarg, NULL, 0);
+			break;
+		case 'L':
+			par_threshold = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// before any other thread is created, so they all inherit the mask
+	if (NULL != trace_path && -1 == cksum_trace_start_writer(trace_path, "name_lookup_server"))
+	{
+		perror("cksum_trace_start_writer");
+		exit(EXIT_FAILURE);
+	}
 
-	// register our name	
-	att = name_attach(NULL, SERVER_NAME, 0);
+	if (par_workers)
+	{
+		par = cksum_par_create(par_workers, CKSUM_PAR_DEFAULT_CHUNK, par_threshold);
+		if (NULL == par)
+		{
+			perror("cksum_par_create");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (cache_budget && -1 == cksum_cache_init(cache_budget, cache_min_len))
+	{
+		perror("cksum_cache_init");
+		exit(EXIT_FAILURE);
+	}
+
+	// register our name
+	att = name_attach(NULL, name, 0);
 
 	if (NULL == att)
 	{
 		perror("name_attach");
 		exit(EXIT_FAILURE);
 	}
+	if (-1 == cksum_async_server_init(att->chid))
+	{
+		perror("cksum_async_server_init");
+		exit(EXIT_FAILURE);
+	}
+	if (accounting && -1 == cksum_acct_resmgr_start(CKSUM_ACCT_PATH))
+	{
+		perror("cksum_acct_resmgr_start");
+		exit(EXIT_FAILURE);
+	}
+
 	//	chid = ChannelCreate( 0 );
 	//	//PUT CODE HERE to create a channel, store channel id in the chid variable
 	//	if(-1 == chid) {                //was there an error creating the channel?
@@ -61,61 +990,42 @@ int main(void)
 	printf("Server's pid: %d, chid: %d\n", pid, att->chid); //print our pid/chid so
 	//client can be told where to
 	//connect
-	while (1)
+
+	if (edf_workers > 0)
+		run_edf(att, edf_workers);
+	if (maximum > 0)
+		run_thread_pool(att, lo_water, hi_water, maximum);
+
+	spin_receive_init(&spin, spin_us * 1000ULL);
+	if (spin_us)
 	{
-		rcvid = MsgReceive(att->chid, &rbuf, sizeof(rbuf), NULL );
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = spin_on_signal;
+		sigaction(SIGINT, &sa, NULL);
+		sigaction(SIGTERM, &sa, NULL);
+	}
+
+	while (!spin_stop)
+	{
+		rcvid = spin_receive(&spin, att->chid, &rbuf, sizeof(rbuf), &info);
 		//PUT CODE HERE to receive msg from client, store the receive id in rcvid
 		if (rcvid == -1)
 		{ //was there an error receiving msg?
+			if (EINTR == errno && spin_stop)
+				break;
 			perror("MsgReceive"); //look up errno code and print
 			exit(EXIT_FAILURE); //give up
 		}
 		else if (0 == rcvid)
 		{
-			if (rbuf.pulse.code < 0)
-			{
-				printf("we got a kernel pulse with a code of %d, and value of %d\n",
-						rbuf.pulse.code, rbuf.pulse.value.sival_int);
-			}
-			else
-			{
-				printf("we got a pulse with a code of %d, and value of %d\n", rbuf.pulse.code,
-						rbuf.pulse.value.sival_int);
-			}
+			handle_pulse(&rbuf.pulse);
 		}
 		else // we got a message
 		{
-			printf("we got a message with type %d\n", rbuf.type);
-			switch (rbuf.type)
-			{
-			case CKSUM_MSG_TYPE:
-				printf("Got a checksum message\n");
-				checksum = calculate_checksum(rbuf.msg.string_to_cksum);
-
-				//PUT CODE HERE TO reply to client with checksum, store the return status in statussum));
-				status = MsgReply(rcvid, EOK, &checksum, sizeof(checksum));
-				if (-1 == status)
-				{
-					perror("MsgReply");
-				}
-				break;
-			default:
-				// unknown message type, unblock client with an error
-				if (-1 == MsgError(rcvid, ENOSYS))
-					perror("MsgError");
-			}
+			receive_begin(&inflight, &acct, rcvid, &info);
+			serve_msg(&rbuf, &info, 0, &inflight, &acct);
 		}
 	}
+	spin_report(&spin);
 	return 0;
 }
-
-int calculate_checksum(char *text)
-{
-	char *c;
-	int cksum = 0;
-
-	for (c = text; *c != '\0'; c++)
-		cksum += *c;
-	return cksum;
-}
-
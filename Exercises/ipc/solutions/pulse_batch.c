@@ -0,0 +1,62 @@
+////////////////////////////////////////////////////////////////////////////////
+// pulse_batch.c
+//
+// Pulse coalescing, see pulse_batch.h
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "pulse_batch.h"
+
+void pulse_batch_init(pulse_batch_t *batch)
+{
+	memset(batch, 0, sizeof(*batch));
+}
+
+int pulse_batch_add(pulse_batch_t *batch, const struct _pulse *pulse)
+{
+	int i = pulse->code - _PULSE_CODE_MINAVAIL;
+
+	if (pulse->code < _PULSE_CODE_MINAVAIL)
+		return -1;
+	if (0 == batch->count[i]++)
+		batch->codes[batch->ncodes++] = pulse->code;
+	batch->value[i] = pulse->value.sival_int;
+	batch->pulses++;
+	return 0;
+}
+
+int pulse_batch_drain(int chid, pulse_batch_t *batch, void *msg, size_t bytes,
+		struct _msg_info *info)
+{
+	struct sigevent event;
+	int rcvid;
+
+	// a receive with a timeout of nothing won't block: if something is
+	// queued it is received, if not the receive times out at once
+	event.sigev_notify = SIGEV_UNBLOCK;
+	while (1)
+	{
+		TimerTimeout(CLOCK_MONOTONIC, _NTO_TIMEOUT_RECEIVE, &event, NULL, NULL);
+		rcvid = MsgReceive(chid, msg, bytes, info);
+		if (0 != rcvid || -1 == pulse_batch_add(batch, msg))
+			return rcvid;
+	}
+}
+
+void pulse_batch_flush(pulse_batch_t *batch, pulse_batch_fn_t fn, void *arg)
+{
+	unsigned i;
+	int c;
+
+	for (i = 0; i < batch->ncodes; i++)
+	{
+		c = batch->codes[i] - _PULSE_CODE_MINAVAIL;
+		fn(batch->codes[i], batch->count[c], batch->value[c], arg);
+		batch->count[c] = 0;
+	}
+	batch->ncodes = 0;
+	batch->pulses = 0;
+}
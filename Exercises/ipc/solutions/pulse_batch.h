@@ -0,0 +1,51 @@
+#ifndef _PULSE_BATCH_H_
+#define _PULSE_BATCH_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// pulse_batch.h
+//
+// Coalescing pulses: once one pulse has woken a server, it takes every other
+// pulse already queued on the channel with non-blocking receives (as
+// time/nonblockpulserec.c does) and folds them into a count and the latest
+// value per code, so whatever it does for a code is done once per batch
+// rather than once per pulse.
+//
+// Only pulses with codes from _PULSE_CODE_MINAVAIL up are folded.  The
+// kernel's own pulses (disconnect, unblock...) each name a connection or a
+// message, so draining stops at one, as it does at a message, and hands it
+// back to be handled on its own, after the batch so far.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <sys/neutrino.h>
+
+#define PULSE_BATCH_CODES (_PULSE_CODE_MAXAVAIL - _PULSE_CODE_MINAVAIL + 1)
+
+typedef struct
+{
+	unsigned pulses; // folded since the last flush
+	unsigned ncodes;
+	int codes[PULSE_BATCH_CODES]; // the codes seen, in the order first seen
+	unsigned count[PULSE_BATCH_CODES]; // by code - _PULSE_CODE_MINAVAIL
+	int value[PULSE_BATCH_CODES]; // the latest value
+} pulse_batch_t;
+
+// handler for one code of a batch
+typedef void (*pulse_batch_fn_t)(int code, unsigned count, int value, void *arg);
+
+void pulse_batch_init(pulse_batch_t *batch);
+
+// fold pulse in, returns 0, or -1 if its code is not one that is folded
+int pulse_batch_add(pulse_batch_t *batch, const struct _pulse *pulse);
+
+// fold in every pulse queued on chid without waiting.  Returns -1 with errno
+// ETIMEDOUT when nothing is left.  Otherwise returns the rcvid of the first
+// message (> 0) or kernel pulse (0) in the way, which is in msg, or -1 with
+// errno set if a receive failed.
+int pulse_batch_drain(int chid, pulse_batch_t *batch, void *msg, size_t bytes,
+		struct _msg_info *info);
+
+// call fn once for each code in the batch, then empty it
+void pulse_batch_flush(pulse_batch_t *batch, pulse_batch_fn_t fn, void *arg);
+
+#endif //_PULSE_BATCH_H_
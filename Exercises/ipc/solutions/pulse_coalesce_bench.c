@@ -0,0 +1,215 @@
+////////////////////////////////////////////////////////////////////////////////
+// pulse_coalesce_bench.c
+//
+// Pulses handled one at a time, as pulse_server does by default, against
+// coalesced (pulse_server -c, see pulse_batch.h).
+//
+// Producer threads send bursts of pulses over their own connections to a
+// server thread, spread over four codes.  Handling a pulse is what
+// pulse_server does, a line printed (to /dev/null, line buffered like a
+// terminal, so one write per line); coalesced, a line is printed per code
+// per batch.  Each mode reports the pulses received per second and the
+// high-water mark of the queue, the most pulses sent but not yet received
+// when one wakes the server.
+//
+// Built for QNX as pulse_coalesce_bench, and for Linux ("make host") as
+// pulse_coalesce_bench_host against the message passing stand-in in ../host.
+//
+// -p producers  producer threads (default 4)
+// -n pulses     pulses sent by each producer (default 100000)
+// -b burst      pulses sent back to back (default 64)
+// -i us         pause between bursts (default 0)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/neutrino.h>
+
+#include "pulse_batch.h"
+
+#define BENCH_CODES 4
+
+typedef union
+{
+	uint16_t type;
+	struct _pulse pulse;
+} recv_buf_t;
+
+static int chid;
+static unsigned producers = 4;
+static unsigned pulses = 100000;
+static unsigned burst = 64;
+static unsigned pause_us;
+
+static unsigned sent; // counted before each send
+static unsigned received;
+static unsigned high_water;
+static FILE *out;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *producer(void *arg)
+{
+	unsigned id = (uintptr_t)arg;
+	unsigned i;
+	int coid;
+
+	coid = ConnectAttach(0, 0, chid, _NTO_SIDE_CHANNEL, 0);
+	if (-1 == coid)
+	{
+		perror("ConnectAttach");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < pulses; i++)
+	{
+		if (0 != i && 0 == i % burst && 0 != pause_us)
+			usleep(pause_us);
+		__atomic_fetch_add(&sent, 1, __ATOMIC_RELAXED);
+		if (-1 == MsgSendPulse(coid, -1, _PULSE_CODE_MINAVAIL + (id + i) % BENCH_CODES, i))
+		{
+			perror("MsgSendPulse");
+			exit(EXIT_FAILURE);
+		}
+	}
+	ConnectDetach(coid);
+	return NULL;
+}
+
+// woken by a pulse, note how many are queued (counting it)
+static void note_queued(void)
+{
+	unsigned queued = __atomic_load_n(&sent, __ATOMIC_RELAXED) - received;
+
+	if (queued > high_water)
+		high_water = queued;
+}
+
+static void handle_coalesced(int code, unsigned count, int value, void *arg)
+{
+	fprintf(out, "we got %u pulses with a code of %d, the last with a value of %d\n", count,
+			code, value);
+}
+
+static void serve(int coalesce)
+{
+	unsigned total = producers * pulses;
+	pulse_batch_t batch;
+	recv_buf_t rbuf;
+	int rcvid;
+
+	pulse_batch_init(&batch);
+	while (received < total)
+	{
+		rcvid = MsgReceive(chid, &rbuf, sizeof(rbuf), NULL);
+		if (0 != rcvid)
+		{
+			perror("MsgReceive");
+			exit(EXIT_FAILURE);
+		}
+		note_queued();
+		if (!coalesce)
+		{
+			received++;
+			fprintf(out, "we got a pulse with a code of %d, and value of %d\n",
+					rbuf.pulse.code, rbuf.pulse.value.sival_int);
+			continue;
+		}
+		pulse_batch_add(&batch, &rbuf.pulse);
+		rcvid = pulse_batch_drain(chid, &batch, &rbuf, sizeof(rbuf), NULL);
+		if (-1 != rcvid || ETIMEDOUT != errno)
+		{
+			perror("MsgReceive");
+			exit(EXIT_FAILURE);
+		}
+		received += batch.pulses;
+		pulse_batch_flush(&batch, handle_coalesced, NULL);
+	}
+}
+
+static void run(int coalesce)
+{
+	pthread_t tids[producers];
+	uint64_t start, elapsed;
+	unsigned i;
+
+	sent = received = high_water = 0;
+	start = now_ns();
+	for (i = 0; i < producers; i++)
+	{
+		if (0 != pthread_create(&tids[i], NULL, producer, (void *)(uintptr_t)i))
+		{
+			fprintf(stderr, "pthread_create failed\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	serve(coalesce);
+	elapsed = now_ns() - start;
+	for (i = 0; i < producers; i++)
+		pthread_join(tids[i], NULL);
+
+	printf("%-10s %12.0f %12u\n", coalesce ? "coalesced" : "single", received * 1e9 / elapsed,
+			high_water);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:n:b:i:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'p':
+			producers = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			pulses = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			burst = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			pause_us = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (0 == producers || 0 == pulses || 0 == burst)
+	{
+		fprintf(stderr, "producers, pulses and burst must be positive\n");
+		exit(EXIT_FAILURE);
+	}
+
+	out = fopen("/dev/null", "w");
+	if (NULL == out)
+	{
+		perror("/dev/null");
+		exit(EXIT_FAILURE);
+	}
+	setvbuf(out, NULL, _IOLBF, BUFSIZ);
+
+	chid = ChannelCreate(0);
+	if (-1 == chid)
+	{
+		perror("ChannelCreate");
+		exit(EXIT_FAILURE);
+	}
+
+	printf("%u producers, %u pulses each in bursts of %u\n", producers, pulses, burst);
+	printf("%-10s %12s %12s\n", "server", "pulses/s", "high water");
+	run(0);
+	run(1);
+	return EXIT_SUCCESS;
+}
@@ -9,6 +9,10 @@
 //
 // Using the comments below, put code in to complete the program.  Look up
 // function arguments in the course book or the QNX documentation.
+//
+// Strings come either in the fixed size cksum_msg_t or, from newer clients,
+// as a cksum_str_hdr_t followed by just the string.  Only the header and a
+// short string fit in the receive buffer, a longer string is read in.
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <stdio.h>
@@ -18,16 +22,27 @@
 #include <process.h>
 
 #include "msg_def.h"  //layout of msg's should be defined by a struct, here's its definition
+#include "cksum.h"
+#include "cksum_str.h"
 
-int
-calculate_checksum(char *text);
+// room for a header and a string as long as the old fixed message held
+typedef union
+{
+	uint16_t type;
+	cksum_msg_t msg;
+	cksum_str_hdr_t str;
+} recv_buf_t;
 
 int main(void)
 {
 	int chid;
 	int pid;
 	int rcvid;
-	cksum_msg_t msg;
+	recv_buf_t rbuf;
+	struct _msg_info info;
+	size_t received;
+	const void *payload;
+	void *allocated;
 	int status;
 	int checksum;
 
@@ -46,17 +61,19 @@ int main(void)
 	while (1)
 	{
 		//PUT CODE HERE to receive msg from client, store the receive id in rcvid
-		rcvid = MsgReceive(chid, &msg, sizeof(msg), NULL);
+		rcvid = MsgReceive(chid, &rbuf, sizeof(rbuf), &info);
 		if (-1 == rcvid)
 		{ //was there an error receiving msg?
 			perror("MsgReceive"); //look up errno code and print
 			exit(EXIT_FAILURE); //give up
 		}
+		received = info.msglen < sizeof(rbuf) ? info.msglen : sizeof(rbuf);
 		//PUT CODE HERE to calculate the check sum by calling calculate_checksum()
-		if (msg.msg_type == CKSUM_MSG_TYPE)
+		if (rbuf.type == CKSUM_MSG_TYPE)
 		{
 			printf("Got a checksum message\n");
-			checksum = calculate_checksum(msg.string_to_cksum);
+			checksum = calculate_checksum_len(rbuf.msg.string_to_cksum,
+					cksum_str_fixed_len(&rbuf.msg, received));
 
 			//PUT CODE HERE TO reply to client with checksum, store the return status in status
 			status = MsgReply(rcvid, EOK, &checksum, sizeof(checksum));
@@ -66,9 +83,29 @@ int main(void)
 				exit(EXIT_FAILURE);
 			}
 		}
+		else if (rbuf.type == CKSUM_STR_MSG_TYPE)
+		{
+			payload = cksum_str_payload(rcvid, &rbuf.str, received, &allocated);
+			if (NULL == payload)
+			{
+				if (-1 == MsgError(rcvid, errno))
+					perror("MsgError");
+				continue;
+			}
+			printf("Got a checksum message of %u bytes\n", rbuf.str.length);
+			checksum = calculate_checksum_len(payload, rbuf.str.length);
+			free(allocated);
+
+			status = MsgReply(rcvid, EOK, &checksum, sizeof(checksum));
+			if (-1 == status)
+			{
+				perror("MsgReply");
+				exit(EXIT_FAILURE);
+			}
+		}
 		else
 		{
-			printf("Got an unknown message type %d\n", msg.msg_type);
+			printf("Got an unknown message type %d\n", rbuf.type);
 			if (-1 == MsgError(rcvid, ENOSYS ))
 			{
 				perror("MsgError");
@@ -79,14 +116,3 @@ int main(void)
 	}
 	return 0;
 }
-
-int calculate_checksum(char *text)
-{
-	char *c;
-	int cksum = 0;
-
-	for (c = text; *c != '\0'; c++)
-		cksum += *c;
-	return cksum;
-}
-
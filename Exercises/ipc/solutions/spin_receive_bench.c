@@ -0,0 +1,249 @@
+////////////////////////////////////////////////////////////////////////////////
+// spin_receive_bench.c
+//
+// Round trip latency with the server blocking in MsgReceive() against
+// busy-polling first (spin_receive.h), for a client that sends a request,
+// works on the reply for a while, and sends the next.
+//
+// As in msg_latency, the parent serves and a forked child is the client,
+// once per mode.  The client reports the round trip percentiles; the server
+// reports, through one last message, how its receives went (hits caught
+// spinning, misses that spun and blocked, receives that blocked straight
+// away), the time it spent spinning and the CPU time it used, both per
+// request.
+//
+// Built for QNX as spin_receive_bench, and for Linux ("make host") as
+// spin_receive_bench_host against the message passing stand-in in ../host.
+// Spinning only pays with a CPU for the server and one for the client.
+//
+// -n count   round trips per mode (default 20000)
+// -t us      client work between requests (default 20)
+// -s us      longest spin (default 100)
+// -S         the client sleeps between requests instead of working
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <sys/neutrino.h>
+#include <sys/iomsg.h>
+
+#include "cksum_hist.h"
+#include "spin_receive.h"
+
+#define BENCH_MSG_TYPE (_IO_MAX + 1)
+#define BENCH_STATS_TYPE (_IO_MAX + 2)
+
+#define WARMUP 1000
+
+typedef union
+{
+	uint16_t type;
+	struct _pulse pulse;
+} recv_buf_t;
+
+typedef struct
+{
+	spin_receive_t spin;
+	uint64_t cpu_ns; // the server's
+} bench_stats_t;
+
+static uint64_t clock_ns(clockid_t id)
+{
+	struct timespec ts;
+
+	clock_gettime(id, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t now_ns(void)
+{
+	return clock_ns(CLOCK_MONOTONIC);
+}
+
+static void serve(int chid, uint64_t max_spin_ns)
+{
+	bench_stats_t stats;
+	uint32_t result = 0;
+	recv_buf_t rbuf;
+	int rcvid;
+
+	spin_receive_init(&stats.spin, max_spin_ns);
+	while (1)
+	{
+		rcvid = spin_receive(&stats.spin, chid, &rbuf, sizeof(rbuf), NULL);
+		if (-1 == rcvid)
+		{
+			perror("MsgReceive");
+			exit(EXIT_FAILURE);
+		}
+		if (0 == rcvid)
+		{
+			if (_PULSE_CODE_DISCONNECT == rbuf.pulse.code)
+				return;
+			continue;
+		}
+		if (BENCH_STATS_TYPE == rbuf.type)
+		{
+			stats.cpu_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+			if (-1 == MsgReply(rcvid, EOK, &stats, sizeof(stats)))
+				perror("MsgReply");
+		}
+		else if (-1 == MsgReply(rcvid, EOK, &result, sizeof(result)))
+			perror("MsgReply");
+	}
+}
+
+static void work(unsigned think_us, int sleeping)
+{
+	struct timespec ts;
+	uint64_t until;
+
+	if (sleeping)
+	{
+		ts.tv_sec = 0;
+		ts.tv_nsec = think_us * 1000;
+		nanosleep(&ts, NULL);
+		return;
+	}
+	until = now_ns() + think_us * 1000ULL;
+	while (now_ns() < until)
+		;
+}
+
+static void client(pid_t server_pid, int chid, const char *mode, unsigned count,
+		unsigned think_us, int sleeping)
+{
+	uint16_t type = BENCH_MSG_TYPE;
+	bench_stats_t before, after;
+	cksum_hist_t *hist;
+	uint32_t result;
+	uint64_t t0;
+	unsigned i;
+	int coid;
+
+	coid = ConnectAttach(0, server_pid, chid, _NTO_SIDE_CHANNEL, 0);
+	hist = cksum_hist_create();
+	if (-1 == coid || NULL == hist)
+	{
+		perror("client");
+		exit(EXIT_FAILURE);
+	}
+
+	for (i = 0; i < WARMUP + count; i++)
+	{
+		if (WARMUP == i)
+		{
+			type = BENCH_STATS_TYPE;
+			if (-1 == MsgSend(coid, &type, sizeof(type), &before, sizeof(before)))
+				break;
+			type = BENCH_MSG_TYPE;
+		}
+		t0 = now_ns();
+		if (-1 == MsgSend(coid, &type, sizeof(type), &result, sizeof(result)))
+			break;
+		if (i >= WARMUP)
+			cksum_hist_record(hist, now_ns() - t0);
+		work(think_us, sleeping);
+	}
+	type = BENCH_STATS_TYPE;
+	if (i < WARMUP + count || -1 == MsgSend(coid, &type, sizeof(type), &after, sizeof(after)))
+	{
+		perror("MsgSend");
+		exit(EXIT_FAILURE);
+	}
+
+	printf("%-6s %8.2f %8.2f %8.2f %8.2f %8lu %8lu %8lu %8.2f %8.2f\n", mode,
+			cksum_hist_percentile(hist, 50) / 1e3, cksum_hist_percentile(hist, 99) / 1e3,
+			cksum_hist_percentile(hist, 99.9) / 1e3, cksum_hist_max(hist) / 1e3,
+			after.spin.hits - before.spin.hits, after.spin.misses - before.spin.misses,
+			after.spin.blocks - before.spin.blocks,
+			(after.spin.spin_ns - before.spin.spin_ns) / 1e3 / count,
+			(after.cpu_ns - before.cpu_ns) / 1e3 / count);
+	ConnectDetach(coid);
+	cksum_hist_destroy(hist);
+}
+
+static void run(const char *mode, uint64_t max_spin_ns, unsigned count, unsigned think_us,
+		int sleeping)
+{
+	int chid;
+	int status;
+	pid_t pid;
+
+	chid = ChannelCreate(_NTO_CHF_DISCONNECT);
+	if (-1 == chid)
+	{
+		perror("ChannelCreate");
+		exit(EXIT_FAILURE);
+	}
+
+	// flush before forking, or the child prints our buffered output again
+	fflush(stdout);
+	pid = fork();
+	if (-1 == pid)
+	{
+		perror("fork");
+		exit(EXIT_FAILURE);
+	}
+	if (0 == pid)
+	{
+		client(getppid(), chid, mode, count, think_us, sleeping);
+		exit(EXIT_SUCCESS);
+	}
+
+	serve(chid, max_spin_ns);
+	if (-1 == waitpid(pid, &status, 0) || !WIFEXITED(status) || EXIT_SUCCESS != WEXITSTATUS(status))
+	{
+		fprintf(stderr, "client failed\n");
+		exit(EXIT_FAILURE);
+	}
+	ChannelDestroy(chid);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned count = 20000;
+	unsigned think_us = 20;
+	unsigned max_spin_us = 100;
+	int sleeping = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:t:s:S")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			think_us = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			max_spin_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			sleeping = 1;
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (0 == count || 0 == max_spin_us)
+	{
+		fprintf(stderr, "count and spin must be positive\n");
+		exit(EXIT_FAILURE);
+	}
+
+	printf("%u round trips, client %s %u us between them, times in us\n", count,
+			sleeping ? "sleeping" : "working", think_us);
+	printf("%-6s %8s %8s %8s %8s %8s %8s %8s %8s %8s\n", "server", "p50", "p99", "p99.9", "max",
+			"hits", "misses", "blocks", "spin/req", "cpu/req");
+	run("block", 0, count, think_us, sleeping);
+	run("spin", max_spin_us * 1000ULL, count, think_us, sleeping);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+////////////////////////////////////////////////////////////////////////////////
+// spin_receive.c
+//
+// Busy-polling MsgReceive(), see spin_receive.h
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "spin_receive.h"
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void spin_receive_init(spin_receive_t *spin, uint64_t max_ns)
+{
+	memset(spin, 0, sizeof(*spin));
+	spin->max_ns = max_ns;
+	// start out spinning as long as allowed, the gaps soon say otherwise
+	spin->gap_ns = max_ns / 2 * 8;
+	spin->budget_ns = max_ns;
+}
+
+// fold in how long the request just received took to come
+static void adapt(spin_receive_t *spin, uint64_t gap)
+{
+	uint64_t avg;
+
+	// anything much longer than a spin is just idle, and shouldn't keep us
+	// from spinning for long once requests come quickly again
+	if (gap > spin->max_ns * 4)
+		gap = spin->max_ns * 4;
+	// gap_ns holds 8 times the average, this is avg += (gap - avg) / 8
+	spin->gap_ns += gap - spin->gap_ns / 8;
+	avg = spin->gap_ns / 8;
+	spin->budget_ns = avg * 2 > spin->max_ns ? 0 : avg * 2;
+}
+
+int spin_receive(spin_receive_t *spin, int chid, void *msg, size_t bytes,
+		struct _msg_info *info)
+{
+	struct sigevent event;
+	uint64_t start, now;
+	int rcvid;
+
+	if (0 == spin->max_ns)
+	{
+		spin->blocks++;
+		return MsgReceive(chid, msg, bytes, info);
+	}
+
+	start = now_ns();
+	if (0 != spin->budget_ns)
+	{
+		event.sigev_notify = SIGEV_UNBLOCK;
+		do
+		{
+			TimerTimeout(CLOCK_MONOTONIC, _NTO_TIMEOUT_RECEIVE, &event, NULL, NULL);
+			rcvid = MsgReceive(chid, msg, bytes, info);
+			now = now_ns();
+			if (-1 != rcvid || ETIMEDOUT != errno)
+			{
+				spin->hits++;
+				spin->spin_ns += now - start;
+				adapt(spin, now - start);
+				return rcvid;
+			}
+		} while (now - start < spin->budget_ns);
+		spin->misses++;
+		spin->spin_ns += now - start;
+	}
+	else
+		spin->blocks++;
+
+	rcvid = MsgReceive(chid, msg, bytes, info);
+	adapt(spin, now_ns() - start);
+	return rcvid;
+}
+
+void spin_receive_merge(spin_receive_t *dst, const spin_receive_t *src)
+{
+	dst->hits += src->hits;
+	dst->misses += src->misses;
+	dst->blocks += src->blocks;
+	dst->spin_ns += src->spin_ns;
+}
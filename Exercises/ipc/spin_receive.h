@@ -0,0 +1,52 @@
+#ifndef _SPIN_RECEIVE_H_
+#define _SPIN_RECEIVE_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// spin_receive.h
+//
+// MsgReceive() that busy-polls before it blocks, for servers whose clients
+// come back within microseconds, where being woken from a blocking receive
+// is most of the round trip.
+//
+// Called after a request is finished, spin_receive() first tries
+// non-blocking receives (TimerTimeout() with no time) for up to a spin
+// budget, then gives up and blocks.  The budget adapts: it is twice the
+// recent average gap between the call and the next request arriving,
+// capped at the maximum given, and nothing at all once requests come
+// further apart than that, so a server that is mostly idle stops burning
+// the CPU by itself.  It starts spinning again once requests come closer.
+//
+// Spinning takes a CPU the clients could use, it only pays where the server
+// has one to itself.  The counters say how it went: a hit is a request
+// caught while spinning, a miss a spin that ran out and blocked.
+//
+// Keep one spin_receive_t per receiving thread.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/neutrino.h>
+
+typedef struct
+{
+	uint64_t max_ns; // longest spin
+	uint64_t gap_ns; // average wait for the next request, scaled by 8
+	uint64_t budget_ns; // the next spin
+
+	unsigned long hits; // caught spinning
+	unsigned long misses; // spun, then blocked
+	unsigned long blocks; // blocked without spinning
+	uint64_t spin_ns; // time spent spinning, hits and misses
+} spin_receive_t;
+
+// max_ns 0 never spins, spin_receive() is then just MsgReceive()
+void spin_receive_init(spin_receive_t *spin, uint64_t max_ns);
+
+// MsgReceive(), spinning first as above
+int spin_receive(spin_receive_t *spin, int chid, void *msg, size_t bytes,
+		struct _msg_info *info);
+
+// add src's counters into dst
+void spin_receive_merge(spin_receive_t *dst, const spin_receive_t *src);
+
+#endif //_SPIN_RECEIVE_H_
@@ -12,6 +12,7 @@
 #include <sys/neutrino.h>
 
 #include "msg_def.h"
+#include "cksum.h"
 #include <unistd.h>
 
 typedef union
@@ -21,8 +22,6 @@ typedef union
 	struct _pulse pulse;
 } msg_buf_t;
 
-int calculate_checksum(char *text);
-
 int main(void)
 {
 	int rcvid;
@@ -102,14 +101,3 @@ int main(void)
 	}
 	return 0;
 }
-
-int calculate_checksum(char *text)
-{
-	char *c;
-	int cksum = 0;
-
-	for (c = text; *c != '\0'; c++)
-		cksum += *c;
-	return cksum;
-}
-
@@ -22,6 +22,8 @@
 #include <sys/neutrino.h>
 #include <sys/resmgr.h>
 
+#include "req_arena.h"
+
 /* default name for this device: /dev/example */
 
 #define EXAMPLE_NAME "/dev/example"
@@ -263,8 +265,11 @@ io_write (resmgr_context_t *ctp, io_write_t *msg, RESMGR_OCB_T *ocb)
     	return _RESMGR_NOREPLY;
     }
 
-    /* find somewhere to put the data -- in a real driver, this might be a hardware output buffer */
-    buf = malloc(msg->i.nbytes);
+    /* find somewhere to put the data -- in a real driver, this might be a hardware output buffer.
+     * It only has to last until we've replied, so it comes from the request arena rather than
+     * the heap (writes too big for the arena still go to the heap), and req_arena_reset() gives
+     * it back. */
+    buf = req_arena_alloc(msg->i.nbytes);
     if(buf == NULL) {
     	// oops, too big
     	return ENOMEM;
@@ -275,21 +280,24 @@ io_write (resmgr_context_t *ctp, io_write_t *msg, RESMGR_OCB_T *ocb)
 
     /* if we failed getting the data, return failure to client */
     if(nb == -1) {
-    	free(buf);
-    	return errno;
+    	status = errno;
+    	req_arena_reset();
+    	return status;
     }
 
     // dump that data out to stdout (printf would do this, but easier to
 	// use write than figure out the correct format string since this
 	// isn't null-terminated data)
 	status = write( STDOUT_FILENO, buf, nb );
-	free(buf);
 	if(status == -1) {
-		return errno;
+		status = errno;
+		req_arena_reset();
+		return status;
 	}
 
 	/* unblock the client with the correct number of bytes written */
 	MsgReply(ctp->rcvid, nb, NULL, 0);
+	req_arena_reset();
 
 	// if we actually handled any data, mark that a write was done for
 	// time updates (POSIX stuff)
@@ -11,6 +11,9 @@
  * -p prio      priority (default 40)
  * -t           trigger tracing on failure
  * -v           run verbose (cumulative verbosity level)
+ * -T file      trace each request (hw.msg), writing when it was sent and
+ *              when it was done to file, for cksum_trace_join with what
+ *              hw_server -T writes
  * 
  */
 
@@ -28,12 +31,18 @@
 #include <sys/trace.h>
 
 #include "hw_server.h"
+#include "name_cache.h"
+#include "cksum_trace.h"
 #include <string.h>
 
 /* connection to server */
 int server_coid;
 int verbose = 0;
 
+/* with -T, where the client's trace records go, and the last request's */
+FILE *trace_fp = NULL;
+uint64_t trace_id, send_ns, done_ns;
+
 
 /*
  * 	error_out
@@ -67,32 +76,49 @@ int do_work()
   static unsigned op = 0;
   int ret;
   
-  struct send_data_msg msg;
+  unsigned oplength;
   
-  msg.hdr.type = SEND_DATA;
-  msg.oplength = work_array[op];
+  oplength = work_array[op];
   op = (op +1) % 10;
   
-  ret = MsgSend(server_coid, &msg, sizeof(msg), NULL, 0 );
+  if( NULL != trace_fp )
+  {
+    trace_id = cksum_trace_next_id();
+    send_ns = cksum_trace_now();
+  }
+  ret = hw_send_data(HW_SERVER_NAME, oplength, trace_id, send_ns);
   if( -1 == ret ) 
     error_out( "MsgSend to hw_server", errno );
-  return msg.oplength; 
+  if( NULL != trace_fp )
+    done_ns = cksum_trace_now();
+  return oplength; 
+}
+
+/*
+ * 	trace_done
+ *
+ * 	This routine writes out the last request's trace record, once it
+ * 	has been timed
+ */
+void trace_done()
+{
+  if( NULL == trace_fp )
+    return;
+  if( fprintf( trace_fp, "%llu,%llu,%llu\n", (unsigned long long)trace_id,
+      (unsigned long long)send_ns, (unsigned long long)done_ns ) < 0 )
+    error_out( "writing trace", errno );
 }
 
 /*
  *	find_server
  *
- *	This routine opens the hardware server in preparation for IPC
+ *	This routine opens the hardware server in preparation for IPC,
+ *	waiting for it to attach its name if it isn't running yet.  If it
+ *	restarts later, do_work() finds the new one (see name_cache.h).
  */
 void find_server()
 {
-  while( 1 )
-  {
-    server_coid = name_open( HW_SERVER_NAME, 0 );
-    if( server_coid != -1)
-       break;
-    sleep(1);
-  }
+  server_coid = name_cache_wait( HW_SERVER_NAME, NAME_CACHE_FOREVER );
   if( -1 == server_coid ) 
      error_out("failed to find server: " HW_SERVER_NAME, errno );
   if(verbose) printf("server_coid is %x\n", server_coid);
@@ -122,7 +148,7 @@ int main( int argc, char *argv[])
   deadline = 1000*1000; // default to 1 millisecond
 
   /* parse arguments */  
-  while (( opt = getopt( argc, argv, "d:p:vt" )) != -1 )
+  while (( opt = getopt( argc, argv, "d:p:vtT:" )) != -1 )
   {
     switch( opt )
     {
@@ -141,6 +167,14 @@ int main( int argc, char *argv[])
     case 't':
     	trigger++;
         break;
+    case 'T':
+        trace_fp = fopen( optarg, "w" );
+        if( NULL == trace_fp )
+          error_out( optarg, errno );
+        /* a line at a time, so what was traced is there when it is killed */
+        setvbuf( trace_fp, NULL, _IOLBF, 0 );
+        fprintf( trace_fp, "%s\n", CKSUM_TRACE_CLIENT_CSV );
+        break;
     }
   }
   
@@ -182,6 +216,7 @@ int main( int argc, char *argv[])
       oplength = do_work();
       clock_after = ClockCycles();
       clock_delta_ns = 1000000000 * (clock_after-clock_before)/cps;
+      trace_done();
       if(verbose) printf("elapsed: %ld ns,  oplength: %d us\n", clock_delta_ns, oplength );
       if( clock_delta_ns < deadline )
       {
@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////////////////////////////
+// hw_msgs.c
+//
+// Generated by msggen from hw.msg, don't edit, see hw_msgs.h
+////////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/neutrino.h>
+
+#include "name_cache.h"
+#include "hw_msgs.h"
+
+// each type's header size, where the length of the data after it is (and
+// its size, 0 for none), the most data it can have and if it is a string
+static const struct
+{
+	uint16_t size;
+	uint16_t len_offset;
+	uint8_t len_size;
+	uint8_t string;
+	uint32_t max;
+} layouts[HW_NUM_MSGS] =
+{
+	{ sizeof(hw_send_data_t), 0, 0, 0, 0 },
+	{ sizeof(hw_get_data_t), 0, 0, 0, 0 },
+};
+
+static int refuse(int rcvid, int error)
+{
+	if (-1 == MsgError(rcvid, error))
+		perror("MsgError");
+	return -1;
+}
+
+int hw_dispatch(int rcvid, hw_rx_t *msg, size_t received,
+		const hw_handler_t handlers[HW_NUM_MSGS], hw_handler_t other, void *ctx)
+{
+	unsigned idx;
+	uint32_t len = 0;
+	uint16_t len16;
+
+	if (received > sizeof(*msg))
+		received = sizeof(*msg);
+	if (received < sizeof(msg->type))
+		return refuse(rcvid, EBADMSG);
+	// below the base wraps round to far past the end
+	idx = (unsigned)(msg->type - HW_MSG_BASE);
+	if (idx >= HW_NUM_MSGS || NULL == handlers[idx])
+	{
+		if (NULL != other)
+			return other(rcvid, msg, received, ctx);
+		return refuse(rcvid, ENOSYS);
+	}
+	if (received < layouts[idx].size)
+		return refuse(rcvid, EBADMSG);
+	if (layouts[idx].len_size)
+	{
+		if (sizeof(len16) == layouts[idx].len_size)
+		{
+			memcpy(&len16, msg->max + layouts[idx].len_offset, sizeof(len16));
+			len = len16;
+		}
+		else
+			memcpy(&len, msg->max + layouts[idx].len_offset, sizeof(len));
+		if (len > layouts[idx].max)
+			return refuse(rcvid, EMSGSIZE);
+		if (received < layouts[idx].size + len)
+			return refuse(rcvid, EBADMSG);
+		if (layouts[idx].string)
+			msg->max[layouts[idx].size + len] = '\0';
+	}
+	return handlers[idx](rcvid, msg, received, ctx);
+}
+
+int hw_send_data(const char *name, uint32_t oplength, uint64_t trace_id, uint64_t client_ns)
+{
+	hw_send_data_t msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = HW_MSG_SEND_DATA;
+	msg.oplength = oplength;
+	msg.trace_id = trace_id;
+	msg.client_ns = client_ns;
+	if (-1 == name_cache_send(name, &msg, sizeof(msg), NULL, 0))
+		return -1;
+	return 0;
+}
+
+int hw_get_data(const char *name, uint32_t bytes_needed, uint64_t trace_id, uint64_t client_ns)
+{
+	hw_get_data_t msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = HW_MSG_GET_DATA;
+	msg.bytes_needed = bytes_needed;
+	msg.trace_id = trace_id;
+	msg.client_ns = client_ns;
+	if (-1 == name_cache_send(name, &msg, sizeof(msg), NULL, 0))
+		return -1;
+	return 0;
+}
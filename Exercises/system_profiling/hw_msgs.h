@@ -0,0 +1,93 @@
+#ifndef _HW_MSGS_H_
+#define _HW_MSGS_H_
+
+////////////////////////////////////////////////////////////////////////////////
+// hw_msgs.h
+//
+// Generated by msggen from hw.msg, don't edit: change that and run
+// "make msgs".
+//
+// What each message puts on the wire (header, then its data), with the
+// padding left in it:
+//
+//   send_data             24 bytes, 2 padding
+//   get_data              24 bytes, 2 padding
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/neutrino.h>
+#include <sys/iomsg.h>
+
+#define HW_MSG_BASE (_IO_MAX + 1)
+#define HW_NUM_MSGS 2
+
+// message types, and their places in a handler table
+#define HW_MSG_SEND_DATA (HW_MSG_BASE + 0)
+#define HW_IDX_SEND_DATA 0
+#define HW_MSG_GET_DATA (HW_MSG_BASE + 1)
+#define HW_IDX_GET_DATA 1
+
+// a high priority client has work for the hardware
+typedef struct
+{
+	uint16_t type;
+	uint8_t reserved0[2];
+	uint32_t oplength; // how long the hardware is busy with it
+	uint64_t trace_id;
+	uint64_t client_ns;
+} hw_send_data_t;
+_Static_assert(sizeof(hw_send_data_t) == 24, "hw_send_data_t is 24 bytes");
+_Static_assert(offsetof(hw_send_data_t, reserved0) == 2, "reserved0 at 2");
+_Static_assert(offsetof(hw_send_data_t, oplength) == 4, "oplength at 4");
+_Static_assert(offsetof(hw_send_data_t, trace_id) == 8, "trace_id at 8");
+_Static_assert(offsetof(hw_send_data_t, client_ns) == 16, "client_ns at 16");
+
+// a low priority client wants data from the hardware
+typedef struct
+{
+	uint16_t type;
+	uint8_t reserved0[2];
+	uint32_t bytes_needed;
+	uint64_t trace_id;
+	uint64_t client_ns;
+} hw_get_data_t;
+_Static_assert(sizeof(hw_get_data_t) == 24, "hw_get_data_t is 24 bytes");
+_Static_assert(offsetof(hw_get_data_t, reserved0) == 2, "reserved0 at 2");
+_Static_assert(offsetof(hw_get_data_t, bytes_needed) == 4, "bytes_needed at 4");
+_Static_assert(offsetof(hw_get_data_t, trace_id) == 8, "trace_id at 8");
+_Static_assert(offsetof(hw_get_data_t, client_ns) == 16, "client_ns at 16");
+
+// everything the server receives: a pulse, or any message with all of
+// its data (and a nul after a string), so one MsgReceive() gets it all
+#define HW_RX_SIZE 24
+
+typedef union
+{
+	uint16_t type;
+	struct _pulse pulse;
+	hw_send_data_t send_data;
+	hw_get_data_t get_data;
+	char max[HW_RX_SIZE];
+} hw_rx_t;
+
+// handles one message; what it returns, hw_dispatch() does
+typedef int (*hw_handler_t)(int rcvid, hw_rx_t *msg, size_t received, void *ctx);
+
+// server side: check the message received into msg (received bytes of it)
+// against the layout of its type and call handlers[type - HW_MSG_BASE]
+// with it.  Types outside the protocol, or without a handler, go to other
+// (or, if that is NULL, get MsgError(ENOSYS)).  A message too short for
+// its type gets MsgError(EBADMSG), one with too much data EMSGSIZE, and
+// -1 is returned.
+int hw_dispatch(int rcvid, hw_rx_t *msg, size_t received,
+		const hw_handler_t handlers[HW_NUM_MSGS], hw_handler_t other, void *ctx);
+
+// client side: send each message to the server attached as name, waiting
+// for it and sending again if it restarts (name_cache_send()).  The
+// header goes from the stack and any data straight from the caller's
+// buffer.  Return 0, or -1 with errno set (EMSGSIZE for too much data).
+int hw_send_data(const char *name, uint32_t oplength, uint64_t trace_id, uint64_t client_ns);
+int hw_get_data(const char *name, uint32_t bytes_needed, uint64_t trace_id, uint64_t client_ns);
+
+#endif //_HW_MSGS_H_
@@ -9,6 +9,14 @@
  * 
  * -t number of threads (default 4)
  * -v verbose (multiple vs possible)
+ * -b busy-poll for up to this many microseconds before blocking in
+ *    MsgReceive() (spin_receive.h), for clients that come straight back.
+ *    Each thread polls on its own, so it is best used with few threads.
+ *    How the receives went is printed on SIGINT or SIGTERM.
+ * -T file: record when each traced message (one with a trace id, see
+ *    hw.msg) was received, got the hardware and was replied to, and write
+ *    them to file on SIGUSR1 (../ipc/solutions/cksum_trace.h).  Time spent
+ *    waiting for the hardware lock shows as queueing in cksum_trace_join.
  * 
  */
 
@@ -23,8 +31,11 @@
 #include <sys/trace.h>
 #include <sys/syspage.h>
 #include <inttypes.h>
+#include <signal.h>
 
 #include "hw_server.h"
+#include "spin_receive.h"
+#include "cksum_trace.h"
 #include <string.h>
 
 /* #define PRIO_FIX */
@@ -54,6 +65,9 @@ struct hw_descriptor hw_device;
 struct sched_param sched_param;
 name_attach_t *attach;
 int verbose = 0;
+unsigned spin_us = 0;
+spin_receive_t *spin_stats; /* one per thread */
+const char *trace_path = NULL;
 
 /*
  * 	error_out
@@ -175,13 +189,15 @@ void hw_unlock()
 /*
  * hw_out
  *
- * lock hardware structure for safe access
+ * lock hardware structure for safe access, noting when in trace if tracing
  * pretend to do hardware work by delaying some time with nanospin_clock()
  * unlock hardware structure
  */
-void hw_out(int period)
+void hw_out(int period, cksum_trace_rec_t *trace)
 {
 	hw_lock();
+	if (NULL != trace)
+		trace->dequeue_ns = trace->compute_ns = cksum_trace_now();
 	if (verbose)
 		printf("hw_out(high) post-lock, period: %d\n", period);
 
@@ -197,14 +213,16 @@ void hw_out(int period)
 /*
  * hw_in
  *
- * lock hardware structure for safe access
+ * lock hardware structure for safe access, noting when in trace if tracing
  * pretend to do hardware work by delaying some time with nanospin_clock()
  * unlock hardware structure
  */
-void hw_in(int length)
+void hw_in(int length, cksum_trace_rec_t *trace)
 {
 
 	hw_lock();
+	if (NULL != trace)
+		trace->dequeue_ns = trace->compute_ns = cksum_trace_now();
 	if (verbose)
 		printf("hw_in(low) post-lock, length %d\n", length);
 
@@ -221,20 +239,123 @@ void hw_in(int length)
 		printf("hw_in(low) post-unlock\n");
 }
 
+/*
+ * trace_start
+ *
+ * with -T, start trace off for a message that carries a trace id, received
+ * at *received_ns, and return it; otherwise NULL, and nothing is recorded
+ */
+cksum_trace_rec_t *trace_start(cksum_trace_rec_t *trace, uint64_t trace_id,
+		uint64_t client_ns, uint32_t length, const uint64_t *received_ns)
+{
+	if (NULL == trace_path || 0 == trace_id)
+		return NULL;
+	memset(trace, 0, sizeof(*trace));
+	trace->trace_id = trace_id;
+	trace->client_ns = client_ns;
+	trace->receive_ns = *received_ns;
+	trace->length = length;
+	return trace;
+}
+
+/*
+ * reply_ok
+ *
+ * reply EOK, and record the trace if there is one once the client has it
+ */
+void reply_ok(int rcvid, cksum_trace_rec_t *trace)
+{
+	if (NULL != trace)
+		trace->reply_ns = cksum_trace_now();
+	if ( -1 == MsgReply(rcvid, EOK, NULL, 0) )
+		perror( "MsgReply" );
+	if (NULL != trace)
+		(void)cksum_trace_record(trace);
+}
+
+/*
+ * send_data, get_data
+ *
+ * handlers for our two messages, called by hw_dispatch() once it has checked
+ * the message is as long as its type says.  ctx is when it was received.
+ */
+int send_data(int rcvid, hw_rx_t *msg, size_t received, void *ctx)
+{
+	cksum_trace_rec_t trace;
+	cksum_trace_rec_t *tracing;
+
+	tracing = trace_start(&trace, msg->send_data.trace_id, msg->send_data.client_ns,
+			msg->send_data.oplength, ctx);
+	if (verbose)
+		printf("started send (high prio)\n");
+	hw_out(msg->send_data.oplength, tracing);
+	if (verbose)
+		printf("finished send (high prio)\n");
+	reply_ok(rcvid, tracing);
+	return 0;
+}
+
+int get_data(int rcvid, hw_rx_t *msg, size_t received, void *ctx)
+{
+	cksum_trace_rec_t trace;
+	cksum_trace_rec_t *tracing;
+
+	tracing = trace_start(&trace, msg->get_data.trace_id, msg->get_data.client_ns,
+			msg->get_data.bytes_needed, ctx);
+	if (verbose)
+		printf("started get (low prio)\n");
+	hw_in(msg->get_data.bytes_needed, tracing);
+	if (verbose)
+		printf("finished get (low prio)\n");
+	reply_ok(rcvid, tracing);
+	return 0;
+}
+
+/*
+ * other_msg
+ *
+ * name_open() connecting to us, or anything else
+ */
+int other_msg(int rcvid, hw_rx_t *msg, size_t received, void *ctx)
+{
+	if (_IO_CONNECT == msg->type)
+	{
+		if ( -1 == MsgReply(rcvid, EOK, NULL, 0) )
+			perror( "MsgReply" );
+		return 0;
+	}
+	if (verbose)
+		printf("hwserver: Unexpected message\n");
+	if ( -1 == MsgError(rcvid, ENOSYS ) )
+		perror( "MsgError" );
+	return -1;
+}
+
+const hw_handler_t handlers[HW_NUM_MSGS] =
+{
+	[HW_IDX_SEND_DATA] = send_data,
+	[HW_IDX_GET_DATA] = get_data,
+};
+
 /*
  * mainloop
  *
  * while 1 loop receiving messages and processing them *
  * called by multiple threads
  */
-void mainloop()
+void mainloop(spin_receive_t *spin)
 {
 	int rcvid;
-	hw_msgs_t msg;
+	hw_rx_t msg;
+	struct _msg_info info;
+	uint64_t received_ns = 0;
 
+	spin_receive_init(spin, spin_us * 1000ULL);
 	while (1)
 	{
-		rcvid = MsgReceive(attach->chid, &msg, sizeof(msg), NULL );
+		rcvid = spin_receive(spin, attach->chid, &msg, sizeof(msg), &info );
+		if (NULL != trace_path)
+			received_ns = cksum_trace_now();
 		if (verbose > 2)
 			printf("hw_server: unblocked from receive\n");
 		if (-1 == rcvid)
@@ -248,38 +369,8 @@ void mainloop()
 		}
 		if (verbose > 1)
 			printf("hw_server: got a message, type:%d expecting: %d or %d\n",
-					msg.hdr.type, SEND_DATA, GET_DATA );
-		switch (msg.hdr.type)
-		{
-		case _IO_CONNECT:
-			if ( -1 == MsgReply(rcvid, EOK, NULL, 0) )
-				perror( "MsgReply" );
-			break;
-		case SEND_DATA:
-			if (verbose)
-				printf("started send (high prio)\n");
-			hw_out(msg.snd.oplength);
-			if (verbose)
-				printf("finished send (high prio)\n");
-			if ( -1 == MsgReply(rcvid, EOK, NULL, 0) )
-				perror( "MsgReply" );
-			break;
-		case GET_DATA:
-			if (verbose)
-				printf("started get (low prio)\n");
-			hw_in(msg.get.bytes_needed);
-			if (verbose)
-				printf("finished get (low prio)\n");
-			if ( -1 == MsgReply(rcvid, EOK, NULL, 0) )
-				perror( "MsgReply" );
-			break;
-		default:
-			if (verbose)
-				printf("hwserver: Unexpected message\n");
-			if ( -1 == MsgError(rcvid, ENOSYS ) )
-				perror( "MsgError" );
-			break;
-		}
+					msg.type, HW_MSG_SEND_DATA, HW_MSG_GET_DATA );
+		hw_dispatch(rcvid, &msg, info.msglen, handlers, other_msg, &received_ns);
 	}
 }
 
@@ -292,7 +383,7 @@ void mainloop()
 
 void * thread_func(void * thread_data)
 {
-	mainloop();
+	mainloop(thread_data);
 	return NULL;
 }
 
@@ -306,18 +397,42 @@ void create_threads(int num_threads)
 	int i;
 	int ret;
 
-	/* if one thread, become the main loop */
-	if (1 == num_threads)
-		mainloop();
+	spin_stats = calloc(num_threads, sizeof(*spin_stats));
+	if (NULL == spin_stats)
+		error_out("calloc", errno );
+
+	/* if one thread, become the main loop, unless main has to report */
+	if (1 == num_threads && !spin_us)
+		mainloop(&spin_stats[0]);
 	else
 		for (i = 0; i < num_threads; i++)
 		{
-			ret = pthread_create(NULL, NULL, thread_func, NULL );
+			ret = pthread_create(NULL, NULL, thread_func, &spin_stats[i] );
 			if (-1 == ret)
 				error_out("pthread_create", errno );
 		}
 }
 
+/*
+ * spin_report
+ *
+ * wait to be killed, then print how the busy-polling receives went
+ */
+void spin_report(int num_threads, sigset_t *sigs)
+{
+	spin_receive_t total;
+	int signo;
+	int i;
+
+	sigwait(sigs, &signo);
+	memset(&total, 0, sizeof(total));
+	for (i = 0; i < num_threads; i++)
+		spin_receive_merge(&total, &spin_stats[i]);
+	printf("hw_server: busy-poll: %lu hits, %lu misses, %lu blocked, %.3f s spinning\n",
+			total.hits, total.misses, total.blocks, total.spin_ns / 1e9);
+	exit(EXIT_SUCCESS);
+}
+
 /*
  * main
  */
@@ -325,18 +440,25 @@ int main(int argc, char *argv[])
 {
 	int opt;
 	int num_threads = 4;
+	sigset_t sigs;
 
 	/* parse arguments */
-	while ((opt = getopt(argc, argv, "t:v")) != -1)
+	while ((opt = getopt(argc, argv, "t:vb:T:")) != -1)
 	{
 		switch (opt)
 		{
 		case 't':
 			num_threads = atoi(optarg);
 			break;
+		case 'b':
+			spin_us = strtoul(optarg, NULL, 0);
+			break;
 		case 'v':
 			verbose++;
 			break;
+		case 'T':
+			trace_path = optarg;
+			break;
 		}
 	}
 
@@ -345,8 +467,20 @@ int main(int argc, char *argv[])
 
 	init();
 
+	/* the receiving threads mustn't take the signals main waits for */
+	sigemptyset(&sigs);
+	sigaddset(&sigs, SIGINT);
+	sigaddset(&sigs, SIGTERM);
+	if (spin_us)
+		pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+	if (NULL != trace_path && -1 == cksum_trace_start_writer(trace_path, "hw_server"))
+		error_out("cksum_trace_start_writer", errno );
+
 	create_threads(num_threads);
 
+	if (spin_us)
+		spin_report(num_threads, &sigs);
+
 	/* wait to be killed */
 	pause();
 	return EXIT_FAILURE;
@@ -2,41 +2,12 @@
  * 	hw_server.h
  */
 
-
-#include <sys/iomsg.h>
+/*
+ * the messages, their HW_MSG_* type codes, the union hw_server receives into,
+ * its dispatcher and the client stubs are generated from hw.msg into
+ * hw_msgs.h and hw_msgs.c by ../ipc/msggen -- change hw.msg and "make msgs"
+ * rather than editing them
+ */
+#include "hw_msgs.h"
 
 #define HW_SERVER_NAME "HW_SERVER"
-
-struct hw_msg_hdr
-{
-	short type;
-	short subtype;
-};
-
-struct send_data_msg
-{
-	struct hw_msg_hdr hdr;
-	unsigned oplength;
-/* data follows structure in memory */
-};
-
-struct get_data_msg
-{
-	struct hw_msg_hdr hdr;
-	unsigned bytes_needed;
-};
-
-typedef union hw_msgs
-{
-	struct _pulse pulse;
-	struct send_data_msg snd;
-	struct get_data_msg get;
-	struct hw_msg_hdr hdr;
-} hw_msgs_t;
-
-/* message types */
-
-/* don't conflict with system messages */
-#define MSG_BASE (_IO_MAX + 1 )
-#define SEND_DATA MSG_BASE
-#define GET_DATA (MSG_BASE + 1)
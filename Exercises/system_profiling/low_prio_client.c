@@ -5,6 +5,9 @@
  * It will do a series of operations of varying lengths on a 4 ms interval,
  * 
  * -p priority (default 10)
+ * -T file     trace each request (hw.msg), writing when it was sent and
+ *             when it was done to file, for cksum_trace_join with what
+ *             hw_server -T writes
  * 
  */
 
@@ -19,12 +22,17 @@
 #include <inttypes.h>
 
 #include "hw_server.h"
+#include "name_cache.h"
+#include "cksum_trace.h"
 #include <string.h>
 
 /* connection to server */
 int server_coid;
 int verbose = 0;
 
+/* with -T, where the client's trace records go */
+FILE *trace_fp = NULL;
+
 /*
  * 	error_out
  *
@@ -57,31 +65,36 @@ void do_work()
 	static int op = 0;
 	int ret;
 
-	struct get_data_msg msg;
+	unsigned bytes_needed;
+	uint64_t trace_id = 0, send_ns = 0;
 
-	msg.hdr.type = GET_DATA;
-	msg.bytes_needed = work_array[op];
+	bytes_needed = work_array[op];
 	op++;
 	op %= 10;
-	ret = MsgSend(server_coid, &msg, sizeof(msg), NULL, 0);
+	if (NULL != trace_fp)
+	{
+		trace_id = cksum_trace_next_id();
+		send_ns = cksum_trace_now();
+	}
+	ret = hw_get_data(HW_SERVER_NAME, bytes_needed, trace_id, send_ns);
 	if (-1 == ret)
 		error_out("MsgSend to hw_server", errno );
+	if (NULL != trace_fp && fprintf(trace_fp, "%llu,%llu,%llu\n",
+			(unsigned long long)trace_id, (unsigned long long)send_ns,
+			(unsigned long long)cksum_trace_now()) < 0)
+		error_out("writing trace", errno );
 }
 
 /*
  *	find_server
  *
- *	This routine opens the hardware server in preparation for IPC
+ *	This routine opens the hardware server in preparation for IPC,
+ *	waiting for it to attach its name if it isn't running yet.  If it
+ *	restarts later, do_work() finds the new one (see name_cache.h).
  */
 void find_server()
 {
-	while (1)
-	{
-		server_coid = name_open(HW_SERVER_NAME, 0);
-		if (server_coid != -1)
-			break;
-		sleep(1);
-	}
+	server_coid = name_cache_wait(HW_SERVER_NAME, NAME_CACHE_FOREVER);
 	if (-1 == server_coid)
 		error_out("failed to find server: " HW_SERVER_NAME, errno );
 }
@@ -102,7 +115,7 @@ int main(int argc, char *argv[])
 	int ret;
 
 	/* parse arguments */
-	while ((opt = getopt(argc, argv, "p:")) != -1)
+	while ((opt = getopt(argc, argv, "p:vT:")) != -1)
 	{
 		switch (opt)
 		{
@@ -112,6 +125,14 @@ int main(int argc, char *argv[])
 		case 'v':
 			verbose++;
 			break;
+		case 'T':
+			trace_fp = fopen(optarg, "w");
+			if (NULL == trace_fp)
+				error_out(optarg, errno );
+			/* a line at a time, so what was traced is there when it is killed */
+			setvbuf(trace_fp, NULL, _IOLBF, 0);
+			fprintf(trace_fp, "%s\n", CKSUM_TRACE_CLIENT_CSV);
+			break;
 		}
 	}
 